@@ -59,6 +59,8 @@ typedef struct ScmConvInfoRec {
     const char *toCode;         /* conver to ... */
     int istate;                 /* current input state */
     int ostate;                 /* current output state */
+    int asciiIn;                /* how ASCII chars are encoded in input and */
+    int asciiOut;               /*  output, for bulk conversion (jconv.c) */
     ScmPort *remote;            /* source or drain port */
     int ownerp;                 /* do I own remote port? */
     int remoteClosed;           /* true if remore port is closed */
@@ -1879,6 +1879,253 @@ static ScmSize jconv_ident(ScmConvInfo *cinfo SCM_UNUSED, const char **iptr,
     }
 }
 
+/*=================================================================
+ * Bulk ASCII runs
+ *
+ *   In all the encodings above, an ASCII character is encoded as itself
+ *   in a unit of 1, 2 or 4 octets (ISO-2022-JP only in JIS_ASCII state,
+ *   and UTF-16/32 once the endianness is determined).  Since most text
+ *   is mostly ASCII, jconv_1tier converts runs of them in bulk instead
+ *   of calling the conversion routine for each character.
+ */
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define ASCII_RUN_SSE2 1
+#else
+#define ASCII_RUN_SSE2 0
+#endif
+
+enum {
+    ASCII_NONE,                 /* no bulk conversion */
+    ASCII_BYTE,                 /* single octet 0x00-0x7f */
+    ASCII_JIS,                  /* ditto, in JIS_ASCII state */
+    ASCII_UTF16,                /* 16bit unit */
+    ASCII_UTF32                 /* 32bit unit */
+};
+
+static int ascii_kind(int code)
+{
+    switch (code) {
+    case JCODE_ASCII: case JCODE_EUCJ: case JCODE_SJIS:
+    case JCODE_UTF8: case JCODE_UTF8BOM:
+    case JCODE_ISO8859_1: case JCODE_ISO8859_2: case JCODE_ISO8859_3:
+    case JCODE_ISO8859_4: case JCODE_ISO8859_5: case JCODE_ISO8859_6:
+    case JCODE_ISO8859_7: case JCODE_ISO8859_8: case JCODE_ISO8859_9:
+    case JCODE_ISO8859_10: case JCODE_ISO8859_11: case JCODE_ISO8859_13:
+    case JCODE_ISO8859_14: case JCODE_ISO8859_15: case JCODE_ISO8859_16:
+        return ASCII_BYTE;
+    case JCODE_ISO2022JP:
+        return ASCII_JIS;
+    case JCODE_UTF16: case JCODE_UTF16BE: case JCODE_UTF16LE:
+        return ASCII_UTF16;
+    case JCODE_UTF32: case JCODE_UTF32BE: case JCODE_UTF32LE:
+        return ASCII_UTF32;
+    default:
+        return ASCII_NONE;
+    }
+}
+
+/* The following routines convert at most N leading ASCII characters
+   of IN into OUT, and return the number of characters converted. */
+
+static ScmSize ascii_copy(const u_char *in, ScmSize n, u_char *out)
+{
+    ScmSize i = 0;
+#if ASCII_RUN_SSE2
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in+i));
+        if (_mm_movemask_epi8(v)) break;
+        _mm_storeu_si128((__m128i*)(out+i), v);
+    }
+#else  /*!ASCII_RUN_SSE2*/
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        memcpy(&w, in+i, 8);
+        if (w & 0x8080808080808080ULL) break;
+        memcpy(out+i, &w, 8);
+    }
+#endif /*!ASCII_RUN_SSE2*/
+    for (; i < n && in[i] < 0x80; i++) out[i] = in[i];
+    return i;
+}
+
+static ScmSize ascii_widen16(const u_char *in, ScmSize n, u_char *out, int be)
+{
+    ScmSize i = 0;
+#if ASCII_RUN_SSE2
+    const __m128i z = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in+i));
+        if (_mm_movemask_epi8(v)) break;
+        __m128i lo = be ? _mm_unpacklo_epi8(z, v) : _mm_unpacklo_epi8(v, z);
+        __m128i hi = be ? _mm_unpackhi_epi8(z, v) : _mm_unpackhi_epi8(v, z);
+        _mm_storeu_si128((__m128i*)(out+i*2), lo);
+        _mm_storeu_si128((__m128i*)(out+i*2+16), hi);
+    }
+#endif /*ASCII_RUN_SSE2*/
+    for (; i < n && in[i] < 0x80; i++) {
+        out[i*2]   = be ? 0 : in[i];
+        out[i*2+1] = be ? in[i] : 0;
+    }
+    return i;
+}
+
+static ScmSize ascii_widen32(const u_char *in, ScmSize n, u_char *out, int be)
+{
+    ScmSize i = 0;
+#if ASCII_RUN_SSE2
+    const __m128i z = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in+i));
+        if (_mm_movemask_epi8(v)) break;
+        __m128i w[2], d[4];
+        w[0] = be ? _mm_unpacklo_epi8(z, v) : _mm_unpacklo_epi8(v, z);
+        w[1] = be ? _mm_unpackhi_epi8(z, v) : _mm_unpackhi_epi8(v, z);
+        for (int k = 0; k < 2; k++) {
+            d[k*2]   = be ? _mm_unpacklo_epi16(z, w[k])
+                          : _mm_unpacklo_epi16(w[k], z);
+            d[k*2+1] = be ? _mm_unpackhi_epi16(z, w[k])
+                          : _mm_unpackhi_epi16(w[k], z);
+        }
+        for (int k = 0; k < 4; k++) {
+            _mm_storeu_si128((__m128i*)(out+i*4+k*16), d[k]);
+        }
+    }
+#endif /*ASCII_RUN_SSE2*/
+    for (; i < n && in[i] < 0x80; i++) {
+        out[i*4]   = 0;
+        out[i*4+1] = 0;
+        out[i*4+2] = 0;
+        out[i*4+3] = 0;
+        out[be ? i*4+3 : i*4] = in[i];
+    }
+    return i;
+}
+
+static ScmSize ascii_narrow16(const u_char *in, ScmSize n, u_char *out, int be)
+{
+    ScmSize i = 0;
+#if ASCII_RUN_SSE2
+    /* We load units as little-endian, so an ASCII char in UTF-16BE
+       appears as c<<8. */
+    const __m128i z = _mm_setzero_si128();
+    const __m128i m = _mm_set1_epi16(be ? (short)0x80ff : (short)0xff80);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in+i*2));
+        __m128i t = _mm_cmpeq_epi16(_mm_and_si128(v, m), z);
+        if (_mm_movemask_epi8(t) != 0xffff) break;
+        if (be) v = _mm_srli_epi16(v, 8);
+        _mm_storel_epi64((__m128i*)(out+i), _mm_packus_epi16(v, v));
+    }
+#endif /*ASCII_RUN_SSE2*/
+    for (; i < n; i++) {
+        u_char h = in[be ? i*2 : i*2+1], l = in[be ? i*2+1 : i*2];
+        if (h != 0 || l >= 0x80) break;
+        out[i] = l;
+    }
+    return i;
+}
+
+static ScmSize ascii_narrow32(const u_char *in, ScmSize n, u_char *out, int be)
+{
+    ScmSize i = 0;
+#if ASCII_RUN_SSE2
+    const __m128i z = _mm_setzero_si128();
+    const __m128i m = _mm_set1_epi32(be ? (int)0x80ffffff : (int)0xffffff80);
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in+i*4));
+        __m128i t = _mm_cmpeq_epi32(_mm_and_si128(v, m), z);
+        if (_mm_movemask_epi8(t) != 0xffff) break;
+        if (be) v = _mm_srli_epi32(v, 24);
+        v = _mm_packs_epi32(v, v);
+        v = _mm_packus_epi16(v, v);
+        int w = _mm_cvtsi128_si32(v);
+        memcpy(out+i, &w, 4);
+    }
+#endif /*ASCII_RUN_SSE2*/
+    for (; i < n; i++) {
+        const u_char *u = in + i*4;
+        u_char c = be ? u[3] : u[0];
+        if ((be ? (u[0]|u[1]|u[2]) : (u[1]|u[2]|u[3])) != 0 || c >= 0x80) {
+            break;
+        }
+        out[i] = c;
+    }
+    return i;
+}
+
+static inline int utf_endian_known(int state)
+{
+    return state == UTF_BE || state == UTF_LE;
+}
+
+/* Converts the run of ASCII characters at the beginning of the input.
+   Returns the number of input octets consumed, and sets the number of
+   output octets emitted in *outchars.  Returns 0 if there's no such run,
+   or the current states don't allow bulk conversion. */
+static inline ScmSize ascii_run(ScmConvInfo *cinfo,
+                                const char *inptr, ScmSize inroom,
+                                char *outptr, ScmSize outroom,
+                                ScmSize *outchars)
+{
+    const u_char *in = (const u_char*)inptr;
+    u_char *out = (u_char*)outptr;
+    ScmSize n;
+
+    switch (cinfo->asciiOut) {
+    case ASCII_JIS:
+        if (cinfo->ostate != JIS_ASCII) return 0;
+        break;
+    case ASCII_UTF16: case ASCII_UTF32:
+        if (!utf_endian_known(cinfo->ostate)) return 0;
+        break;
+    }
+
+    switch (cinfo->asciiIn) {
+    case ASCII_JIS:
+        if (cinfo->istate != JIS_ASCII || in[0] >= 0x80) return 0;
+        else {
+            /* ESC may switch the state */
+            const u_char *esc = memchr(in, 0x1b, inroom);
+            if (esc) inroom = esc - in;
+        }
+        /* FALLTHROUGH */
+    case ASCII_BYTE:
+        if (inroom == 0 || in[0] >= 0x80) return 0;
+        switch (cinfo->asciiOut) {
+        case ASCII_UTF16:
+            n = ascii_widen16(in, (inroom < outroom/2 ? inroom : outroom/2),
+                              out, cinfo->ostate == UTF_BE);
+            *outchars = n*2;
+            return n;
+        case ASCII_UTF32:
+            n = ascii_widen32(in, (inroom < outroom/4 ? inroom : outroom/4),
+                              out, cinfo->ostate == UTF_BE);
+            *outchars = n*4;
+            return n;
+        default:
+            n = ascii_copy(in, (inroom < outroom ? inroom : outroom), out);
+            *outchars = n;
+            return n;
+        }
+    case ASCII_UTF16:
+        if (!utf_endian_known(cinfo->istate)) return 0;
+        n = ascii_narrow16(in, (inroom/2 < outroom ? inroom/2 : outroom),
+                           out, cinfo->istate == UTF_BE);
+        *outchars = n;
+        return n*2;
+    case ASCII_UTF32:
+        if (!utf_endian_known(cinfo->istate)) return 0;
+        n = ascii_narrow32(in, (inroom/4 < outroom ? inroom/4 : outroom),
+                           out, cinfo->istate == UTF_BE);
+        *outchars = n;
+        return n*4;
+    default:
+        return 0;
+    }
+}
+
 /* calling conversion routine for each char */
 static ScmSize jconv_1tier(ScmConvInfo *cinfo, const char **iptr,
                            ScmSize *iroom, char **optr, ScmSize *oroom)
@@ -1895,7 +2142,13 @@ static ScmSize jconv_1tier(ScmConvInfo *cinfo, const char **iptr,
     SCM_ASSERT(cvt != NULL);
     while (inr > 0 && outr > 0) {
         ScmSize outchars;
-        ScmSize inchars = cvt(cinfo, inp, inr, outp, outr, &outchars);
+        ScmSize inchars = 0;
+        if (cinfo->asciiIn != ASCII_NONE) {
+            inchars = ascii_run(cinfo, inp, inr, outp, outr, &outchars);
+        }
+        if (inchars == 0) {
+            inchars = cvt(cinfo, inp, inr, outp, outr, &outchars);
+        }
         if (ERRP(inchars)) {
             converted = inchars;
             break;
@@ -2004,6 +2257,18 @@ ScmConvInfo *jconv_open(const char *toCode, const char *fromCode,
         handler = jconv_1tier;
     }
 
+    int asciiIn = ASCII_NONE, asciiOut = ASCII_NONE;
+    if (handler == jconv_1tier) {
+        asciiIn = ascii_kind(incode);
+        asciiOut = ascii_kind(outcode);
+        /* We don't handle conversions between UTF-16 and UTF-32 */
+        if (asciiOut == ASCII_NONE
+            || ((asciiIn == ASCII_UTF16 || asciiIn == ASCII_UTF32)
+                && (asciiOut == ASCII_UTF16 || asciiOut == ASCII_UTF32))) {
+            asciiIn = ASCII_NONE;
+        }
+    }
+
     ScmConvInfo *cinfo;
     cinfo = SCM_NEW(ScmConvInfo);
     cinfo->jconv = handler;
@@ -2013,6 +2278,8 @@ ScmConvInfo *jconv_open(const char *toCode, const char *fromCode,
     cinfo->toCode = toCode;
     cinfo->istate = istate;
     cinfo->ostate = ostate;
+    cinfo->asciiIn = asciiIn;
+    cinfo->asciiOut = asciiOut;
     cinfo->fromCode = fromCode;
     /* The replacement settings can be modified by jconv_set_replacement */
     cinfo->replacep = FALSE;
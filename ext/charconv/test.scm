@@ -408,6 +408,41 @@
           '("NONE" "ASCII" "EUCJP" "UTF-8" "SJIS" "ISO2022JP")
           '("NONE" "ASCII" "EUCJP" "UTF-8" "SJIS" "ISO2022JP"))
 
+;;--------------------------------------------------------------------
+(test-section "long ASCII runs")
+
+;; Runs of ASCII chars are converted in bulk.  Make sure the boundaries
+;; between runs and other chars are handled in every encoding.
+(define (ascii-run n)
+  (list->string (map (^i (integer->char (+ 32 (modulo (* i 7) 95)))) (iota n))))
+
+;; Encode ASCII string S in units of WIDTH octets.
+(define (widen s width big-endian?)
+  (rlet1 v (make-u8vector (* width (string-length s)) 0)
+    (dotimes [i (string-length s)]
+      (u8vector-set! v (if big-endian? (+ (* i width) width -1) (* i width))
+                     (char->integer (string-ref s i))))))
+
+(let* ([kana (string (ucs->char #x3042) (ucs->char #x30a2))]
+       [runs (map ascii-run '(1 15 16 17 31 33 100 1000 4099))]
+       [src (string-join runs kana 'suffix)])
+  (dolist [code '("EUCJP" "SJIS" "ISO2022JP" "UTF-16" "UTF-16BE" "UTF-16LE"
+                  "UTF-32" "UTF-32BE" "UTF-32LE")]
+    (test* #"round trip via ~code" src
+           (ces-convert (ces-convert src 'utf-8 code) code 'utf-8)))
+  (dolist [code '("ASCII" "ISO8859-1" "ISO8859-15")]
+    (let1 s (apply string-append runs)
+      (test* #"round trip via ~code" s
+             (ces-convert (ces-convert s 'utf-8 code) code 'utf-8))))
+  (let1 s (list-ref runs 7)
+    (test* "ASCII -> UTF-16LE" (widen s 2 #f)
+           (ces-convert-to <u8vector> s 'utf-8 'utf-16le))
+    (test* "ASCII -> UTF-32BE" (widen s 4 #t)
+           (ces-convert-to <u8vector> s 'utf-8 'utf-32be))
+    (test* "UTF-16BE -> ASCII" s
+           (ces-convert (ces-convert-to <u8vector> s 'utf-8 'utf-16be)
+                        'utf-16be 'ascii))))
+
 ;;--------------------------------------------------------------------
 (test-section "call-with/conversion")
 
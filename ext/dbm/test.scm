@@ -257,6 +257,237 @@
 (test-module 'dbm.fsdbm)
 (full-test <fsdbm>)
 
+;;
+;; BTREE test
+;;
+
+(use dbm.btree)
+(test-module 'dbm.btree)
+(full-test <btree>)
+
+(let ()
+  (define (open-btree mode . opts)
+    (apply dbm-open <btree> :path *test-dbm* :rw-mode mode opts))
+  (define (keys-of db start end)
+    (reverse (btree-range-fold db start end (^[k v r] (cons k r)) '())))
+  (define (numkey i) (format "k~5,'0d" i))
+  (define big (make-string 3000 #\あ))
+
+  (test-section "btree specific")
+  (dynamic-wind
+   clean-up
+   (^[]
+     (let1 db (open-btree :create :page-size 512)
+       ;; insert in scrambled order
+       (dotimes [i 2000]
+         (let1 j (modulo (* i 7919) 2000)
+           (dbm-put! db (numkey j) (x->string j))))
+       (test* "key order" (map numkey (iota 2000))
+              (dbm-map db (^[k v] k)))
+       (test* "range" (map numkey (iota 5 100))
+              (keys-of db (numkey 100) (numkey 105)))
+       (test* "range (open start)" (map numkey (iota 3))
+              (keys-of db #f (numkey 3)))
+       (test* "range (open end)" (map numkey (iota 3 1997))
+              (keys-of db (numkey 1997) #f))
+       (test* "range (empty)" '() (keys-of db (numkey 5) (numkey 5)))
+       (dbm-put! db "big" big)
+       (test* "overflow value" big (dbm-get db "big"))
+       (dbm-put! db "big" "small")
+       (test* "overflow value replaced" "small" (dbm-get db "big"))
+       (dbm-put! db "big2" big)
+       (let1 k (u8vector->string '#u8(255 0))
+         (test* "incomplete key" "bin"
+                (begin (dbm-put! db k "bin") (dbm-get db k))))
+       (test* "key too long" (test-error)
+              (dbm-put! db (make-string 200 #\x) "v"))
+       (dotimes [i 2000]
+         (unless (zero? (modulo i 10)) (dbm-delete! db (numkey i))))
+       (test* "delete and merge" (map numkey (iota 20 0 10))
+              (keys-of db (numkey 0) (numkey 200)))
+       (dbm-close db))
+     (let1 db (open-btree :read)
+       (test* "persistence" (map numkey (iota 20 0 10))
+              (keys-of db (numkey 0) (numkey 200)))
+       (test* "persistence (overflow)" big (dbm-get db "big2"))
+       (dbm-close db))
+
+     (let1 db (open-btree :write)
+       (test* "transaction" '("a" "b")
+              (btree-transaction db
+                (^[]
+                  (dbm-put! db "a" "1")
+                  (dbm-put! db "b" "2")
+                  (keys-of db "a" "ba"))))
+       (test* "transaction abort" '(#f #f "1")
+              (begin
+                (guard (e [else #f])
+                  (btree-transaction db
+                    (^[]
+                      (dbm-put! db "c" "3")
+                      (dbm-delete! db "a")
+                      (error "abort"))))
+                (list (dbm-get db "c" #f) (dbm-exists? db "c")
+                      (dbm-get db "a" #f))))
+       ;; A fold runs on the snapshot at the time it started.
+       (let1 n (dbm-fold db (^[k v r] (+ r 1)) 0)
+         (test* "snapshot" n
+                (dbm-fold db (^[k v r]
+                               (dbm-put! db (string-append k "!") v)
+                               (+ r 1))
+                          0))
+         (test* "snapshot (after)" (* n 2) (dbm-fold db (^[k v r] (+ r 1)) 0)))
+       ;; Another handle sees committed data.
+       (let1 rd (open-btree :read)
+         (test* "reader" "2" (dbm-get rd "b"))
+         (dbm-put! db "b" "two")
+         (test* "reader sees commit" "two" (dbm-get rd "b"))
+         (btree-transaction db
+           (^[]
+             (dbm-put! db "b" "deux")
+             (test* "reader doesn't see pending" "two" (dbm-get rd "b"))))
+         (test* "reader sees transaction" "deux" (dbm-get rd "b"))
+         (dbm-close rd))
+       ;; Other handles of the file in this process share the descriptor,
+       ;; so closing them doesn't release the writer lock.
+       (test* "db-exists? while writing" #t (dbm-db-exists? <btree> *test-dbm*))
+       (test* "second writer in the same process" (test-error)
+              (open-btree :write))
+       (test* "writer still works" "deux" (dbm-get db "b"))
+       ;; A page overwritten while it is being read is detected by
+       ;; checking its stamps again.
+       (test* "stamps are checked after reading" '(ok stale)
+              (let ([read-pages (with-module dbm.btree read-pages)]
+                    [stale? (with-module dbm.btree btree-stale-snapshot?)]
+                    [view (make-u8vector 64 0)])
+                (u8vector-set! view 8 1)
+                (u8vector-set! view 56 1)
+                (list (read-pages db view 1 (^[] 'ok))
+                      (guard (e [(stale? e) 'stale])
+                        (read-pages db view 1
+                                    (^[] (u8vector-set! view 8 2) 'ok))))))
+       (cond-expand
+        [(and gauche.sys.fcntl
+              (not gauche.os.windows)
+              (not gauche.os.cygwin))
+         (test* "writer lock is kept" 'locked
+                (let1 pid (sys-fork)
+                  (if (= pid 0)
+                    ;; Forget the handles inherited from the parent, so
+                    ;; that only the fcntl lock can stop us.
+                    (begin
+                      (hash-table-clear!
+                       (with-module dbm.btree *open-files*))
+                      (sys-exit (guard (e [else 0])
+                                  (open-btree :write)
+                                  1)))
+                    (receive (_ code) (sys-waitpid pid)
+                      (if (and (sys-wait-exited? code)
+                               (= (sys-wait-exit-status code) 0))
+                        'locked
+                        'not-locked)))))]
+        [else])
+       (dbm-close db))
+
+     (let1 db (open-btree :create :page-size 1024)
+       (btree-bulk-load! db (map (^i (cons (numkey i)
+                                           (make-string (modulo i 300) #\z)))
+                                 (iota 10000)))
+       (test* "bulk load" 10000 (dbm-fold db (^[k v r] (+ r 1)) 0))
+       (test* "bulk load get" (make-string 280 #\z) (dbm-get db (numkey 880)))
+       (test* "bulk load range" (map numkey (iota 10 5000))
+              (keys-of db (numkey 5000) (numkey 5010)))
+       (test* "bulk load order check" (test-error)
+              (let1 db2 (dbm-open <btree> :path *test2-dbm* :rw-mode :create)
+                (unwind-protect
+                    (btree-bulk-load! db2 '(("b" . "1") ("a" . "2")))
+                  (dbm-close db2))))
+       (dbm-put! db (numkey 5000) "new")
+       (dbm-delete! db (numkey 5001))
+       (test* "bulk load then update" '("new" #f)
+              (list (dbm-get db (numkey 5000)) (dbm-get db (numkey 5001) #f)))
+       (dbm-close db))
+     (let1 db (open-btree :read)
+       (test* "bulk load reopen" 9999 (dbm-fold db (^[k v r] (+ r 1)) 0))
+       (dbm-close db))
+
+     ;; Bulk load reuses the pages freed by the deletions; they're within
+     ;; the mapped region, but their new contents are in the port buffer.
+     (let1 db (open-btree :create :page-size 512)
+       (dotimes [i 200] (dbm-put! db (numkey i) "old"))
+       (dotimes [i 200] (dbm-delete! db (numkey i)))
+       (test* "bulk load into reused pages" '("new" 200)
+              (btree-transaction db
+                (^[]
+                  (btree-bulk-load! db (map (^i (cons (numkey i) "new"))
+                                            (iota 200)))
+                  (list (dbm-get db (numkey 100))
+                        (dbm-fold db (^[k v r] (+ r 1)) 0)))))
+       (dbm-close db))
+
+     ;; The writer doesn't reuse the pages of a snapshot that a reader is
+     ;; traversing, whether the reader is in this process or not.
+     (let ()
+       (define (update-all! db)
+         (dotimes [j 3]
+           (dotimes [i 200] (dbm-put! db (numkey i) #"new~j"))))
+       (define (old-values? vs)
+         (and (= (length vs) 200) (every (cut equal? "old" <>) vs)))
+       (let1 db (open-btree :create :page-size 512)
+         (dotimes [i 200] (dbm-put! db (numkey i) "old"))
+         (let1 rd (open-btree :read)
+           (test* "traversal keeps its snapshot" #t
+                  (old-values?
+                   (dbm-fold rd (^[k v r]
+                                  (when (null? r) (update-all! db))
+                                  (cons v r))
+                             '())))
+           (dbm-close rd))
+         (dotimes [i 200] (dbm-put! db (numkey i) "old"))
+         (cond-expand
+          [(and gauche.sys.fcntl
+                (not gauche.os.windows)
+                (not gauche.os.cygwin))
+           (test* "traversal in another process keeps its snapshot" 'ok
+                  (receive (from-child to-parent) (sys-pipe)
+                    (receive (from-parent to-child) (sys-pipe)
+                      (let1 pid (sys-fork)
+                        (if (= pid 0)
+                          (begin
+                            (close-port from-child)
+                            (close-port to-child)
+                            (hash-table-clear!
+                             (with-module dbm.btree *open-files*))
+                            (sys-exit
+                             (guard (e [else 2])
+                               (let1 rd (open-btree :read)
+                                 (if (old-values?
+                                      (dbm-fold rd
+                                                (^[k v r]
+                                                  (when (null? r)
+                                                    (write-char #\x to-parent)
+                                                    (flush to-parent)
+                                                    (read-char from-parent))
+                                                  (cons v r))
+                                                '()))
+                                   0
+                                   1)))))
+                          (begin
+                            (close-port to-parent)
+                            (close-port from-parent)
+                            (unless (eof-object? (read-char from-child))
+                              (update-all! db)
+                              (write-char #\x to-child)
+                              (flush to-child))
+                            (receive (_ code) (sys-waitpid pid)
+                              (if (and (sys-wait-exited? code)
+                                       (= (sys-wait-exit-status code) 0))
+                                'ok
+                                'failed))))))))]
+          [else])
+         (dbm-close db))))
+   clean-up))
+
 ;;
 ;; GDBM test
 ;;
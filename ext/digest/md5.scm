@@ -49,28 +49,24 @@
 
 (define-class <md5> (<message-digest-algorithm>)
   ((context :getter context-of))
-  :metaclass <md5-meta>)
+  :metaclass <md5-meta>
+  :transient-data #t)
 
 (define-method initialize ((self <md5>) initargs)
   (next-method)
   (slot-set! self 'context (make <md5-context>)))
 
-(define-constant *md5-unit-len* 4096)
-
+;; %md5-update takes a string, a uvector or an input port and feeds
+;; the data to the context in C.
 (define (md5-digest)
-  (let ([md5 (make <md5-context>)]
-        [buf (make-u8vector *md5-unit-len*)])
-    (generator-for-each
-     (^x (%md5-update md5 x))
-     (^[] (let1 count (read-block! buf)
-            (cond [(eof-object? count) count]
-                  [(< count *md5-unit-len*)
-                   (uvector-alias <u8vector> buf 0 count)]
-                  [else buf]))))
+  (let1 md5 (make <md5-context>)
+    (%md5-update md5 (current-input-port))
     (%md5-final md5)))
 
 (define (md5-digest-string string)
-  (with-input-from-string string md5-digest))
+  (let1 md5 (make <md5-context>)
+    (%md5-update md5 string)
+    (%md5-final md5)))
 
 ;;;
 ;;; Digest framework
@@ -81,6 +77,8 @@
   (%md5-final (context-of self)))
 (define-method digest ((class <md5-meta>))
   (md5-digest))
+(define-method digest-message ((class <md5-meta>) msg)
+  (md5-digest-string msg))
 
 ;;;
 ;;; Low-level bindings
@@ -119,7 +117,18 @@
        (MD5_Update (& (-> md5 ctx))
                   (cast (const unsigned char*) (SCM_STRING_BODY_START b))
                   (SCM_STRING_BODY_SIZE b)))]
-    [else (SCM_TYPE_ERROR data "u8vector or string")]))
+    [(SCM_UVECTORP data)
+     (MD5_Update (& (-> md5 ctx))
+                (cast (const unsigned char*)
+                      (SCM_UVECTOR_ELEMENTS (SCM_UVECTOR data)))
+                (Scm_UVectorSizeInBytes (SCM_UVECTOR data)))]
+    [(SCM_IPORTP data)
+     (let* ([buf::(.array char (16384))])
+       (loop (let* ([n::ScmSize (Scm_Getz buf 16384 (SCM_PORT data))])
+               (when (<= n 0) (break))
+               (MD5_Update (& (-> md5 ctx))
+                          (cast (const unsigned char*) buf) n))))]
+    [else (SCM_TYPE_ERROR data "uvector, string or input port")]))
 
  (define-cproc %md5-final (md5::<md5-context>)
    (let* ([digest::(.array (unsigned char) [16])])
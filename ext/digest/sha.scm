@@ -54,21 +54,21 @@
 ;;;  High-level API
 ;;;
 
-(define-constant *sha-unit-len* 4096)
-
+;; The update procedures take a string, a uvector or an input port and
+;; feed the data to the context in C, so there's no per-block overhead
+;; in Scheme.
 (define (gen-digest init update end)
-  (^[] (let ([ctx (make <sha-context>)]
-             [buf (make-u8vector *sha-unit-len*)])
+  (^[] (let1 ctx (make <sha-context>)
          (init ctx)
-         (generator-for-each
-          (^x (update ctx x))
-          (^[] (let1 count (read-block! buf)
-                 (cond [(eof-object? count) count]
-                       [(< count *sha-unit-len*)
-                        (uvector-alias <u8vector> buf 0 count)]
-                       [else buf]))))
+         (update ctx (current-input-port))
          (end ctx))))
 
+(define (gen-message-digest init update end)
+  (^[msg] (let1 ctx (make <sha-context>)
+            (init ctx)
+            (update ctx msg)
+            (end ctx))))
+
 (define sha1-digest   (gen-digest %sha1-init   %sha1-update   %sha1-final))
 (define sha224-digest (gen-digest %sha224-init %sha224-update %sha224-final))
 (define sha256-digest (gen-digest %sha256-init %sha256-update %sha256-final))
@@ -79,15 +79,24 @@
 (define sha3-384-digest (gen-digest %sha3-384-init %sha3-384-update %sha3-384-final))
 (define sha3-512-digest (gen-digest %sha3-512-init %sha3-512-update %sha3-512-final))
 
-(define (sha1-digest-string s)   (with-input-from-string s sha1-digest))
-(define (sha224-digest-string s) (with-input-from-string s sha224-digest))
-(define (sha256-digest-string s) (with-input-from-string s sha256-digest))
-(define (sha384-digest-string s) (with-input-from-string s sha384-digest))
-(define (sha512-digest-string s) (with-input-from-string s sha512-digest))
-(define (sha3-224-digest-string s) (with-input-from-string s sha3-224-digest))
-(define (sha3-256-digest-string s) (with-input-from-string s sha3-256-digest))
-(define (sha3-384-digest-string s) (with-input-from-string s sha3-384-digest))
-(define (sha3-512-digest-string s) (with-input-from-string s sha3-512-digest))
+(define sha1-digest-string
+  (gen-message-digest %sha1-init %sha1-update %sha1-final))
+(define sha224-digest-string
+  (gen-message-digest %sha224-init %sha224-update %sha224-final))
+(define sha256-digest-string
+  (gen-message-digest %sha256-init %sha256-update %sha256-final))
+(define sha384-digest-string
+  (gen-message-digest %sha384-init %sha384-update %sha384-final))
+(define sha512-digest-string
+  (gen-message-digest %sha512-init %sha512-update %sha512-final))
+(define sha3-224-digest-string
+  (gen-message-digest %sha3-224-init %sha3-224-update %sha3-224-final))
+(define sha3-256-digest-string
+  (gen-message-digest %sha3-256-init %sha3-256-update %sha3-256-final))
+(define sha3-384-digest-string
+  (gen-message-digest %sha3-384-init %sha3-384-update %sha3-384-final))
+(define sha3-512-digest-string
+  (gen-message-digest %sha3-512-init %sha3-512-update %sha3-512-final))
 
 ;;;
 ;;; Digest framework
@@ -99,13 +108,15 @@
         [init   (string->symbol #"%sha~|n|-init")]
         [update (string->symbol #"%sha~|n|-update")]
         [final  (string->symbol #"%sha~|n|-final")]
-        [digest (string->symbol #"sha~|n|-digest")])
+        [digest (string->symbol #"sha~|n|-digest")]
+        [digest-msg (string->symbol #"sha~|n|-digest-string")])
     `(begin
        (define-class ,meta (<message-digest-algorithm-meta>) ())
        (define-class ,cls (<message-digest-algorithm>)
          (context)
          :metaclass ,meta
-         :hmac-block-size ,block-size)
+         :hmac-block-size ,block-size
+         :transient-data #t)
        (define-method initialize ((self ,cls) initargs)
          (next-method)
          (let1 ctx (make <sha-context>)
@@ -116,7 +127,9 @@
        (define-method digest-final! ((self ,cls))
          (,final (slot-ref self'context)))
        (define-method digest ((class ,meta))
-         (,digest)))))
+         (,digest))
+       (define-method digest-message ((class ,meta) msg)
+         (,digest-msg msg)))))
 
 (define-framework 1    64)
 (define-framework 224  64)
@@ -145,6 +158,8 @@
 
   (.include "sha3.h")
 
+  (.define SHA_PORT_BUFSIZ 16384)
+
   (.define LIBGAUCHE_EXT_BODY)
   (.include <gauche/extern.h>)      ; fix SCM_EXTERN in SCM_CLASS_DECL
 
@@ -200,6 +215,9 @@
    (set! (-> ctx version) 3)
    (sha3_Init512 (& (-> ctx v3))))
 
+ ;; DATA may be a u8vector, a string, any other uvector (hashed as its
+ ;; raw bytes, e.g. a view of an mmapped region), or an input port,
+ ;; which is read until EOF.
  (define-cise-stmt common-update
    [(_ update ctx vers data)
     `(cond
@@ -213,7 +231,19 @@
          (,update (& (-> ,ctx ,vers))
                   (cast (const unsigned char*) (SCM_STRING_BODY_START b))
                   (SCM_STRING_BODY_SIZE b)))]
-      [else (SCM_TYPE_ERROR ,data "u8vector or string")])])
+      [(SCM_UVECTORP ,data)
+       (,update (& (-> ,ctx ,vers))
+                (cast (const unsigned char*)
+                      (SCM_UVECTOR_ELEMENTS (SCM_UVECTOR ,data)))
+                (Scm_UVectorSizeInBytes (SCM_UVECTOR ,data)))]
+      [(SCM_IPORTP ,data)
+       (let* ([buf::(.array char (SHA_PORT_BUFSIZ))])
+         (loop (let* ([n::ScmSize (Scm_Getz buf SHA_PORT_BUFSIZ
+                                            (SCM_PORT ,data))])
+                 (when (<= n 0) (break))
+                 (,update (& (-> ,ctx ,vers))
+                          (cast (const unsigned char*) buf) n))))]
+      [else (SCM_TYPE_ERROR ,data "uvector, string or input port")])])
 
  (define-cproc %sha1-update (ctx::<sha-context> data) ::<void>
    (check-version ctx 2)
@@ -36,6 +36,7 @@
 #include <string.h>	/* memcpy()/memset() or bcopy()/bzero() */
 #include <assert.h>	/* assert() */
 #include "sha2.h"
+#include "shani.h"
 
 /*
  * ASSERT NOTE:
@@ -660,6 +661,11 @@ void SHA1_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
                         context->s1.bitcount += freespace << 3;
                         len -= freespace;
                         data += freespace;
+#ifdef GAUCHE_DIGEST_SHANI
+                        if (Scm__ShaniAvailable()) {
+                                Scm__SHA1_ShaniBlocks(context->s1.state, context->s1.buffer, 1);
+                        } else
+#endif /* GAUCHE_DIGEST_SHANI */
                         SHA1_Internal_Transform(context, (sha_word32*)context->s1.buffer);
                 } else {
                         /* The buffer is not yet full */
@@ -670,6 +676,16 @@ void SHA1_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
                         return;
                 }
         }
+#ifdef GAUCHE_DIGEST_SHANI
+        /* Use SHA extensions if the CPU supports them (not in the original) */
+        if (len >= 64 && Scm__ShaniAvailable()) {
+                size_t nblocks = len / 64;
+                Scm__SHA1_ShaniBlocks(context->s1.state, data, nblocks);
+                context->s1.bitcount += (sha_word64)nblocks << 9;
+                len -= nblocks * 64;
+                data += nblocks * 64;
+        }
+#endif /* GAUCHE_DIGEST_SHANI */
         while (len >= 64) {
                 /* Process as many complete blocks as we can */
                 SHA1_Internal_Transform(context, (sha_word32*)data);
@@ -1007,6 +1023,11 @@ void SHA256_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
                         context->s256.bitcount += freespace << 3;
                         len -= freespace;
                         data += freespace;
+#ifdef GAUCHE_DIGEST_SHANI
+                        if (Scm__ShaniAvailable()) {
+                                Scm__SHA256_ShaniBlocks(context->s256.state, context->s256.buffer, 1);
+                        } else
+#endif /* GAUCHE_DIGEST_SHANI */
                         SHA256_Internal_Transform(context, (sha_word32*)context->s256.buffer);
                 } else {
                         /* The buffer is not yet full */
@@ -1017,6 +1038,16 @@ void SHA256_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
                         return;
                 }
         }
+#ifdef GAUCHE_DIGEST_SHANI
+        /* Use SHA extensions if the CPU supports them (not in the original) */
+        if (len >= 64 && Scm__ShaniAvailable()) {
+                size_t nblocks = len / 64;
+                Scm__SHA256_ShaniBlocks(context->s256.state, data, nblocks);
+                context->s256.bitcount += (sha_word64)nblocks << 9;
+                len -= nblocks * 64;
+                data += nblocks * 64;
+        }
+#endif /* GAUCHE_DIGEST_SHANI */
         while (len >= 64) {
                 /* Process as many complete blocks as we can */
                 SHA256_Internal_Transform(context, (sha_word32*)data);
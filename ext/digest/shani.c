@@ -0,0 +1,269 @@
+/*
+ * shani.c - SHA-1 and SHA-256 block functions using x86 SHA extensions
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "shani.h"
+
+#if defined(GAUCHE_DIGEST_SHANI)
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+/* Returns nonzero if the CPU supports SHA, SSSE3 and SSE4.1. */
+int Scm__ShaniAvailable(void)
+{
+    static volatile int available = -1;
+    if (available < 0) {
+        unsigned int a, b, c, d;
+        int r = 0;
+        if (__get_cpuid(0, &a, &b, &c, &d) && a >= 7) {
+            __cpuid(1, a, b, c, d);
+            if ((c & (1U<<9)) && (c & (1U<<19))) {     /* SSSE3, SSE4.1 */
+                __cpuid_count(7, 0, a, b, c, d);
+                if (b & (1U<<29)) r = 1;               /* SHA */
+            }
+        }
+        available = r;
+    }
+    return available;
+}
+
+#define SHANI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+
+/*
+ * SHA-1
+ *
+ * Each group of 4 rounds uses 4 message words M(g).  M(g+4) is computed
+ * as msg2(msg1(M(g), M(g+1)) ^ M(g+2), M(g+3)), and we spread the steps
+ * over the groups so that only 4 registers are needed.
+ */
+
+#define SHA1_FIRST(M)                                   \
+    do {                                                \
+        E0 = _mm_add_epi32(E0, M);                      \
+        E1 = ABCD;                                      \
+        ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);        \
+    } while (0)
+
+#define SHA1_ROUNDS(Ein, Eout, M, f)                    \
+    do {                                                \
+        Ein = _mm_sha1nexte_epu32(Ein, M);              \
+        Eout = ABCD;                                    \
+        ABCD = _mm_sha1rnds4_epu32(ABCD, Ein, f);       \
+    } while (0)
+
+#define SHA1_MSG1(Mp, M)  (Mp = _mm_sha1msg1_epu32(Mp, M))
+#define SHA1_XOR(Mpp, M)  (Mpp = _mm_xor_si128(Mpp, M))
+#define SHA1_MSG2(Mn, M)  (Mn = _mm_sha1msg2_epu32(Mn, M))
+
+SHANI_TARGET
+void Scm__SHA1_ShaniBlocks(uint32_t state[5],
+                           const uint8_t *data, size_t nblocks)
+{
+    const __m128i MASK = _mm_set_epi64x(0x0001020304050607ULL,
+                                        0x08090a0b0c0d0e0fULL);
+    __m128i ABCD, ABCD_SAVE, E0, E0_SAVE, E1;
+    __m128i M0, M1, M2, M3;
+
+    ABCD = _mm_loadu_si128((const __m128i*)state);
+    E0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+    ABCD = _mm_shuffle_epi32(ABCD, 0x1b);
+
+    for (; nblocks > 0; nblocks--, data += 64) {
+        ABCD_SAVE = ABCD;
+        E0_SAVE = E0;
+
+        M0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), MASK);
+        M1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data+16)), MASK);
+        M2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data+32)), MASK);
+        M3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data+48)), MASK);
+
+        /* 0-3 */
+        SHA1_FIRST(M0);
+        /* 4-7 */
+        SHA1_ROUNDS(E1, E0, M1, 0); SHA1_MSG1(M0, M1);
+        /* 8-11 */
+        SHA1_ROUNDS(E0, E1, M2, 0); SHA1_MSG1(M1, M2); SHA1_XOR(M0, M2);
+        /* 12-15 */
+        SHA1_ROUNDS(E1, E0, M3, 0); SHA1_MSG2(M0, M3); SHA1_MSG1(M2, M3);
+        SHA1_XOR(M1, M3);
+        /* 16-19 */
+        SHA1_ROUNDS(E0, E1, M0, 0); SHA1_MSG2(M1, M0); SHA1_MSG1(M3, M0);
+        SHA1_XOR(M2, M0);
+        /* 20-23 */
+        SHA1_ROUNDS(E1, E0, M1, 1); SHA1_MSG2(M2, M1); SHA1_MSG1(M0, M1);
+        SHA1_XOR(M3, M1);
+        /* 24-27 */
+        SHA1_ROUNDS(E0, E1, M2, 1); SHA1_MSG2(M3, M2); SHA1_MSG1(M1, M2);
+        SHA1_XOR(M0, M2);
+        /* 28-31 */
+        SHA1_ROUNDS(E1, E0, M3, 1); SHA1_MSG2(M0, M3); SHA1_MSG1(M2, M3);
+        SHA1_XOR(M1, M3);
+        /* 32-35 */
+        SHA1_ROUNDS(E0, E1, M0, 1); SHA1_MSG2(M1, M0); SHA1_MSG1(M3, M0);
+        SHA1_XOR(M2, M0);
+        /* 36-39 */
+        SHA1_ROUNDS(E1, E0, M1, 1); SHA1_MSG2(M2, M1); SHA1_MSG1(M0, M1);
+        SHA1_XOR(M3, M1);
+        /* 40-43 */
+        SHA1_ROUNDS(E0, E1, M2, 2); SHA1_MSG2(M3, M2); SHA1_MSG1(M1, M2);
+        SHA1_XOR(M0, M2);
+        /* 44-47 */
+        SHA1_ROUNDS(E1, E0, M3, 2); SHA1_MSG2(M0, M3); SHA1_MSG1(M2, M3);
+        SHA1_XOR(M1, M3);
+        /* 48-51 */
+        SHA1_ROUNDS(E0, E1, M0, 2); SHA1_MSG2(M1, M0); SHA1_MSG1(M3, M0);
+        SHA1_XOR(M2, M0);
+        /* 52-55 */
+        SHA1_ROUNDS(E1, E0, M1, 2); SHA1_MSG2(M2, M1); SHA1_MSG1(M0, M1);
+        SHA1_XOR(M3, M1);
+        /* 56-59 */
+        SHA1_ROUNDS(E0, E1, M2, 2); SHA1_MSG2(M3, M2); SHA1_MSG1(M1, M2);
+        SHA1_XOR(M0, M2);
+        /* 60-63 */
+        SHA1_ROUNDS(E1, E0, M3, 3); SHA1_MSG2(M0, M3); SHA1_MSG1(M2, M3);
+        SHA1_XOR(M1, M3);
+        /* 64-67 */
+        SHA1_ROUNDS(E0, E1, M0, 3); SHA1_MSG2(M1, M0); SHA1_MSG1(M3, M0);
+        SHA1_XOR(M2, M0);
+        /* 68-71 */
+        SHA1_ROUNDS(E1, E0, M1, 3); SHA1_MSG2(M2, M1); SHA1_XOR(M3, M1);
+        /* 72-75 */
+        SHA1_ROUNDS(E0, E1, M2, 3); SHA1_MSG2(M3, M2);
+        /* 76-79 */
+        SHA1_ROUNDS(E1, E0, M3, 3);
+
+        E0 = _mm_sha1nexte_epu32(E0, E0_SAVE);
+        ABCD = _mm_add_epi32(ABCD, ABCD_SAVE);
+    }
+
+    ABCD = _mm_shuffle_epi32(ABCD, 0x1b);
+    _mm_storeu_si128((__m128i*)state, ABCD);
+    state[4] = (uint32_t)_mm_extract_epi32(E0, 3);
+}
+
+/*
+ * SHA-256
+ *
+ * M(g+1) = msg2(msg1(M(g-3), M(g-2)) + alignr(M(g), M(g-1)), M(g)).
+ */
+
+static const uint32_t K256[64] __attribute__((aligned(16))) = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA256_ROUNDS(g, M)                                             \
+    do {                                                                \
+        MSG = _mm_add_epi32(M, _mm_load_si128((const __m128i*)&K256[4*(g)])); \
+        STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);            \
+        MSG = _mm_shuffle_epi32(MSG, 0x0e);                             \
+        STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);            \
+    } while (0)
+
+#define SHA256_MSG1(Mp, M)   (Mp = _mm_sha256msg1_epu32(Mp, M))
+#define SHA256_MSG2(Mn, M, Mp)                                          \
+    do {                                                                \
+        Mn = _mm_add_epi32(Mn, _mm_alignr_epi8(M, Mp, 4));              \
+        Mn = _mm_sha256msg2_epu32(Mn, M);                               \
+    } while (0)
+
+SHANI_TARGET
+void Scm__SHA256_ShaniBlocks(uint32_t state[8],
+                             const uint8_t *data, size_t nblocks)
+{
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                        0x0405060700010203ULL);
+    __m128i STATE0, STATE1, ABEF_SAVE, CDGH_SAVE, MSG, TMP;
+    __m128i M0, M1, M2, M3;
+
+    TMP = _mm_loadu_si128((const __m128i*)&state[0]);
+    STATE1 = _mm_loadu_si128((const __m128i*)&state[4]);
+    TMP = _mm_shuffle_epi32(TMP, 0xb1);            /* CDAB */
+    STATE1 = _mm_shuffle_epi32(STATE1, 0x1b);      /* EFGH */
+    STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);      /* ABEF */
+    STATE1 = _mm_blend_epi16(STATE1, TMP, 0xf0);   /* CDGH */
+
+    for (; nblocks > 0; nblocks--, data += 64) {
+        ABEF_SAVE = STATE0;
+        CDGH_SAVE = STATE1;
+
+        M0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), MASK);
+        M1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data+16)), MASK);
+        M2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data+32)), MASK);
+        M3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data+48)), MASK);
+
+        SHA256_ROUNDS(0, M0);
+        SHA256_ROUNDS(1, M1);  SHA256_MSG1(M0, M1);
+        SHA256_ROUNDS(2, M2);  SHA256_MSG1(M1, M2);
+        SHA256_ROUNDS(3, M3);  SHA256_MSG2(M0, M3, M2); SHA256_MSG1(M2, M3);
+        SHA256_ROUNDS(4, M0);  SHA256_MSG2(M1, M0, M3); SHA256_MSG1(M3, M0);
+        SHA256_ROUNDS(5, M1);  SHA256_MSG2(M2, M1, M0); SHA256_MSG1(M0, M1);
+        SHA256_ROUNDS(6, M2);  SHA256_MSG2(M3, M2, M1); SHA256_MSG1(M1, M2);
+        SHA256_ROUNDS(7, M3);  SHA256_MSG2(M0, M3, M2); SHA256_MSG1(M2, M3);
+        SHA256_ROUNDS(8, M0);  SHA256_MSG2(M1, M0, M3); SHA256_MSG1(M3, M0);
+        SHA256_ROUNDS(9, M1);  SHA256_MSG2(M2, M1, M0); SHA256_MSG1(M0, M1);
+        SHA256_ROUNDS(10, M2); SHA256_MSG2(M3, M2, M1); SHA256_MSG1(M1, M2);
+        SHA256_ROUNDS(11, M3); SHA256_MSG2(M0, M3, M2); SHA256_MSG1(M2, M3);
+        SHA256_ROUNDS(12, M0); SHA256_MSG2(M1, M0, M3); SHA256_MSG1(M3, M0);
+        SHA256_ROUNDS(13, M1); SHA256_MSG2(M2, M1, M0);
+        SHA256_ROUNDS(14, M2); SHA256_MSG2(M3, M2, M1);
+        SHA256_ROUNDS(15, M3);
+
+        STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+        STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+    }
+
+    TMP = _mm_shuffle_epi32(STATE0, 0x1b);         /* FEBA */
+    STATE1 = _mm_shuffle_epi32(STATE1, 0xb1);      /* DCHG */
+    STATE0 = _mm_blend_epi16(TMP, STATE1, 0xf0);   /* DCBA */
+    STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);      /* HGFE */
+    _mm_storeu_si128((__m128i*)&state[0], STATE0);
+    _mm_storeu_si128((__m128i*)&state[4], STATE1);
+}
+
+#endif /*GAUCHE_DIGEST_SHANI*/
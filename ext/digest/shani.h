@@ -0,0 +1,61 @@
+/*
+ * shani.h - SHA-1 and SHA-256 block functions using x86 SHA extensions
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_DIGEST_SHANI_H
+#define GAUCHE_DIGEST_SHANI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The functions are compiled with per-function target attributes, so
+   we don't need special compiler flags; whether the CPU actually has
+   the extensions is checked at runtime by Scm__ShaniAvailable().
+   Define GAUCHE_DIGEST_NO_SHANI to exclude them altogether. */
+#if (defined(__x86_64__) || defined(__i386__))                  \
+    && (defined(__clang__)                                      \
+        || (defined(__GNUC__)                                   \
+            && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))) \
+    && !defined(GAUCHE_DIGEST_NO_SHANI)
+#define GAUCHE_DIGEST_SHANI 1
+#endif
+
+#if defined(GAUCHE_DIGEST_SHANI)
+extern int  Scm__ShaniAvailable(void);
+/* Process NBLOCKS 64-byte blocks of DATA, updating STATE. */
+extern void Scm__SHA1_ShaniBlocks(uint32_t state[5],
+                                  const uint8_t *data, size_t nblocks);
+extern void Scm__SHA256_ShaniBlocks(uint32_t state[8],
+                                    const uint8_t *data, size_t nblocks);
+#endif /*GAUCHE_DIGEST_SHANI*/
+
+#endif /*GAUCHE_DIGEST_SHANI_H*/
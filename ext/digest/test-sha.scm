@@ -208,4 +208,75 @@
     (sha3-test <sha3-512> input sha3-512-expect)
     ))
 
+;; The string, uvector, port and file paths must agree with each other,
+;; especially around the block boundaries where the accelerated
+;; transform takes over.
+(test-section "update paths")
+
+(let1 data (with-output-to-string
+             (^[] (dotimes [i 1500] (write-byte (modulo (* i 7) 128)))))
+  (dolist [class (list <sha1> <sha224> <sha256> <sha384> <sha512> <sha3-256>)]
+    (dolist [len '(0 1 55 56 63 64 65 127 128 129 640 1027 1500)]
+      (let* ([msg (string-copy data 0 len)]
+             [expected (with-input-from-string msg (cut digest-to 'hex class))])
+        (test* #"~(class-name class) message ~len" expected
+               (digest-message-to 'hex class msg))
+        (test* #"~(class-name class) u8vector ~len" expected
+               (digest-message-to 'hex class (string->u8vector msg)))
+        (when (zero? (modulo len 4))
+          (test* #"~(class-name class) u32vector ~len" expected
+                 (let1 d (make class)
+                   (digest-update! d (uvector-alias <u32vector>
+                                                    (string->u8vector msg)))
+                   (digest-hexify (digest-final! d)))))
+        (test* #"~(class-name class) port ~len" expected
+               (let1 d (make class)
+                 (digest-update! d (open-input-string msg))
+                 (digest-hexify (digest-final! d))))))))
+
+(let ([file "test-sha.o"]
+      [data (make-string 100000 #\a)])
+  (remove-files file)
+  (with-output-to-file file (cut display data))
+  (test* "digest-file-to" (digest-message-to 'hex <sha256> data)
+         (digest-file-to 'hex <sha256> file))
+  (test* "tree-digest-file-to (single leaf)"
+         (digest-message-to 'hex <sha256>
+                            (string-append "\x01;"
+                                           (digest-message-to
+                                            <string> <sha256>
+                                            (string-append "\x00;" data))))
+         (tree-digest-file-to 'hex <sha256> file))
+  (test* "tree-digest-file-to (multiple leaves)"
+         (digest-message-to 'hex <sha1>
+                            (string-append
+                             "\x01;"
+                             (digest-message-to <string> <sha1>
+                                                (string-append
+                                                 "\x00;"
+                                                 (string-copy data 0 65536)))
+                             (digest-message-to <string> <sha1>
+                                                (string-append
+                                                 "\x00;"
+                                                 (string-copy data 65536)))))
+         (tree-digest-file-to 'hex <sha1> file :leaf-size 65536))
+  (let ()
+    ;; A user-defined algorithm that keeps the message
+    (define-class <keeping-meta> (<message-digest-algorithm-meta>) ())
+    (define-class <keeping> (<message-digest-algorithm>) ()
+      :metaclass <keeping-meta>)
+    (define kept #f)
+    (define-method digest-message ((class <keeping-meta>) msg)
+      (set! kept msg)
+      (digest-message <sha256> msg))
+    (test* "digest-file-to (algorithm keeping the data)"
+           (list (digest-message-to 'hex <sha256> data) 100000 97)
+           (let1 r (digest-file-to 'hex <keeping> file)
+             (gc)
+             (list r (u8vector-length kept) (u8vector-ref kept 99999)))))
+  (with-output-to-file file (cut display ""))
+  (test* "digest-file-to (empty)" (digest-message-to 'hex <sha256> "")
+         (digest-file-to 'hex <sha256> file))
+  (remove-files file))
+
 (test-end)
@@ -188,6 +188,30 @@
        (rlet1 p '()
          (for-each (^x (push! p x)) (sseq 1 2 3 4 5))))
 
+;; vectors and strings have their own shortcut methods
+(test* "fold (u8vector)" '(5 4 3 2 1)
+       (fold cons '() '#u8(1 2 3 4 5)))
+(test* "fold (f64vector)" 7.5
+       (fold + 0 '#f64(0.5 1.5 2.5 3.0)))
+(test* "fold (bitvector)" '(1 0 1 1)
+       (fold cons '() '#*1101))
+(test* "fold (empty)" 'z
+       (fold cons 'z '#s16()))
+(test* "fold (multibyte string)" '(#\c #\λ #\b #\あ)
+       (fold cons '() "あbλc"))
+(test* "map (s16vector)" '(-2 4 -6)
+       (map (^x (* x 2)) '#s16(-1 2 -3)))
+(test* "map (multibyte string)" '(#\あ #\B #\Λ)
+       (map char-upcase "あbλ"))
+(test* "map (n-ary, uvector)" '(11 22 33)
+       (map + '#u8(1 2 3) '#(10 20 30 40)))
+(test* "for-each (u32vector)" '(3 2 1)
+       (rlet1 p '()
+         (for-each (^x (push! p x)) '#u32(1 2 3))))
+(test* "for-each (multibyte string)" '(#\う #\い #\あ)
+       (rlet1 p '()
+         (for-each (^x (push! p x)) "あいう")))
+
 (test* "map$" '(#\A #\B #\C #\D #\E)
        ((map$ char-upcase) "abcde"))
 (test* "for-each$" '(#\A #\B #\C #\D #\E)
@@ -146,6 +146,41 @@
   (test-generate '(0 1 2 3 4 5 6 7 8 9)
                  (generate
                   (^[yield] (let loop ([i 0]) (yield i) (loop (+ i 1))))))
+  ;; yield from deep inside of recursion
+  (test-generate '(a b c d e f g h)
+                 (generate
+                  (^[yield]
+                    (let walk ([t '((a (b c)) ((d) e) (((f g h))))])
+                      (cond [(null? t)]
+                            [(pair? t) (walk (car t)) (walk (cdr t))]
+                            [else (yield t)])))))
+  (cond-expand
+   [gauche.sys.pthreads
+    (test* "generate, consumed from another thread" '(0 1 2)
+           (let* ([g (generate (^[yield] (dotimes [i 3] (yield i))))]
+                  [a (g)])
+             (cons a (thread-join!
+                      (thread-start! (make-thread (^[] (list (g) (g)))))))))]
+   [else])
+  )
+
+(let ()
+  (define (test-generate expect gen)
+    (test* "generate/fiber" expect (generator->list gen 10)))
+
+  (test-generate '() (generate/fiber (^[yield] #f)))
+  (test-generate '(0) (generate/fiber (^[yield] (yield 0) 3)))
+  (test-generate '(0 1) (generate/fiber (^[yield] (yield 0) (yield 1))))
+  (test-generate '(0 1 2 3 4 5 6 7 8 9)
+                 (generate/fiber
+                  (^[yield] (let loop ([i 0]) (yield i) (loop (+ i 1))))))
+  (test-generate '(a b c d e f g h)
+                 (generate/fiber
+                  (^[yield]
+                    (let walk ([t '((a (b c)) ((d) e) (((f g h))))])
+                      (cond [(null? t)]
+                            [(pair? t) (walk (car t)) (walk (cdr t))]
+                            [else (yield t)])))))
   )
 
 (test* "x->generator <hash-table>" '((0 . a) (1 . b) (2 . c))
@@ -1,4 +1,5 @@
 (use parser.peg)
+(use parser.peg.deprecated)
 (use gauche.charconv)
 (use srfi.13)
 (use srfi.42)
@@ -27,6 +28,18 @@
 (time (peg-parse-string csv-parser data))
 ;(profiler-stop)
 
+;; A grammar that backtracks: each line is first tried as a record
+;; terminated by ';', then as a plain record.  With $memo, the second
+;; try reuses the fields parsed by the first one.
+(define (backtracking-csv-parser memo)
+  (let* ([field  (memo ($->rope ($many ($one-of #[^,\n]))))]
+         [record ($sep-by field ($char #\,) 1)]
+         [line   ($or ($try ($seq0 record ($char #\;))) record)])
+    ($sep-by line ($char #\newline))))
+
+(time (peg-parse-string (backtracking-csv-parser identity) data))
+(time (peg-parse-string (backtracking-csv-parser $memo) data))
+
 ;(profiler-show)
 
 #|
@@ -62,7 +62,7 @@
           $optional
           $sep-by $end-by $sep-end-by
           $chain-left $chain-right
-          $lazy $parameterize
+          $lazy $parameterize $memo
 
           $cut $raise
 
@@ -282,10 +282,20 @@
 (define (construct-peg-parser-error r v s s1)
   (make-peg-parse-error r v (%get-input-pos s s1) s1))
 
+;; Each driver gives a fresh memo table to the parser it runs.  $memo
+;; looks it up.  The table itself is created when $memo is first called,
+;; so that a parser without $memo pays nothing.
+;; See "Packrat memoization" below.
+(define %memo-table (make-parameter #f))
+
+(define-syntax with-memo-table
+  (syntax-rules ()
+    [(_ expr) (parameterize ([%memo-table (vector #f)]) expr)]))
+
 ;; API
 ;;   Default driver.  Returns parsed value and next stream
 (define (peg-run-parser parser s)
-  (receive (r v s1) (parser s)
+  (receive (r v s1) (with-memo-table (parser s))
     (if (parse-success? r)
       (values (rope-finalize v) s1)
       (raise (construct-peg-parser-error r v s s1)))))
@@ -326,7 +336,7 @@
   (let1 s (%->lseq src)
     (^[] (if (null? s)
            (eof-object)
-           (receive (r v s1) (parser s)
+           (receive (r v s1) (with-memo-table (parser s))
              (cond [(not (parse-success? r))
                     (raise (construct-peg-parser-error r v s s1))]
                    [(eof-object? v) (set! s '()) v]
@@ -340,7 +350,7 @@
     (generator->lseq
      (^[] (if (null? s)
             (eof-object)
-            (receive (r v s1) (parser s)
+            (receive (r v s1) (with-memo-table (parser s))
               ;; TODO: Refactor this part and similar part above
               (let1 val (cond [(not (parse-success? r))
                                (raise (construct-peg-parser-error r v s s1))]
@@ -706,12 +716,91 @@
 ;     (letrec ((p (lambda (s) (set! p parse) (p s))))
 ;       (lambda (s) (p s))))))
 
+;; API
+;; $memo parser
+;;   Packrat memoization.  The result of PARSER at each input position
+;;   is recorded in the memo table of the current driver run, and reused
+;;   when the same input position is parsed again, e.g. after backtracking
+;;   with $try or $or.
+;;   The memo table maps an input position (a cell of the input list)
+;;   to an alist of (<key> r v s1), where <key> is unique to each $memo.
+;;   PARSER should be free from side effects, since it won't be called
+;;   again on the memoized position.
+;;   When PARSER is called outside of a driver, there's no table and
+;;   PARSER is just called.
+(define ($memo parse)
+  (let1 key (list '$memo)
+    (^s (if-let1 cell (%memo-table)
+          (let* ([tab (or (vector-ref cell 0)
+                          (rlet1 t (make-hash-table 'eq?)
+                            (vector-set! cell 0 t)))]
+                 [hit (assq key (hash-table-get tab s '()))])
+            (if hit
+              (apply values (cdr hit))
+              (receive (r v s1) (parse s)
+                ;; PARSE may have added entries at S, so we re-fetch them.
+                (hash-table-put! tab s
+                                 (acons key (list r v s1)
+                                        (hash-table-get tab s '())))
+                (values r v s1))))
+          (parse s)))))
+
 ;; Utility
 (define (%check-min-max min max)
   (when (or (negative? min)
             (and max (> min max)))
     (error "invalid argument:" min max)))
 
+;; Combinator fusion
+;;   Parsers that match one item by a predicate ($satisfy without RESULT,
+;;   hence $char, $one-of and $none-of) and $string parsers carry
+;;   a descriptor in their procedure tags:
+;;
+;;     (item <pred> <expect>)
+;;     (string . <string>)
+;;
+;;   When $many and $many_ are constructed over such a parser, they
+;;   return a loop that examines the input directly, instead of calling
+;;   the parser and receiving three values for each item.
+;;   The fused loop must behave exactly as the generic one, including
+;;   the failure it returns.
+(define %procedure-copy (with-module gauche.internal %procedure-copy))
+(define %procedure-tags-alist
+  (with-module gauche.internal %procedure-tags-alist))
+
+(define (%tag-parser parser desc)
+  (%procedure-copy parser `((peg-fusion . ,desc))))
+
+(define (%fuse-many parse min max collect?)
+  (match (and (procedure? parse)
+              (assq-ref (%procedure-tags-alist parse) 'peg-fusion))
+    [('item pred expect) (%many-items pred expect min max collect?)]
+    [('string . str)     (%many-strings str min max collect?)]
+    [_ #f]))
+
+(define (%many-items pred expect min max collect?)
+  (^s (let loop ([vs '()] [s s] [count 0])
+        (cond [(>=? count max) (return-result (if collect? (reverse! vs) #t) s)]
+              [(and (pair? s) (pred (car s)))
+               (loop (if collect? (cons (car s) vs) vs) (cdr s) (+ count 1))]
+              [(<= min count) (return-result (if collect? (reverse! vs) #t) s)]
+              [else (return-failure/expect expect s)]))))
+
+;; NB: A partial match of STR doesn't consume input, as $string.
+(define (%many-strings str min max collect?)
+  (define lis (string->list str))
+  (define (skip s)
+    (let loop ([s s] [lis lis])
+      (cond [(null? lis) s]
+            [(and (pair? s) (eqv? (car s) (car lis))) (loop (cdr s) (cdr lis))]
+            [else #f])))
+  (^s (let loop ([vs '()] [s s] [count 0])
+        (cond [(>=? count max) (return-result (if collect? (reverse! vs) #t) s)]
+              [(skip s) => (^[s1] (loop (if collect? (cons str vs) vs)
+                                        s1 (+ count 1)))]
+              [(<= min count) (return-result (if collect? (reverse! vs) #t) s)]
+              [else (return-failure/expect str s)]))))
+
 ;; API
 ;; $many p :optional min max
 ;; $many_ p :optional min max
@@ -719,27 +808,29 @@
 ;; $many1_ p :optional max
 (define-inline ($many parse :optional (min 0) (max #f))
   (%check-min-max min max)
-  (lambda (s)
-    (let loop ([vs '()] [s s] [count 0])
-      (if (>=? count max)
-        (return-result (reverse! vs) s)
-        (receive (r v s1) (parse s)
-          (cond [(parse-success? r) (loop (cons v vs) s1 (+ count 1))]
-                [(and (eq? s s1) (<= min count))
-                 (return-result (reverse! vs) s1)]
-                [else (return-failure r v s1)]))))))
+  (or (%fuse-many parse min max #t)
+      (lambda (s)
+        (let loop ([vs '()] [s s] [count 0])
+          (if (>=? count max)
+            (return-result (reverse! vs) s)
+            (receive (r v s1) (parse s)
+              (cond [(parse-success? r) (loop (cons v vs) s1 (+ count 1))]
+                    [(and (eq? s s1) (<= min count))
+                     (return-result (reverse! vs) s1)]
+                    [else (return-failure r v s1)])))))))
 
 (define-inline ($many_ parse :optional (min 0) (max #f))
   (%check-min-max min max)
-  (lambda (s)
-    (let loop ([s s] [count 0])
-      (if (>=? count max)
-        (return-result #t s)
-        (receive (r v s1) (parse s)
-          (cond [(parse-success? r) (loop s1 (+ count 1))]
-                [(and (eq? s s1) (<= min count))
-                 (return-result #t s1)]
-                [else (return-failure r v s1)]))))))
+  (or (%fuse-many parse min max #f)
+      (lambda (s)
+        (let loop ([s s] [count 0])
+          (if (>=? count max)
+            (return-result #t s)
+            (receive (r v s1) (parse s)
+              (cond [(parse-success? r) (loop s1 (+ count 1))]
+                    [(and (eq? s s1) (<= min count))
+                     (return-result #t s1)]
+                    [else (return-failure r v s1)])))))))
 
 (define-inline ($many1 parse :optional (max #f)) ($many parse 1 max))
 (define-inline ($many1_ parse :optional (max #f)) ($many_ parse 1 max))
@@ -853,12 +944,13 @@
 ;;     as the value of successulf parsing.
 ;;   - Otherwise, returns failure with EXPECT as the expected input.
 (define-inline ($satisfy pred expect :optional (result #f))
-  (^s (if-let1 v (and (pair? s) (pred (car s)))
-        (return-result (if result
-                         (result (car s) v)
-                         (car s))
-                       (cdr s))
-        (return-failure/expect expect s))))
+  (let1 p (^s (if-let1 v (and (pair? s) (pred (car s)))
+                (return-result (if result
+                                 (result (car s) v)
+                                 (car s))
+                               (cdr s))
+                (return-failure/expect expect s)))
+    (if result p (%tag-parser p `(item ,pred ,expect)))))
 
 ;; API
 ;; $match1 PATTERN [(=> FAIL)] [RESULT]
@@ -1157,20 +1249,22 @@
 ;; NB: On success, we know the matched input is the same as STR,
 ;; so we don't need to bother to collect matched chars.
 (define-inline ($string str)
-  (if (= (string-length str) 1)
-    (let1 ch (string-ref str 0)
-      (^s
-        (if (and (pair? s) (eqv? (car s) ch))
-          (return-result str (cdr s))
-          (return-failure/expect str s))))
-    (let1 lis (string->list str)
-      (^[s0]
-        (let loop ([s s0] [lis lis])
-          (if (null? lis)
-            (return-result str s)
-            (if (and (pair? s) (eqv? (car s) (car lis)))
-              (loop (cdr s) (cdr lis))
-              (return-failure/expect str s0))))))))
+  (%tag-parser
+   (if (= (string-length str) 1)
+     (let1 ch (string-ref str 0)
+       (^s
+         (if (and (pair? s) (eqv? (car s) ch))
+           (return-result str (cdr s))
+           (return-failure/expect str s))))
+     (let1 lis (string->list str)
+       (^[s0]
+         (let loop ([s s0] [lis lis])
+           (if (null? lis)
+             (return-result str s)
+             (if (and (pair? s) (eqv? (car s) (car lis)))
+               (loop (cdr s) (cdr lis))
+               (return-failure/expect str s0)))))))
+   `(string . ,str)))
 
 (define ($string-ci str)
   (let1 lis (string->list str)
@@ -1220,6 +1314,8 @@
      [(char-set? items)
       ($satisfy (^x (and (char? x) (char-set-contains? items x)))
                 items)]
+     [(and (list? items) (every (^x (or (char? x) (symbol? x))) items))
+      ($satisfy (^x (memv x items)) items)]
      [(list? items) ($expect (apply $or (map $. items)) items)]
      [else (error "$one-of requires a charset or a list of items, \
                    but got:" items)]))
@@ -481,6 +481,66 @@
            ($lazy ($char #\a)) "a")
 (test-fail "$lazy" '(0 #\a)
            ($lazy ($char #\a)) "b")
+;; $memo
+(let* ([count 0]
+       [word ($->string ($many1 ($one-of #[a-z])))]
+       [counted (^s (inc! count) (word s))])
+  (define (p w) ($or ($try ($seq w ($char #\;))) w))
+  (define (run parser input)
+    (set! count 0)
+    (let1 r (guard (e [(<parse-error> e) 'error])
+              (peg-parse-string parser input))
+      (list r count)))
+  (test* "$memo" '("abc" 2) (run (p counted) "abc"))
+  (test* "$memo" '("abc" 1) (run (p ($memo counted)) "abc"))
+  (test* "$memo" '(#\; 1)   (run (p ($memo counted)) "abc;"))
+  (test* "$memo (failure)" '(error 1) (run (p ($memo counted)) "123"))
+  (test* "$memo (without driver)" "xyz"
+         (receive (r v s) (($memo word) (string->list "xyz"))
+           (rope-finalize v)))
+  (test* "$memo (generator)" '("ab" "cd" "ef")
+         (generator->list
+          (peg-parser->generator ($seq0 (p ($memo counted))
+                                        ($many_ ($. #\space)))
+                                 "ab cd ef"))))
+
+;; fused $many
+;;  Wrapping a parser by a lambda hides it from fusion, so we compare
+;;  the results with the generic loop.
+(let ()
+  (define (hide p) (^s (p s)))
+  (define-syntax test-fused
+    (syntax-rules ()
+      [(_ label make-parser input)
+       (test* label
+              (guard (e [(<parse-error> e)
+                         (list (ref e 'position) (ref e 'objects))])
+                (peg-parse-string (make-parser hide) input))
+              (guard (e [(<parse-error> e)
+                         (list (ref e 'position) (ref e 'objects))])
+                (peg-parse-string (make-parser identity) input)))]))
+  (test-fused "fused $many charset" (^h ($many (h ($one-of #[a-c]))))
+              "abcabcd")
+  (test-fused "fused $many charset min" (^h ($many (h ($one-of #[a-c])) 8))
+              "abcabcd")
+  (test-fused "fused $many charset max" (^h ($many (h ($one-of #[a-c])) 1 4))
+              "abcabcd")
+  (test-fused "fused $many_ char" (^h ($seq ($many_ (h ($char #\a)))
+                                           ($any)))
+              "aaab")
+  (test-fused "fused $many1 none-of" (^h ($many1 (h ($none-of #[,]))))
+              ",abc")
+  (test-fused "fused $many items" (^h ($many (h ($one-of '(#\x #\y)))))
+              "xyxz")
+  (test-fused "fused $many string" (^h ($many (h ($string "ab"))))
+              "ababac")
+  (test-fused "fused $many string min" (^h ($many (h ($string "ab")) 3))
+              "ababac")
+  (test-fused "fused $many_ string" (^h ($seq ($many_ (h ($string "ab")) 1 2)
+                                             ($any)))
+              "abababab")
+  (test-fused "fused $many string eos" (^h ($many (h ($string "ab"))))
+              "aba"))
 
 ;;;============================================================
 ;;; Backtrack control
@@ -0,0 +1,433 @@
+/*
+ * csv.c - native tokenizer for text.csv
+ *
+ *   Copyright (c) 2000-2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "csv.h"
+
+/*
+ * The tokenizer follows the same state transitions as the Scheme
+ * version in csv.scm (start, unquoted, quoted, quoted-tail), but
+ * accumulates the bytes of all fields of a record in one buffer and
+ * remembers the range of each field.  Once the record is read, fields
+ * are created as strings that share a single copy of the buffer.
+ *
+ * If both the separator and the quote character are ASCII, which is
+ * almost always the case, we read the input bytewise; since no byte
+ * of a multibyte character falls into ASCII range in utf-8, the bytes
+ * of other characters can just be copied to the buffer.  Otherwise we
+ * read characters.
+ */
+
+#define CSV_BUFSIZ  1024
+#define CSV_NFIELDS 32
+
+typedef struct csv_reader_rec {
+    ScmPort *port;
+    ScmChar sep;
+    ScmChar quo;                /* SCM_CHAR_INVALID if no quoting */
+    ScmCharSet *trim;           /* NULL if no trimming */
+    int bytewise;
+
+    char *buf;                  /* record buffer */
+    ScmSize size;
+    ScmSize capacity;
+
+    ScmSize *fields;            /* start and end offset of each field */
+    ScmSize nfields;
+    ScmSize fcapacity;
+
+    char sbuf[CSV_BUFSIZ];
+    ScmSize sfields[CSV_NFIELDS*2];
+} csv_reader;
+
+static void csv_reader_init(csv_reader *r, ScmPort *port,
+                            ScmObj sep, ScmObj quo, ScmObj trim)
+{
+    if (!SCM_CHARP(sep)) {
+        Scm_Error("character required for separator, but got: %S", sep);
+    }
+    if (!SCM_CHARP(quo) && !SCM_FALSEP(quo)) {
+        Scm_Error("character or #f required for quote char, but got: %S",
+                  quo);
+    }
+    if (!SCM_CHAR_SET_P(trim) && !SCM_FALSEP(trim)) {
+        Scm_Error("char-set or #f required for trim charset, but got: %S",
+                  trim);
+    }
+    r->port = port;
+    r->sep = SCM_CHAR_VALUE(sep);
+    r->quo = SCM_CHARP(quo) ? SCM_CHAR_VALUE(quo) : SCM_CHAR_INVALID;
+    r->trim = SCM_CHAR_SET_P(trim) ? SCM_CHAR_SET(trim) : NULL;
+    r->bytewise = (r->sep < 0x80 && r->quo < 0x80);
+    r->buf = r->sbuf;
+    r->size = 0;
+    r->capacity = CSV_BUFSIZ;
+    r->fields = r->sfields;
+    r->nfields = 0;
+    r->fcapacity = CSV_NFIELDS;
+}
+
+static void csv_error(csv_reader *r, const char *msg)
+{
+    ScmObj name = Scm_PortName(r->port);
+    if (SCM_FALSEP(name)) Scm_Error("%s", msg);
+    Scm_Error("%s (%S:%d)", msg, name, (int)Scm_PortLine(r->port));
+}
+
+static inline int csv_getc(csv_reader *r)
+{
+    return r->bytewise ? Scm_Getb(r->port) : Scm_Getc(r->port);
+}
+
+static void csv_grow(csv_reader *r, ScmSize need)
+{
+    ScmSize ncap = r->capacity * 2;
+    while (ncap < r->size + need) ncap *= 2;
+    char *nbuf = SCM_NEW_ATOMIC2(char*, ncap);
+    memcpy(nbuf, r->buf, r->size);
+    r->buf = nbuf;
+    r->capacity = ncap;
+}
+
+static inline void csv_putc(csv_reader *r, int c)
+{
+    if (r->bytewise || c < 0x80) {
+        if (r->size >= r->capacity) csv_grow(r, 1);
+        r->buf[r->size++] = (char)c;
+    } else {
+        int n = SCM_CHAR_NBYTES(c);
+        if (r->size + n > r->capacity) csv_grow(r, n);
+        SCM_CHAR_PUT(r->buf + r->size, c);
+        r->size += n;
+    }
+}
+
+static void csv_add_field(csv_reader *r, ScmSize start, ScmSize end)
+{
+    if (r->nfields >= r->fcapacity) {
+        ScmSize *nf = SCM_NEW_ATOMIC_ARRAY(ScmSize, r->fcapacity*4);
+        memcpy(nf, r->fields, sizeof(ScmSize)*r->nfields*2);
+        r->fields = nf;
+        r->fcapacity *= 2;
+    }
+    r->fields[r->nfields*2]   = start;
+    r->fields[r->nfields*2+1] = end;
+    r->nfields++;
+}
+
+/* Returns the length of the character at P, or 0 if it is not in
+   the trim charset. */
+static inline int csv_trimmable(csv_reader *r, const char *p, const char *end)
+{
+    int n = SCM_CHAR_NFOLLOWS(*p) + 1;
+    if (n <= 0 || p + n > end) return 0;
+    ScmChar ch;
+    SCM_CHAR_GET(p, ch);
+    if (ch == SCM_CHAR_INVALID) return 0;
+    if (!Scm_CharSetContains(r->trim, ch)) return 0;
+    return n;
+}
+
+static int csv_all_trimmable(csv_reader *r, ScmSize start, ScmSize end)
+{
+    const char *p = r->buf + start, *e = r->buf + end;
+    while (p < e) {
+        int n = csv_trimmable(r, p, e);
+        if (n == 0) return FALSE;
+        p += n;
+    }
+    return TRUE;
+}
+
+static void csv_add_trimmed_field(csv_reader *r, ScmSize start, ScmSize end)
+{
+    if (r->trim) {
+        const char *b = r->buf + start, *e = r->buf + end;
+        while (b < e) {
+            int n = csv_trimmable(r, b, e);
+            if (n == 0) break;
+            b += n;
+        }
+        while (b < e) {
+            const char *prev;
+            SCM_CHAR_BACKWARD(e, b, prev);
+            if (prev == NULL || csv_trimmable(r, prev, e) == 0) break;
+            e = prev;
+        }
+        start = b - r->buf;
+        end = e - r->buf;
+    }
+    csv_add_field(r, start, end);
+}
+
+/* Called after the opening quote.  Reads the content up to the closing
+   quote and adds it as a field.  Returns the character following the
+   closing quote. */
+static int csv_read_quoted(csv_reader *r)
+{
+    ScmSize start = r->size;
+    for (;;) {
+        int c = csv_getc(r);
+        if (c == EOF) csv_error(r, "unterminated quoted field");
+        if (c == r->quo) {
+            c = csv_getc(r);
+            if (c != r->quo) {
+                csv_add_field(r, start, r->size);
+                return c;
+            }
+        }
+        csv_putc(r, c);
+    }
+}
+
+/* Reads one record.  Returns FALSE if the port is already at EOF. */
+static int csv_read_record(csv_reader *r)
+{
+    r->size = 0;
+    r->nfields = 0;
+    if ((r->bytewise ? Scm_Peekb(r->port) : Scm_Peekc(r->port)) == EOF) {
+        return FALSE;
+    }
+
+    for (;;) {
+        ScmSize start = r->size;
+        int c = csv_getc(r);
+        if (c == '\n' || c == EOF) {
+            csv_add_field(r, start, start);
+            return TRUE;
+        }
+        if (c == r->sep) {
+            csv_add_field(r, start, start);
+            continue;
+        }
+        if (c == r->quo) {
+            c = csv_read_quoted(r);
+        } else {
+            for (;;) {
+                csv_putc(r, c);
+                c = csv_getc(r);
+                if (c == '\n' || c == EOF || c == r->sep) break;
+                if (c == r->quo) {
+                    if (r->trim == NULL
+                        || !csv_all_trimmable(r, start, r->size)) {
+                        csv_error(r, "quote char in a field");
+                    }
+                    r->size = start;
+                    c = csv_read_quoted(r);
+                    goto quoted_tail;
+                }
+            }
+            csv_add_trimmed_field(r, start, r->size);
+            if (c == r->sep) continue;
+            return TRUE;
+        }
+    quoted_tail:
+        /* Anything between the closing quote and the separator is
+           ignored. */
+        while (c != '\n' && c != EOF && c != r->sep) c = csv_getc(r);
+        if (c != r->sep) return TRUE;
+    }
+}
+
+/* Make the K-th field a string.  BODY is a copy of the record buffer,
+   shared by the fields. */
+static inline ScmObj csv_field_string(csv_reader *r, const char *body,
+                                      ScmSize k)
+{
+    ScmSize s = r->fields[k*2], e = r->fields[k*2+1];
+    return Scm_MakeString(body + s, e - s, -1, 0);
+}
+
+static const char *csv_record_body(csv_reader *r)
+{
+    char *body = SCM_NEW_ATOMIC2(char*, r->size + 1);
+    memcpy(body, r->buf, r->size);
+    body[r->size] = '\0';
+    return body;
+}
+
+ScmObj Scm_CsvReadRecord(ScmPort *port, ScmObj sep, ScmObj quo, ScmObj trim)
+{
+    csv_reader r;
+    csv_reader_init(&r, port, sep, quo, trim);
+    if (!csv_read_record(&r)) return SCM_EOF;
+
+    const char *body = csv_record_body(&r);
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    for (ScmSize k = 0; k < r.nfields; k++) {
+        SCM_APPEND1(h, t, csv_field_string(&r, body, k));
+    }
+    return h;
+}
+
+/*
+ * Columns
+ *
+ *   TYPES is a vector; each element is <string>, a uvector class, or #f.
+ *   Reads all the records up to EOF, and returns a vector of columns.
+ *   A column of <string> is a vector of strings; a column of a uvector
+ *   class is a uvector of that class, into which the field is stored
+ *   as a number; the column is #f for #f.  Missing fields are treated
+ *   as empty.  An empty field in a floating-point column becomes NaN.
+ */
+
+typedef struct csv_column_rec {
+    int kind;                   /* COL_SKIP, COL_STRING or COL_UVECTOR */
+    ScmClass *klass;            /* uvector class */
+    ScmUVectorType utype;
+    ScmObj strings;             /* list of strings, reversed */
+    ScmObj vec;                 /* uvector, its size is the capacity */
+    ScmSize count;
+} csv_column;
+
+enum { COL_SKIP, COL_STRING, COL_UVECTOR };
+
+static void csv_column_init(csv_column *col, ScmObj type)
+{
+    col->kind = COL_SKIP;
+    col->klass = NULL;
+    col->utype = SCM_UVECTOR_INVALID;
+    col->strings = SCM_NIL;
+    col->vec = SCM_FALSE;
+    col->count = 0;
+
+    if (SCM_FALSEP(type)) return;
+    if (SCM_EQ(type, SCM_OBJ(SCM_CLASS_STRING))) {
+        col->kind = COL_STRING;
+        return;
+    }
+    if (SCM_CLASSP(type) && Scm_UVectorType(SCM_CLASS(type)) >= 0) {
+        col->kind = COL_UVECTOR;
+        col->klass = SCM_CLASS(type);
+        col->utype = Scm_UVectorType(col->klass);
+        col->vec = Scm_MakeUVector(col->klass, 64, NULL);
+        return;
+    }
+    Scm_Error("column type must be <string>, a uvector class or #f, "
+              "but got: %S", type);
+}
+
+static void csv_column_push_number(csv_column *col, ScmObj num)
+{
+    ScmSize cap = SCM_UVECTOR_SIZE(col->vec);
+    if (col->count >= cap) {
+        int eltsize = Scm_UVectorElementSize(col->klass);
+        ScmObj nv = Scm_MakeUVector(col->klass, cap*2, NULL);
+        memcpy(SCM_UVECTOR_ELEMENTS(nv), SCM_UVECTOR_ELEMENTS(col->vec),
+               cap*eltsize);
+        col->vec = nv;
+    }
+    Scm_UVectorSet(SCM_UVECTOR(col->vec), col->utype, col->count++, num,
+                   SCM_CLAMP_ERROR);
+}
+
+static int csv_float_type_p(ScmUVectorType t)
+{
+    return (t == SCM_UVECTOR_F16 || t == SCM_UVECTOR_F32
+            || t == SCM_UVECTOR_F64);
+}
+
+static ScmObj csv_column_result(csv_column *col)
+{
+    switch (col->kind) {
+    case COL_STRING:
+        return Scm_ListToVector(Scm_ReverseX(col->strings), 0, -1);
+    case COL_UVECTOR:
+        /* Share the elements; the slack beyond COUNT is just unused. */
+        return Scm_MakeUVector(col->klass, col->count,
+                               SCM_UVECTOR_ELEMENTS(col->vec));
+    default:
+        return SCM_FALSE;
+    }
+}
+
+ScmObj Scm_CsvReadColumns(ScmPort *port, ScmObj sep, ScmObj quo,
+                          ScmObj trim, ScmObj types)
+{
+    if (!SCM_VECTORP(types)) {
+        Scm_Error("vector required for column types, but got: %S", types);
+    }
+    ScmSize ncols = SCM_VECTOR_SIZE(types);
+    csv_column *cols = SCM_NEW_ARRAY(csv_column, ncols);
+    for (ScmSize i = 0; i < ncols; i++) {
+        csv_column_init(&cols[i], SCM_VECTOR_ELEMENT(types, i));
+    }
+
+    csv_reader r;
+    csv_reader_init(&r, port, sep, quo, trim);
+    while (csv_read_record(&r)) {
+        const char *body = NULL;
+        for (ScmSize i = 0; i < ncols; i++) {
+            csv_column *col = &cols[i];
+            if (col->kind == COL_SKIP) continue;
+            if (col->kind == COL_STRING) {
+                if (i >= r.nfields) {
+                    col->strings = Scm_Cons(SCM_MAKE_STR(""), col->strings);
+                } else {
+                    if (body == NULL) body = csv_record_body(&r);
+                    col->strings = Scm_Cons(csv_field_string(&r, body, i),
+                                            col->strings);
+                }
+                continue;
+            }
+            /* Numeric column.  The string is only used for conversion,
+               so it can point into the record buffer. */
+            ScmSize s = 0, e = 0;
+            if (i < r.nfields) {
+                s = r.fields[i*2];
+                e = r.fields[i*2+1];
+            }
+            if (s == e) {
+                if (!csv_float_type_p(col->utype)) {
+                    csv_error(&r, "empty field in a numeric column");
+                }
+                csv_column_push_number(col, SCM_NAN);
+                continue;
+            }
+            ScmObj str = Scm_MakeString(r.buf + s, e - s, -1, 0);
+            ScmObj num = Scm_StringToNumber(SCM_STRING(str), 10, 0);
+            if (SCM_FALSEP(num)) {
+                Scm_Error("non-numeric field in column %d: %S", (int)i,
+                          Scm_CopyString(SCM_STRING(str)));
+            }
+            csv_column_push_number(col, num);
+        }
+    }
+
+    ScmObj v = Scm_MakeVector(ncols, SCM_FALSE);
+    for (ScmSize i = 0; i < ncols; i++) {
+        SCM_VECTOR_ELEMENT(v, i) = csv_column_result(&cols[i]);
+    }
+    return v;
+}
@@ -38,6 +38,7 @@
   (use srfi.42)
   (use gauche.sequence)
   (export make-csv-reader
+          make-csv-column-reader
           make-csv-writer
           csv-trim-unquoted-charset
           make-csv-header-parser
@@ -54,12 +55,49 @@
 (define csv-trim-unquoted-charset (make-parameter #[\s]))
 
 
+;; The tokenizer is written in C (csv.c).  It handles the common case
+;; where the separator and the quote char are characters and the trim
+;; charset is a char-set; otherwise we fall back to the Scheme version,
+;; csv-reader below.
+(inline-stub
+ (.include "csv.h")
+
+ (define-cproc %csv-read-record (port::<input-port> sep quo trim)
+   (return (Scm_CsvReadRecord port sep quo trim)))
+ (define-cproc %csv-read-columns (port::<input-port> sep quo trim types)
+   (return (Scm_CsvReadColumns port sep quo trim types)))
+ )
+
+(define (native-params? sep quo trim-charset)
+  (and (char? sep)
+       (or (char? quo) (not quo))
+       (or (char-set? trim-charset) (not trim-charset))))
+
 ;; API
 (define (make-csv-reader separator
                          :optional (quote-char #\")
                                    (trim-charset (csv-trim-unquoted-charset)))
-  (^[:optional (port (current-input-port))]
-    (csv-reader separator quote-char port trim-charset)))
+  (if (native-params? separator quote-char trim-charset)
+    (^[:optional (port (current-input-port))]
+      (%csv-read-record port separator quote-char trim-charset))
+    (^[:optional (port (current-input-port))]
+      (csv-reader separator quote-char port trim-charset))))
+
+;; API
+;; Read all the remaining records into columns.  TYPES is a list,
+;; each element of which is <string>, a uvector class or #f, for
+;; the corresponding column.  Returns a vector of columns.
+(define (make-csv-column-reader separator types
+                                :optional (quote-char #\")
+                                          (trim-charset
+                                           (csv-trim-unquoted-charset)))
+  (unless (native-params? separator quote-char trim-charset)
+    (error "make-csv-column-reader requires a character separator, \
+            a character or #f quote-char, and a char-set or #f \
+            trim-charset, but got:" separator quote-char trim-charset))
+  (let1 types (list->vector types)
+    (^[:optional (port (current-input-port))]
+      (%csv-read-columns port separator quote-char trim-charset types))))
 
 (define (csv-reader sep quo port trim-charset)
   (define (eor? ch) (or (eqv? ch #\newline) (eof-object? ch)))
@@ -0,0 +1,219 @@
+;;
+;; testing text.csv
+;;
+
+(test-section "text.csv")
+
+(use text.csv)
+(use gauche.uvector)
+(test-module 'text.csv)
+
+(test* "csv-reader" '("abc" "def" "" "ghi")
+       (call-with-input-string "abc  ,  def  ,, ghi  "
+         (make-csv-reader #\,)))
+
+(test* "csv-reader (trim, parameter)" '("abc" "def" "" "ghi")
+       (parameterize ([csv-trim-unquoted-charset #[_]])
+         (call-with-input-string "abc__,__def__,,_ghi__"
+           (make-csv-reader #\,))))
+
+(test* "csv-reader (do not trim)" '("abc  " "  def  " "" " ghi  ")
+       (call-with-input-string "abc  ,  def  ,, ghi  "
+         (make-csv-reader #\, #\" #f)))
+
+(test* "csv-reader" '("abc" "def" "" ", ghi")
+       (call-with-input-string "abc  :  def  :: , ghi  "
+         (make-csv-reader #\:)))
+
+(test* "csv-reader" '("abc" "def" "ghi")
+       (call-with-input-string "abc  ,  \"def\"  , \"ghi\"  "
+         (make-csv-reader #\,)))
+
+(test* "csv-reader" '("abc" " de,f " "gh\ni" "jkl")
+       (call-with-input-string "   abc,  \" de,f \"  , \"gh\ni\", \"jkl\""
+         (make-csv-reader #\,)))
+
+(test* "csv-reader (do not allow extra spaces w/o trimming)"
+       (test-error <error> #/quote char in a field/)
+       (parameterize ([csv-trim-unquoted-charset #f])
+         (call-with-input-string "abc  ,  \"def\"  , \"ghi\"  "
+           (make-csv-reader #\,))))
+
+(test* "csv-reader" '("ab\nc" "de \n\n \nf " "" "" "gh\"\n\"i")
+       (call-with-input-string "   \"ab\nc\" ,  \"de \n\n \nf \"  ,  , \"\" , \"gh\"\"\n\"\"i\""
+         (make-csv-reader #\,)))
+
+(test* "csv-reader" '(("" "") ("a" "") ("" "b"))
+       (let1 r (make-csv-reader #\,)
+         (call-with-input-string ",\na,  \n  ,b"
+           (^p (let* ([a (r p)] [b (r p)] [c (r p)] [d (r p)])
+                 (and (eof-object? d)
+                      (list a b c)))))))
+
+(test* "csv-reader" (test-error)
+       (call-with-input-string " abc,  def , \"ghi\"\"\n\n"
+         (make-csv-reader #\,)))
+
+(test* "csv-reader" #t
+       (eof-object?
+        (call-with-input-string "" (make-csv-reader #\,))))
+
+(test* "csv-writer"
+       "abc,def,123,\"what's up?\",\"he said, \"\"nothing new.\"\"\"\n"
+       (call-with-output-string
+         (lambda (out)
+           ((make-csv-writer #\,)
+            out
+            '("abc" "def" "123" "what's up?" "he said, \"nothing new.\""))))
+       )
+
+(test* "csv-writer"
+       "abc,def,123,\"what's up?\",\"he said, \"\"nothing new.\"\"\"\r\n"
+       (call-with-output-string
+         (lambda (out)
+           ((make-csv-writer #\, "\r\n")
+            out
+            '("abc" "def" "123" "what's up?" "he said, \"nothing new.\""))))
+       )
+
+(test* "csv-writer" "\n"
+       (call-with-output-string
+         (lambda (out)
+           ((make-csv-writer #\,) out '()))))
+
+;; middle-level API
+
+(let ([data '(("" "" "" "" "" "" "" "" "")
+              ("Exported data" "" "" "" "" "" "" "" "")
+              ("" "" "" "" "" "" "" "" "")
+              ("" "" "Year" "Country" "" "Population" "GDP" "" "Note")
+              ("" "" "1958" "Land of Lisp" "" "39994" "551,435,453" "" "")
+              ("" "" "1957" "United States of Formula Translators" "" "115333"
+               "4,343,225,434" "" "Estimated")
+              ("" "" "1959" "People's Republic of COBOL" ""
+               "82524" "3,357,551,143" "" "")
+              ("" "" "1970" "Kingdom of Pascal" "" "3785" "" "" "GDP missing")
+              ("" "" "" "" "" "" "" "" "")
+              ("" "" "1962" "APL Republic" "" "1545" "342,335,151" "" ""))]
+      [header-slots1  '("Country" "Year" "GDP" "Population")]
+      [header-slots2 '(#/country/i #/year/i #/gdp/i #/popu/i)])
+  (test* "make-csv-header-parser (strings)" '#(3 2 6 5)
+         (any (make-csv-header-parser header-slots1) data))
+
+  (test* "make-csv-header-parser (regexps)" '#(3 2 6 5)
+         (any (make-csv-header-parser header-slots2) data))
+
+  (test* "make-csv-record-parser (strings)"
+         '(("Land of Lisp" "1958" "551,435,453" "39994")
+           ("United States of Formula Translators" "1957" "4,343,225,434"
+            "115333")
+           ("People's Republic of COBOL" "1959" "3,357,551,143" "82524")
+           ("APL Republic" "1962" "342,335,151" "1545"))
+         (filter-map (make-csv-record-parser header-slots1 '#(3 2 6 5)
+                                             '(("Year" #/^\d+$/)
+                                               "Country" "Population" "GDP"))
+                     data))
+
+  (test* "make-csv-record-parser (regexps)"
+         '(("Land of Lisp" "1958" "551,435,453" "39994")
+           ("United States of Formula Translators" "1957" "4,343,225,434"
+            "115333")
+           ("People's Republic of COBOL" "1959" "3,357,551,143" "82524")
+           ("APL Republic" "1962" "342,335,151" "1545"))
+         (filter-map (make-csv-record-parser header-slots2 '#(3 2 6 5)
+                                             '((#/year/i #/^\d+$/)
+                                               #/country/i #/popu/i #/gdp/i))
+                     data))
+
+  (test* "csv-rows->tuples (allow-gap? #f)"
+         '(("Land of Lisp" "1958" "551,435,453" "39994")
+           ("United States of Formula Translators" "1957" "4,343,225,434"
+            "115333")
+           ("People's Republic of COBOL" "1959" "3,357,551,143" "82524")
+           ("Kingdom of Pascal" "1970" "" "3785"))
+         (csv-rows->tuples data header-slots1))
+
+  (test* "csv-rows->tuples (allow-gap? #t)"
+         '(("Land of Lisp" "1958" "551,435,453" "39994")
+           ("United States of Formula Translators" "1957" "4,343,225,434"
+            "115333")
+           ("People's Republic of COBOL" "1959" "3,357,551,143" "82524")
+           ("Kingdom of Pascal" "1970" "" "3785")
+           ("APL Republic" "1962" "342,335,151" "1545"))
+         (csv-rows->tuples data header-slots1 :allow-gap? #t))
+  )
+
+;; native tokenizer
+
+(test* "csv-reader (multibyte)" '("\u3042\u3044" "\u3046" "\u3048\u304a")
+       (call-with-input-string " \u3042\u3044 , \u3046,\"\u3048\u304a\""
+         (make-csv-reader #\,)))
+
+(test* "csv-reader (trim multibyte)" '("\u3042" "\u3046")
+       (call-with-input-string "\u3000\u3042\u3000,\u3046"
+         (make-csv-reader #\, #\" (char-set #\u3000))))
+
+(test* "csv-reader (multibyte separator)" '("ab" "c d" "e\u3001f")
+       (call-with-input-string "ab\u3001 c d \u3001'e\u3001f'"
+         (make-csv-reader #\u3001 #\')))
+
+(test* "csv-reader (no quote)" '("\"ab\"" "c")
+       (call-with-input-string "\"ab\",c"
+         (make-csv-reader #\, #f)))
+
+(test* "csv-reader (predicate trimmer)" '("abc" "def")
+       (call-with-input-string "--abc--,-def"
+         (make-csv-reader #\, #\" (cut char=? #\- <>))))
+
+(test* "csv-reader (long fields)"
+       (list (make-string 3000 #\a) "b" (make-string 5000 #\c))
+       (call-with-input-string (string-append (make-string 3000 #\a) ",b,\""
+                                              (make-string 5000 #\c) "\"")
+         (make-csv-reader #\,)))
+
+(test* "csv-reader (many fields)" (map number->string (iota 100))
+       (call-with-input-string (string-join (map number->string (iota 100))
+                                            ",")
+         (make-csv-reader #\,)))
+
+(test* "csv-reader (line count)" '(("a" "b\nc") ("d") 4)
+       (call-with-input-string "a,\"b\nc\"\nd\nx"
+         (^p (let* ([r (make-csv-reader #\,)]
+                    [x (r p)]
+                    [y (r p)])
+               (list x y (port-current-line p))))))
+
+(test* "csv-reader (error line)" (test-error <error> #/unterminated.*:4\)/)
+       (call-with-input-string "a,b\nc,d\n\"e\nf"
+         (^p (let1 r (make-csv-reader #\,)
+               (r p) (r p) (r p)))))
+
+(test* "csv-column-reader"
+       '(#("a" "b" "c d" "") #f (1.5 -2.0 3000.0 nan) (1 2 3 4))
+       (let1 v (call-with-input-string
+                   "a,x,1.5,1\nb,y,-2,2\n \"c d\" ,z,3e3,3\n,,,4"
+                 (make-csv-column-reader #\, `(,<string> #f ,<f64vector>
+                                               ,<s32vector>)))
+         (list (vector-ref v 0)
+               (vector-ref v 1)
+               (map (^x (if (nan? x) 'nan x))
+                    (f64vector->list (vector-ref v 2)))
+               (s32vector->list (vector-ref v 3)))))
+
+(test* "csv-column-reader (missing fields, many rows)"
+       (list 1000 (iota 1000) (make-list 1000 ""))
+       (let1 v (call-with-input-string
+                   (with-output-to-string
+                     (^[] (dotimes [i 1000] (print i))))
+                 (make-csv-column-reader #\, `(,<s64vector> ,<string>)))
+         (list (s64vector-length (vector-ref v 0))
+               (s64vector->list (vector-ref v 0))
+               (vector->list (vector-ref v 1)))))
+
+(test* "csv-column-reader (non-numeric)" (test-error <error> #/non-numeric/)
+       (call-with-input-string "1\nx\n"
+         (make-csv-column-reader #\, `(,<f64vector>))))
+
+(test* "csv-column-reader (empty integer)" (test-error <error> #/empty field/)
+       (call-with-input-string "1\n\n"
+         (make-csv-column-reader #\, `(,<u8vector>))))
@@ -106,6 +106,12 @@ struct ScmTLSRec {
     ScmObj (*loadPrivateKey)(ScmTLS*, const char*, const char*);
     ScmObj (*getConnectionAddress)(ScmTLS*, int);
     void   (*finalize)(ScmObj, void*);
+    /* Byte-level I/O, used by the ports and tls-read!.  readBytes
+       decrypts at most SIZE bytes into BUF, returning the number of bytes
+       read, or 0 on EOF.  writeBytes sends all SIZE bytes.  They may be
+       NULL if the backend doesn't support them. */
+    ScmSize (*readBytes)(ScmTLS*, uint8_t*, ScmSize);
+    ScmSize (*writeBytes)(ScmTLS*, const uint8_t*, ScmSize);
 };
 
 SCM_CLASS_DECL(Scm_TLSClass);
@@ -163,13 +169,37 @@ enum {
 extern ScmObj Scm_TLSRead(ScmTLS* t);
 extern ScmObj Scm_TLSWrite(ScmTLS* t, ScmObj msg);
 
+/* Reads into the caller's buffer.  Returns the number of bytes read,
+   which is at most SIZE, or 0 on EOF. */
+extern ScmSize Scm_TLSReadBytes(ScmTLS* t, uint8_t *buf, ScmSize size);
+
+/* Size of the port buffer, large enough to hold a full TLS record. */
+#define SCM_TLS_PORT_BUFSIZ  16384
+
 extern ScmObj Scm_TLSInputPort(ScmTLS* t);
 extern ScmObj Scm_TLSOutputPort(ScmTLS* t);
 
 /* internal, for tls.scm implementation convenience */
 extern ScmObj Scm_TLSInputPortSet(ScmTLS* t, ScmObj port);
 extern ScmObj Scm_TLSOutputPortSet(ScmTLS* t, ScmObj port);
-
+/* Create buffered ports on T.  Returns #f if the backend doesn't
+   support byte-level I/O. */
+extern ScmObj Scm_TLSMakeInputPort(ScmTLS* t);
+extern ScmObj Scm_TLSMakeOutputPort(ScmTLS* t);
+
+/* Session cache.  Key returns the cache key for a connection, which
+   covers everything that affects verification of the server.  Lookup
+   returns the data stored by the backend for the key, or #f.
+   NoteServer records the result of a server-side lookup for
+   statistics. */
+extern int    Scm_TLSSessionCacheSize(void);
+extern ScmObj Scm_TLSSessionCacheKey(const char *host, const char *port,
+                                     ScmObj server_name, ScmObj ca);
+extern ScmObj Scm_TLSSessionCacheLookup(ScmObj key);
+extern void   Scm_TLSSessionCacheStore(ScmObj key, ScmObj data);
+extern void   Scm_TLSSessionCacheNoteServer(int hit);
+extern ScmObj Scm_TLSSessionCacheStats(void);
+extern void   Scm_TLSSessionCacheClear(void);
 
 SCM_DECL_END
 
@@ -73,6 +73,60 @@
                            (flush (tls-output-port clnt))
                            (string-length (read-line (tls-input-port clnt))))
                        (tls-close clnt)))))
+          (test* "tls-read!" "OK:Mahalo\r\n"
+                 (parameterize ((tls-ca-bundle-path (datafile "test-cert.pem")))
+                   (let1 clnt (make <mbed-tls> :server-name "localhost")
+                     (unwind-protect
+                         (begin
+                           (tls-connect clnt "localhost" serv-port)
+                           (display "Mahalo\r\n" (tls-output-port clnt))
+                           (flush (tls-output-port clnt))
+                           (let1 buf (make-u8vector 64 0)
+                             (let loop ([pos 0])
+                               (let1 n (tls-read! clnt buf pos)
+                                 (if (eof-object? n)
+                                   (u8vector->string buf 0 pos)
+                                   (loop (+ pos n)))))))
+                       (tls-close clnt)))))
+          (let ()
+            (define (request msg :optional (skip #f))
+              (parameterize ((tls-ca-bundle-path (datafile "test-cert.pem")))
+                (let1 clnt (make <mbed-tls> :server-name "localhost"
+                                 :skip-verification skip)
+                  (unwind-protect
+                      (begin
+                        (tls-connect clnt "localhost" serv-port)
+                        (display #"~|msg|\r\n" (tls-output-port clnt))
+                        (flush (tls-output-port clnt))
+                        (read-line (tls-input-port clnt)))
+                    (tls-close clnt)))))
+            (define (stat key) (assq-ref (tls-session-cache-stats) key))
+            (tls-session-cache-clear!)
+            (test* "session cache (first)" '("OK:Ahoy" 1 1)
+                   (list (request "Ahoy")
+                         (stat 'client-lookups)
+                         (stat 'client-entries)))
+            ;; Whether the session is actually resumed depends on the
+            ;; features mbedTLS is built with.  Here we only check the
+            ;; resumed (or not) connection works and the cache is consulted.
+            (test* "session cache (second)" '("OK:Ahoy again" 2 1 #t)
+                   (list (request "Ahoy again")
+                         (stat 'client-lookups)
+                         (stat 'client-entries)
+                         (<= (stat 'server-hits) (stat 'server-lookups))))
+            ;; A connection that skips verification neither looks up
+            ;; nor stores a session.
+            (test* "session cache (skip verification)" '("OK:Hi" 2 1)
+                   (list (request "Hi" #t)
+                         (stat 'client-lookups)
+                         (stat 'client-entries)))
+            (test* "session cache size (invalid)" (test-error)
+                   (parameterize ((tls-session-cache-size -1)) #f))
+            (test* "session cache disabled" '("OK:Bye" 0)
+                   (parameterize ((tls-session-cache-size 0))
+                     (tls-session-cache-clear!)
+                     (list (request "Bye")
+                           (stat 'client-lookups)))))
           (test* "server shutdown" 'bye
                  (parameterize ((tls-ca-bundle-path (datafile "test-cert.pem")))
                    (let1 clnt (make <mbed-tls> :server-name "localhost")
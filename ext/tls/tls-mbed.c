@@ -43,6 +43,12 @@
 #include <mbedtls/entropy.h>
 #include <mbedtls/net_sockets.h>
 #include <mbedtls/debug.h>
+#if defined(MBEDTLS_SSL_CACHE_C)
+#include <mbedtls/ssl_cache.h>
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+#include <mbedtls/ssl_ticket.h>
+#endif
 #include <psa/crypto.h>         /* for psa_crypto_init */
 
 SCM_CLASS_DECL(Scm_MbedTLSClass);
@@ -90,8 +96,16 @@ typedef struct ScmMbedTLSRec {
     mbedtls_ssl_config conf;
     mbedtls_x509_crt ca;
     mbedtls_pk_context pk;
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_cache_context cache; /* server session cache */
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+    mbedtls_ssl_ticket_context ticket; /* server ticket keys */
+#endif
     ScmObj server_name;
     _Bool skip_verification;
+    ScmObj session_key;         /* client; key of the session cache, or #f
+                                   if the session can't be cached */
 } ScmMbedTLS;
 
 /*
@@ -145,6 +159,134 @@ static void mbed_close_check(ScmMbedTLS *t, const char *op)
 }
 
 
+/*
+ * Session resumption
+ */
+
+/* mbedtls_ssl_session_save/load appeared in 2.19. */
+#define MBED_HAVE_SESSION_SAVE  (MBEDTLS_VERSION_NUMBER >= 0x02130000)
+
+/* Client side.  We may be called more than once per connection; in
+   TLS 1.3, the session becomes resumable only after the server sends
+   a ticket, which arrives after the handshake. */
+static void mbed_save_session(ScmMbedTLS *t SCM_UNUSED)
+{
+#if MBED_HAVE_SESSION_SAVE
+    if (SCM_FALSEP(t->session_key) || Scm_TLSSessionCacheSize() == 0) return;
+
+    mbedtls_ssl_session s;
+    mbedtls_ssl_session_init(&s);
+    if (mbedtls_ssl_get_session(&t->ctx, &s) == 0) {
+        size_t len = 0;
+        (void)mbedtls_ssl_session_save(&s, NULL, 0, &len);
+        if (len > 0) {
+            ScmObj v = Scm_MakeU8Vector(len, 0);
+            if (mbedtls_ssl_session_save(&s, SCM_U8VECTOR_ELEMENTS(v),
+                                         len, &len) == 0) {
+                Scm_TLSSessionCacheStore(t->session_key, v);
+            }
+        }
+    }
+    mbedtls_ssl_session_free(&s);
+#endif /*MBED_HAVE_SESSION_SAVE*/
+}
+
+static void mbed_restore_session(ScmMbedTLS *t SCM_UNUSED)
+{
+#if MBED_HAVE_SESSION_SAVE
+    if (SCM_FALSEP(t->session_key) || Scm_TLSSessionCacheSize() == 0) return;
+    ScmObj v = Scm_TLSSessionCacheLookup(t->session_key);
+    if (!SCM_U8VECTORP(v)) return;
+
+    /* If the data can't be loaded, we just do a full handshake. */
+    mbedtls_ssl_session s;
+    mbedtls_ssl_session_init(&s);
+    if (mbedtls_ssl_session_load(&s, SCM_U8VECTOR_ELEMENTS(v),
+                                 SCM_U8VECTOR_SIZE(v)) == 0) {
+        (void)mbedtls_ssl_set_session(&t->ctx, &s);
+    }
+    mbedtls_ssl_session_free(&s);
+#endif /*MBED_HAVE_SESSION_SAVE*/
+}
+
+/* Lifetime of tickets in seconds; the same as the default timeout of
+   mbedTLS's session cache. */
+#define MBED_TICKET_LIFETIME  86400
+
+/* Server side.  We wrap mbedTLS's session cache and ticket parser to
+   count hits. */
+#if defined(MBEDTLS_SSL_CACHE_C)
+#if MBEDTLS_VERSION_MAJOR >= 3
+static int mbed_cache_get(void *data, unsigned char const *id, size_t idlen,
+                          mbedtls_ssl_session *session)
+{
+    ScmMbedTLS *t = (ScmMbedTLS*)data;
+    int r = mbedtls_ssl_cache_get(&t->cache, id, idlen, session);
+    Scm_TLSSessionCacheNoteServer(r == 0);
+    return r;
+}
+
+static int mbed_cache_set(void *data, unsigned char const *id, size_t idlen,
+                          const mbedtls_ssl_session *session)
+{
+    ScmMbedTLS *t = (ScmMbedTLS*)data;
+    return mbedtls_ssl_cache_set(&t->cache, id, idlen, session);
+}
+#else  /*MBEDTLS_VERSION_MAJOR < 3*/
+static int mbed_cache_get(void *data, mbedtls_ssl_session *session)
+{
+    ScmMbedTLS *t = (ScmMbedTLS*)data;
+    int r = mbedtls_ssl_cache_get(&t->cache, session);
+    Scm_TLSSessionCacheNoteServer(r == 0);
+    return r;
+}
+
+static int mbed_cache_set(void *data, const mbedtls_ssl_session *session)
+{
+    ScmMbedTLS *t = (ScmMbedTLS*)data;
+    return mbedtls_ssl_cache_set(&t->cache, session);
+}
+#endif /*MBEDTLS_VERSION_MAJOR < 3*/
+#endif /*MBEDTLS_SSL_CACHE_C*/
+
+#if defined(MBEDTLS_SSL_TICKET_C)
+static int mbed_ticket_write(void *data, const mbedtls_ssl_session *session,
+                             unsigned char *start, const unsigned char *end,
+                             size_t *tlen, uint32_t *lifetime)
+{
+    ScmMbedTLS *t = (ScmMbedTLS*)data;
+    return mbedtls_ssl_ticket_write(&t->ticket, session, start, end,
+                                    tlen, lifetime);
+}
+
+static int mbed_ticket_parse(void *data, mbedtls_ssl_session *session,
+                             unsigned char *buf, size_t len)
+{
+    ScmMbedTLS *t = (ScmMbedTLS*)data;
+    int r = mbedtls_ssl_ticket_parse(&t->ticket, session, buf, len);
+    Scm_TLSSessionCacheNoteServer(r == 0);
+    return r;
+}
+#endif /*MBEDTLS_SSL_TICKET_C*/
+
+static void mbed_setup_server_session_cache(ScmMbedTLS *t SCM_UNUSED)
+{
+    int size = Scm_TLSSessionCacheSize();
+    if (size == 0) return;  /* no resumption */
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_cache_set_max_entries(&t->cache, size);
+    mbedtls_ssl_conf_session_cache(&t->conf, t, mbed_cache_get, mbed_cache_set);
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+    int r = mbedtls_ssl_ticket_setup(&t->ticket, mbedtls_ctr_drbg_random,
+                                     &t->ctr_drbg, MBEDTLS_CIPHER_AES_256_GCM,
+                                     MBED_TICKET_LIFETIME);
+    if (r != 0) mbed_error("mbedtls_ssl_ticket_setup() failed: %s (%d)", r);
+    mbedtls_ssl_conf_session_tickets_cb(&t->conf, mbed_ticket_write,
+                                        mbed_ticket_parse, t);
+#endif
+}
+
 static ScmObj mbed_connect(ScmTLS *tls,
                            const char *host,
                            const char *port,
@@ -218,10 +360,19 @@ static ScmObj mbed_connect(ScmTLS *tls,
 
     mbedtls_ssl_set_bio(&t->ctx, &t->conn, mbedtls_net_send, mbedtls_net_recv, NULL);
 
+    /* A resumed session isn't verified again; we don't share sessions
+       with connections that skip verification. */
+    if (!t->skip_verification) {
+        t->session_key = Scm_TLSSessionCacheKey(host, port,
+                                                t->server_name, s_ca_file);
+    }
+    mbed_restore_session(t);
+
     r = mbedtls_ssl_handshake(&t->ctx);
     if (r != 0) mbed_error("TLS handshake failed: %s (%d)", r);
 
     t->state = CONNECTED;
+    mbed_save_session(t);
     return SCM_OBJ(t);
 }
 
@@ -269,6 +420,8 @@ static ScmObj mbed_bind(ScmTLS *tls,
         mbed_error("mbedtls_ssl_confown_cert() failed: %s (%d)", r);
     }
 
+    mbed_setup_server_session_cache(t);
+
     t->state = BOUND;
     return SCM_OBJ(t);
 }
@@ -305,53 +458,68 @@ static ScmObj mbed_accept(ScmTLS *tls) /* tls must already be bound */
     return SCM_OBJ(t);
 }
 
-static ScmObj mbed_read(ScmTLS *tls)
+/* Decrypts directly into BUF.  A single call returns at most the rest
+   of the current record. */
+static ScmSize mbed_read_bytes(ScmTLS *tls, uint8_t *buf, ScmSize size)
 {
     ScmMbedTLS *t = (ScmMbedTLS*)tls;
     mbed_context_check(t, "read");
     mbed_close_check(t, "read");
-    uint8_t buf[1024] = {};
 
-    int nread = 0;
-    do {
-        int r = mbedtls_ssl_read(&t->ctx, buf+nread, sizeof(buf));
-        if (r == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) return SCM_EOF;
-        if (r == 0) return SCM_EOF; /* peer dropped w/o notification */
+    if (size > INT_MAX) size = INT_MAX;
+    for (;;) {
+        int r = mbedtls_ssl_read(&t->ctx, buf, (size_t)size);
+        if (r == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) return 0;
+        if (r == 0) return 0; /* peer dropped w/o notification */
         if (r == MBEDTLS_ERR_SSL_WANT_READ) continue;
 #if defined(MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET)
-        if (r == MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET) continue;
+        if (r == MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET) {
+            mbed_save_session(t);
+            continue;
+        }
 #endif
         if (r < 0) mbed_error("mbedtls_ssl_read() failed: %s (%d)", r);
-        nread += r;
-    } while (nread == 0);
-
-    return Scm_MakeString((char *)buf, nread, nread,
-                          SCM_STRING_INCOMPLETE | SCM_STRING_COPYING);
+        return r;
+    }
 }
 
-static ScmObj mbed_write(ScmTLS *tls, ScmObj msg)
+static ScmSize mbed_write_bytes(ScmTLS *tls, const uint8_t *buf, ScmSize size)
 {
     ScmMbedTLS *t = (ScmMbedTLS*)tls;
     mbed_context_check(t, "write");
     mbed_close_check(t, "write");
 
-    ScmSize size;
-    const uint8_t* cmsg = Scm_GetBytes(msg, &size);
-
-    if (cmsg == NULL) {
-        Scm_TypeError("TLS message", "uniform vector or string", msg);
-    }
-    int nsent = 0;
-    do {
-        int r = mbedtls_ssl_write(&t->ctx, cmsg+nsent, size-nsent);
+    ScmSize nsent = 0;
+    while (nsent < size) {
+        int r = mbedtls_ssl_write(&t->ctx, buf+nsent, (size_t)(size-nsent));
         if (r == MBEDTLS_ERR_SSL_WANT_WRITE) continue;
 #if defined(MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET)
         if (r == MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET) continue;
 #endif
         if (r < 0) mbed_error("mbedtls_ssl_write() failed: %s (%d)", r);
         nsent += r;
-    } while (nsent < size);
-    return SCM_MAKE_INT(nsent);
+    }
+    return nsent;
+}
+
+static ScmObj mbed_read(ScmTLS *tls)
+{
+    uint8_t buf[SCM_TLS_PORT_BUFSIZ];
+    ScmSize nread = mbed_read_bytes(tls, buf, sizeof(buf));
+    if (nread == 0) return SCM_EOF;
+    return Scm_MakeString((char *)buf, nread, nread,
+                          SCM_STRING_INCOMPLETE | SCM_STRING_COPYING);
+}
+
+static ScmObj mbed_write(ScmTLS *tls, ScmObj msg)
+{
+    ScmSize size;
+    const uint8_t* cmsg = Scm_GetBytes(msg, &size);
+
+    if (cmsg == NULL) {
+        Scm_TypeError("TLS message", "uniform vector or string", msg);
+    }
+    return Scm_MakeInteger(mbed_write_bytes(tls, cmsg, size));
 }
 
 static u_long mbed_poll(ScmTLS *tls, u_long rwflags, ScmTimeSpec *timeout)
@@ -403,6 +571,12 @@ static void mbed_cleanup(ScmMbedTLS *t)
     mbedtls_entropy_free(&t->entropy);
     mbedtls_pk_free(&t->pk);
     mbedtls_x509_crt_free(&t->ca);
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_cache_free(&t->cache);
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+    mbedtls_ssl_ticket_free(&t->ticket);
+#endif
     mbedtls_ssl_free(&t->ctx);
     mbedtls_ctr_drbg_free(&t->ctr_drbg);
     mbedtls_ssl_config_free(&t->conf);
@@ -551,12 +725,19 @@ static ScmObj mbed_allocate(ScmClass *klass, ScmObj initargs)
     mbedtls_x509_crt_init(&t->ca);
     mbedtls_pk_init(&t->pk);
     mbedtls_entropy_init(&t->entropy);
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_cache_init(&t->cache);
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+    mbedtls_ssl_ticket_init(&t->ticket);
+#endif
 
 #ifdef MBEDTLS_DEBUG_C
     mbedtls_ssl_conf_dbg(&t->conf, mbed_debug, stderr);
 #endif
 
     t->server_name = server_name;
+    t->session_key = SCM_FALSE;
     t->skip_verification =
         SCM_BOOL_VALUE(Scm_GetKeyword(k_skip_verification, initargs, SCM_FALSE));
     t->common.in_port = t->common.out_port = SCM_UNDEFINED;
@@ -566,6 +747,8 @@ static ScmObj mbed_allocate(ScmClass *klass, ScmObj initargs)
     t->common.accept = mbed_accept;
     t->common.read = mbed_read;
     t->common.write = mbed_write;
+    t->common.readBytes = mbed_read_bytes;
+    t->common.writeBytes = mbed_write_bytes;
     t->common.poll = mbed_poll;
     t->common.close = mbed_close;
     t->common.loadCertificate = mbed_load_certificate;
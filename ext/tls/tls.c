@@ -154,6 +154,72 @@ ScmObj Scm_TLSWrite(ScmTLS* t, ScmObj msg)
     return (t->write)(t, msg);
 }
 
+ScmSize Scm_TLSReadBytes(ScmTLS* t, uint8_t *buf, ScmSize size)
+{
+    if (!t->readBytes) {
+        Scm_Error("tls-read! is not supported on %S", t);
+    }
+    if (size <= 0) return 0;
+    return t->readBytes(t, buf, size);
+}
+
+/*
+ * Ports
+ *
+ *   The input port decrypts records directly into its buffer, and the
+ *   output port hands the whole buffer to the backend, which packs it
+ *   into as few records as possible.  Like socket ports, they're
+ *   line-buffered.
+ */
+
+static ScmSize tls_port_filler(ScmPort *p, ScmSize cnt)
+{
+    ScmTLS *t = SCM_TLS(Scm_PortBufferStruct(p)->data);
+    return t->readBytes(t, (uint8_t*)Scm_PortBufferStruct(p)->end, cnt);
+}
+
+static ScmSize tls_port_flusher(ScmPort *p, ScmSize cnt,
+                                int forcep SCM_UNUSED)
+{
+    ScmTLS *t = SCM_TLS(Scm_PortBufferStruct(p)->data);
+    return t->writeBytes(t, (const uint8_t*)Scm_PortBufferStruct(p)->buffer,
+                         cnt);
+}
+
+static ScmObj make_tls_port(ScmTLS *t, int dir)
+{
+    ScmPortBuffer bufrec;
+    memset(&bufrec, 0, sizeof(bufrec));
+    bufrec.size = SCM_TLS_PORT_BUFSIZ;
+    bufrec.buffer = SCM_NEW_ATOMIC2(char *, SCM_TLS_PORT_BUFSIZ);
+    bufrec.mode = SCM_PORT_BUFFER_LINE;
+    if (dir == SCM_PORT_INPUT) {
+        bufrec.filler = tls_port_filler;
+    } else {
+        bufrec.flusher = tls_port_flusher;
+    }
+    bufrec.data = (void*)t;
+
+    /* Keep T in the name, as socket ports do, so that it isn't GCed
+       while the port is alive. */
+    ScmObj name = SCM_LIST2(SCM_MAKE_STR(dir == SCM_PORT_INPUT
+                                         ? "tls input" : "tls output"),
+                            SCM_OBJ(t));
+    return Scm_MakeBufferedPort(SCM_CLASS_PORT, name, dir, FALSE, &bufrec);
+}
+
+ScmObj Scm_TLSMakeInputPort(ScmTLS* t)
+{
+    if (!t->readBytes) return SCM_FALSE;
+    return make_tls_port(t, SCM_PORT_INPUT);
+}
+
+ScmObj Scm_TLSMakeOutputPort(ScmTLS* t)
+{
+    if (!t->writeBytes) return SCM_FALSE;
+    return make_tls_port(t, SCM_PORT_OUTPUT);
+}
+
 ScmObj Scm_TLSInputPort(ScmTLS* t)
 {
     return t->in_port;
@@ -190,6 +256,138 @@ ScmObj Scm_TLSGetConnectionAddress(ScmTLS *t, int who)
     }
 }
 
+/*
+ * Session cache
+ *
+ *   Client side, we keep the session data of the last connection to
+ *   each server, so that the next connection to the same server can
+ *   resume the session instead of doing a full handshake.  The data is
+ *   serialized by the backend and opaque here.
+ *
+ *   A resumed session skips the certificate check, so the key includes
+ *   the server name and the CA bundle the session was verified with,
+ *   besides host:port.  The backend never stores nor offers a session
+ *   of a connection that skips verification.
+ *
+ *   Server side, the backend keeps its own cache and ticket keys per
+ *   bound TLS, and only reports lookups here for the statistics.
+ *
+ *   The maximum number of entries is taken from the parameter
+ *   tls-session-cache-size, which is defined in tls.scm so that an
+ *   invalid value is rejected when it is set.  When the client cache
+ *   is full, the oldest entry is evicted.
+ */
+
+static struct {
+    ScmInternalMutex mutex;
+    ScmHashCore table;          /* key -> (serial . data) */
+    u_long serial;
+    u_long client_lookups;
+    u_long client_hits;
+    u_long server_lookups;
+    u_long server_hits;
+} session_cache;
+
+int Scm_TLSSessionCacheSize(void)
+{
+    static ScmObj session_cache_size = SCM_UNDEFINED;
+    SCM_BIND_PROC(session_cache_size, "tls-session-cache-size",
+                  SCM_FIND_MODULE("rfc.tls", 0));
+    /* The value is validated by the parameter's filter. */
+    return (int)SCM_INT_VALUE(Scm_ApplyRec0(session_cache_size));
+}
+
+ScmObj Scm_TLSSessionCacheKey(const char *host, const char *port,
+                              ScmObj server_name, ScmObj ca)
+{
+    return Scm_Sprintf("%s:%s %S %S", host, port, server_name, ca);
+}
+
+ScmObj Scm_TLSSessionCacheLookup(ScmObj key)
+{
+    ScmObj data = SCM_FALSE;
+    (void)SCM_INTERNAL_MUTEX_LOCK(session_cache.mutex);
+    ScmDictEntry *e = Scm_HashCoreSearch(&session_cache.table,
+                                         (intptr_t)key, SCM_DICT_GET);
+    session_cache.client_lookups++;
+    if (e) {
+        session_cache.client_hits++;
+        data = SCM_CDR(SCM_DICT_VALUE(e));
+    }
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(session_cache.mutex);
+    return data;
+}
+
+void Scm_TLSSessionCacheStore(ScmObj key, ScmObj data)
+{
+    int size = Scm_TLSSessionCacheSize();
+    if (size == 0) return;
+
+    (void)SCM_INTERNAL_MUTEX_LOCK(session_cache.mutex);
+    if (Scm_HashCoreSearch(&session_cache.table, (intptr_t)key, SCM_DICT_GET)
+        == NULL) {
+        while (Scm_HashCoreNumEntries(&session_cache.table) >= size) {
+            ScmHashIter iter;
+            ScmDictEntry *e, *oldest = NULL;
+            Scm_HashIterInit(&iter, &session_cache.table);
+            while ((e = Scm_HashIterNext(&iter)) != NULL) {
+                if (oldest == NULL
+                    || (SCM_INT_VALUE(SCM_CAR(SCM_DICT_VALUE(e)))
+                        < SCM_INT_VALUE(SCM_CAR(SCM_DICT_VALUE(oldest))))) {
+                    oldest = e;
+                }
+            }
+            Scm_HashCoreSearch(&session_cache.table, oldest->key,
+                               SCM_DICT_DELETE);
+        }
+    }
+    ScmDictEntry *e = Scm_HashCoreSearch(&session_cache.table,
+                                         (intptr_t)key, SCM_DICT_CREATE);
+    ScmObj serial = SCM_MAKE_INT(session_cache.serial++);
+    (void)SCM_DICT_SET_VALUE(e, Scm_Cons(serial, data));
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(session_cache.mutex);
+}
+
+void Scm_TLSSessionCacheNoteServer(int hit)
+{
+    (void)SCM_INTERNAL_MUTEX_LOCK(session_cache.mutex);
+    session_cache.server_lookups++;
+    if (hit) session_cache.server_hits++;
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(session_cache.mutex);
+}
+
+ScmObj Scm_TLSSessionCacheStats(void)
+{
+    u_long cl, ch, sl, sh;
+    int n;
+    (void)SCM_INTERNAL_MUTEX_LOCK(session_cache.mutex);
+    cl = session_cache.client_lookups;
+    ch = session_cache.client_hits;
+    sl = session_cache.server_lookups;
+    sh = session_cache.server_hits;
+    n = Scm_HashCoreNumEntries(&session_cache.table);
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(session_cache.mutex);
+
+    return SCM_LIST5(Scm_Cons(SCM_INTERN("client-entries"), SCM_MAKE_INT(n)),
+                     Scm_Cons(SCM_INTERN("client-lookups"),
+                              Scm_MakeIntegerU(cl)),
+                     Scm_Cons(SCM_INTERN("client-hits"),
+                              Scm_MakeIntegerU(ch)),
+                     Scm_Cons(SCM_INTERN("server-lookups"),
+                              Scm_MakeIntegerU(sl)),
+                     Scm_Cons(SCM_INTERN("server-hits"),
+                              Scm_MakeIntegerU(sh)));
+}
+
+void Scm_TLSSessionCacheClear(void)
+{
+    (void)SCM_INTERNAL_MUTEX_LOCK(session_cache.mutex);
+    Scm_HashCoreClear(&session_cache.table);
+    session_cache.client_lookups = session_cache.client_hits = 0;
+    session_cache.server_lookups = session_cache.server_hits = 0;
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(session_cache.mutex);
+}
+
 /*
  * Debug level management
  */
@@ -300,4 +498,6 @@ void Scm_Init_tls(ScmModule *mod)
     k_num_sessions = SCM_MAKE_KEYWORD("num-sessions");
 
     SCM_INTERNAL_MUTEX_INIT(debug_level_setter_mutex);
+    SCM_INTERNAL_MUTEX_INIT(session_cache.mutex);
+    Scm_HashCoreInitSimple(&session_cache.table, SCM_HASH_STRING, 0, NULL);
 }
@@ -41,9 +41,11 @@
   (export <tls> make-tls tls-connect
           tls-bind tls-accept tls-poll tls-close
           tls-load-certificate tls-load-private-key
-          tls-read tls-write
+          tls-read tls-read! tls-write
           tls-input-port tls-output-port
           tls-ca-bundle-path tls-debug-level-set!
+          tls-session-cache-size tls-session-cache-stats
+          tls-session-cache-clear!
           default-tls-class
 
           ;; connection interface
@@ -62,6 +64,16 @@
   )
 (select-module rfc.tls)
 
+;; The maximum number of cached sessions, for the client cache and for
+;; each bound server.  0 disables session resumption.  The value is read
+;; from C (Scm_TLSSessionCacheSize), which relies on this filter.
+(define tls-session-cache-size
+  (make-parameter 128
+                  (^n (unless (and (fixnum? n) (<= 0 n #x7fffffff))
+                        (error "tls-session-cache-size must be a nonnegative \
+                                fixnum, but got:" n))
+                      n)))
+
 ;; The initialization of default-tls-class depends on the availability
 ;; of classes and tls-ca-bundle-path.
 
@@ -109,8 +121,25 @@
  (define-cproc %tls-close (tls::<tls>) Scm_TLSClose)
  (define-cproc tls-read (tls::<tls>) Scm_TLSRead)
  (define-cproc tls-write (tls::<tls> msg) Scm_TLSWrite)
+ (define-cproc tls-read! (tls::<tls> buf::<u8vector>
+                          :optional (start::<fixnum> 0) (end::<fixnum> -1))
+   (let* ([size::ScmSmallInt (SCM_U8VECTOR_SIZE buf)])
+     (SCM_CHECK_START_END start end size)
+     (SCM_UVECTOR_CHECK_MUTABLE buf)
+     (if (== start end)
+       (return (SCM_MAKE_INT 0))
+       (let* ([n::ScmSize
+               (Scm_TLSReadBytes tls
+                                 (+ (cast uint8_t* (SCM_U8VECTOR_ELEMENTS buf))
+                                    start)
+                                 (- end start))])
+         (if (== n 0)
+           (return SCM_EOF)
+           (return (SCM_MAKE_INT n)))))))
  (define-cproc tls-input-port (tls::<tls>) Scm_TLSInputPort)
  (define-cproc tls-output-port (tls::<tls>) Scm_TLSOutputPort)
+ (define-cproc tls-session-cache-stats () Scm_TLSSessionCacheStats)
+ (define-cproc tls-session-cache-clear! () ::<void> Scm_TLSSessionCacheClear)
  (define-cproc tls-poll (tls::<tls> rwflags::<list> :optional (timeout #f))
    (let* ([ts::ScmTimeSpec]
           [pts::ScmTimeSpec* (Scm_GetTimeSpec timeout (& ts))]
@@ -139,6 +168,8 @@
  ;; internal
  (define-cproc %tls-input-port-set! (tls::<tls> port) Scm_TLSInputPortSet)
  (define-cproc %tls-output-port-set! (tls::<tls> port) Scm_TLSOutputPortSet)
+ (define-cproc %tls-make-input-port (tls::<tls>) Scm_TLSMakeInputPort)
+ (define-cproc %tls-make-output-port (tls::<tls>) Scm_TLSMakeOutputPort)
  (define-cproc %tls-get-self-address (tls::<tls>)
    (return (Scm_TLSGetConnectionAddress tls TLS_SELF_ADDRESS)))
  (define-cproc %tls-get-peer-address (tls::<tls>)
@@ -219,7 +250,18 @@
 (define-cproc %tls-system-ca-bundle-available? () ::<boolean>
   Scm_TLSSystemCABundleAvailable)
 
+;; If the backend supports byte-level I/O, we use buffered ports
+;; implemented in C.  Otherwise, fall back to the virtual ports on top
+;; of tls-read and tls-write.
 (define (make-tls-input-port tls)
+  (or (%tls-make-input-port tls)
+      (make-virtual-tls-input-port tls)))
+
+(define (make-tls-output-port tls)
+  (or (%tls-make-output-port tls)
+      (make-virtual-tls-output-port tls)))
+
+(define (make-virtual-tls-input-port tls)
   (rlet1 ip (make <virtual-input-port>)
     (set! (~ ip'getb)
           (let ((buf #f) (pos 0) (size 0))
@@ -237,7 +279,7 @@
                       (set! pos 0)
                       (reader))))))))))
 
-(define (make-tls-output-port tls)
+(define (make-virtual-tls-output-port tls)
   (rlet1 op (make <virtual-output-port>)
     (set! (~ op'puts) (^[msg] (tls-write tls msg)))
     (set! (~ op'putb) (^[b] (tls-write tls (make-byte-string 1 b))))))
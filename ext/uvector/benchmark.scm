@@ -0,0 +1,53 @@
+;;
+;; Measure throughput of element-wise operations and reductions on
+;; uvectors.  On x86_64 CPUs with AVX2, f32, f64, s32 and u8 vectors
+;; are processed by SIMD kernels; s16 and f16 show the scalar speed
+;; for comparison.
+;;
+;;   gosh -I. -I../../src -I../../lib ./benchmark.scm
+;;
+
+(use gauche.time)
+(use gauche.uvector)
+
+(define *size* 1000000)
+(define *repeat* 20)
+
+;; Returns TAGvector-NAME procedure, e.g. (op 'f64 "add") => f64vector-add
+(define (op tag name)
+  (global-variable-ref 'gauche.uvector (string->symbol #"~|tag|vector-~name")))
+
+;; Small values, so that u8 products don't overflow.
+(define (make-data tag)
+  (rlet1 v (make-uvector (global-variable-ref 'gauche.uvector
+                                              (symbol-append '< tag 'vector>))
+                         *size*)
+    (dotimes [i *size*]
+      (uvector-set! v i (modulo (* i 37) 16)))))
+
+(define (report label thunk)
+  (let1 t (time-result-real (time-this *repeat* thunk))
+    (format #t "  ~24a: ~8,3f sec  ~8,1f Melem/s\n"
+            label t (/ (* *size* *repeat*) t 1e6))))
+
+(define (bench tag)
+  (let ([x (make-data tag)]
+        [y (make-data tag)]
+        [tmp (make-data tag)])
+    (print #"~|tag|vector")
+    (report "add" (^[] ((op tag "add") x y)))
+    (report "add! constant" (^[] (uvector-copy! tmp 0 x)
+                                 ((op tag "add!") tmp 1)))
+    (report "sub" (^[] ((op tag "sub") x y)))
+    (report "mul" (^[] ((op tag "mul") x y)))
+    (report "dot" (^[] ((op tag "dot") x y)))
+    (report "range-check" (^[] ((op tag "range-check") x 0 100)))
+    (report "clamp" (^[] ((op tag "clamp") x 0 100)))
+    (report "sum" (^[] (uvector-sum x)))
+    (report "min" (^[] (uvector-min x)))
+    (report "max" (^[] (uvector-max x)))
+    (report "argmin" (^[] (uvector-argmin x)))))
+
+(define (main args)
+  (for-each bench '(f64 f32 s32 u8 s16 f16))
+  0)
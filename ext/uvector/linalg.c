@@ -0,0 +1,381 @@
+/*
+ * linalg.c - native kernels for matrix operations
+ *
+ *   Copyright (c) 2000-2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <string.h>
+#include <limits.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include <gauche/priv/arith.h>
+#include "linalg.h"
+
+/*
+ * These kernels back array-mul, array-inverse and determinant of
+ * gauche.array when all the operands are backed by uvectors of the
+ * same class.  They follow the element-wise definitions in matrix.scm
+ * exactly, including the order of operations, so that the results are
+ * the same as the generic path:
+ *
+ *  - Floating-point products are accumulated in double, in the order
+ *    of the inner index, and rounded to the element type when stored.
+ *  - Integer products are accumulated in a machine word with overflow
+ *    checks.  If an intermediate value overflows, or the result doesn't
+ *    fit in the element type, we give up and let the generic path
+ *    compute the exact result (or raise the same error).
+ *
+ * Multiplication of floating-point matrices is blocked so that a tile
+ * of the right operand stays in cache while it is applied to all rows
+ * of the left operand.  When the tile is contiguous, the innermost
+ * loop is a plain saxpy that the compiler can vectorize.
+ */
+
+typedef struct mview_rec {
+    void *elts;                 /* elements of the backing uvector */
+    ScmSmallInt off;            /* position of element (0, 0) */
+    ScmSmallInt s0;             /* stride between rows */
+    ScmSmallInt s1;             /* stride between columns */
+} mview;
+
+#define MREF(v, T, i, j) \
+    (((T*)(v)->elts)[(v)->off + (i)*(v)->s0 + (j)*(v)->s1])
+
+/* Rows of the right operand (and columns of the left operand) in a tile */
+#define MM_TILE_ROWS 256
+/* Columns of the right operand (and of the result) in a tile */
+#define MM_TILE_COLS 64
+
+/* Sets up a view of an N0xN1 matrix.  Returns FALSE if the arguments
+   don't describe a matrix that fits in the backing storage, which
+   shouldn't happen for well-formed arrays. */
+static int make_view(mview *v, ScmObj storage, ScmSmallInt off, ScmObj coef,
+                     ScmSmallInt n0, ScmSmallInt n1)
+{
+    if (!SCM_UVECTORP(storage)) return FALSE;
+    if (!SCM_S32VECTORP(coef) || SCM_S32VECTOR_SIZE(coef) != 2) return FALSE;
+    v->elts = SCM_UVECTOR_ELEMENTS(storage);
+    v->off = off;
+    v->s0 = SCM_S32VECTOR_ELEMENTS(coef)[0];
+    v->s1 = SCM_S32VECTOR_ELEMENTS(coef)[1];
+    if (n0 == 0 || n1 == 0) return TRUE;
+    ScmSmallInt d0 = (n0-1)*v->s0, d1 = (n1-1)*v->s1;
+    ScmSmallInt lo = off + (d0 < 0 ? d0 : 0) + (d1 < 0 ? d1 : 0);
+    ScmSmallInt hi = off + (d0 > 0 ? d0 : 0) + (d1 > 0 ? d1 : 0);
+    return (lo >= 0 && hi < SCM_UVECTOR_SIZE(storage));
+}
+
+/*
+ * Multiplication
+ */
+
+#define DEF_FLOAT_MUL(name, T)                                          \
+static void name(mview *r, mview *a, mview *b,                          \
+                 ScmSmallInt n, ScmSmallInt m, ScmSmallInt p,           \
+                 double *acc)                                           \
+{                                                                       \
+    for (ScmSmallInt kk = 0; kk < p; kk += MM_TILE_COLS) {              \
+        ScmSmallInt kn = (p - kk < MM_TILE_COLS) ? p - kk : MM_TILE_COLS; \
+        memset(acc, 0, n * kn * sizeof(double));                        \
+        for (ScmSmallInt jj = 0; jj < m; jj += MM_TILE_ROWS) {          \
+            ScmSmallInt je = (m - jj < MM_TILE_ROWS) ? m : jj + MM_TILE_ROWS; \
+            for (ScmSmallInt i = 0; i < n; i++) {                       \
+                double *c = acc + i*kn;                                 \
+                for (ScmSmallInt j = jj; j < je; j++) {                 \
+                    double x = MREF(a, T, i, j);                        \
+                    const T *y = &MREF(b, T, j, kk);                    \
+                    if (b->s1 == 1) {                                   \
+                        for (ScmSmallInt k = 0; k < kn; k++) {          \
+                            c[k] += x * y[k];                           \
+                        }                                               \
+                    } else {                                            \
+                        for (ScmSmallInt k = 0; k < kn; k++) {          \
+                            c[k] += x * y[k*b->s1];                     \
+                        }                                               \
+                    }                                                   \
+                }                                                       \
+            }                                                           \
+        }                                                               \
+        for (ScmSmallInt i = 0; i < n; i++) {                           \
+            for (ScmSmallInt k = 0; k < kn; k++) {                      \
+                MREF(r, T, i, kk+k) = (T)acc[i*kn + k];                 \
+            }                                                           \
+        }                                                               \
+    }                                                                   \
+}
+
+DEF_FLOAT_MUL(mul_f32, float)
+DEF_FLOAT_MUL(mul_f64, double)
+
+#define DEF_SINT_MUL(name, T, lo, hi)                                   \
+static int name(mview *r, mview *a, mview *b,                           \
+                ScmSmallInt n, ScmSmallInt m, ScmSmallInt p,            \
+                long *acc)                                              \
+{                                                                       \
+    for (ScmSmallInt i = 0; i < n; i++) {                               \
+        for (ScmSmallInt k = 0; k < p; k++) acc[k] = 0;                 \
+        for (ScmSmallInt j = 0; j < m; j++) {                           \
+            long x = MREF(a, T, i, j);                                  \
+            if (x == 0) continue;                                       \
+            for (ScmSmallInt k = 0; k < p; k++) {                       \
+                long y = MREF(b, T, j, k), t = 0, s, v;                 \
+                SMULOV(t, v, x, y);                                     \
+                if (v) return FALSE;                                    \
+                SADDOV(s, v, acc[k], t);                                \
+                if (v) return FALSE;                                    \
+                acc[k] = s;                                             \
+            }                                                           \
+        }                                                               \
+        for (ScmSmallInt k = 0; k < p; k++) {                           \
+            if (acc[k] < (lo) || acc[k] > (hi)) return FALSE;           \
+        }                                                               \
+        for (ScmSmallInt k = 0; k < p; k++) {                           \
+            MREF(r, T, i, k) = (T)acc[k];                               \
+        }                                                               \
+    }                                                                   \
+    return TRUE;                                                        \
+}
+
+#define DEF_UINT_MUL(name, T, hi)                                       \
+static int name(mview *r, mview *a, mview *b,                           \
+                ScmSmallInt n, ScmSmallInt m, ScmSmallInt p,            \
+                u_long *acc)                                            \
+{                                                                       \
+    for (ScmSmallInt i = 0; i < n; i++) {                               \
+        for (ScmSmallInt k = 0; k < p; k++) acc[k] = 0;                 \
+        for (ScmSmallInt j = 0; j < m; j++) {                           \
+            u_long x = MREF(a, T, i, j);                                \
+            if (x == 0) continue;                                       \
+            for (ScmSmallInt k = 0; k < p; k++) {                       \
+                u_long y = MREF(b, T, j, k), t = 0, s, v;               \
+                UMULOV(t, v, x, y);                                     \
+                if (v) return FALSE;                                    \
+                UADDOV(s, v, acc[k], t);                                \
+                if (v) return FALSE;                                    \
+                acc[k] = s;                                             \
+            }                                                           \
+        }                                                               \
+        for (ScmSmallInt k = 0; k < p; k++) {                           \
+            if (acc[k] > (hi)) return FALSE;                            \
+        }                                                               \
+        for (ScmSmallInt k = 0; k < p; k++) {                           \
+            MREF(r, T, i, k) = (T)acc[k];                               \
+        }                                                               \
+    }                                                                   \
+    return TRUE;                                                        \
+}
+
+DEF_SINT_MUL(mul_s8,  int8_t,  -128, 127)
+DEF_SINT_MUL(mul_s16, int16_t, -32768, 32767)
+DEF_SINT_MUL(mul_s32, int32_t, -2147483647L-1, 2147483647L)
+DEF_UINT_MUL(mul_u8,  uint8_t,  255UL)
+DEF_UINT_MUL(mul_u16, uint16_t, 65535UL)
+DEF_UINT_MUL(mul_u32, uint32_t, 4294967295UL)
+#if SIZEOF_LONG >= 8
+DEF_SINT_MUL(mul_s64, int64_t, LONG_MIN, LONG_MAX)
+DEF_UINT_MUL(mul_u64, uint64_t, ULONG_MAX)
+#endif
+
+ScmObj Scm_UVectorMatrixMul(ScmObj r, ScmSmallInt roff, ScmObj rcoef,
+                            ScmObj a, ScmSmallInt aoff, ScmObj acoef,
+                            ScmObj b, ScmSmallInt boff, ScmObj bcoef,
+                            ScmSmallInt n, ScmSmallInt m, ScmSmallInt p)
+{
+    mview rv, av, bv;
+    ScmClass *klass = Scm_ClassOf(r);
+
+    /* The result must not share storage with the operands, for we
+       overwrite it while reading them. */
+    if (SCM_EQ(r, a) || SCM_EQ(r, b)) return SCM_FALSE;
+    if (Scm_ClassOf(a) != klass || Scm_ClassOf(b) != klass) return SCM_FALSE;
+    if (!make_view(&rv, r, roff, rcoef, n, p)
+        || !make_view(&av, a, aoff, acoef, n, m)
+        || !make_view(&bv, b, boff, bcoef, m, p)) {
+        return SCM_FALSE;
+    }
+    if (n == 0 || p == 0) return SCM_TRUE;
+
+    int ok = TRUE;
+    switch (Scm_UVectorType(klass)) {
+    case SCM_UVECTOR_F32:
+    case SCM_UVECTOR_F64: {
+        ScmSmallInt ncols = (p < MM_TILE_COLS) ? p : MM_TILE_COLS;
+        double *acc = SCM_NEW_ATOMIC_ARRAY(double, n*ncols);
+        if (Scm_UVectorType(klass) == SCM_UVECTOR_F32) {
+            mul_f32(&rv, &av, &bv, n, m, p, acc);
+        } else {
+            mul_f64(&rv, &av, &bv, n, m, p, acc);
+        }
+        break;
+    }
+    case SCM_UVECTOR_S8:
+    case SCM_UVECTOR_S16:
+    case SCM_UVECTOR_S32:
+#if SIZEOF_LONG >= 8
+    case SCM_UVECTOR_S64:
+#endif
+    {
+        long *acc = SCM_NEW_ATOMIC_ARRAY(long, p);
+        switch (Scm_UVectorType(klass)) {
+        case SCM_UVECTOR_S8:  ok = mul_s8(&rv, &av, &bv, n, m, p, acc); break;
+        case SCM_UVECTOR_S16: ok = mul_s16(&rv, &av, &bv, n, m, p, acc); break;
+        case SCM_UVECTOR_S32: ok = mul_s32(&rv, &av, &bv, n, m, p, acc); break;
+#if SIZEOF_LONG >= 8
+        case SCM_UVECTOR_S64: ok = mul_s64(&rv, &av, &bv, n, m, p, acc); break;
+#endif
+        default: ok = FALSE;
+        }
+        break;
+    }
+    case SCM_UVECTOR_U8:
+    case SCM_UVECTOR_U16:
+    case SCM_UVECTOR_U32:
+#if SIZEOF_LONG >= 8
+    case SCM_UVECTOR_U64:
+#endif
+    {
+        u_long *acc = SCM_NEW_ATOMIC_ARRAY(u_long, p);
+        switch (Scm_UVectorType(klass)) {
+        case SCM_UVECTOR_U8:  ok = mul_u8(&rv, &av, &bv, n, m, p, acc); break;
+        case SCM_UVECTOR_U16: ok = mul_u16(&rv, &av, &bv, n, m, p, acc); break;
+        case SCM_UVECTOR_U32: ok = mul_u32(&rv, &av, &bv, n, m, p, acc); break;
+#if SIZEOF_LONG >= 8
+        case SCM_UVECTOR_U64: ok = mul_u64(&rv, &av, &bv, n, m, p, acc); break;
+#endif
+        default: ok = FALSE;
+        }
+        break;
+    }
+    default:
+        /* f16 and complex types go through the generic path */
+        ok = FALSE;
+    }
+    return SCM_MAKE_BOOL(ok);
+}
+
+/*
+ * Gaussian elimination
+ *
+ * These mirror array-row-echelon! and array-solve-left-identity! in
+ * matrix.scm, operating on an NxM matrix where N <= M.
+ */
+
+#define DEF_FLOAT_ECHELON(name, T)                                      \
+static int name(mview *v, ScmSmallInt n, ScmSmallInt m)                 \
+{                                                                       \
+    int factor = 1;                                                     \
+    ScmSmallInt i = 0;                                                  \
+    while (i < n) {                                                     \
+        if (MREF(v, T, i, i) == 0) {                                    \
+            /* pivot non-zero row to top */                             \
+            ScmSmallInt j = i+1;                                        \
+            while (j < n && MREF(v, T, j, i) == 0) j++;                 \
+            if (j == n) return 0;                                       \
+            for (ScmSmallInt k = 0; k < m; k++) {                       \
+                T t = MREF(v, T, j, k);                                 \
+                MREF(v, T, j, k) = MREF(v, T, i, k);                    \
+                MREF(v, T, i, k) = t;                                   \
+            }                                                           \
+            factor = -factor;                                           \
+        } else {                                                        \
+            /* eliminate other non-zero rows */                         \
+            for (ScmSmallInt j = i+1; j < n; j++) {                     \
+                if (MREF(v, T, j, i) == 0) continue;                    \
+                double f = (double)MREF(v, T, j, i)                     \
+                    / (double)MREF(v, T, i, i);                         \
+                for (ScmSmallInt k = 0; k < m; k++) {                   \
+                    MREF(v, T, j, k) =                                  \
+                        (T)(MREF(v, T, j, k) - f * MREF(v, T, i, k));   \
+                }                                                       \
+            }                                                           \
+            i++;                                                        \
+        }                                                               \
+    }                                                                   \
+    return factor;                                                      \
+}
+
+#define DEF_FLOAT_SOLVE(name, T, echelon)                               \
+static void name(mview *v, ScmSmallInt n, ScmSmallInt m)                \
+{                                                                       \
+    echelon(v, n, m);                                                   \
+    /* zero-out */                                                      \
+    for (ScmSmallInt i = n-1; i >= 0; i--) {                            \
+        double d = MREF(v, T, i, i);                                    \
+        if (d == 0) continue;                                           \
+        for (ScmSmallInt j = i-1; j >= 0; j--) {                        \
+            double f = MREF(v, T, j, i) / d;                            \
+            MREF(v, T, i, j) = 0;                                       \
+            for (ScmSmallInt k = j; k < m; k++) {                       \
+                MREF(v, T, j, k) =                                      \
+                    (T)(MREF(v, T, j, k) - f * MREF(v, T, i, k));       \
+            }                                                           \
+        }                                                               \
+    }                                                                   \
+    /* reduce */                                                        \
+    for (ScmSmallInt i = 0; i < n; i++) {                               \
+        double d = MREF(v, T, i, i);                                    \
+        if (d == 0 || d == 1) continue;                                 \
+        MREF(v, T, i, i) = 1;                                           \
+        for (ScmSmallInt j = i+1; j < m; j++) {                         \
+            MREF(v, T, i, j) = (T)(MREF(v, T, i, j) / d);               \
+        }                                                               \
+    }                                                                   \
+}
+
+DEF_FLOAT_ECHELON(echelon_f32, float)
+DEF_FLOAT_ECHELON(echelon_f64, double)
+DEF_FLOAT_SOLVE(solve_f32, float, echelon_f32)
+DEF_FLOAT_SOLVE(solve_f64, double, echelon_f64)
+
+ScmObj Scm_UVectorMatrixRowEchelon(ScmObj v, ScmSmallInt off, ScmObj coef,
+                                   ScmSmallInt n, ScmSmallInt m)
+{
+    mview mv;
+    if (n > m || !make_view(&mv, v, off, coef, n, m)) return SCM_FALSE;
+    switch (Scm_UVectorType(Scm_ClassOf(v))) {
+    case SCM_UVECTOR_F32: return SCM_MAKE_INT(echelon_f32(&mv, n, m));
+    case SCM_UVECTOR_F64: return SCM_MAKE_INT(echelon_f64(&mv, n, m));
+    default: return SCM_FALSE;
+    }
+}
+
+ScmObj Scm_UVectorMatrixSolveLeftIdentity(ScmObj v, ScmSmallInt off,
+                                          ScmObj coef,
+                                          ScmSmallInt n, ScmSmallInt m)
+{
+    mview mv;
+    if (n > m || !make_view(&mv, v, off, coef, n, m)) return SCM_FALSE;
+    switch (Scm_UVectorType(Scm_ClassOf(v))) {
+    case SCM_UVECTOR_F32: solve_f32(&mv, n, m); return SCM_TRUE;
+    case SCM_UVECTOR_F64: solve_f64(&mv, n, m); return SCM_TRUE;
+    default: return SCM_FALSE;
+    }
+}
@@ -0,0 +1,57 @@
+/*
+ * linalg.h - native kernels for matrix operations
+ *
+ *   Copyright (c) 2000-2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef GAUCHE_UVECTOR_LINALG_H
+#define GAUCHE_UVECTOR_LINALG_H
+
+#include <gauche.h>
+
+/* A matrix is passed as the backing uvector of an array, together with
+   the offset and the coefficient vector (s32vector of length 2) that
+   map 0-based indexes (i, j) to the position in the backing storage.
+   These return #f when the operation can't be done natively, in which
+   case the caller should use the generic path. */
+extern ScmObj Scm_UVectorMatrixMul(ScmObj r, ScmSmallInt roff, ScmObj rcoef,
+                                   ScmObj a, ScmSmallInt aoff, ScmObj acoef,
+                                   ScmObj b, ScmSmallInt boff, ScmObj bcoef,
+                                   ScmSmallInt n, ScmSmallInt m,
+                                   ScmSmallInt p);
+extern ScmObj Scm_UVectorMatrixRowEchelon(ScmObj v, ScmSmallInt off,
+                                          ScmObj coef,
+                                          ScmSmallInt n, ScmSmallInt m);
+extern ScmObj Scm_UVectorMatrixSolveLeftIdentity(ScmObj v, ScmSmallInt off,
+                                                 ScmObj coef,
+                                                 ScmSmallInt n, ScmSmallInt m);
+
+#endif /* GAUCHE_UVECTOR_LINALG_H */
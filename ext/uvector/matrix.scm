@@ -130,8 +130,28 @@
         [(= i n) res]
       (array-set! res i i 1))))
 
+;; Native kernels in gauche.uvector (linalg.c) handle matrices backed by
+;; uvectors of the same class.  They return #f if they can't handle
+;; the arguments, in which case we use the generic code.
+(define %uvector-matrix-mul!
+  (with-module gauche.uvector %uvector-matrix-mul!))
+(define %uvector-matrix-row-echelon!
+  (with-module gauche.uvector %uvector-matrix-row-echelon!))
+(define %uvector-matrix-solve-left-identity!
+  (with-module gauche.uvector %uvector-matrix-solve-left-identity!))
+
+(define (%native-matrix-op kernel a)
+  (and (= (array-rank a) 2)
+       (uvector? (~ a'backing-storage))
+       (kernel (~ a'backing-storage) (~ a'offset) (~ a'coefficient-vector)
+               (array-length a 0) (array-length a 1))))
+
 ;; Gaussian elimination, returns factor applied to determinant
 (define (array-row-echelon! a)
+  (or (%native-matrix-op %uvector-matrix-row-echelon! a)
+      (%array-row-echelon! a)))
+
+(define (%array-row-echelon! a)
   (let* ([start (start-vector-of a)]
          [row-start (s32vector-ref start 0)]
          [col-start (s32vector-ref start 1)]
@@ -174,6 +194,10 @@
                           (loop2 (+ j 1)))]))])))))
 
 (define (array-solve-left-identity! a)
+  (unless (%native-matrix-op %uvector-matrix-solve-left-identity! a)
+    (%array-solve-left-identity! a)))
+
+(define (%array-solve-left-identity! a)
   (array-row-echelon! a)
   (let* ([start (start-vector-of a)]
          [row-start (s32vector-ref start 0)]
@@ -296,16 +320,31 @@
                                (= p (array-length r 1)))))
           (errof "result array can't hold the result of multiplication"))
         (rlet1 res (or r (make-minimal-backend-array (list a b) (shape 0 n 0 p)))
-          (do ([i a-start-row (+ i 1)])       ; for-each row of a
-              [(= i a-end-row)]
-            (do ([k b-start-col (+ k 1)])     ; for-each col of b
-                [(= k b-end-col)]
-              (let1 tmp 0
-                (do ([j a-start-col (+ j 1)]) ; for-each col of a & row of b
-                    [(= j a-end-col)]
-                  (inc! tmp (* (array-ref a i j)
-                               (array-ref b (- j a-col-b-row-off) k))))
-                (array-set! res (- i a-start-row) (- k b-start-col) tmp)))))))))
+          (unless (%native-array-mul! res a b n m p)
+            (do ([i a-start-row (+ i 1)])       ; for-each row of a
+                [(= i a-end-row)]
+              (do ([k b-start-col (+ k 1)])     ; for-each col of b
+                  [(= k b-end-col)]
+                (let1 tmp 0
+                  (do ([j a-start-col (+ j 1)]) ; for-each col of a & row of b
+                      [(= j a-end-col)]
+                    (inc! tmp (* (array-ref a i j)
+                                 (array-ref b (- j a-col-b-row-off) k))))
+                  (array-set! res (- i a-start-row) (- k b-start-col) tmp))))))))))
+
+;; Returns #t if R = A x B is computed by the native kernel.
+(define (%native-array-mul! r a b n m p)
+  (let ([rs (~ r'backing-storage)]
+        [as (~ a'backing-storage)]
+        [bs (~ b'backing-storage)])
+    (and (uvector? rs) (uvector? as) (uvector? bs)
+         (= (array-rank r) 2)
+         (= (array-length r 0) n)
+         (= (array-length r 1) p)
+         (%uvector-matrix-mul! rs (~ r'offset) (~ r'coefficient-vector)
+                               as (~ a'offset) (~ a'coefficient-vector)
+                               bs (~ b'offset) (~ b'coefficient-vector)
+                               n m p))))
 
 (define (array-mul a b) (%array-mul #f a b))
 
@@ -0,0 +1,343 @@
+/*
+ * reduce.c - reductions on uniform vectors
+ *
+ *   Copyright (c) 2000-2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <math.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "reduce.h"
+#include "simd.h"
+
+/*
+ * uvector-sum, uvector-min, uvector-max, uvector-argmin, uvector-argmax
+ *
+ *  - Integer sums are exact.
+ *  - Floating-point elements are summed in double into 8 partial sums,
+ *    the element at offset k from START going to the (k mod 8)-th one,
+ *    and the partial sums are added pairwise at the end.  The result
+ *    may differ from adding elements one by one, but it is the same
+ *    whether the SIMD kernels are used or not.
+ *  - The minimum or maximum of a floating-point vector is NaN if it
+ *    contains NaN.  -0.0 is considered smaller than 0.0.
+ *  - argmin and argmax return the index of the first element that is
+ *    numerically equal to the minimum or maximum (or the first NaN).
+ */
+
+#define HALF2D(x)  Scm_HalfToDouble(x)
+#define FLT2D(x)   ((double)(x))
+
+#define DISPATCH_FLOAT(type, LOOP)                                      \
+    switch (type) {                                                     \
+    case SCM_UVECTOR_F16: LOOP(ScmHalfFloat, HALF2D); break;            \
+    case SCM_UVECTOR_F32: LOOP(float, FLT2D); break;                    \
+    case SCM_UVECTOR_F64: LOOP(double, FLT2D); break;                   \
+    }
+
+/* Signed integers and unsigned ones that fit in int64_t */
+#define DISPATCH_INT(type, LOOP)                                        \
+    switch (type) {                                                     \
+    case SCM_UVECTOR_S8:  LOOP(int8_t); break;                          \
+    case SCM_UVECTOR_U8:  LOOP(uint8_t); break;                         \
+    case SCM_UVECTOR_S16: LOOP(int16_t); break;                         \
+    case SCM_UVECTOR_U16: LOOP(uint16_t); break;                        \
+    case SCM_UVECTOR_S32: LOOP(int32_t); break;                         \
+    case SCM_UVECTOR_U32: LOOP(uint32_t); break;                        \
+    case SCM_UVECTOR_S64: LOOP(int64_t); break;                         \
+    }
+
+static int check_args(const char *name, ScmUVector *v,
+                      ScmSmallInt *start, ScmSmallInt *end)
+{
+    int type = Scm_UVectorType(Scm_ClassOf(SCM_OBJ(v)));
+    switch (type) {
+    case SCM_UVECTOR_C32: case SCM_UVECTOR_C64: case SCM_UVECTOR_C128:
+        Scm_Error("%s: real-valued uvector required, but got: %S",
+                  name, SCM_OBJ(v));
+    }
+    ScmSmallInt s = *start, e = *end;
+    SCM_CHECK_START_END(s, e, SCM_UVECTOR_SIZE(v));
+    *start = s;
+    *end = e;
+    return type;
+}
+
+static int float_type_p(int type)
+{
+    return (type == SCM_UVECTOR_F16
+            || type == SCM_UVECTOR_F32
+            || type == SCM_UVECTOR_F64);
+}
+
+/*
+ * Sum
+ */
+
+ScmObj Scm_UVectorSum(ScmUVector *v, ScmSmallInt start, ScmSmallInt end)
+{
+    int type = check_args("uvector-sum", v, &start, &end);
+    const void *elts = SCM_UVECTOR_ELEMENTS(v);
+    ScmSmallInt i = start;
+
+    if (float_type_p(type)) {
+        double acc[8] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+        if (type != SCM_UVECTOR_F16) {
+            size_t esize = (type == SCM_UVECTOR_F32)? 4 : 8;
+            i += uvsimd_sum(type, (const char*)elts + start*esize,
+                            end - start, acc);
+        }
+#define SUM_FLOAT(etype, conv)                                  \
+        do {                                                    \
+            const etype *p = (const etype*)elts;                \
+            for (; i < end; i++) acc[(i-start)%8] += conv(p[i]); \
+        } while (0)
+        DISPATCH_FLOAT(type, SUM_FLOAT);
+#undef SUM_FLOAT
+        return Scm_MakeFlonum(((acc[0]+acc[4]) + (acc[2]+acc[6]))
+                              + ((acc[1]+acc[5]) + (acc[3]+acc[7])));
+    }
+
+    switch (type) {
+    case SCM_UVECTOR_S8: case SCM_UVECTOR_S16: case SCM_UVECTOR_S32: {
+        /* Can't overflow, for there can't be 2^32 elements. */
+        int64_t acc = 0;
+        if (type == SCM_UVECTOR_S32) {
+            i += uvsimd_sum(type, (const int32_t*)elts + start,
+                            end - start, &acc);
+        }
+#define SUM_INT(etype)                                                  \
+        do {                                                            \
+            const etype *p = (const etype*)elts;                        \
+            for (; i < end; i++) acc += p[i];                           \
+        } while (0)
+        DISPATCH_INT(type, SUM_INT);
+        return Scm_MakeInteger64(acc);
+    }
+    case SCM_UVECTOR_U8: case SCM_UVECTOR_U16: case SCM_UVECTOR_U32: {
+        uint64_t acc = 0;
+        if (type == SCM_UVECTOR_U8) {
+            i += uvsimd_sum(type, (const uint8_t*)elts + start,
+                            end - start, &acc);
+        }
+        DISPATCH_INT(type, SUM_INT);
+#undef SUM_INT
+        return Scm_MakeIntegerU64(acc);
+    }
+    case SCM_UVECTOR_S64: {
+        /* Accumulate in int64_t while it doesn't overflow. */
+        const int64_t *p = (const int64_t*)elts;
+        ScmObj r = SCM_MAKE_INT(0);
+        int64_t acc = 0;
+        for (; i < end; i++) {
+            int64_t t = (int64_t)((uint64_t)acc + (uint64_t)p[i]);
+            if (((acc ^ t) & (p[i] ^ t)) < 0) {
+                r = Scm_Add(r, Scm_MakeInteger64(acc));
+                t = p[i];
+            }
+            acc = t;
+        }
+        return Scm_Add(r, Scm_MakeInteger64(acc));
+    }
+    case SCM_UVECTOR_U64: {
+        const uint64_t *p = (const uint64_t*)elts;
+        ScmObj r = SCM_MAKE_INT(0);
+        uint64_t acc = 0;
+        for (; i < end; i++) {
+            uint64_t t = acc + p[i];
+            if (t < acc) {
+                r = Scm_Add(r, Scm_MakeIntegerU64(acc));
+                t = p[i];
+            }
+            acc = t;
+        }
+        return Scm_Add(r, Scm_MakeIntegerU64(acc));
+    }
+    }
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+/*
+ * Min and max
+ */
+
+/* Minimum or maximum of a floating-point vector.  START < END. */
+static double minmax_float(int type, const void *elts, int maxp,
+                           ScmSmallInt start, ScmSmallInt end)
+{
+    ScmSmallInt i = start, k = 0;
+    double r = 0.0;
+    int nanp = FALSE;
+
+    if (type != SCM_UVECTOR_F16) {
+        size_t esize = (type == SCM_UVECTOR_F32)? 4 : 8;
+        k = uvsimd_minmax(type, (const char*)elts + start*esize,
+                          end - start, maxp, &r);
+        i += k;
+    }
+#define MINMAX_FLOAT(etype, conv)                                       \
+    do {                                                                \
+        const etype *p = (const etype*)elts;                            \
+        if (k == 0) r = conv(p[i++]);                                   \
+        nanp = isnan(r);                                                \
+        for (; i < end && !nanp; i++) {                                 \
+            double x = conv(p[i]);                                      \
+            if (isnan(x)) nanp = TRUE;                                  \
+            else if (maxp ? (r < x) : (x < r)) r = x;                   \
+        }                                                               \
+    } while (0)
+    DISPATCH_FLOAT(type, MINMAX_FLOAT);
+#undef MINMAX_FLOAT
+    if (nanp) return SCM_DBL_NAN;
+
+    /* -0.0 and 0.0 compare equal, so we might have picked either. */
+    if (r == 0.0) {
+        int found = FALSE;
+#define FIND_ZERO(etype, conv)                                          \
+        do {                                                            \
+            const etype *p = (const etype*)elts;                        \
+            for (i = start; i < end && !found; i++) {                   \
+                double x = conv(p[i]);                                  \
+                if (x == 0.0 && (maxp ? !signbit(x) : signbit(x)))      \
+                    found = TRUE;                                       \
+            }                                                           \
+        } while (0)
+        DISPATCH_FLOAT(type, FIND_ZERO);
+#undef FIND_ZERO
+        if (maxp) r = found ? 0.0 : -0.0;
+        else      r = found ? -0.0 : 0.0;
+    }
+    return r;
+}
+
+ScmObj Scm_UVectorMinMax(ScmUVector *v, int maxp,
+                         ScmSmallInt start, ScmSmallInt end)
+{
+    const char *name = maxp ? "uvector-max" : "uvector-min";
+    int type = check_args(name, v, &start, &end);
+    const void *elts = SCM_UVECTOR_ELEMENTS(v);
+
+    if (start == end) {
+        Scm_Error("%s: no elements in the range of %S", name, SCM_OBJ(v));
+    }
+    if (float_type_p(type)) {
+        return Scm_MakeFlonum(minmax_float(type, elts, maxp, start, end));
+    }
+    if (type == SCM_UVECTOR_U64) {
+        const uint64_t *p = (const uint64_t*)elts;
+        uint64_t r = p[start];
+        for (ScmSmallInt i = start+1; i < end; i++) {
+            if (maxp ? (r < p[i]) : (p[i] < r)) r = p[i];
+        }
+        return Scm_MakeIntegerU64(r);
+    }
+
+    ScmSmallInt i = start, k = 0;
+    int64_t r = 0;
+    if (type == SCM_UVECTOR_S32 || type == SCM_UVECTOR_U8) {
+        size_t esize = (type == SCM_UVECTOR_S32)? 4 : 1;
+        long lr = 0;
+        k = uvsimd_minmax(type, (const char*)elts + start*esize,
+                          end - start, maxp, &lr);
+        r = lr;
+        i += k;
+    }
+#define MINMAX_INT(etype)                                               \
+    do {                                                                \
+        const etype *p = (const etype*)elts;                            \
+        if (k == 0) r = p[i++];                                         \
+        for (; i < end; i++) {                                          \
+            if (maxp ? (r < p[i]) : (p[i] < r)) r = p[i];               \
+        }                                                               \
+    } while (0)
+    DISPATCH_INT(type, MINMAX_INT);
+#undef MINMAX_INT
+    return Scm_MakeInteger64(r);
+}
+
+ScmObj Scm_UVectorArgMinMax(ScmUVector *v, int maxp,
+                            ScmSmallInt start, ScmSmallInt end)
+{
+    const char *name = maxp ? "uvector-argmax" : "uvector-argmin";
+    int type = check_args(name, v, &start, &end);
+    const void *elts = SCM_UVECTOR_ELEMENTS(v);
+    ScmSmallInt i = start;
+
+    if (start == end) return SCM_FALSE;
+
+    if (float_type_p(type)) {
+        double r = minmax_float(type, elts, maxp, start, end);
+        if (type != SCM_UVECTOR_F16) {
+            size_t esize = (type == SCM_UVECTOR_F32)? 4 : 8;
+            i += uvsimd_find(type, (const char*)elts + start*esize,
+                             end - start, &r);
+        }
+        int nanp = isnan(r);
+#define FIND_FLOAT(etype, conv)                                         \
+        do {                                                            \
+            const etype *p = (const etype*)elts;                        \
+            for (; i < end; i++) {                                      \
+                double x = conv(p[i]);                                  \
+                if (nanp ? isnan(x) : (x == r)) break;                  \
+            }                                                           \
+        } while (0)
+        DISPATCH_FLOAT(type, FIND_FLOAT);
+#undef FIND_FLOAT
+        return Scm_MakeInteger(i);
+    }
+    if (type == SCM_UVECTOR_U64) {
+        const uint64_t *p = (const uint64_t*)elts;
+        ScmSmallInt ri = start;
+        for (i = start+1; i < end; i++) {
+            if (maxp ? (p[ri] < p[i]) : (p[i] < p[ri])) ri = i;
+        }
+        return Scm_MakeInteger(ri);
+    }
+
+    ScmObj m = Scm_UVectorMinMax(v, maxp, start, end);
+    int64_t r = Scm_GetInteger64(m);
+    if (type == SCM_UVECTOR_S32 || type == SCM_UVECTOR_U8) {
+        size_t esize = (type == SCM_UVECTOR_S32)? 4 : 1;
+        long lr = (long)r;
+        i += uvsimd_find(type, (const char*)elts + start*esize,
+                         end - start, &lr);
+    }
+#define FIND_INT(etype)                                                 \
+    do {                                                                \
+        const etype *p = (const etype*)elts;                            \
+        for (; i < end; i++) {                                          \
+            if (p[i] == r) break;                                       \
+        }                                                               \
+    } while (0)
+    DISPATCH_INT(type, FIND_INT);
+#undef FIND_INT
+    return Scm_MakeInteger(i);
+}
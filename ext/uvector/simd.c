@@ -0,0 +1,712 @@
+/*
+ * simd.c - SIMD kernels for uniform vectors
+ *
+ *   Copyright (c) 2000-2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <math.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "simd.h"
+
+#if defined(GAUCHE_UVECTOR_SIMD)
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+/* Returns nonzero if the CPU supports AVX2 and the OS saves YMM state. */
+int Scm__UVectorSimdAvailable(void)
+{
+    static volatile int available = -1;
+    if (available < 0) {
+        unsigned int a, b, c, d;
+        int r = 0;
+        if (__get_cpuid(0, &a, &b, &c, &d) && a >= 7) {
+            __cpuid(1, a, b, c, d);
+            if ((c & (1U<<27)) && (c & (1U<<28))) {    /* OSXSAVE, AVX */
+                unsigned int xlo, xhi;
+                __asm__ volatile ("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+                if ((xlo & 6) == 6) {                  /* XMM and YMM state */
+                    __cpuid_count(7, 0, a, b, c, d);
+                    if (b & (1U<<5)) r = 1;            /* AVX2 */
+                }
+            }
+        }
+        available = r;
+    }
+    return available;
+}
+
+#define UVSIMD_TARGET __attribute__((target("avx2")))
+
+/*
+ * Element-wise arithmetic
+ */
+
+/* Floating-point operations on two floats give the same result whether
+   computed in float or in double and then rounded to float, so we can
+   operate on f32 directly.  (The scalar code converts the constant
+   operand to float as well.) */
+
+#define FLOAT_ARITH_LOOP(W, LOAD, STORE, OP, YLOAD)             \
+    for (; i + W <= n; i += W) {                                \
+        STORE(d+i, OP(LOAD(x+i), YLOAD));                       \
+    }
+
+#define FLOAT_ARITH(W, LOAD, STORE, ADD, SUB, MUL, DIV, YLOAD)  \
+    switch (op) {                                               \
+    case UVSIMD_add: FLOAT_ARITH_LOOP(W, LOAD, STORE, ADD, YLOAD); break; \
+    case UVSIMD_sub: FLOAT_ARITH_LOOP(W, LOAD, STORE, SUB, YLOAD); break; \
+    case UVSIMD_mul: FLOAT_ARITH_LOOP(W, LOAD, STORE, MUL, YLOAD); break; \
+    case UVSIMD_div: FLOAT_ARITH_LOOP(W, LOAD, STORE, DIV, YLOAD); break; \
+    }
+
+UVSIMD_TARGET
+static ScmSmallInt arith_f64(int op, double *d, const double *x,
+                             const double *y, const double *c, ScmSmallInt n)
+{
+    ScmSmallInt i = 0;
+    if (y) {
+        FLOAT_ARITH(4, _mm256_loadu_pd, _mm256_storeu_pd,
+                    _mm256_add_pd, _mm256_sub_pd, _mm256_mul_pd, _mm256_div_pd,
+                    _mm256_loadu_pd(y+i));
+    } else {
+        __m256d cc = _mm256_set1_pd(*c);
+        FLOAT_ARITH(4, _mm256_loadu_pd, _mm256_storeu_pd,
+                    _mm256_add_pd, _mm256_sub_pd, _mm256_mul_pd, _mm256_div_pd,
+                    cc);
+    }
+    return i;
+}
+
+UVSIMD_TARGET
+static ScmSmallInt arith_f32(int op, float *d, const float *x,
+                             const float *y, const double *c, ScmSmallInt n)
+{
+    ScmSmallInt i = 0;
+    if (y) {
+        FLOAT_ARITH(8, _mm256_loadu_ps, _mm256_storeu_ps,
+                    _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps, _mm256_div_ps,
+                    _mm256_loadu_ps(y+i));
+    } else {
+        __m256 cc = _mm256_set1_ps((float)*c);
+        FLOAT_ARITH(8, _mm256_loadu_ps, _mm256_storeu_ps,
+                    _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps, _mm256_div_ps,
+                    cc);
+    }
+    return i;
+}
+
+/* s32: stops at the first chunk in which any element overflows. */
+UVSIMD_TARGET
+static ScmSmallInt arith_s32(int op, int32_t *d, const int32_t *x,
+                             const int32_t *y, const long *c, ScmSmallInt n)
+{
+    ScmSmallInt i = 0;
+    __m256i cc = _mm256_set1_epi32(y ? 0 : (int32_t)*c);
+    for (; i + 8 <= n; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(x+i));
+        __m256i b = y ? _mm256_loadu_si256((const __m256i*)(y+i)) : cc;
+        __m256i r;
+        switch (op) {
+        case UVSIMD_add: {
+            r = _mm256_add_epi32(a, b);
+            __m256i ov = _mm256_and_si256(_mm256_xor_si256(a, r),
+                                          _mm256_xor_si256(b, r));
+            if (_mm256_movemask_ps(_mm256_castsi256_ps(ov))) return i;
+            break;
+        }
+        case UVSIMD_sub: {
+            r = _mm256_sub_epi32(a, b);
+            __m256i ov = _mm256_and_si256(_mm256_xor_si256(a, b),
+                                          _mm256_xor_si256(a, r));
+            if (_mm256_movemask_ps(_mm256_castsi256_ps(ov))) return i;
+            break;
+        }
+        case UVSIMD_mul: {
+            /* 64-bit products of even and odd elements.  A product fits
+               in 32 bits iff its high word equals the sign of its low
+               word. */
+            __m256i pe = _mm256_mul_epi32(a, b);
+            __m256i po = _mm256_mul_epi32(_mm256_srli_epi64(a, 32),
+                                          _mm256_srli_epi64(b, 32));
+            __m256i ce = _mm256_cmpeq_epi32(_mm256_srli_epi64(pe, 32),
+                                            _mm256_srai_epi32(pe, 31));
+            __m256i co = _mm256_cmpeq_epi32(_mm256_srli_epi64(po, 32),
+                                            _mm256_srai_epi32(po, 31));
+            int me = _mm256_movemask_ps(_mm256_castsi256_ps(ce));
+            int mo = _mm256_movemask_ps(_mm256_castsi256_ps(co));
+            if ((me & mo & 0x55) != 0x55) return i;
+            r = _mm256_mullo_epi32(a, b);
+            break;
+        }
+        default:
+            return i;
+        }
+        _mm256_storeu_si256((__m256i*)(d+i), r);
+    }
+    return i;
+}
+
+/* u8: stops at the first chunk in which any element goes out of range. */
+UVSIMD_TARGET
+static ScmSmallInt arith_u8(int op, uint8_t *d, const uint8_t *x,
+                            const uint8_t *y, const long *c, ScmSmallInt n)
+{
+    ScmSmallInt i = 0;
+    if (op == UVSIMD_mul) {
+        __m256i cc = _mm256_set1_epi16(y ? 0 : (int16_t)*c);
+        __m256i hi = _mm256_set1_epi16((int16_t)0xff00);
+        for (; i + 16 <= n; i += 16) {
+            __m256i a = _mm256_cvtepu8_epi16(
+                _mm_loadu_si128((const __m128i*)(x+i)));
+            __m256i b = y
+                ? _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(y+i)))
+                : cc;
+            __m256i p = _mm256_mullo_epi16(a, b);
+            if (!_mm256_testz_si256(p, hi)) return i;
+            _mm_storeu_si128((__m128i*)(d+i),
+                             _mm_packus_epi16(_mm256_castsi256_si128(p),
+                                              _mm256_extracti128_si256(p, 1)));
+        }
+        return i;
+    }
+
+    __m256i cc = _mm256_set1_epi8(y ? 0 : (char)*c);
+    for (; i + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(x+i));
+        __m256i b = y ? _mm256_loadu_si256((const __m256i*)(y+i)) : cc;
+        __m256i r, s;
+        switch (op) {
+        case UVSIMD_add:
+            r = _mm256_add_epi8(a, b); s = _mm256_adds_epu8(a, b); break;
+        case UVSIMD_sub:
+            r = _mm256_sub_epi8(a, b); s = _mm256_subs_epu8(a, b); break;
+        default:
+            return i;
+        }
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(r, s)) != -1) return i;
+        _mm256_storeu_si256((__m256i*)(d+i), r);
+    }
+    return i;
+}
+
+ScmSmallInt Scm__UVectorSimdArith(int type, int op, void *d,
+                                  const void *x, const void *y,
+                                  ScmSmallInt n)
+{
+    switch (type) {
+    case SCM_UVECTOR_F64: return arith_f64(op, d, x, y, NULL, n);
+    case SCM_UVECTOR_F32: return arith_f32(op, d, x, y, NULL, n);
+    case SCM_UVECTOR_S32: return arith_s32(op, d, x, y, NULL, n);
+    case SCM_UVECTOR_U8:  return arith_u8(op, d, x, y, NULL, n);
+    default: return 0;
+    }
+}
+
+ScmSmallInt Scm__UVectorSimdArithConst(int type, int op, void *d,
+                                       const void *x, const void *c,
+                                       ScmSmallInt n)
+{
+    switch (type) {
+    case SCM_UVECTOR_F64: return arith_f64(op, d, x, NULL, c, n);
+    case SCM_UVECTOR_F32: return arith_f32(op, d, x, NULL, c, n);
+    case SCM_UVECTOR_S32: {
+        long v = *(const long*)c;
+        if (v < INT32_MIN || v > INT32_MAX) return 0;
+        return arith_s32(op, d, x, NULL, c, n);
+    }
+    case SCM_UVECTOR_U8: {
+        long v = *(const long*)c;
+        if (v < 0 || v > 255) return 0;
+        return arith_u8(op, d, x, NULL, c, n);
+    }
+    default: return 0;
+    }
+}
+
+/*
+ * Dot product
+ *
+ * Only for integer vectors, for which the result is exact regardless of
+ * the order of additions.  Floating-point dot products are accumulated
+ * sequentially by the scalar code, and vectorizing them would change
+ * the result.
+ */
+
+UVSIMD_TARGET
+static ScmObj dot_u8(const uint8_t *x, const uint8_t *y, ScmSmallInt n)
+{
+    uint64_t total = 0;
+    ScmSmallInt i = 0;
+    while (i + 32 <= n) {
+        /* Each iteration adds at most 4*255*255 to a 32-bit lane, so we
+           can do 4096 iterations before moving the sums to TOTAL. */
+        __m256i acc = _mm256_setzero_si256();
+        for (int k = 0; k < 4096 && i + 32 <= n; k++, i += 32) {
+            __m128i a0 = _mm_loadu_si128((const __m128i*)(x+i));
+            __m128i a1 = _mm_loadu_si128((const __m128i*)(x+i+16));
+            __m128i b0 = _mm_loadu_si128((const __m128i*)(y+i));
+            __m128i b1 = _mm_loadu_si128((const __m128i*)(y+i+16));
+            acc = _mm256_add_epi32(acc,
+                                   _mm256_madd_epi16(_mm256_cvtepu8_epi16(a0),
+                                                     _mm256_cvtepu8_epi16(b0)));
+            acc = _mm256_add_epi32(acc,
+                                   _mm256_madd_epi16(_mm256_cvtepu8_epi16(a1),
+                                                     _mm256_cvtepu8_epi16(b1)));
+        }
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i*)lanes, acc);
+        for (int k = 0; k < 8; k++) total += lanes[k];
+    }
+    for (; i < n; i++) total += (uint64_t)x[i] * y[i];
+    return Scm_MakeIntegerU64(total);
+}
+
+UVSIMD_TARGET
+static ScmObj dot_s32(const int32_t *x, const int32_t *y, ScmSmallInt n)
+{
+    /* Products are less than 2^62 in magnitude.  We keep each 64-bit
+       lane within [-2^62, 2^62) so that adding a product never overflows,
+       moving the lanes to the exact sum R when needed. */
+    ScmObj r = SCM_MAKE_INT(0);
+    __m256i acc = _mm256_setzero_si256();
+    __m256i bias = _mm256_set1_epi64x(1LL<<62);
+    ScmSmallInt i = 0;
+
+#define FLUSH_LANES()                                                   \
+    do {                                                                \
+        int64_t lanes_[4];                                              \
+        _mm256_storeu_si256((__m256i*)lanes_, acc);                     \
+        for (int k_ = 0; k_ < 4; k_++) {                                \
+            r = Scm_Add(r, Scm_MakeInteger64(lanes_[k_]));              \
+        }                                                               \
+        acc = _mm256_setzero_si256();                                   \
+    } while (0)
+
+#define ACCUMULATE(p)                                                   \
+    do {                                                                \
+        acc = _mm256_add_epi64(acc, p);                                 \
+        if (_mm256_movemask_pd(                                         \
+                _mm256_castsi256_pd(_mm256_add_epi64(acc, bias)))) {    \
+            FLUSH_LANES();                                              \
+        }                                                               \
+    } while (0)
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(x+i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(y+i));
+        ACCUMULATE(_mm256_mul_epi32(a, b));
+        ACCUMULATE(_mm256_mul_epi32(_mm256_srli_epi64(a, 32),
+                                    _mm256_srli_epi64(b, 32)));
+    }
+    FLUSH_LANES();
+    for (; i < n; i++) {
+        r = Scm_Add(r, Scm_MakeInteger64((int64_t)x[i] * y[i]));
+    }
+    return r;
+#undef ACCUMULATE
+#undef FLUSH_LANES
+}
+
+int Scm__UVectorSimdDot(int type, const void *x, const void *y,
+                        ScmSmallInt n, ScmObj *result)
+{
+    switch (type) {
+    case SCM_UVECTOR_U8:  *result = dot_u8(x, y, n); return TRUE;
+    case SCM_UVECTOR_S32: *result = dot_s32(x, y, n); return TRUE;
+    default: return FALSE;
+    }
+}
+
+/*
+ * Range check
+ *
+ * Returns the number of leading elements that are known to be within
+ * [LO, HI].  As in the scalar code, NaN is never out of range.
+ */
+
+UVSIMD_TARGET
+static __m256d out_of_range_pd(__m256d v, const double *lo, const double *hi)
+{
+    __m256d out = _mm256_setzero_pd();
+    if (lo) out = _mm256_or_pd(out, _mm256_cmp_pd(v, _mm256_set1_pd(*lo),
+                                                  _CMP_LT_OQ));
+    if (hi) out = _mm256_or_pd(out, _mm256_cmp_pd(_mm256_set1_pd(*hi), v,
+                                                  _CMP_LT_OQ));
+    return out;
+}
+
+UVSIMD_TARGET
+static ScmSmallInt in_range_f64(const double *x, ScmSmallInt n,
+                                const double *lo, const double *hi)
+{
+    ScmSmallInt i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d out = out_of_range_pd(_mm256_loadu_pd(x+i), lo, hi);
+        if (_mm256_movemask_pd(out)) break;
+    }
+    return i;
+}
+
+UVSIMD_TARGET
+static ScmSmallInt in_range_f32(const float *x, ScmSmallInt n,
+                                const double *lo, const double *hi)
+{
+    /* The scalar code compares in double. */
+    ScmSmallInt i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_cvtps_pd(_mm_loadu_ps(x+i));
+        if (_mm256_movemask_pd(out_of_range_pd(v, lo, hi))) break;
+    }
+    return i;
+}
+
+UVSIMD_TARGET
+static ScmSmallInt in_range_s32(const int32_t *x, ScmSmallInt n,
+                                const long *lo, const long *hi)
+{
+    ScmSmallInt i = 0;
+    __m256i vlo = _mm256_set1_epi32(lo ? (int32_t)*lo : INT32_MIN);
+    __m256i vhi = _mm256_set1_epi32(hi ? (int32_t)*hi : INT32_MAX);
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(x+i));
+        __m256i out = _mm256_or_si256(_mm256_cmpgt_epi32(vlo, v),
+                                      _mm256_cmpgt_epi32(v, vhi));
+        if (!_mm256_testz_si256(out, out)) break;
+    }
+    return i;
+}
+
+UVSIMD_TARGET
+static ScmSmallInt in_range_u8(const uint8_t *x, ScmSmallInt n,
+                               const long *lo, const long *hi)
+{
+    ScmSmallInt i = 0;
+    __m256i vlo = _mm256_set1_epi8((char)(lo ? *lo : 0));
+    __m256i vhi = _mm256_set1_epi8((char)(hi ? *hi : 255));
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(x+i));
+        __m256i in = _mm256_and_si256(
+            _mm256_cmpeq_epi8(_mm256_max_epu8(v, vlo), v),
+            _mm256_cmpeq_epi8(_mm256_min_epu8(v, vhi), v));
+        if (_mm256_movemask_epi8(in) != -1) break;
+    }
+    return i;
+}
+
+ScmSmallInt Scm__UVectorSimdInRange(int type, const void *x, ScmSmallInt n,
+                                    const void *lo, const void *hi)
+{
+    switch (type) {
+    case SCM_UVECTOR_F64: return in_range_f64(x, n, lo, hi);
+    case SCM_UVECTOR_F32: return in_range_f32(x, n, lo, hi);
+    case SCM_UVECTOR_S32: return in_range_s32(x, n, lo, hi);
+    case SCM_UVECTOR_U8:  return in_range_u8(x, n, lo, hi);
+    default: return 0;
+    }
+}
+
+/*
+ * Reductions (see reduce.c for the semantics)
+ */
+
+/* Floating-point elements are summed in double into 8 partial sums;
+   element i goes to ACC[i%8].  Integer elements are summed into
+   an int64_t (s32) or uint64_t (u8). */
+
+UVSIMD_TARGET
+static ScmSmallInt sum_f64(const double *x, ScmSmallInt n, double *acc)
+{
+    __m256d a0 = _mm256_loadu_pd(acc), a1 = _mm256_loadu_pd(acc+4);
+    ScmSmallInt i = 0;
+    for (; i + 8 <= n; i += 8) {
+        a0 = _mm256_add_pd(a0, _mm256_loadu_pd(x+i));
+        a1 = _mm256_add_pd(a1, _mm256_loadu_pd(x+i+4));
+    }
+    _mm256_storeu_pd(acc, a0);
+    _mm256_storeu_pd(acc+4, a1);
+    return i;
+}
+
+UVSIMD_TARGET
+static ScmSmallInt sum_f32(const float *x, ScmSmallInt n, double *acc)
+{
+    __m256d a0 = _mm256_loadu_pd(acc), a1 = _mm256_loadu_pd(acc+4);
+    ScmSmallInt i = 0;
+    for (; i + 8 <= n; i += 8) {
+        a0 = _mm256_add_pd(a0, _mm256_cvtps_pd(_mm_loadu_ps(x+i)));
+        a1 = _mm256_add_pd(a1, _mm256_cvtps_pd(_mm_loadu_ps(x+i+4)));
+    }
+    _mm256_storeu_pd(acc, a0);
+    _mm256_storeu_pd(acc+4, a1);
+    return i;
+}
+
+UVSIMD_TARGET
+static ScmSmallInt sum_s32(const int32_t *x, ScmSmallInt n, int64_t *acc)
+{
+    __m256i a = _mm256_setzero_si256();
+    ScmSmallInt i = 0;
+    for (; i + 8 <= n; i += 8) {
+        a = _mm256_add_epi64(a, _mm256_cvtepi32_epi64(
+                                 _mm_loadu_si128((const __m128i*)(x+i))));
+        a = _mm256_add_epi64(a, _mm256_cvtepi32_epi64(
+                                 _mm_loadu_si128((const __m128i*)(x+i+4))));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, a);
+    *acc += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return i;
+}
+
+UVSIMD_TARGET
+static ScmSmallInt sum_u8(const uint8_t *x, ScmSmallInt n, uint64_t *acc)
+{
+    __m256i a = _mm256_setzero_si256();
+    __m256i z = _mm256_setzero_si256();
+    ScmSmallInt i = 0;
+    for (; i + 32 <= n; i += 32) {
+        a = _mm256_add_epi64(a, _mm256_sad_epu8(
+                                 _mm256_loadu_si256((const __m256i*)(x+i)), z));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, a);
+    *acc += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return i;
+}
+
+ScmSmallInt Scm__UVectorSimdSum(int type, const void *x, ScmSmallInt n,
+                                void *acc)
+{
+    switch (type) {
+    case SCM_UVECTOR_F64: return sum_f64(x, n, acc);
+    case SCM_UVECTOR_F32: return sum_f32(x, n, acc);
+    case SCM_UVECTOR_S32: return sum_s32(x, n, acc);
+    case SCM_UVECTOR_U8:  return sum_u8(x, n, acc);
+    default: return 0;
+    }
+}
+
+/* Minimum or maximum of the leading elements, stored in *RESULT (double
+   for f32 and f64, long for s32 and u8).  For floating-point vectors,
+   the result is NaN if any of the elements is NaN.  The sign of a zero
+   result is unspecified; the caller takes care of it. */
+
+UVSIMD_TARGET
+static ScmSmallInt minmax_f64(const double *x, ScmSmallInt n, int maxp,
+                              double *result)
+{
+    __m256d m = _mm256_loadu_pd(x), nan = _mm256_setzero_pd();
+    ScmSmallInt i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_loadu_pd(x+i);
+        nan = _mm256_or_pd(nan, _mm256_cmp_pd(v, v, _CMP_UNORD_Q));
+        m = maxp ? _mm256_max_pd(m, v) : _mm256_min_pd(m, v);
+    }
+    if (_mm256_movemask_pd(nan)) {
+        *result = SCM_DBL_NAN;
+    } else {
+        double lanes[4];
+        _mm256_storeu_pd(lanes, m);
+        double r = lanes[0];
+        for (int k = 1; k < 4; k++) {
+            if (maxp ? (lanes[k] > r) : (lanes[k] < r)) r = lanes[k];
+        }
+        *result = r;
+    }
+    return i;
+}
+
+UVSIMD_TARGET
+static ScmSmallInt minmax_f32(const float *x, ScmSmallInt n, int maxp,
+                              double *result)
+{
+    __m256 m = _mm256_loadu_ps(x), nan = _mm256_setzero_ps();
+    ScmSmallInt i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(x+i);
+        nan = _mm256_or_ps(nan, _mm256_cmp_ps(v, v, _CMP_UNORD_Q));
+        m = maxp ? _mm256_max_ps(m, v) : _mm256_min_ps(m, v);
+    }
+    if (_mm256_movemask_ps(nan)) {
+        *result = SCM_DBL_NAN;
+    } else {
+        float lanes[8];
+        _mm256_storeu_ps(lanes, m);
+        float r = lanes[0];
+        for (int k = 1; k < 8; k++) {
+            if (maxp ? (lanes[k] > r) : (lanes[k] < r)) r = lanes[k];
+        }
+        *result = r;
+    }
+    return i;
+}
+
+UVSIMD_TARGET
+static ScmSmallInt minmax_s32(const int32_t *x, ScmSmallInt n, int maxp,
+                              long *result)
+{
+    __m256i m = _mm256_loadu_si256((const __m256i*)x);
+    ScmSmallInt i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(x+i));
+        m = maxp ? _mm256_max_epi32(m, v) : _mm256_min_epi32(m, v);
+    }
+    int32_t lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, m);
+    long r = lanes[0];
+    for (int k = 1; k < 8; k++) {
+        if (maxp ? (lanes[k] > r) : (lanes[k] < r)) r = lanes[k];
+    }
+    *result = r;
+    return i;
+}
+
+UVSIMD_TARGET
+static ScmSmallInt minmax_u8(const uint8_t *x, ScmSmallInt n, int maxp,
+                             long *result)
+{
+    __m256i m = _mm256_loadu_si256((const __m256i*)x);
+    ScmSmallInt i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(x+i));
+        m = maxp ? _mm256_max_epu8(m, v) : _mm256_min_epu8(m, v);
+    }
+    uint8_t lanes[32];
+    _mm256_storeu_si256((__m256i*)lanes, m);
+    long r = lanes[0];
+    for (int k = 1; k < 32; k++) {
+        if (maxp ? (lanes[k] > r) : (lanes[k] < r)) r = lanes[k];
+    }
+    *result = r;
+    return i;
+}
+
+/* Returns 0 if N is too small; otherwise *RESULT is set. */
+ScmSmallInt Scm__UVectorSimdMinMax(int type, const void *x, ScmSmallInt n,
+                                   int maxp, void *result)
+{
+    switch (type) {
+    case SCM_UVECTOR_F64:
+        return (n < 4) ? 0 : minmax_f64(x, n, maxp, result);
+    case SCM_UVECTOR_F32:
+        return (n < 8) ? 0 : minmax_f32(x, n, maxp, result);
+    case SCM_UVECTOR_S32:
+        return (n < 8) ? 0 : minmax_s32(x, n, maxp, result);
+    case SCM_UVECTOR_U8:
+        return (n < 32) ? 0 : minmax_u8(x, n, maxp, result);
+    default: return 0;
+    }
+}
+
+/* Returns the index of the first element numerically equal to *VAL
+   (or the first NaN, if *VAL is NaN), or the number of leading elements
+   that are known not to match. */
+
+UVSIMD_TARGET
+static ScmSmallInt find_f64(const double *x, ScmSmallInt n, double val)
+{
+    __m256d v = _mm256_set1_pd(val);
+    int nanp = isnan(val);
+    ScmSmallInt i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d e = _mm256_loadu_pd(x+i);
+        int m = _mm256_movemask_pd(nanp
+                                   ? _mm256_cmp_pd(e, e, _CMP_UNORD_Q)
+                                   : _mm256_cmp_pd(e, v, _CMP_EQ_OQ));
+        if (m) return i + __builtin_ctz(m);
+    }
+    return i;
+}
+
+UVSIMD_TARGET
+static ScmSmallInt find_f32(const float *x, ScmSmallInt n, double val)
+{
+    /* The scalar code compares in double.  A float equals VAL only if
+       VAL is exactly representable in float. */
+    int nanp = isnan(val);
+    if (!nanp && (double)(float)val != val) return 0;
+    __m256 v = _mm256_set1_ps((float)val);
+    ScmSmallInt i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 e = _mm256_loadu_ps(x+i);
+        int m = _mm256_movemask_ps(nanp
+                                   ? _mm256_cmp_ps(e, e, _CMP_UNORD_Q)
+                                   : _mm256_cmp_ps(e, v, _CMP_EQ_OQ));
+        if (m) return i + __builtin_ctz(m);
+    }
+    return i;
+}
+
+UVSIMD_TARGET
+static ScmSmallInt find_s32(const int32_t *x, ScmSmallInt n, long val)
+{
+    if (val < INT32_MIN || val > INT32_MAX) return 0;
+    __m256i v = _mm256_set1_epi32((int32_t)val);
+    ScmSmallInt i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i e = _mm256_loadu_si256((const __m256i*)(x+i));
+        int m = _mm256_movemask_ps(_mm256_castsi256_ps(
+                                       _mm256_cmpeq_epi32(e, v)));
+        if (m) return i + __builtin_ctz(m);
+    }
+    return i;
+}
+
+UVSIMD_TARGET
+static ScmSmallInt find_u8(const uint8_t *x, ScmSmallInt n, long val)
+{
+    if (val < 0 || val > 255) return 0;
+    __m256i v = _mm256_set1_epi8((char)val);
+    ScmSmallInt i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i e = _mm256_loadu_si256((const __m256i*)(x+i));
+        unsigned int m = (unsigned int)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(e, v));
+        if (m) return i + __builtin_ctz(m);
+    }
+    return i;
+}
+
+ScmSmallInt Scm__UVectorSimdFind(int type, const void *x, ScmSmallInt n,
+                                 const void *val)
+{
+    switch (type) {
+    case SCM_UVECTOR_F64: return find_f64(x, n, *(const double*)val);
+    case SCM_UVECTOR_F32: return find_f32(x, n, *(const double*)val);
+    case SCM_UVECTOR_S32: return find_s32(x, n, *(const long*)val);
+    case SCM_UVECTOR_U8:  return find_u8(x, n, *(const long*)val);
+    default: return 0;
+    }
+}
+
+#endif /*GAUCHE_UVECTOR_SIMD*/
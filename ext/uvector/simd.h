@@ -0,0 +1,178 @@
+/*
+ * simd.h - SIMD kernels for uniform vectors
+ *
+ *   Copyright (c) 2000-2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef GAUCHE_UVECTOR_SIMD_H
+#define GAUCHE_UVECTOR_SIMD_H
+
+/* Kernels for common element-wise operations, dot products, range checks
+   and reductions on f32, f64, s32 and u8 vectors using AVX2.  They are
+   compiled with per-function target attributes, and used only if the CPU
+   supports AVX2, which is checked at runtime.  Define
+   GAUCHE_UVECTOR_NO_SIMD to exclude them altogether.
+
+   Every kernel produces exactly the same result as the scalar code.
+   Integer kernels give up at the first chunk that would overflow or go
+   out of range, and return the number of elements processed so far; the
+   caller continues from there with the scalar code, which takes care of
+   clamping and errors. */
+#if defined(__x86_64__)                                         \
+    && (defined(__clang__)                                      \
+        || (defined(__GNUC__)                                   \
+            && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))) \
+    && !defined(GAUCHE_UVECTOR_NO_SIMD)
+#define GAUCHE_UVECTOR_SIMD 1
+#endif
+
+/* Operations of element-wise arithmetic */
+enum {
+    UVSIMD_add,
+    UVSIMD_sub,
+    UVSIMD_mul,
+    UVSIMD_div
+};
+
+/* Vectors shorter than this aren't worth dispatching */
+#define UVSIMD_MIN_LENGTH 16
+
+#if defined(GAUCHE_UVECTOR_SIMD)
+extern int Scm__UVectorSimdAvailable(void);
+extern ScmSmallInt Scm__UVectorSimdArith(int type, int op, void *d,
+                                         const void *x, const void *y,
+                                         ScmSmallInt n);
+extern ScmSmallInt Scm__UVectorSimdArithConst(int type, int op, void *d,
+                                              const void *x, const void *c,
+                                              ScmSmallInt n);
+extern int Scm__UVectorSimdDot(int type, const void *x, const void *y,
+                               ScmSmallInt n, ScmObj *result);
+extern ScmSmallInt Scm__UVectorSimdInRange(int type, const void *x,
+                                           ScmSmallInt n,
+                                           const void *lo, const void *hi);
+extern ScmSmallInt Scm__UVectorSimdSum(int type, const void *x,
+                                       ScmSmallInt n, void *acc);
+extern ScmSmallInt Scm__UVectorSimdMinMax(int type, const void *x,
+                                          ScmSmallInt n, int maxp,
+                                          void *result);
+extern ScmSmallInt Scm__UVectorSimdFind(int type, const void *x,
+                                        ScmSmallInt n, const void *val);
+#endif /*GAUCHE_UVECTOR_SIMD*/
+
+static inline int uvsimd_usable(ScmSmallInt n)
+{
+#if defined(GAUCHE_UVECTOR_SIMD)
+    return (n >= UVSIMD_MIN_LENGTH && Scm__UVectorSimdAvailable());
+#else
+    (void)n;
+    return FALSE;
+#endif
+}
+
+/* The following wrappers return the number of elements processed
+   (or FALSE, for uvsimd_dot), which is 0 if SIMD isn't available or
+   the type isn't supported.  C points to a value of the natural type
+   of the vector (double for f32 and f64, long for s32 and u8). */
+
+static inline ScmSmallInt uvsimd_arith(int type, int op, void *d,
+                                       const void *x, const void *y,
+                                       ScmSmallInt n)
+{
+#if defined(GAUCHE_UVECTOR_SIMD)
+    if (uvsimd_usable(n)) return Scm__UVectorSimdArith(type, op, d, x, y, n);
+#endif
+    return 0;
+}
+
+static inline ScmSmallInt uvsimd_arith_const(int type, int op, void *d,
+                                             const void *x, const void *c,
+                                             ScmSmallInt n)
+{
+#if defined(GAUCHE_UVECTOR_SIMD)
+    if (uvsimd_usable(n)) {
+        return Scm__UVectorSimdArithConst(type, op, d, x, c, n);
+    }
+#endif
+    return 0;
+}
+
+static inline int uvsimd_dot(int type, const void *x, const void *y,
+                             ScmSmallInt n, ScmObj *result)
+{
+#if defined(GAUCHE_UVECTOR_SIMD)
+    if (uvsimd_usable(n)) return Scm__UVectorSimdDot(type, x, y, n, result);
+#endif
+    return FALSE;
+}
+
+/* LO and HI may be NULL if there's no bound. */
+static inline ScmSmallInt uvsimd_in_range(int type, const void *x,
+                                          ScmSmallInt n,
+                                          const void *lo, const void *hi)
+{
+#if defined(GAUCHE_UVECTOR_SIMD)
+    if (uvsimd_usable(n)) return Scm__UVectorSimdInRange(type, x, n, lo, hi);
+#endif
+    return 0;
+}
+
+/* Reductions; see simd.c for what ACC, RESULT and VAL point to. */
+static inline ScmSmallInt uvsimd_sum(int type, const void *x, ScmSmallInt n,
+                                     void *acc)
+{
+#if defined(GAUCHE_UVECTOR_SIMD)
+    if (uvsimd_usable(n)) return Scm__UVectorSimdSum(type, x, n, acc);
+#endif
+    return 0;
+}
+
+static inline ScmSmallInt uvsimd_minmax(int type, const void *x,
+                                        ScmSmallInt n, int maxp,
+                                        void *result)
+{
+#if defined(GAUCHE_UVECTOR_SIMD)
+    if (uvsimd_usable(n)) {
+        return Scm__UVectorSimdMinMax(type, x, n, maxp, result);
+    }
+#endif
+    return 0;
+}
+
+static inline ScmSmallInt uvsimd_find(int type, const void *x,
+                                      ScmSmallInt n, const void *val)
+{
+#if defined(GAUCHE_UVECTOR_SIMD)
+    if (uvsimd_usable(n)) return Scm__UVectorSimdFind(type, x, n, val);
+#endif
+    return 0;
+}
+
+#endif /*GAUCHE_UVECTOR_SIMD_H*/
@@ -1384,6 +1384,146 @@
 (clamp-test-u64 #u64(127 0 4 200 255)
                 #u64(3 3 3 3 3) #u64(199 199 199 199 199))
 
+;;-------------------------------------------------------------------
+(test-section "long vectors")
+
+;; Long f32, f64, s32 and u8 vectors may be processed by SIMD kernels.
+;; The results must be the same as the element-by-element path, which
+;; is used when the other operand is a vector.
+(let ()
+  (define (gen-vec make n f)
+    (rlet1 v (make n)
+      (dotimes [i n] (uvector-set! v i (f i)))))
+  (define (check name op x y . opts)
+    (test* #"~name (~(class-name (class-of x)))"
+           (apply op x (uvector->vector y) opts)
+           (apply op x y opts)))
+
+  (expand-uvec
+   (f32 f64)
+   (let ([x (gen-vec make-@vector 100 (^i (/ (- i 37.5) 3)))]
+         [y (gen-vec make-@vector 100 (^i (+ (* i 0.7) 0.125)))])
+     (check "add" @vector-add x y)
+     (check "sub" @vector-sub x y)
+     (check "mul" @vector-mul x y)
+     (check "div" @vector-div x y)
+     (test* "mul const" (@vector-mul x (make-vector 100 0.1))
+            (@vector-mul x 0.1))
+     (test* "div! const" (@vector-div x (make-vector 100 3.0))
+            (@vector-div! (@vector-copy x) 3.0))
+     (test* "dot" (@vector-dot x (uvector->vector y)) (@vector-dot x y))
+     (let1 z (@vector-copy x)
+       (@vector-set! z 70 +nan.0)
+       (test* "range-check" 61 (@vector-range-check x -12.5 7.5))
+       (test* "range-check (nan)" #f (@vector-range-check z -12.5 #f))
+       (test* "clamp" (@vector-clamp x (make-vector 100 -5) #f)
+              (@vector-clamp x -5 #f)))))
+
+  (let ([x (gen-vec make-s32vector 100 (^i (* (- i 50) 40000)))]
+        [y (gen-vec make-s32vector 100 (^i (* (- 60 i) 30000)))])
+    (check "add" s32vector-add x y)
+    (check "sub" s32vector-sub x y)
+    (check "mul" s32vector-mul x y 'both)
+    (test* "mul (overflow)" (test-error) (s32vector-mul x y))
+    (check "add (overflow)" s32vector-add x
+           (gen-vec make-s32vector 100 (^i (if (= i 83) #x7fffffff i)))
+           'high)
+    (test* "add const" (s32vector-add x (make-vector 100 -12345))
+           (s32vector-add x -12345))
+    (test* "dot" (s32vector-dot x (uvector->vector y)) (s32vector-dot x y))
+    (test* "dot (large)" (* 100 #x-80000000 #x-80000000)
+           (s32vector-dot (make-s32vector 100 #x-80000000)
+                          (make-s32vector 100 #x-80000000)))
+    (test* "range-check" 96 (s32vector-range-check x #f 1800000))
+    (test* "clamp!" (s32vector-clamp x -1000000 1000000)
+           (s32vector-clamp! (s32vector-copy x)
+                             (make-vector 100 -1000000)
+                             (make-list 100 1000000))))
+
+  (let ([x (gen-vec make-u8vector 100 (^i (modulo (* i 7) 200)))]
+        [y (gen-vec make-u8vector 100 (^i (modulo (* i 3) 50)))])
+    (check "add" u8vector-add x y 'both)
+    (check "sub" u8vector-sub x y 'both)
+    (check "mul" u8vector-mul x y 'both)
+    (check "mul" u8vector-mul
+           (u8vector-clamp x #f 15) (u8vector-clamp y #f 15))
+    (test* "sub (underflow)" (test-error) (u8vector-sub y x))
+    (test* "dot" (u8vector-dot x (uvector->vector y)) (u8vector-dot x y))
+    (test* "dot (large)" (* 100000 255 255)
+           (u8vector-dot (make-u8vector 100000 255)
+                         (make-u8vector 100000 255)))
+    (test* "range-check" 57 (u8vector-range-check x 0 198))
+    (test* "range-check" #f (u8vector-range-check x 0 199))
+    (test* "clamp" (map (cut clamp <> 10 100) (u8vector->list x))
+           (u8vector->list (u8vector-clamp x 10 100)))))
+
+;;-------------------------------------------------------------------
+(test-section "reductions")
+
+(let ()
+  (define (gen-vec make n f)
+    (rlet1 v (make n)
+      (dotimes [i n] (uvector-set! v i (f i)))))
+
+  (let ([f64 (gen-vec make-f64vector 100 (^i (* (- (modulo (* i 37) 100) 50)
+                                               0.25)))])
+    (test* "uvector-sum" (exact (uvector-sum f64))
+           (apply + (map exact (f64vector->list f64))))
+    (test* "uvector-sum f32 vs f64" (uvector-sum f64)
+           (uvector-sum (list->f32vector (f64vector->list f64))))
+    (test* "uvector-min" -12.5 (uvector-min f64))
+    (test* "uvector-max" 12.25 (uvector-max f64))
+    (test* "uvector-argmin" 0 (uvector-argmin f64))
+    (test* "uvector-argmax" 27 (uvector-argmax f64))
+    (test* "uvector-min (range)" -12.25 (uvector-min f64 51 97))
+    (test* "uvector-argmin (range)" 73 (uvector-argmin f64 51 97))
+    (f64vector-set! f64 77 +nan.0)
+    (test* "uvector-min (nan)" #t (nan? (uvector-min f64)))
+    (test* "uvector-argmax (nan)" 77 (uvector-argmax f64)))
+
+  (let1 zs (gen-vec make-f64vector 40 (^i (case i
+                                            [(5) -0.0]
+                                            [(20) 1.0]
+                                            [else 0.0])))
+    (test* "uvector-min (-0.0)" -0.0 (uvector-min zs) eqv?)
+    (test* "uvector-min (0.0)" 0.0 (uvector-min zs 6) eqv?)
+    (test* "uvector-max (-0.0)" -0.0
+           (uvector-max (make-f32vector 40 -0.0)) eqv?)
+    (test* "uvector-argmin (-0.0)" 0 (uvector-argmin zs)))
+
+  (let ([s32 (gen-vec make-s32vector 100 (^i (* (- i 50) 40000000)))]
+        [u8  (gen-vec make-u8vector 1000 (^i (+ (modulo (* i 13) 200) 20)))]
+        [s8  (gen-vec make-s8vector 100 (^i (- (modulo (* i 7) 256) 128)))]
+        [u64 (u64vector (- (expt 2 64) 1) (- (expt 2 64) 1) 3)]
+        [s64 (s64vector (- (expt 2 63) 1) (- (expt 2 63) 1) -5)])
+    (test* "uvector-sum (s32)" (apply + (s32vector->list s32))
+           (uvector-sum s32))
+    (test* "uvector-sum (u8)" (apply + (u8vector->list u8)) (uvector-sum u8))
+    (test* "uvector-sum (s8)" (apply + (s8vector->list s8)) (uvector-sum s8))
+    (test* "uvector-sum (u64)" (+ (* 2 (- (expt 2 64) 1)) 3)
+           (uvector-sum u64))
+    (test* "uvector-sum (s64)" (- (* 2 (- (expt 2 63) 1)) 5)
+           (uvector-sum s64))
+    (test* "uvector-min (s32)" -2000000000 (uvector-min s32))
+    (test* "uvector-max (s32)" 1960000000 (uvector-max s32))
+    (test* "uvector-min (u8)" 20 (uvector-min u8))
+    (test* "uvector-max (u8)" 219 (uvector-max u8))
+    (test* "uvector-argmin (u8)" 0 (uvector-argmin u8))
+    (test* "uvector-argmax (u8)" (list-index (cut = <> 219) (u8vector->list u8))
+           (uvector-argmax u8))
+    (test* "uvector-argmax (u8, range)" 923
+           (uvector-argmax (u8vector-clamp u8 #f 218) 850 1000))
+    (test* "uvector-min (s8)" -128 (uvector-min s8))
+    (test* "uvector-argmax (u64)" 0 (uvector-argmax u64))
+    (test* "uvector-argmin (s64)" 2 (uvector-argmin s64)))
+
+  (test* "uvector-sum (empty)" 0 (uvector-sum (u8vector)))
+  (test* "uvector-sum (empty)" 0.0 (uvector-sum (f32vector)))
+  (test* "uvector-min (empty)" (test-error) (uvector-min (s32vector)))
+  (test* "uvector-argmin (empty)" #f (uvector-argmin (s32vector 1 2) 1 1))
+  (test* "uvector-sum (complex)" (test-error) (uvector-sum (c64vector 1 2)))
+  )
+
 ;;-------------------------------------------------------------------
 (test-section "block i/o")
 
@@ -2639,6 +2779,61 @@
       #,(<f64array> (0 2 0 2) 22 28 49 64))
      )))
 
+;; Matrices backed by the same uvector class are handled by native
+;; kernels; check them against the generic path.
+(let ()
+  (define (elt i j) (- (modulo (+ (* i 7) (* j 13)) 19) 9))
+  (define (mat make n m f)
+    (rlet1 a (make (shape 0 n 0 m) 0) (array-retabulate! a f)))
+  (define (generic-mul n m p)
+    (map exact (array->list (array-mul (mat make-array n m elt)
+                                       (mat make-array m p (^[i j] (elt j i)))))))
+  (define (native-mul make n m p)
+    (map exact (array->list (array-mul (mat make n m elt)
+                                       (mat make m p (^[i j] (elt j i)))))))
+  (let1 expected (generic-mul 37 300 70)
+    (dolist [make `(,make-f64array ,make-f32array ,make-s16array
+                    ,make-s32array ,make-s64array)]
+      (test* "array-mul native vs generic" expected
+             (native-mul make 37 300 70))))
+
+  ;; non-contiguous operands
+  (let* ([a (share-array (mat make-f64array 6 4 elt) (shape 0 4 0 6)
+                         (^[i j] (values j i)))]
+         [b (share-array (mat make-f64array 5 12 elt) (shape 0 6 0 5)
+                         (^[i j] (values (- 4 j) (* i 2))))]
+         [ga (share-array (mat make-array 6 4 elt) (shape 0 4 0 6)
+                          (^[i j] (values j i)))]
+         [gb (share-array (mat make-array 5 12 elt) (shape 0 6 0 5)
+                          (^[i j] (values (- 4 j) (* i 2))))])
+    (test* "array-mul native (shared)"
+           (array->list (array-mul ga gb))
+           (map exact (array->list (array-mul a b)))))
+
+  ;; integer overflow in the middle falls back to the generic path
+  (test* "array-mul native (intermediate overflow)"
+         (expt 2 62)
+         (array-ref (array-mul (s64array (shape 0 1 0 3)
+                                         (expt 2 62) (expt 2 62)
+                                         (- (expt 2 62)))
+                               (s64array (shape 0 3 0 1) 1 1 1))
+                    0 0))
+  (test* "array-mul native (out of range)" (test-error)
+         (array-mul (s8array (shape 0 1 0 2) 100 100)
+                    (s8array (shape 0 2 0 1) 1 1)))
+
+  ;; Gaussian elimination
+  (let* ([n 20]
+         [f (^[i j] (if (= i j) (+ (elt i j) 100) (elt i j)))]
+         [a (mat make-f64array n n f)])
+    (test* "array-inverse native" (make-list (* n n) #t)
+           (map (^[x y] (approx-equal? x y 1e-10))
+                (array->list (array-mul a (array-inverse a)))
+                (array->list (identity-array n <f64array>))))
+    (test* "determinant native" (determinant (mat make-array n n f))
+           (determinant a)
+           (^[x y] (< (abs (- 1 (/ x y))) 1e-10)))))
+
 (test* "array-vector-mul"
        '#s32(3 5 7 9)
        (array-vector-mul '#,(<u32array> (0 4 0 2) 1 2 3 4 5 6 7 8)
@@ -3016,6 +3211,33 @@
        (equal? s (call-with-string-io s (^[in out]
                                           (copy-port in out :unit 100000)))))
 
+;;-------------------------------------------------------------------
+(test-section "sort")
+
+(let ()
+  (define (uvsort-test name make-uv in)
+    (let ([expected (sort in (^[a b] (< a b)))]
+          [uv (make-uv in)])
+      (test* #"sort ~name" (make-uv expected) (sort uv))
+      (test* #"sort ~name (source intact)" (make-uv in) uv)
+      (test* #"stable-sort ~name" (make-uv expected) (stable-sort uv))
+      (test* #"sort! ~name" (make-uv expected) (rlet1 v (make-uv in) (sort! v)))))
+  (uvsort-test "u8" list->u8vector '(3 255 0 7 128 7 1))
+  (uvsort-test "s8" list->s8vector '(3 -128 0 7 127 -7 1))
+  (uvsort-test "s16" list->s16vector '(3 -32768 0 7 32767 -7 1))
+  (uvsort-test "u32" list->u32vector '(3 4294967295 0 7 65536 7 1))
+  (uvsort-test "s32" list->s32vector '(3 -2147483648 0 2147483647 -7 1))
+  (uvsort-test "s64" list->s64vector
+               '(3 -9223372036854775808 0 9223372036854775807 -7 1))
+  (uvsort-test "u64" list->u64vector '(3 18446744073709551615 0 7 1))
+  (uvsort-test "f32" list->f32vector '(3.5 -1.25 0.0 +inf.0 -inf.0 1.0))
+  (uvsort-test "f64" list->f64vector '(3.5 -1.25 0.0 +inf.0 -inf.0 1e300))
+  (test* "sort f64 with NaN falls back" 3
+         (f64vector-length (sort (f64vector 1.0 +nan.0 0.0))))
+  (test* "sort (cmp) u8" '#u8(9 5 3 1)
+         (sort (u8vector 3 1 9 5) >))
+  )
+
 ;;-------------------------------------------------------------------
 (test-section "binary search")
 
@@ -65,6 +65,7 @@
           uvector-alias uvector-segment/shared
           uvector-binary-search uvector-class-element-size
           uvector-copy uvector-copy! uvector-ref uvector-set! uvector-size
+          uvector-sum uvector-min uvector-max uvector-argmin uvector-argmax
           uvector->list uvector->vector uvector-swap-bytes uvector-swap-bytes!
           list->uvector vector->uvector
 
@@ -97,7 +98,9 @@
   (.include "gauche/uvector.h")
   (.include "gauche/priv/vectorP.h")
   (.include "gauche/priv/bytesP.h")
-  (.include "uvectorP.h")))
+  (.include "uvectorP.h")
+  (.include "linalg.h")
+  (.include "reduce.h")))
 
 ;; uvlib.scm is generated by uvlib.scm.tmpl
 (include "./uvlib.scm")
@@ -481,6 +484,63 @@
     [else (return FALSE)]
     ))
 
+;;-------------------------------------------------------------
+;; Reductions
+;;
+
+(inline-stub
+ (define-cproc uvector-sum (v::<uvector> :optional (start::<fixnum> 0)
+                                                   (end::<fixnum> -1))
+   (return (Scm_UVectorSum v start end)))
+
+ (define-cproc uvector-min (v::<uvector> :optional (start::<fixnum> 0)
+                                                   (end::<fixnum> -1))
+   (return (Scm_UVectorMinMax v FALSE start end)))
+
+ (define-cproc uvector-max (v::<uvector> :optional (start::<fixnum> 0)
+                                                   (end::<fixnum> -1))
+   (return (Scm_UVectorMinMax v TRUE start end)))
+
+ (define-cproc uvector-argmin (v::<uvector> :optional (start::<fixnum> 0)
+                                                      (end::<fixnum> -1))
+   (return (Scm_UVectorArgMinMax v FALSE start end)))
+
+ (define-cproc uvector-argmax (v::<uvector> :optional (start::<fixnum> 0)
+                                                      (end::<fixnum> -1))
+   (return (Scm_UVectorArgMinMax v TRUE start end)))
+ )
+
+;;-------------------------------------------------------------
+;; Matrix kernels
+;;
+
+;; These are used by gauche.array (matrix.scm) for matrices backed by
+;; uvectors.  A matrix is given as the backing storage, the offset and
+;; the coefficient vector of an array.  They return #f if the kernel
+;; can't handle the arguments, and the caller should use the generic code.
+(inline-stub
+ (define-cproc %uvector-matrix-mul! (r::<uvector> roff::<fixnum> rcoef
+                                     a::<uvector> aoff::<fixnum> acoef
+                                     b::<uvector> boff::<fixnum> bcoef
+                                     n::<fixnum> m::<fixnum> p::<fixnum>)
+   (SCM_UVECTOR_CHECK_MUTABLE r)
+   (return (Scm_UVectorMatrixMul (SCM_OBJ r) roff rcoef
+                                 (SCM_OBJ a) aoff acoef
+                                 (SCM_OBJ b) boff bcoef
+                                 n m p)))
+
+ (define-cproc %uvector-matrix-row-echelon! (v::<uvector> off::<fixnum> coef
+                                             n::<fixnum> m::<fixnum>)
+   (SCM_UVECTOR_CHECK_MUTABLE v)
+   (return (Scm_UVectorMatrixRowEchelon (SCM_OBJ v) off coef n m)))
+
+ (define-cproc %uvector-matrix-solve-left-identity! (v::<uvector>
+                                                     off::<fixnum> coef
+                                                     n::<fixnum> m::<fixnum>)
+   (SCM_UVECTOR_CHECK_MUTABLE v)
+   (return (Scm_UVectorMatrixSolveLeftIdentity (SCM_OBJ v) off coef n m)))
+ )
+
 ;;-------------------------------------------------------------
 ;; special coercers (most sequence methods are in uvlib.scm.tmpl
 ;;
@@ -0,0 +1,423 @@
+;;;
+;;; control.green-thread - green threads
+;;;
+;;;   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; Green threads are lightweight threads multiplexed on an OS thread.
+;; Each green thread runs on a fiber (see make-fiber), which costs a small
+;; VM stack segment instead of a full VM and C stack of an OS thread.
+;;
+;; A scheduler runs in an OS thread, and switches green threads when they
+;; yield, sleep, or wait for I/O.  A green thread waiting for I/O is parked
+;; on the scheduler's selector, so other green threads can run meanwhile.
+;; A green-thread pool runs schedulers in several OS threads; a green
+;; thread stays in the scheduler it is started in, for a fiber can only be
+;; resumed by the VM that started it.
+;;
+;; Fibers don't switch C stacks, so a green thread can't yield from a
+;; procedure called back from C.  Nor can it yield from within another
+;; fiber running in it, such as a generate/fiber body; both signal an
+;; error.  Blocking I/O procedures don't park the green thread by
+;; themselves, either; call green-thread-wait-readable or
+;; green-thread-wait-writable before the operation that may block.
+
+(define-module control.green-thread
+  (use gauche.threads)
+  (use gauche.selector)
+  (use data.queue)
+  (use data.heap)
+  (export <green-thread> make-green-thread green-thread?
+          green-thread-name green-thread-state current-green-thread
+          green-thread-start! green-thread-join!
+          green-thread-yield! green-thread-sleep!
+          green-thread-wait-readable green-thread-wait-writable
+          run-green-threads
+          <green-thread-pool> make-green-thread-pool green-thread-pool?
+          green-thread-pool-spawn! green-thread-pool-shutdown!))
+(select-module control.green-thread)
+
+;; State is one of new, runnable, running, blocked, or terminated.
+(define-record-type <green-thread> %make-green-thread green-thread?
+  (name      green-thread-name)
+  (thunk     gt-thunk gt-thunk-set!)
+  (fiber     gt-fiber gt-fiber-set!)
+  (scheduler gt-scheduler gt-scheduler-set!)
+  (state     green-thread-state gt-state-set!)
+  (result    gt-result gt-result-set!)      ; list of values
+  (exception gt-exception gt-exception-set!)
+  (waiters   gt-waiters gt-waiters-set!)    ; ((green-thread . token) ...)
+  (token     gt-token gt-token-set!)        ; what we're waiting for, or #f
+  (wakeup    gt-wakeup gt-wakeup-set!)      ; value given at wakeup
+  (lock      gt-lock gt-lock-set!))         ; (mutex . cv) for joiners in
+                                            ;  other OS threads, or #f.
+                                            ;  If set, the mutex also guards
+                                            ;  state change to 'terminated
+                                            ;  and waiters.
+
+(define (make-green-thread thunk :optional (name #f))
+  (assume-type thunk <procedure>)
+  (%make-green-thread name thunk #f #f 'new #f #f '() #f #f #f))
+
+;; One scheduler per OS thread.
+(define-record-type <scheduler> %make-scheduler #f
+  (runq     scheduler-runq)                 ; <queue> of green threads
+  (timers   scheduler-timers)               ; heap of (time gt . token)
+  (selector scheduler-selector)
+  (current  scheduler-current scheduler-current-set!)
+  (nlive    scheduler-nlive scheduler-nlive-set!)  ; # of unfinished threads
+  (nio      scheduler-nio scheduler-nio-set!)      ; # of threads waiting I/O
+  (inbox    scheduler-inbox)                ; <mtqueue> or #f (see pool)
+  (wakeup   scheduler-wakeup)               ; (in . out) pipe or #f
+  (shutdown scheduler-shutdown? scheduler-shutdown-set!))
+
+(define (make-scheduler pooled?)
+  (%make-scheduler (make-queue)
+                   (make-binary-heap :key car)
+                   (make <selector>)
+                   #f 0 0
+                   (and pooled? (make-mtqueue))
+                   (and pooled? (receive (in out) (sys-pipe) (cons in out)))
+                   #f))
+
+(define *scheduler* (make-thread-local #f 'green-thread-scheduler))
+
+(define (current-green-thread)
+  (and-let1 s (tlref *scheduler*)
+    (scheduler-current s)))
+
+(define %fiber-yieldable? (with-module gauche.internal %fiber-yieldable?))
+
+;; Returns the current green thread, after making sure it can switch.
+;; fiber-yield switches out of the innermost fiber, which isn't the green
+;; thread's if we're in a nested fiber (e.g. a generate/fiber body); nor
+;; can it yield from a C callback or reset.  We check it before changing
+;; the state of the green thread.
+(define (%current who)
+  (rlet1 gt (or (current-green-thread)
+                (errorf "~a called outside of a green thread" who))
+    (%check-switchable who gt)))
+
+(define (%check-switchable who gt)
+  (unless (%fiber-yieldable? (gt-fiber gt))
+    (errorf "~a can't switch green threads from within another fiber, \
+             a C callback or reset: ~s" who gt)))
+
+(define (now)
+  (receive (s ns) (sys-clock-gettime-monotonic)
+    (if s
+      (+ s (* ns 1e-9))
+      (receive (s us) (sys-gettimeofday) (+ s (* us 1e-6))))))
+
+;;
+;; Switching
+;;
+
+;; Suspend the current green thread GT until somebody calls wake! with
+;; the same TOKEN.  Returns the value given to wake!.
+(define (park! gt token)
+  (gt-token-set! gt token)
+  (gt-state-set! gt 'blocked)
+  (fiber-yield)
+  (rlet1 v (gt-wakeup gt)
+    (gt-wakeup-set! gt #f)))
+
+;; Make GT runnable if it still waits for TOKEN.  A stale token (e.g. of a
+;; timer entry whose wait is already satisfied by I/O) is ignored.
+(define (wake! gt token val)
+  (when (and token (eq? (gt-token gt) token))
+    (gt-token-set! gt #f)
+    (gt-wakeup-set! gt val)
+    (gt-state-set! gt 'runnable)
+    (enqueue! (scheduler-runq (gt-scheduler gt)) gt)))
+
+(define (%start! s gt)
+  (let1 thunk (gt-thunk gt)
+    (gt-fiber-set! gt (make-fiber
+                       (^[] (receive r (thunk) (gt-result-set! gt r)))))
+    (gt-thunk-set! gt #f)
+    (gt-scheduler-set! gt s)
+    (gt-state-set! gt 'runnable)
+    (scheduler-nlive-set! s (+ (scheduler-nlive s) 1))
+    (enqueue! (scheduler-runq s) gt)))
+
+(define (terminate! s gt)
+  (define (finish!)
+    (gt-state-set! gt 'terminated)
+    (begin0 (gt-waiters gt)
+      (gt-waiters-set! gt '())))
+  (gt-fiber-set! gt #f)
+  (scheduler-nlive-set! s (- (scheduler-nlive s) 1))
+  (let1 waiters (if-let1 lock (gt-lock gt)
+                  (with-locking-mutex (car lock)
+                    (^[] (begin0 (finish!)
+                           (condition-variable-broadcast! (cdr lock)))))
+                  (finish!))
+    ;; A waiter in other scheduler is woken through its inbox.
+    (dolist [w waiters]
+      (let1 ws (gt-scheduler (car w))
+        (if (eq? ws s)
+          (wake! (car w) (cdr w) #t)
+          (post! ws (cons 'wake w)))))))
+
+(define (run-one! s gt)
+  (let1 f (gt-fiber gt)
+    (scheduler-current-set! s gt)
+    (gt-state-set! gt 'running)
+    ;; An error escaping from the fiber finishes it.
+    (guard (e [else (gt-exception-set! gt e)])
+      (fiber-resume f))
+    (scheduler-current-set! s #f)
+    (when (eq? (fiber-state f) 'done)
+      (terminate! s gt))))
+
+;; Handle messages posted from other OS threads: a green thread to start,
+;; (wake <green-thread> . <token>) to resume a joiner, or shutdown.
+(define (process-inbox! s)
+  (and-let1 inbox (scheduler-inbox s)
+    (dolist [msg (dequeue-all! inbox)]
+      (cond [(eq? msg 'shutdown) (scheduler-shutdown-set! s #t)]
+            [(pair? msg) (wake! (cadr msg) (cddr msg) #t)]
+            [else (%start! s msg)]))))
+
+(define (fire-timers! s)
+  (let ([timers (scheduler-timers s)]
+        [t (now)])
+    (let loop ()
+      (unless (binary-heap-empty? timers)
+        (let1 e (binary-heap-find-min timers)
+          (when (<= (car e) t)
+            (binary-heap-pop-min! timers)
+            (wake! (cadr e) (cddr e) #f)
+            (loop)))))))
+
+;; Wait until some green thread becomes runnable.
+(define (wait-events! s)
+  (let* ([timers (scheduler-timers s)]
+         [timeout (cond [(not (queue-empty? (scheduler-runq s))) 0]
+                        [(binary-heap-empty? timers) #f]
+                        [else (max 0 (- (car (binary-heap-find-min timers))
+                                        (now)))])])
+    (when (and (not timeout)
+               (zero? (scheduler-nio s))
+               (not (scheduler-inbox s)))
+      (error "all green threads are blocked"))
+    (unless (and (eqv? timeout 0)
+                 (zero? (scheduler-nio s))
+                 (not (scheduler-inbox s)))
+      (selector-select (scheduler-selector s)
+                       (and timeout (round->exact (* timeout 1e6)))))
+    (fire-timers! s)))
+
+(define (scheduler-loop! s done?)
+  (let loop ()
+    (process-inbox! s)
+    (unless (done?)
+      ;; Run the threads that are runnable at this point, then check
+      ;; I/O and timers, so that busy threads won't starve waiting ones.
+      (let1 q (scheduler-runq s)
+        (dotimes [(queue-length q)]
+          (run-one! s (dequeue! q))))
+      (unless (done?)
+        (wait-events! s)
+        (loop)))))
+
+;;
+;; API
+;;
+
+(define (green-thread-start! gt)
+  (assume-type gt <green-thread>)
+  (let1 s (or (tlref *scheduler*)
+              (error "no green-thread scheduler is running in this thread:"
+                     gt))
+    (unless (eq? (green-thread-state gt) 'new)
+      (error "green thread is already started:" gt))
+    (%start! s gt)
+    gt))
+
+(define (green-thread-yield!)
+  (let* ([gt (%current 'green-thread-yield!)]
+         [token (list 'yield)])
+    (gt-token-set! gt token)
+    (wake! gt token #t)
+    (fiber-yield)
+    (undefined)))
+
+(define (green-thread-sleep! seconds)
+  (let* ([gt (%current 'green-thread-sleep!)]
+         [token (list 'sleep)])
+    (binary-heap-push! (scheduler-timers (gt-scheduler gt))
+                       (cons* (+ (now) seconds) gt token))
+    (park! gt token)
+    (undefined)))
+
+;; Returns #t when PORT-OR-FD is ready, #f on timeout.
+(define (wait-io who port-or-fd flag timeout)
+  (let* ([gt (%current who)]
+         [s (gt-scheduler gt)]
+         [sel (scheduler-selector s)]
+         [token (list flag)]
+         [handler (^ _ (wake! gt token #t))])
+    (selector-add! sel port-or-fd handler (list flag))
+    (when timeout
+      (binary-heap-push! (scheduler-timers s)
+                         (cons* (+ (now) timeout) gt token)))
+    (scheduler-nio-set! s (+ (scheduler-nio s) 1))
+    ;; NB: We can't use unwind-protect here, for its 'after' handler
+    ;; would run every time the fiber yields.
+    (rlet1 r (park! gt token)
+      (selector-delete! sel port-or-fd handler (list flag))
+      (scheduler-nio-set! s (- (scheduler-nio s) 1)))))
+
+(define (green-thread-wait-readable port-or-fd :optional (timeout #f))
+  (wait-io 'green-thread-wait-readable port-or-fd 'r timeout))
+
+(define (green-thread-wait-writable port-or-fd :optional (timeout #f))
+  (wait-io 'green-thread-wait-writable port-or-fd 'w timeout))
+
+(define (green-thread-join! gt)
+  (assume-type gt <green-thread>)
+  (let ([me (current-green-thread)]
+        [lock (gt-lock gt)])
+    ;; Register ME as a waiter of GT, and park until GT terminates.
+    ;; Returns without parking if GT has already terminated.
+    (define (park-join!)
+      (let1 token (list 'join)
+        (define (register!)
+          (and (not (eq? (green-thread-state gt) 'terminated))
+               (begin (gt-waiters-set! gt (acons me token (gt-waiters gt)))
+                      #t)))
+        (when (if lock
+                (with-locking-mutex (car lock) register!)
+                (register!))
+          (park! me token))))
+    (cond
+     [(eq? (green-thread-state gt) 'terminated)]
+     [(and (eq? (green-thread-state gt) 'new) (not lock))
+      (error "green thread isn't started:" gt)]
+     [(and me (eq? (gt-scheduler me) (gt-scheduler gt)))
+      (when (eq? me gt)
+        (error "green thread can't join itself:" gt))
+      (%check-switchable 'green-thread-join! me)
+      (park-join!)]
+     [(and me lock (scheduler-inbox (gt-scheduler me)))
+      ;; Joining from a green thread of another pool worker.  We park it,
+      ;; so that the worker can run other green threads; GT's scheduler
+      ;; wakes us through our inbox when GT terminates.
+      (%check-switchable 'green-thread-join! me)
+      (park-join!)]
+     [lock
+      ;; Joining from another OS thread.  This blocks the OS thread.
+      (with-locking-mutex (car lock)
+        (^[] (until (eq? (green-thread-state gt) 'terminated)
+               (mutex-unlock! (car lock) (cdr lock))
+               (mutex-lock! (car lock)))))]
+     [else
+      (error "green thread of other scheduler can't be joined:" gt)])
+    (if-let1 e (gt-exception gt)
+      (raise e)
+      (apply values (or (gt-result gt) '())))))
+
+;; Run THUNK as a green thread, and run the scheduler in the current
+;; OS thread until all the green threads finish.
+;; Returns the result of THUNK.
+(define (run-green-threads thunk)
+  (when (tlref *scheduler*)
+    (error "green-thread scheduler is already running in this thread"))
+  (let ([s (make-scheduler #f)]
+        [main (make-green-thread thunk 'main)])
+    (tlset! *scheduler* s)
+    (unwind-protect
+        (begin
+          (%start! s main)
+          (scheduler-loop! s (^[] (zero? (scheduler-nlive s)))))
+      (tlset! *scheduler* #f))
+    (green-thread-join! main)))
+
+;;
+;; Green thread pool
+;;
+;;  Each worker is an OS thread running a scheduler.  Green threads are
+;;  assigned to workers in round-robin.  Other OS threads post a green
+;;  thread to the worker's inbox, and wake up the worker by writing a byte
+;;  to its pipe, on which the worker's selector is waiting.
+;;
+
+(define-record-type <green-thread-pool> %make-pool green-thread-pool?
+  (workers pool-workers)                ; vector of (scheduler . thread)
+  (next    pool-next pool-next-set!))
+
+(define (worker-thunk s)
+  (^[]
+    (let1 in (car (scheduler-wakeup s))
+      (tlset! *scheduler* s)
+      (selector-add! (scheduler-selector s) in
+                     (^[p _] (let loop ()
+                               (read-byte p)
+                               (when (byte-ready? p) (loop))))
+                     '(r))
+      (scheduler-loop! s (^[] (and (scheduler-shutdown? s)
+                                   (zero? (scheduler-nlive s))))))))
+
+(define (make-green-thread-pool :optional (size (sys-available-processors)))
+  (assume (and (exact-integer? size) (positive? size)))
+  (%make-pool (rlet1 v (make-vector size)
+                (dotimes [i size]
+                  (let1 s (make-scheduler #t)
+                    (vector-set! v i (cons s (thread-start!
+                                              (make-thread (worker-thunk s))))))))
+              0))
+
+(define (post! s msg)
+  (enqueue! (scheduler-inbox s) msg)
+  (let1 out (cdr (scheduler-wakeup s))
+    (write-byte 0 out)
+    (flush out)))
+
+(define (green-thread-pool-spawn! pool thunk :optional (name #f))
+  (assume-type pool <green-thread-pool>)
+  (let* ([workers (pool-workers pool)]
+         [k (pool-next pool)]
+         [gt (make-green-thread thunk name)])
+    (pool-next-set! pool (modulo (+ k 1) (vector-length workers)))
+    (gt-lock-set! gt (cons (make-mutex) (make-condition-variable)))
+    ;; Set the scheduler now, so that green threads in the same worker
+    ;; can join GT before it is started.
+    (gt-scheduler-set! gt (car (vector-ref workers k)))
+    (post! (car (vector-ref workers k)) gt)
+    gt))
+
+;; Waits for all the green threads in the pool to finish, then
+;; terminates the workers.
+(define (green-thread-pool-shutdown! pool)
+  (assume-type pool <green-thread-pool>)
+  (vector-for-each (^w (post! (car w) 'shutdown)) (pool-workers pool))
+  (vector-for-each (^w (thread-join! (cdr w))) (pool-workers pool)))
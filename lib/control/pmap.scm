@@ -41,7 +41,7 @@
   (use srfi.19)
   (use control.thread-pool)
   (use control.job)
-  (export pmap pfind pany
+  (export pmap pfind pany psort psort!
           sequential-mapper
           make-static-mapper
           make-pool-mapper
@@ -353,3 +353,38 @@
                     (values #t r)
                     (values #f #f)))
               coll))
+;;;
+;;; Parallel sort
+;;;
+
+;; We split the vector into slices and stable-sort each slice concurrently.
+;; The builtin stable sorter detects presorted runs, so the final pass
+;; over the whole vector just merges the sorted slices.
+
+(define *psort-min-slice* 10000)        ; don't bother splitting smaller ones
+
+(define %vector-stable-sort! (with-module gauche.internal %vector-stable-sort!))
+
+(define (psort! seq :optional (cmp #f) :key (mapper (default-mapper)))
+  (assume-type seq <vector>)
+  (let* ([less? (cond [(not cmp) #f]
+                      [(comparator? cmp)
+                       (^[a b] (< (comparator-compare cmp a b) 0))]
+                      [else cmp])]
+         [len (vector-length seq)]
+         [nslices (min (sys-available-processors)
+                       (quotient len *psort-min-slice*))])
+    (when (> nslices 1)
+      (let1 bounds (map (^i (quotient (* i len) nslices)) (iota (+ nslices 1)))
+        (run-map mapper
+                 (^[range]
+                   (%vector-stable-sort! seq (car range) (cdr range) less?))
+                 (map cons bounds (cdr bounds)))))
+    (%vector-stable-sort! seq 0 len less?)
+    seq))
+
+(define (psort seq :optional (cmp #f) :key (mapper (default-mapper)))
+  (cond [(vector? seq) (psort! (vector-copy seq) cmp :mapper mapper)]
+        [(list? seq)
+         (vector->list (psort! (list->vector seq) cmp :mapper mapper))]
+        [else (error "list or vector required, but got:" seq)]))
@@ -0,0 +1,1318 @@
+;;;
+;;; dbm/btree - B+-tree dbm on a memory-mapped file
+;;;
+;;;   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+
+(define-module dbm.btree
+  (extend dbm)
+  (use gauche.threads)
+  (use gauche.uvector)
+  (use gauche.record)
+  (use gauche.generator)
+  (use gauche.fcntl)
+  (use binary.io)
+  (use data.queue)
+  (use file.util)
+  (export <btree> btree-transaction btree-bulk-load!
+          btree-range-fold btree-range-for-each)
+  )
+(select-module dbm.btree)
+
+;;; Btree keeps the database in a single file, as a copy-on-write
+;;; B+-tree of fixed-size pages.  Pages are never modified once they
+;;; are made reachable from a committed root; an update writes new
+;;; copies of the nodes on the path from the root to the affected leaf,
+;;; then switches to the new root by writing a meta page.
+;;;
+;;; Page 0 and page 1 are meta pages, used alternately by transactions
+;;; with even and odd ids.  Each holds the transaction id, the root
+;;; page, the number of pages, the number of entries and a checksum.
+;;; On open, the valid meta page with the larger transaction id wins,
+;;; so a crash while writing the meta page leaves the previous state.
+;;;
+;;; Every other page begins with a 16-byte header (type, entry count,
+;;; and the id of the transaction that wrote it) and ends with the
+;;; same transaction id.  Leaf entries are keys with inline values, or
+;;; references to a run of overflow pages for large values.  Branch
+;;; entries are the lowest key of a subtree and its page number; the
+;;; first key of a branch node is never looked at.  Keys are ordered
+;;; bytewise, as string<? does.
+;;;
+;;; Readers map the file read-only and parse pages directly from the
+;;; mapping; parsed nodes are cached by page number, and the cache is
+;;; validated against the transaction id in the page.  A reader works on
+;;; a snapshot---the root of some committed transaction---so it never
+;;; sees a half-done update, and never blocks the writer.
+;;;
+;;; Pages that are replaced by a transaction are put in the free list
+;;; tagged with that transaction id.  The writer reuses a free page only
+;;; when no snapshot in use is older than the tag.
+;;;
+;;; Snapshots used by traversals are registered in a reader table shared
+;;; by processes: a snapshot of transaction T is a read lock (fcntl) on
+;;; the byte at *reader-lock-base* + T of the file, which is far beyond
+;;; its end.  The writer finds the oldest one with F_GETLK.  Since fcntl
+;;; locks are per process, the handles in a process count their
+;;; registrations in the open-file record, and the writer looks at it for
+;;; the handles in its own process.  A reader checks that the snapshot is
+;;; still the latest after taking the lock, so that the writer can't have
+;;; picked pages of it based on an older view of the table.
+;;;
+;;; Point lookups don't register their snapshots, to avoid the system
+;;; calls.  Instead, a reader checks that the header and trailer ids of
+;;; each page match and aren't newer than its snapshot, before and after
+;;; reading the page, and retries with the latest snapshot if the page is
+;;; overwritten.  The check also catches the traversals on the platforms
+;;; without fcntl, which signal an error then.
+;;;
+;;; The free list is saved in a chain of pages when the database is
+;;; closed.  If a writer process dies, the next writer rebuilds it by
+;;; scanning the pages reachable from the root.
+;;;
+;;; There can be only one writer at a time; it is enforced by fcntl lock
+;;; on the byte at *writer-lock-offset* across processes, and by a
+;;; registry of open files within a process.
+;;; Since closing any file descriptor of the database file releases the
+;;; process's fcntl lock, all handles of the same file in a process share
+;;; one input port, and we avoid opening another descriptor of a file
+;;; that has a handle open.
+
+(define-constant *btree-magic*   "GBTR")
+(define-constant *btree-version* 1)
+(define-constant *meta-size*     64)
+
+;; Offsets of the bytes locked by the writer and by the readers.
+(define-constant *writer-lock-offset* (expt 2 40))
+(define-constant *reader-lock-base* (+ (expt 2 40) 1))
+
+;; Page types
+(define-constant *leaf-page*     1)
+(define-constant *branch-page*   2)
+(define-constant *overflow-page* 3)
+(define-constant *freelist-page* 4)
+
+;; Meta flags
+(define-constant *freelist-saved* 1)
+
+;; Max number of parsed nodes to keep in the cache
+(define-constant *cache-limit* 16384)
+
+;; Max number of retries of a lookup when a concurrent writer overwrote
+;; the pages of the snapshot.
+(define-constant *max-retry* 10)
+
+(define-condition-type <btree-stale-snapshot> <error> btree-stale-snapshot?)
+
+(define-class <btree-meta> (<dbm-meta>)
+  ())
+
+(define-class <btree> (<dbm>)
+  ((page-size :init-keyword :page-size :init-value 4096)
+   (sync      :init-keyword :sync :init-value #f)
+   (closed?   :init-value #f)
+   ;; internal
+   (file      :init-value #f)   ; open-file record, shared by the handles
+   (in        :init-value #f)   ; input port the file is mapped from
+   (out       :init-value #f)   ; output port to write pages (writer only)
+   (unflushed? :init-value #f)  ; pages written to OUT aren't flushed yet
+   (region    :init-value #f)   ; current memory region of the file
+   (region-size :init-value 0)
+   (file-size :init-value 0)    ; writer only
+   (snapshot  :init-value #f)   ; latest committed snapshot
+   (readers   :init-form (make-hash-table 'eqv?)) ; txn -> # of snapshots
+   (rlock     :init-form (make-mutex)) ; protects snapshot, readers, region
+   (wlock     :init-form (make-mutex)) ; serializes writers
+   (cache     :init-form (make-hash-table 'eqv?)) ; pgno -> node
+   (clock     :init-form (make-mutex)) ; protects cache
+   ;; The pending transaction (writer only).  The tree is made of
+   ;; page numbers of committed nodes and node records of new ones.
+   (owner     :init-value #f)   ; thread running the pending transaction
+   (root      :init-value 0)    ; page number, node, or 0 if empty
+   (count     :init-value 0)
+   (npages    :init-value 2)
+   (free      :init-form (make-queue)) ; (pgno . txn), older first
+   (retired   :init-value '())  ; pages replaced by the pending txn
+   (reused    :init-value '())  ; free list entries taken by the pending txn
+   )
+  :metaclass <btree-meta>)
+
+(define-record-type meta
+  (make-meta page-size txn root npages count flags freelist)
+  meta?
+  (page-size meta-page-size)
+  (txn       meta-txn)
+  (root      meta-root)
+  (npages    meta-npages)
+  (count     meta-count)
+  (flags     meta-flags)
+  (freelist  meta-freelist))
+
+(define-record-type snapshot
+  (make-snapshot txn root count npages region size pending?)
+  snapshot?
+  (txn      snap-txn)
+  (root     snap-root)
+  (count    snap-count)
+  (npages   snap-npages)
+  (region   snap-region snap-region-set!)
+  (size     snap-size snap-size-set!)
+  (pending? snap-pending?))
+
+;; VALS of a leaf are strings or overflow references; VALS of a branch
+;; are page numbers or nodes.  Nodes are never modified.
+(define-record-type node
+  (make-node leaf? keys vals stamp)
+  node?
+  (leaf? node-leaf?)
+  (keys  node-keys)
+  (vals  node-vals)
+  (stamp node-stamp))
+
+(define-record-type ovf
+  (make-ovf page npages size)
+  ovf?
+  (page   ovf-page)
+  (npages ovf-npages)
+  (size   ovf-size))
+
+;;
+;; Open files
+;;
+;;  The handles of the same file in this process share an open-file
+;;  record, keyed by (dev . ino) of the file.  Its input port is closed
+;;  when the last handle is closed, so that the descriptor isn't closed
+;;  while the writer holds the fcntl lock or readers hold theirs.
+;;
+
+(define-record-type open-file
+  (make-open-file key in refs writer readers)
+  open-file?
+  (key     open-file-key)
+  (in      open-file-in)
+  (refs    open-file-refs open-file-refs-set!)
+  (writer  open-file-writer open-file-writer-set!)  ; <btree> or #f
+  (readers open-file-readers))          ; txn -> # of registered snapshots
+
+(define *open-files* (make-hash-table 'equal?))    ; (dev . ino) -> open-file
+(define *open-files-lock* (make-mutex))
+
+(define (with-open-files thunk)
+  (with-locking-mutex *open-files-lock* thunk))
+
+(define (file-key st) (cons (~ st'dev) (~ st'ino)))
+
+;; Returns the open-file record of PATH, or #f.
+;; Must be called with *open-files-lock*.
+(define (registered-file path)
+  (and (file-exists? path)
+       (hash-table-get *open-files* (file-key (sys-stat path)) #f)))
+
+;; Makes DB share the open-file record of its file, creating one if
+;; needed.  Must be called with *open-files-lock*.
+(define (attach-file! db)
+  (let* ([key (file-key (if (~ db'out)
+                          (sys-fstat (~ db'out))
+                          (sys-stat (~ db'path))))]
+         [f (or (hash-table-get *open-files* key #f)
+                (rlet1 f (make-open-file key
+                                         (open-input-file (~ db'path)
+                                                          :element-type :binary)
+                                         0 #f (make-hash-table 'eqv?))
+                  (hash-table-put! *open-files* key f)))])
+    (open-file-refs-set! f (+ (open-file-refs f) 1))
+    (when (~ db'out) (open-file-writer-set! f db))
+    (set! (~ db'file) f)
+    (set! (~ db'in) (open-file-in f))))
+
+;; Must be called with *open-files-lock*.
+(define (detach-file! db)
+  (and-let1 f (~ db'file)
+    (set! (~ db'file) #f)
+    (when (eq? (open-file-writer f) db) (open-file-writer-set! f #f))
+    (open-file-refs-set! f (- (open-file-refs f) 1))
+    (when (zero? (open-file-refs f))
+      (hash-table-delete! *open-files* (open-file-key f))
+      (close-input-port (open-file-in f)))))
+
+;;
+;; Opening and closing
+;;
+
+(define-method dbm-open ((self <btree>))
+  (next-method)
+  (unless (slot-bound? self 'path)
+    (error "path must be set to open btree database"))
+  (let1 m (with-open-files (^[] (open-file! self)))
+    (set! (~ self'page-size) (meta-page-size m))
+    (remap! self)
+    (if (~ self'out)
+      (open-writer! self m)
+      (reader-snapshot self))
+    self))
+
+;; Opens the file and returns the meta record.
+;; Must be called with *open-files-lock*.
+(define (open-file! self)
+  (let ([path   (~ self'path)]
+        [rwmode (~ self'rw-mode)])
+    (guard (e [else
+               (when (~ self'out)
+                 (close-output-port (~ self'out))
+                 (set! (~ self'out) #f))
+               (detach-file! self)
+               (raise e)])
+      (case rwmode
+        [(:read)
+         (unless (%btree-file? path)
+           (errorf "dbm-open: no btree database ~a" path))]
+        [(:write :create)
+         ;; We check it before opening the output port, for closing it
+         ;; would release the lock of the other writer.
+         (when (and-let1 f (registered-file path) (open-file-writer f))
+           (errorf "dbm-open: btree database ~a is already opened for \
+                    writing in this process" path))
+         (set! (~ self'out)
+               (open-output-file path :if-exists :overwrite
+                                 :mode (~ self'file-mode)
+                                 :element-type :binary))
+         (lock-writer! self)
+         (when (or (eq? rwmode :create)
+                   (zero? (~ (sys-fstat (~ self'out))'size)))
+           (btree-initialize! self))])
+      (attach-file! self)
+      (or (find-meta (~ self'in))
+          (errorf "dbm-open: broken btree database ~a" path)))))
+
+(define-method dbm-close ((self <btree>))
+  (unless (~ self'closed?)
+    (when (~ self'out)
+      (when (eq? (~ self'owner) (current-thread))
+        (error "btree: can't close the database within a transaction:" self))
+      (with-locking-mutex (~ self'wlock)
+        (^[]
+          (commit! self #t)
+          (sys-fsync (~ self'out))
+          (close-output-port (~ self'out)))))
+    (with-open-files (^[] (detach-file! self)))
+    (set! (~ self'region) #f)
+    (set! (~ self'snapshot) #f)
+    (hash-table-clear! (~ self'cache))
+    (set! (~ self'closed?) #t))
+  #t)
+
+(define-method dbm-closed? ((self <btree>))
+  (~ self'closed?))
+
+;;
+;; dbm protocols
+;;
+
+(define-method dbm-put! ((self <btree>) key value)
+  (next-method)
+  (let ([k (btree-key self key)]
+        [v (%dbm-v2s self value)])
+    (unless (string? v)
+      (error "btree: value must be a string, but got:" v))
+    (with-pending self (^[] (tree-put! self k v)))))
+
+(define-method dbm-get ((self <btree>) key . args)
+  (next-method)
+  (let* ([k (btree-key self key)]
+         [v (call-with-retry self
+              (^[snap] (and-let1 v (lookup self snap k)
+                         (value-string self snap v))))])
+    (cond [v (%dbm-s2v self v)]
+          [(pair? args) (car args)]
+          [else (errorf "btree: no data for key ~s in database ~s"
+                        key self)])))
+
+(define-method dbm-exists? ((self <btree>) key)
+  (next-method)
+  (let1 k (btree-key self key)
+    (boolean (call-with-retry self (cut lookup self <> k)))))
+
+(define-method dbm-delete! ((self <btree>) key)
+  (next-method)
+  (let1 k (btree-key self key)
+    (with-pending self (^[] (tree-delete! self k)))))
+
+(define-method dbm-fold ((self <btree>) proc seed)
+  (next-method)
+  (fold-range self #f #f proc seed))
+
+(define-method dbm-db-exists? ((class <btree-meta>) name)
+  (btree-file? name))
+
+(define-method dbm-db-remove ((class <btree-meta>) name)
+  (unless (btree-file? name)
+    (error "given path is not a btree database:" name))
+  (sys-unlink name))
+
+(define-method dbm-db-copy ((class <btree-meta>) from to)
+  (with-open-files
+    (^[]
+      (unless (%btree-file? from)
+        (error "source path is not a btree database:" from))
+      ;; Copying opens and closes the file, which would release the locks.
+      (when (and-let1 f (registered-file from)
+              (or (open-file-writer f)
+                  (positive? (hash-table-num-entries (open-file-readers f)))))
+        (error "btree database is being written or traversed in this \
+                process:" from))
+      (copy-file from to :safe #t))))
+
+(define-method dbm-db-move ((class <btree-meta>) from to)
+  (unless (btree-file? from)
+    (error "source path is not a btree database:" from))
+  (move-file from to))
+
+;;
+;; Btree-specific procedures
+;;
+
+;; Runs THUNK as one transaction.  Updates in THUNK are visible to the
+;; calling thread right away, and to others when THUNK returns.  If THUNK
+;; exits abnormally, they are discarded.
+(define (btree-transaction db thunk)
+  (check-writable db 'btree-transaction)
+  (with-pending db thunk))
+
+;; SOURCE is a list or a generator of (key . value), in ascending order
+;; of keys.  If DB is empty, the tree is built bottom up with full pages.
+(define (btree-bulk-load! db source)
+  (check-writable db 'btree-bulk-load!)
+  (let1 gen (if (procedure? source) source (list->generator source))
+    (with-pending db
+      (^[]
+        (if (eqv? (~ db'root) 0)
+          (bulk-build! db gen)
+          (generator-for-each
+           (^p (tree-put! db (btree-key db (car p)) (%dbm-v2s db (cdr p))))
+           gen))))))
+
+;; Folds over the entries whose keys are at least START and less than END,
+;; in ascending order of keys.  #f means unbounded.
+(define (btree-range-fold db start end proc seed)
+  (when (dbm-closed? db)
+    (errorf "btree-range-fold: dbm already closed: ~s" db))
+  (fold-range db (and start (btree-key db start)) (and end (btree-key db end))
+              proc seed))
+
+(define (btree-range-for-each db start end proc)
+  (btree-range-fold db start end (^[k v r] (proc k v)) #f))
+
+;;
+;; Snapshots
+;;
+
+;; Calls PROC with a snapshot of DB.  The thread running the pending
+;; transaction sees its own changes.  Snapshots of the writer are
+;; registered while PROC is running, so that the pages they can reach
+;; won't be reused.  Snapshots of a read-only DB are registered in the
+;; reader table only if REGISTER? is true.
+(define (call-with-snapshot db proc :optional (register? #f))
+  (cond [(eq? (~ db'owner) (current-thread)) (proc (pending-snapshot db))]
+        [(~ db'out)
+         (let1 snap #f
+           (dynamic-wind
+             (^[] (set! snap (acquire-snapshot! db snap)))
+             (^[] (proc snap))
+             (^[] (release-snapshot! db snap))))]
+        [register?
+         (let1 snap #f
+           (dynamic-wind
+             (^[] (set! snap (register-snapshot! db snap)))
+             (^[] (proc snap))
+             (^[] (unregister-reader! db (snap-txn snap)))))]
+        [else (proc (reader-snapshot db))]))
+
+(define (call-with-retry db proc)
+  (let loop ([n 0])
+    (guard (e [(and (btree-stale-snapshot? e) (< n *max-retry*))
+               (loop (+ n 1))])
+      (call-with-snapshot db proc))))
+
+(define (acquire-snapshot! db snap)
+  (with-locking-mutex (~ db'rlock)
+    (^[]
+      (rlet1 s (or snap (~ db'snapshot))
+        (hash-table-update! (~ db'readers) (snap-txn s) (cut + <> 1) 0)))))
+
+(define (release-snapshot! db snap)
+  (with-locking-mutex (~ db'rlock)
+    (^[]
+      (let* ([tab (~ db'readers)]
+             [n (- (hash-table-get tab (snap-txn snap)) 1)])
+        (if (zero? n)
+          (hash-table-delete! tab (snap-txn snap))
+          (hash-table-put! tab (snap-txn snap) n))))))
+
+(define (pending-snapshot db)
+  (make-snapshot (+ (snap-txn (~ db'snapshot)) 1)
+                 (~ db'root) (~ db'count) (~ db'npages)
+                 (~ db'region) (~ db'region-size) #t))
+
+(define (meta->snapshot db m)
+  (make-snapshot (meta-txn m) (meta-root m) (meta-count m) (meta-npages m)
+                 (~ db'region) (~ db'region-size) #f))
+
+;; The latest snapshot of a read-only DB.  We only look at the
+;; transaction ids of the meta pages unless they've changed.
+(define (reader-snapshot db)
+  (with-locking-mutex (~ db'rlock)
+    (^[]
+      (let* ([s (~ db'snapshot)]
+             [psize (~ db'page-size)]
+             [v0 (make-view-uvector (~ db'region) <u8vector> *meta-size* 0 #t)]
+             [v1 (make-view-uvector (~ db'region) <u8vector> *meta-size*
+                                    psize #t)])
+        (if (and s (= (latest-txn v0 v1) (snap-txn s)))
+          s
+          (let1 m (or (latest-meta (decode-meta v0) (decode-meta v1))
+                      (errorf "btree: broken meta pages in ~a" (~ db'path)))
+            (when (> (* (meta-npages m) psize) (~ db'region-size))
+              (remap! db))
+            (rlet1 s (meta->snapshot db m)
+              (set! (~ db'snapshot) s))))))))
+
+;; The larger transaction id of the meta pages V0 and V1.  Only the
+;; writer's meta page may be broken, and it has the larger id if intact.
+(define (latest-txn v0 v1)
+  (max (get-u64le v0 16) (get-u64le v1 16)))
+
+;; Returns the latest snapshot of a read-only DB, registered in the
+;; reader table.  When re-entered, SNAP is registered again.
+(define (register-snapshot! db snap)
+  (if snap
+    (begin (register-reader! db (snap-txn snap)) snap)
+    (let loop ()
+      (let1 s (reader-snapshot db)
+        (register-reader! db (snap-txn s))
+        ;; If a commit has come in before our registration, the writer
+        ;; may not have seen it; try again with the new snapshot.
+        (if (= (snap-txn s) (snap-txn (reader-snapshot db)))
+          s
+          (begin (unregister-reader! db (snap-txn s)) (loop)))))))
+
+(define (stale-snapshot db)
+  (error <btree-stale-snapshot>
+         "btree: snapshot is overwritten by a concurrent writer:" (~ db'path)))
+
+;;
+;; Reader table
+;;
+
+(define (register-reader! db txn)
+  (with-open-files
+    (^[]
+      (let* ([f (~ db'file)]
+             [tab (open-file-readers f)]
+             [n (hash-table-get tab txn 0)])
+        (when (zero? n)
+          (lock-byte! (open-file-in f) 'read (+ *reader-lock-base* txn)))
+        (hash-table-put! tab txn (+ n 1))))))
+
+(define (unregister-reader! db txn)
+  (with-open-files
+    (^[]
+      (and-let* ([f (~ db'file)]
+                 [tab (open-file-readers f)]
+                 [n (hash-table-get tab txn #f)])
+        (if (= n 1)
+          (begin
+            (hash-table-delete! tab txn)
+            (lock-byte! (open-file-in f) 'unlock (+ *reader-lock-base* txn)))
+          (hash-table-put! tab txn (- n 1)))))))
+
+;; TYPE is one of read, write or unlock.  Returns #f if the byte is
+;; locked by another process.
+(define (lock-byte! port type offset)
+  (cond-expand
+   [gauche.sys.fcntl
+    (sys-fcntl port F_SETLK
+               (make <sys-flock>
+                 :type (ecase type
+                         [(read) F_RDLCK] [(write) F_WRLCK] [(unlock) F_UNLCK])
+                 :whence 0 :start offset :len 1))]
+   [else #t]))
+
+;; The oldest transaction before BELOW registered by other processes,
+;; or #f.  F_GETLK tells one of the locks in the range, so we narrow
+;; the range until there's none.
+(define (oldest-reader db below)
+  (cond-expand
+   [gauche.sys.fcntl
+    (let loop ([below below] [found #f])
+      (if (<= below 0)
+        found
+        (let1 fl (make <sys-flock> :type F_WRLCK :whence 0
+                       :start *reader-lock-base* :len below)
+          (sys-fcntl (~ db'out) F_GETLK fl)
+          (if (eqv? (~ fl'type) F_UNLCK)
+            found
+            (let1 txn (- (~ fl'start) *reader-lock-base*)
+              (loop txn txn))))))]
+   [else #f]))
+
+;;
+;; Pages
+;;
+
+(define (remap! db)
+  (let1 size (~ (sys-fstat (~ db'in))'size)
+    (set! (~ db'region) (sys-mmap (~ db'in) PROT_READ MAP_SHARED size))
+    (set! (~ db'region-size) size)))
+
+;; Returns a read-only u8vector of N pages from PGNO as seen in SNAP.
+;; The pending transaction may refer to the pages it has just written
+;; (e.g. by btree-bulk-load!), which may still be in the port buffer,
+;; and may be beyond the current mapping.
+(define (page-view db snap pgno n)
+  (let* ([psize (~ db'page-size)]
+         [end (* (+ pgno n) psize)])
+    (unless (and (>= pgno 2) (<= (+ pgno n) (snap-npages snap)))
+      (stale-snapshot db))
+    (when (and (snap-pending? snap) (~ db'unflushed?))
+      (flush (~ db'out))
+      (set! (~ db'unflushed?) #f))
+    (when (> end (snap-size snap))
+      (unless (snap-pending? snap) (stale-snapshot db))
+      (with-locking-mutex (~ db'rlock) (^[] (remap! db)))
+      (snap-region-set! snap (~ db'region))
+      (snap-size-set! snap (~ db'region-size)))
+    (make-view-uvector (snap-region snap) <u8vector> (* n psize)
+                       (* pgno psize) #t)))
+
+;; Returns the id of the transaction that wrote the pages in VIEW,
+;; after checking they're intact and not newer than SNAP.
+(define (page-stamp db snap view)
+  (let ([h (get-u64le view 8)]
+        [t (get-u64le view (- (u8vector-length view) 8))])
+    (unless (and (= h t) (<= h (snap-txn snap)))
+      (stale-snapshot db))
+    h))
+
+;; A writer in another process may overwrite the pages while we're
+;; reading them.  Like a seqlock reader, we check the stamps of VIEW
+;; again after PROC reads it, and discard the result if they've changed.
+;; An error in PROC on such pages is also taken as staleness.
+(define (read-pages db view stamp proc)
+  (define (intact?)
+    (and (= (get-u64le view 8) stamp)
+         (= (get-u64le view (- (u8vector-length view) 8)) stamp)))
+  (rlet1 r (guard (e [(not (intact?)) (stale-snapshot db)])
+             (proc))
+    (unless (intact?) (stale-snapshot db))))
+
+(define (get-node db snap ref)
+  (if (node? ref) ref (load-node db snap ref)))
+
+(define (load-node db snap pgno)
+  (let* ([view (page-view db snap pgno 1)]
+         [stamp (page-stamp db snap view)]
+         [n (with-locking-mutex (~ db'clock)
+              (^[] (hash-table-get (~ db'cache) pgno #f)))])
+    (if (and n (= (node-stamp n) stamp))
+      n
+      (rlet1 n (read-pages db view stamp (cut parse-node db view stamp))
+        (cache-node! db pgno n)))))
+
+(define (cache-node! db pgno n)
+  (with-locking-mutex (~ db'clock)
+    (^[]
+      (when (>= (hash-table-num-entries (~ db'cache)) *cache-limit*)
+        (hash-table-clear! (~ db'cache)))
+      (hash-table-put! (~ db'cache) pgno n))))
+
+(define (parse-node db view stamp)
+  (let* ([type (get-u8 view 0)]
+         [n (get-u16le view 2)]
+         [keys (make-vector n)]
+         [vals (make-vector n)])
+    (define (key! i pos)
+      (let1 kend (+ pos 2 (get-u16le view pos))
+        (vector-set! keys i (u8vector->string view (+ pos 2) kend))
+        kend))
+    (cond
+     [(eqv? type *leaf-page*)
+      (let loop ([i 0] [pos 16])
+        (when (< i n)
+          (let1 kend (key! i pos)
+            (if (zero? (get-u8 view kend))
+              (let1 vend (+ kend 5 (get-u32le view (+ kend 1)))
+                (vector-set! vals i (u8vector->string view (+ kend 5) vend))
+                (loop (+ i 1) vend))
+              (begin
+                (vector-set! vals i (make-ovf (get-u64le view (+ kend 1))
+                                              (get-u32le view (+ kend 9))
+                                              (get-u32le view (+ kend 13))))
+                (loop (+ i 1) (+ kend 17)))))))
+      (make-node #t keys vals stamp)]
+     [(eqv? type *branch-page*)
+      (let loop ([i 0] [pos 16])
+        (when (< i n)
+          (let1 kend (key! i pos)
+            (vector-set! vals i (get-u64le view kend))
+            (loop (+ i 1) (+ kend 8)))))
+      (make-node #f keys vals stamp)]
+     [else (stale-snapshot db)])))
+
+(define (value-string db snap v)
+  (if (string? v)
+    v
+    (let* ([view (page-view db snap (ovf-page v) (ovf-npages v))]
+           [stamp (page-stamp db snap view)])
+      (read-pages db view stamp
+                  (cut u8vector->string view 16 (+ 16 (ovf-size v)))))))
+
+;;
+;; Sizes
+;;
+
+;; Every entry fits in a quarter of a page, so that splitting a node
+;; that has overflown by one entry always yields two nodes that fit.
+(define (usable-size db) (- (~ db'page-size) 24))
+(define (max-entry-size db) (quotient (usable-size db) 4))
+(define (max-key-size db) (- (max-entry-size db) 19))
+
+(define (inline-value? db ksize v)
+  (and (string? v)
+       (<= (+ 7 ksize (string-size v)) (max-entry-size db))))
+
+(define (entry-size db leaf? k v)
+  (let1 ks (string-size k)
+    (cond [(not leaf?) (+ 10 ks)]
+          [(inline-value? db ks v) (+ 7 ks (string-size v))]
+          [else (+ 19 ks)])))
+
+(define (node-size db n)
+  (let ([keys (node-keys n)] [vals (node-vals n)] [leaf? (node-leaf? n)])
+    (let loop ([i 0] [s 0])
+      (if (= i (vector-length keys))
+        s
+        (loop (+ i 1)
+              (+ s (entry-size db leaf? (vector-ref keys i)
+                               (vector-ref vals i))))))))
+
+(define (btree-key db key)
+  (let1 k (%dbm-k2s db key)
+    (unless (string? k)
+      (error "btree: key must be a string, but got:" k))
+    (when (> (string-size k) (max-key-size db))
+      (errorf "btree: key too long (~a bytes, max ~a bytes): ~,,,,40s"
+              (string-size k) (max-key-size db) k))
+    (if (string-incomplete? k)
+      (or (string-incomplete->complete k) k)
+      k)))
+
+;;
+;; Searching
+;;
+
+;; Index of the first key in KEYS that is not less than K.
+(define (lower-bound keys k)
+  (let loop ([lo 0] [hi (vector-length keys)])
+    (if (< lo hi)
+      (let1 mid (ash (+ lo hi) -1)
+        (if (string<? (vector-ref keys mid) k)
+          (loop (+ mid 1) hi)
+          (loop lo mid)))
+      lo)))
+
+;; Index of the child of a branch node whose subtree may contain K.
+(define (child-index keys k)
+  (let loop ([lo 1] [hi (vector-length keys)])
+    (if (< lo hi)
+      (let1 mid (ash (+ lo hi) -1)
+        (if (string<? k (vector-ref keys mid))
+          (loop lo mid)
+          (loop (+ mid 1) hi)))
+      (- lo 1))))
+
+;; Returns the stored value (a string or an overflow reference) or #f.
+(define (lookup db snap k)
+  (let loop ([ref (snap-root snap)])
+    (and (not (eqv? ref 0))
+         (let* ([n (get-node db snap ref)]
+                [keys (node-keys n)])
+           (if (node-leaf? n)
+             (let1 i (lower-bound keys k)
+               (and (< i (vector-length keys))
+                    (string=? (vector-ref keys i) k)
+                    (vector-ref (node-vals n) i)))
+             (loop (vector-ref (node-vals n) (child-index keys k))))))))
+
+(define (fold-range db lo hi proc seed)
+  (define (walk snap ref seed)          ; returns seed and continue?
+    (let* ([n (get-node db snap ref)]
+           [keys (node-keys n)]
+           [vals (node-vals n)]
+           [len (vector-length keys)])
+      (if (node-leaf? n)
+        (let loop ([i (if lo (lower-bound keys lo) 0)] [seed seed])
+          (cond [(= i len) (values seed #t)]
+                [(and hi (not (string<? (vector-ref keys i) hi)))
+                 (values seed #f)]
+                [else
+                 (loop (+ i 1)
+                       (proc (%dbm-s2k db (vector-ref keys i))
+                             (%dbm-s2v db (value-string db snap
+                                                        (vector-ref vals i)))
+                             seed))]))
+        (let loop ([i (if lo (child-index keys lo) 0)] [seed seed])
+          (cond [(= i len) (values seed #t)]
+                [(and hi (> i 0) (not (string<? (vector-ref keys i) hi)))
+                 (values seed #f)]
+                [else
+                 (receive (seed more?) (walk snap (vector-ref vals i) seed)
+                   (if more? (loop (+ i 1) seed) (values seed #f)))])))))
+  (call-with-snapshot db
+    (^[snap]
+      (if (eqv? (snap-root snap) 0)
+        seed
+        (values-ref (walk snap (snap-root snap) seed) 0)))
+    #t))
+
+;;
+;; Updating
+;;
+
+(define (check-writable db who)
+  (when (dbm-closed? db) (errorf "~a: dbm already closed: ~s" who db))
+  (unless (~ db'out) (errorf "~a: dbm is read only: ~s" who db)))
+
+;; Runs THUNK as a part of the pending transaction.  If we're not in
+;; one, THUNK becomes a transaction by itself.
+(define (with-pending db thunk)
+  (if (eq? (~ db'owner) (current-thread))
+    (thunk)
+    (with-locking-mutex (~ db'wlock)
+      (^[]
+        (let1 done #f
+          (dynamic-wind
+            (^[] (set! (~ db'owner) (current-thread)))
+            (^[] (begin0 (thunk) (commit! db #f) (set! done #t)))
+            (^[] (unless done (abort! db)) (set! (~ db'owner) #f))))))))
+
+(define (retire! db ref)
+  (when (integer? ref) (push! (~ db'retired) ref)))
+
+(define (retire-value! db v)
+  (when (ovf? v)
+    (dotimes [i (ovf-npages v)]
+      (push! (~ db'retired) (+ (ovf-page v) i)))))
+
+(define (vector-insert v i x)
+  (rlet1 r (make-vector (+ (vector-length v) 1))
+    (vector-copy! r 0 v 0 i)
+    (vector-set! r i x)
+    (vector-copy! r (+ i 1) v i)))
+
+(define (vector-remove v i)
+  (rlet1 r (make-vector (- (vector-length v) 1))
+    (vector-copy! r 0 v 0 i)
+    (vector-copy! r i v (+ i 1))))
+
+(define (vector-replace v i x)
+  (rlet1 r (vector-copy v)
+    (vector-set! r i x)))
+
+(define (make-branch nodes)
+  (make-node #f
+             (list->vector (map (^n (vector-ref (node-keys n) 0)) nodes))
+             (list->vector nodes)
+             0))
+
+(define (tree-put! db k v)
+  (if (eqv? (~ db'root) 0)
+    (begin
+      (set! (~ db'root) (make-node #t (vector k) (vector v) 0))
+      (set! (~ db'count) 1))
+    (receive (nodes added?) (insert db (pending-snapshot db) (~ db'root) k v)
+      (set! (~ db'root)
+            (if (null? (cdr nodes)) (car nodes) (make-branch nodes)))
+      (when added? (inc! (~ db'count))))))
+
+(define (tree-delete! db k)
+  (unless (eqv? (~ db'root) 0)
+    (and-let1 n (delete db (pending-snapshot db) (~ db'root) k)
+      (dec! (~ db'count))
+      (set! (~ db'root)
+            (cond [(zero? (vector-length (node-keys n))) 0]
+                  [(and (not (node-leaf? n))
+                        (= (vector-length (node-keys n)) 1))
+                   (vector-ref (node-vals n) 0)]
+                  [else n])))))
+
+;; Returns a list of one or two nodes that replace REF, and whether
+;; a new entry is added.
+(define (insert db snap ref k v)
+  (let* ([n (get-node db snap ref)]
+         [keys (node-keys n)]
+         [vals (node-vals n)])
+    (retire! db ref)
+    (if (node-leaf? n)
+      (let1 i (lower-bound keys k)
+        (if (and (< i (vector-length keys)) (string=? (vector-ref keys i) k))
+          (begin
+            (retire-value! db (vector-ref vals i))
+            (values (split db (make-node #t keys (vector-replace vals i v) 0))
+                    #f))
+          (values (split db (make-node #t (vector-insert keys i k)
+                                       (vector-insert vals i v) 0))
+                  #t)))
+      (let1 i (child-index keys k)
+        (receive (kids added?) (insert db snap (vector-ref vals i) k v)
+          (values (split db (splice-children n i kids)) added?))))))
+
+;; Replaces the I-th child of N with KIDS, a list of one or two nodes.
+(define (splice-children n i kids)
+  (let ([keys (node-keys n)]
+        [vals (vector-replace (node-vals n) i (car kids))])
+    (if (null? (cdr kids))
+      (make-node #f keys vals 0)
+      (let1 right (cadr kids)
+        (make-node #f
+                   (vector-insert keys (+ i 1) (vector-ref (node-keys right) 0))
+                   (vector-insert vals (+ i 1) right)
+                   0)))))
+
+(define (split db n)
+  (let ([total (node-size db n)]
+        [keys (node-keys n)]
+        [vals (node-vals n)]
+        [leaf? (node-leaf? n)])
+    (if (<= total (usable-size db))
+      (list n)
+      (let loop ([i 0] [s 0])
+        (if (< (* s 2) total)
+          (loop (+ i 1) (+ s (entry-size db leaf? (vector-ref keys i)
+                                         (vector-ref vals i))))
+          (list (make-node leaf? (vector-copy keys 0 i) (vector-copy vals 0 i)
+                           0)
+                (make-node leaf? (vector-copy keys i) (vector-copy vals i)
+                           0)))))))
+
+;; Returns the node that replaces REF after removing K, or #f if K isn't
+;; in the subtree.
+(define (delete db snap ref k)
+  (let* ([n (get-node db snap ref)]
+         [keys (node-keys n)]
+         [vals (node-vals n)])
+    (if (node-leaf? n)
+      (let1 i (lower-bound keys k)
+        (and (< i (vector-length keys))
+             (string=? (vector-ref keys i) k)
+             (begin
+               (retire! db ref)
+               (retire-value! db (vector-ref vals i))
+               (make-node #t (vector-remove keys i) (vector-remove vals i) 0))))
+      (let1 i (child-index keys k)
+        (and-let1 kid (delete db snap (vector-ref vals i) k)
+          (retire! db ref)
+          (rebalance db snap n i kid))))))
+
+;; Replaces the I-th child of a branch node N with KID, which has just
+;; lost an entry.  An empty child is dropped, and a small one is merged
+;; with its neighbor if the result fits in a page.
+(define (rebalance db snap n i kid)
+  (let ([keys (node-keys n)]
+        [vals (node-vals n)])
+    (cond
+     [(zero? (vector-length (node-keys kid)))
+      (make-node #f (vector-remove keys i) (vector-remove vals i) 0)]
+     [(or (= (vector-length keys) 1)
+          (> (* (node-size db kid) 4) (usable-size db)))
+      (make-node #f keys (vector-replace vals i kid) 0)]
+     [else
+      (let* ([j (if (> i 0) (- i 1) (+ i 1))]
+             [lo (min i j)]
+             [sib (get-node db snap (vector-ref vals j))]
+             [merged (if (< i j)
+                       (merge-nodes kid sib (vector-ref keys j))
+                       (merge-nodes sib kid (vector-ref keys i)))])
+        (if (<= (node-size db merged) (usable-size db))
+          (begin
+            (retire! db (vector-ref vals j))
+            (make-node #f (vector-remove keys (+ lo 1))
+                       (vector-remove (vector-replace vals lo merged) (+ lo 1))
+                       0))
+          (make-node #f keys (vector-replace vals i kid) 0)))])))
+
+;; SEP is the separator between LEFT and RIGHT in their parent.
+(define (merge-nodes left right sep)
+  (make-node (node-leaf? left)
+             (vector-append (node-keys left)
+                            (if (node-leaf? right)
+                              (node-keys right)
+                              (vector-replace (node-keys right) 0 sep)))
+             (vector-append (node-vals left) (node-vals right))
+             0))
+
+;; Builds the tree from GEN bottom up.  Each level is written out as soon
+;; as its nodes are filled.
+(define (bulk-build! db gen)
+  (define txn (+ (snap-txn (~ db'snapshot)) 1))
+  (define limit (reuse-limit db))
+  ;; Packs (key . val) from NEXT into nodes and returns a list of
+  ;; (first-key . pgno) of the written nodes.
+  (define (build-level leaf? next)
+    (let loop ([e (next)] [keys '()] [vals '()] [size 0] [r '()])
+      (define (emit)
+        (let1 n (make-node leaf? (reverse-list->vector keys)
+                           (reverse-list->vector vals) 0)
+          (acons (vector-ref (node-keys n) 0) (flush-ref! db n txn limit) r)))
+      (if (eof-object? e)
+        (reverse (if (null? keys) r (emit)))
+        (let1 esize (entry-size db leaf? (car e) (cdr e))
+          (if (and (pair? keys) (> (+ size esize) (usable-size db)))
+            (loop (next) (list (car e)) (list (cdr e)) esize (emit))
+            (loop (next) (cons (car e) keys) (cons (cdr e) vals)
+                  (+ size esize) r))))))
+  (let* ([prev #f]
+         [count 0]
+         [entries
+          (^[] (let1 p (gen)
+                 (if (eof-object? p)
+                   p
+                   (let ([k (btree-key db (car p))]
+                         [v (%dbm-v2s db (cdr p))])
+                     (when (and prev (not (string<? prev k)))
+                       (error "btree-bulk-load!: keys are not in ascending \
+                               order:" (car p)))
+                     (unless (string? v)
+                       (error "btree: value must be a string, but got:" v))
+                     (set! prev k)
+                     (inc! count)
+                     (cons k v)))))])
+    (let loop ([level (build-level #t entries)])
+      (cond [(null? level)]
+            [(null? (cdr level)) (set! (~ db'root) (cdar level))]
+            [else (loop (build-level #f (list->generator level)))]))
+    (set! (~ db'count) count)))
+
+;;
+;; Committing
+;;
+
+;; The oldest transaction whose pages may still be read: by this handle,
+;; by read-only handles in this process, or by other processes.
+(define (reuse-limit db)
+  (define (oldest tab m) (hash-table-fold tab (^[txn _ m] (min txn m)) m))
+  (let* ([m (with-locking-mutex (~ db'rlock)
+              (^[] (oldest (~ db'readers) (snap-txn (~ db'snapshot)))))]
+         [m (with-open-files
+              (^[] (oldest (open-file-readers (~ db'file)) m)))])
+    (or (oldest-reader db m) m)))
+
+(define (alloc-page! db limit)
+  (let1 q (~ db'free)
+    (if (and (not (queue-empty? q))
+             (<= (cdr (queue-front q)) limit))
+      (let1 e (dequeue! q)
+        (push! (~ db'reused) e)
+        (car e))
+      (alloc-run! db 1))))
+
+;; Allocates N contiguous pages at the end of the file.  The file is
+;; extended by a quarter at least, to avoid remapping too often.
+(define (alloc-run! db n)
+  (rlet1 pgno (~ db'npages)
+    (let* ([psize (~ db'page-size)]
+           [need (* (+ pgno n) psize)]
+           [fsize (~ db'file-size)])
+      (set! (~ db'npages) (+ pgno n))
+      (when (> need fsize)
+        (let1 size (max need (* (quotient (+ fsize (quotient fsize 4)) psize)
+                                psize))
+          (sys-ftruncate (~ db'out) size)
+          (set! (~ db'file-size) size))))))
+
+(define (write-pages! db pgno buf)
+  (port-seek (~ db'out) (* pgno (~ db'page-size)))
+  (write-uvector buf (~ db'out))
+  (set! (~ db'unflushed?) #t))
+
+;; Fills the header and the trailer of BUF.
+(define (stamp-pages! buf type count txn)
+  (put-u8! buf 0 type)
+  (put-u16le! buf 2 count)
+  (put-u64le! buf 8 txn)
+  (put-u64le! buf (- (u8vector-length buf) 8) txn))
+
+;; Writes out the new nodes reachable from REF and returns its page number.
+(define (flush-ref! db ref txn limit)
+  (if (integer? ref)
+    ref
+    (let* ([leaf? (node-leaf? ref)]
+           [keys (node-keys ref)]
+           [vals (if leaf?
+                   (vector-map (^[k v]
+                                 (if (or (ovf? v)
+                                         (inline-value? db (string-size k) v))
+                                   v
+                                   (write-overflow! db v txn limit)))
+                               keys (node-vals ref))
+                   (vector-map (cut flush-ref! db <> txn limit)
+                               (node-vals ref)))]
+           [buf (make-u8vector (~ db'page-size) 0)]
+           [pgno (alloc-page! db limit)])
+      (stamp-pages! buf (if leaf? *leaf-page* *branch-page*)
+                    (vector-length keys) txn)
+      (let loop ([i 0] [pos 16])
+        (when (< i (vector-length keys))
+          (let* ([k (vector-ref keys i)]
+                 [v (vector-ref vals i)]
+                 [kend (+ pos 2 (string-size k))])
+            (put-u16le! buf pos (string-size k))
+            (string->u8vector! buf (+ pos 2) k)
+            (cond [(not leaf?)
+                   (put-u64le! buf kend v)
+                   (loop (+ i 1) (+ kend 8))]
+                  [(string? v)
+                   (put-u8! buf kend 0)
+                   (put-u32le! buf (+ kend 1) (string-size v))
+                   (string->u8vector! buf (+ kend 5) v)
+                   (loop (+ i 1) (+ kend 5 (string-size v)))]
+                  [else
+                   (put-u8! buf kend 1)
+                   (put-u64le! buf (+ kend 1) (ovf-page v))
+                   (put-u32le! buf (+ kend 9) (ovf-npages v))
+                   (put-u32le! buf (+ kend 13) (ovf-size v))
+                   (loop (+ i 1) (+ kend 17))]))))
+      (write-pages! db pgno buf)
+      (cache-node! db pgno (make-node leaf? keys vals txn))
+      pgno)))
+
+(define (write-overflow! db str txn limit)
+  (let* ([psize (~ db'page-size)]
+         [size (string-size str)]
+         [n (quotient (+ size 24 psize -1) psize)]
+         [pgno (if (= n 1) (alloc-page! db limit) (alloc-run! db n))]
+         [buf (make-u8vector (* n psize) 0)])
+    (stamp-pages! buf *overflow-page* 0 txn)
+    (put-u32le! buf 4 size)
+    (string->u8vector! buf 16 str)
+    (write-pages! db pgno buf)
+    (make-ovf pgno n size)))
+
+;; Saves ENTRIES, a list of (pgno . txn), in a chain of free list pages
+;; at the end of the file.  Returns the first page of the chain, or 0.
+(define (write-freelist! db entries txn)
+  (let* ([psize (~ db'page-size)]
+         [cap (quotient (- psize 32) 16)]
+         [chunks (slices entries cap)]
+         [start (if (null? chunks) 0 (alloc-run! db (length chunks)))])
+    (let loop ([chunks chunks] [pgno start])
+      (unless (null? chunks)
+        (let1 buf (make-u8vector psize 0)
+          (stamp-pages! buf *freelist-page* (length (car chunks)) txn)
+          (put-u64le! buf 16 (if (null? (cdr chunks)) 0 (+ pgno 1)))
+          (let entry-loop ([es (car chunks)] [pos 24])
+            (unless (null? es)
+              (put-u64le! buf pos (caar es))
+              (put-u64le! buf (+ pos 8) (cdar es))
+              (entry-loop (cdr es) (+ pos 16))))
+          (write-pages! db pgno buf)
+          (loop (cdr chunks) (+ pgno 1)))))
+    start))
+
+(define (commit! db save-freelist?)
+  (let* ([committed (~ db'snapshot)]
+         [txn (+ (snap-txn committed) 1)]
+         [root (flush-ref! db (~ db'root) txn (reuse-limit db))]
+         [freed (map (cut cons <> txn) (~ db'retired))])
+    (when (or save-freelist?
+              (not (eqv? root (snap-root committed)))
+              (pair? freed))
+      (let1 freelist (if save-freelist?
+                       (write-freelist! db (append (queue->list (~ db'free))
+                                                   freed)
+                                        txn)
+                       0)
+        (when (~ db'sync) (sys-fsync (~ db'out)))
+        (port-seek (~ db'out) (* (logand txn 1) (~ db'page-size)))
+        (write-uvector (encode-meta (~ db'page-size) txn root (~ db'npages)
+                                    (~ db'count)
+                                    (if save-freelist? *freelist-saved* 0)
+                                    freelist)
+                       (~ db'out))
+        (if (~ db'sync) (sys-fsync (~ db'out)) (flush (~ db'out)))
+        (set! (~ db'unflushed?) #f)
+        (unless (null? freed) (apply enqueue! (~ db'free) freed))
+        (with-locking-mutex (~ db'rlock)
+          (^[]
+            (when (> (* (~ db'npages) (~ db'page-size)) (~ db'region-size))
+              (remap! db))
+            (set! (~ db'snapshot)
+                  (make-snapshot txn root (~ db'count) (~ db'npages)
+                                 (~ db'region) (~ db'region-size) #f))))))
+    (reset-pending! db)))
+
+;; Discards the pending transaction.  Its pages may be in the cache with
+;; the stamp the next transaction will use, so we drop them all.
+(define (abort! db)
+  (dolist [e (~ db'reused)] (queue-push! (~ db'free) e))
+  (with-locking-mutex (~ db'clock) (^[] (hash-table-clear! (~ db'cache))))
+  (reset-pending! db))
+
+(define (reset-pending! db)
+  (let1 s (~ db'snapshot)
+    (set! (~ db'root) (snap-root s))
+    (set! (~ db'count) (snap-count s))
+    (set! (~ db'npages) (snap-npages s))
+    (set! (~ db'retired) '())
+    (set! (~ db'reused) '())))
+
+;;
+;; Meta pages and the file
+;;
+
+(define (meta-checksum v)               ; FNV-1a of the first 56 bytes
+  (let loop ([i 0] [h 2166136261])
+    (if (= i 56)
+      h
+      (loop (+ i 1)
+            (logand (* (logxor h (u8vector-ref v i)) 16777619) #xffffffff)))))
+
+(define (encode-meta psize txn root npages count flags freelist)
+  (rlet1 v (make-u8vector *meta-size* 0)
+    (string->u8vector! v 0 *btree-magic*)
+    (put-u16le! v 4 *btree-version*)
+    (put-u32le! v 8 psize)
+    (put-u32le! v 12 flags)
+    (put-u64le! v 16 txn)
+    (put-u64le! v 24 root)
+    (put-u64le! v 32 npages)
+    (put-u64le! v 40 count)
+    (put-u64le! v 48 freelist)
+    (put-u64le! v 56 (meta-checksum v))))
+
+;; Returns a meta record if V holds a valid meta page, #f otherwise.
+(define (decode-meta v)
+  (and (u8vector? v)
+       (= (u8vector-length v) *meta-size*)
+       (equal? (u8vector->string v 0 4) *btree-magic*)
+       (= (get-u16le v 4) *btree-version*)
+       (= (get-u64le v 56) (meta-checksum v))
+       (make-meta (get-u32le v 8) (get-u64le v 16) (get-u64le v 24)
+                  (get-u64le v 32) (get-u64le v 40) (get-u32le v 12)
+                  (get-u64le v 48))))
+
+(define (latest-meta m0 m1)
+  (cond [(not m0) m1]
+        [(not m1) m0]
+        [(> (meta-txn m1) (meta-txn m0)) m1]
+        [else m0]))
+
+;; Reads the meta pages through the input port.  If the first one is
+;; broken we don't know the page size, so we try the possible ones.
+(define (find-meta in)
+  (define (meta-at off)
+    (port-seek in off)
+    (decode-meta (read-uvector <u8vector> *meta-size* in)))
+  (if-let1 m0 (meta-at 0)
+    (latest-meta m0 (meta-at (meta-page-size m0)))
+    (any (^s (and-let1 m (meta-at s) (and (= (meta-page-size m) s) m)))
+         '(512 1024 2048 4096 8192 16384 32768 65536))))
+
+(define (btree-file? path)
+  (with-open-files (^[] (%btree-file? path))))
+
+;; Must be called with *open-files-lock*.  A file that has a handle open
+;; in this process is a btree; we don't open another descriptor of it.
+(define (%btree-file? path)
+  (and (file-is-regular? path)
+       (or (boolean (registered-file path))
+           (boolean (call-with-input-file path find-meta
+                                          :element-type :binary)))))
+
+(define (btree-initialize! db)
+  (let ([psize (~ db'page-size)]
+        [out (~ db'out)])
+    (unless (and (exact-integer? psize) (<= 512 psize 65536)
+                 (= psize (expt 2 (- (integer-length psize) 1))))
+      (error "btree: page size must be a power of 2 between 512 and 65536, \
+              but got:" psize))
+    (sys-ftruncate out 0)
+    (port-seek out 0)
+    (write-uvector (encode-meta psize 0 0 2 0 *freelist-saved* 0) out)
+    (sys-ftruncate out (* 2 psize))
+    (sys-fsync out)))
+
+(define (lock-writer! db)
+  (cond-expand
+   [gauche.sys.fcntl
+    (unless (guard (e [(<system-error> e)
+                       (not (memv (~ e'errno) (list EACCES EAGAIN)))])
+              (lock-byte! (~ db'out) 'write *writer-lock-offset*))
+      (errorf "dbm-open: btree database ~a is locked by another writer"
+              (~ db'path)))]
+   [else #f]))
+
+(define (open-writer! db m)
+  (let1 snap (meta->snapshot db m)
+    (set! (~ db'snapshot) snap)
+    (set! (~ db'file-size) (~ (sys-fstat (~ db'out))'size))
+    (reset-pending! db)
+    (if (logtest (meta-flags m) *freelist-saved*)
+      ;; The chain itself becomes free by the next commit.
+      (let loop ([pgno (meta-freelist m)])
+        (unless (zero? pgno)
+          (let1 view (page-view db snap pgno 1)
+            (page-stamp db snap view)
+            (dotimes [j (get-u16le view 2)]
+              (enqueue! (~ db'free) (cons (get-u64le view (+ 24 (* j 16)))
+                                          (get-u64le view (+ 32 (* j 16))))))
+            (retire! db pgno)
+            (loop (get-u64le view 16)))))
+      ;; The pages may still be reachable from older snapshots in other
+      ;; processes, so we tag them with the latest transaction.
+      (let1 used (reachable-pages db snap)
+        (dotimes [i (- (snap-npages snap) 2)]
+          (when (zero? (u8vector-ref used (+ i 2)))
+            (enqueue! (~ db'free) (cons (+ i 2) (snap-txn snap)))))))))
+
+;; Returns a u8vector whose I-th element is 1 if the page I is used by SNAP.
+(define (reachable-pages db snap)
+  (rlet1 used (make-u8vector (snap-npages snap) 0)
+    (let walk ([ref (snap-root snap)])
+      (unless (eqv? ref 0)
+        (u8vector-set! used ref 1)
+        (let1 n (load-node db snap ref)
+          (if (node-leaf? n)
+            (vector-for-each
+             (^v (when (ovf? v)
+                   (dotimes [i (ovf-npages v)]
+                     (u8vector-set! used (+ (ovf-page v) i) 1))))
+             (node-vals n))
+            (vector-for-each walk (node-vals n))))))))
@@ -238,7 +238,7 @@
 
 ;; reverse fn of key->path.  returns #f is path is invalid.
 (define (path->key path)
-  (let/cc return
+  (let/ec return
     (string-incomplete->complete
      (with-string-io path
        (lambda ()
@@ -0,0 +1,623 @@
+;;;
+;;; gauche.experimental.shared-heap
+;;;
+;;;   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; Shared heap image.
+;;
+;; An immutable object graph is written into a file once, then any number
+;; of processes map the file read-only and walk it in place.  Nothing is
+;; deserialized on open; the pages are shared among the processes by the
+;; OS, so a large lookup table built by a parent is available to all the
+;; workers at the cost of a single copy in memory.
+;;
+;; The image has no absolute pointers, so it can be mapped anywhere.
+;; It consists of 64-bit words in the native endianness of the writer
+;; (the reader rejects an image of the other endianness).
+;;
+;;   Header (32 bytes):
+;;     0  "GSHP"
+;;     4  u8  version (1)
+;;     5  u8  endianness (1: little, 2: big, 3: arm-little)
+;;     8  s64 root word
+;;    16  s64 size of the image in bytes
+;;
+;;   A word is tagged by its lower 2 bits:
+;;     xx..x00  fixnum (within 62 bits)
+;;     xx..x01  object; the word minus 1 is its byte offset in the image
+;;     xx..x10  character
+;;     xx..x11  '(), #f, #t, eof, undefined (0 to 4 shifted by 2)
+;;
+;;   An object is 8-byte aligned and begins with a header word, whose
+;;   lower 8 bits are the type and the rest is the length:
+;;     1  pair        car word, cdr word
+;;     2  vector      LEN words
+;;     3  string      LEN bytes of utf-8, padded
+;;     4  symbol      ditto, the name
+;;     5  keyword     ditto, the name
+;;     6  flonum      f64
+;;     7  number      ditto, the external representation (bignums etc.)
+;;     8  uvector     header is LEN<<16 | subtype<<8 | 8; the elements
+;;                    follow the header and are 16-byte aligned
+;;     9  table       LEN buckets (power of 2), a count word, then
+;;                    LEN slots of (hash+1, key word, value word).
+;;                    Open addressing with linear probing; hash is
+;;                    portable-hash, so it's the same in every process.
+;;    10  trie        LEN entries of (key word, value word), sorted
+;;                    by the bytes of the key string.
+;;
+;; Strings, symbols, flonums, numbers and uvectors are returned as
+;; ordinary Scheme objects when they are referenced; uvectors are views
+;; to the mapped region, so they cost nothing but the header.  Pairs,
+;; vectors, tables and tries are returned as small handles that refer
+;; to the image.  Shared structures and cycles are preserved.
+;;
+;; Hash tables in the source graph become tables, whose keys must be
+;; strings, symbols, keywords, numbers, characters or booleans; lookup
+;; compares keys with equal?.  Tries (data.trie) with string keys become
+;; tries.
+
+(define-module gauche.experimental.shared-heap
+  (use gauche.uvector)
+  (use gauche.record)
+  (use gauche.sequence)
+  (use gauche.dictionary)
+  (use binary.io)
+  (use data.trie)
+  (export <shared-heap> shared-heap? shared-heap-save shared-heap-open
+          shared-heap-root shared->native
+
+          <shared-object> <shared-pair> <shared-vector>
+          <shared-table> <shared-trie>
+          shared-pair? shared-car shared-cdr
+          shared-vector? shared-vector-length shared-vector-ref
+          shared-table? shared-table-num-entries shared-table-ref
+          shared-table-exists? shared-table-fold
+          shared-trie? shared-trie-num-entries shared-trie-ref
+          shared-trie-exists? shared-trie-fold
+          shared-trie-common-prefix-fold
+
+          call-with-iterator size-of))
+(select-module gauche.experimental.shared-heap)
+
+(define-constant *magic* "GSHP")
+(define-constant *version* 1)
+(define-constant *header-size* 32)
+
+(define-constant T_PAIR    1)
+(define-constant T_VECTOR  2)
+(define-constant T_STRING  3)
+(define-constant T_SYMBOL  4)
+(define-constant T_KEYWORD 5)
+(define-constant T_FLONUM  6)
+(define-constant T_NUMBER  7)
+(define-constant T_UVECTOR 8)
+(define-constant T_TABLE   9)
+(define-constant T_TRIE    10)
+
+(define *specials* (vector '() #f #t (eof-object) (undefined)))
+
+(define *uvector-classes*
+  (vector <s8vector> <u8vector> <s16vector> <u16vector>
+          <s32vector> <u32vector> <s64vector> <u64vector>
+          <f16vector> <f32vector> <f64vector>
+          <c32vector> <c64vector> <c128vector>))
+
+;; Fixnums beyond this range are stored as numbers.
+(define-constant *imm-max* (- (expt 2 61) 1))
+(define-constant *imm-min* (- (expt 2 61)))
+
+(define (%endian-code)
+  (case (native-endian)
+    [(little-endian) 1]
+    [(big-endian) 2]
+    [else 3]))
+
+;; Hash values are kept in the fixnum range; 0 marks an empty slot.
+(define (%hash key)
+  (+ (logand (portable-hash key 0) (- (expt 2 60) 1)) 1))
+
+(define (%table-key? key)
+  (or (string? key) (symbol? key) (keyword? key)
+      (number? key) (char? key) (boolean? key)))
+
+;;;
+;;; Writer
+;;;
+
+;; Writes OBJ to PATH as a shared heap image.  The file is written
+;; under a temporary name and renamed, so that the processes that are
+;; mapping the old image are not affected.
+(define (shared-heap-save obj path)
+  (define endian (native-endian))
+  (define buf (make-u8vector 4096 0))
+  (define pos *header-size*)
+  (define seen (make-hash-table 'eq?))           ; obj -> word
+  (define strings (make-hash-table 'string=?))   ; string -> word
+
+  (define (alloc! size)
+    (let1 end (+ pos (* (quotient (+ size 7) 8) 8))
+      (when (> end (u8vector-length buf))
+        (let1 nbuf (make-u8vector (max end (* 2 (u8vector-length buf))) 0)
+          (u8vector-copy! nbuf 0 buf 0 pos)
+          (set! buf nbuf)))
+      (begin0 pos (set! pos end))))
+  (define (put-word! off w) (put-s64! buf off w endian))
+  (define (get-word off) (get-s64 buf off endian))
+  (define (put-header! off len type) (put-word! off (logior (ash len 8) type)))
+
+  (define (encode x)
+    (cond [(null? x) 3]
+          [(eq? x #f) 7]
+          [(eq? x #t) 11]
+          [(eof-object? x) 15]
+          [(undefined? x) 19]
+          [(char? x) (+ (ash (char->integer x) 2) 2)]
+          [(and (exact-integer? x) (<= *imm-min* x *imm-max*)) (ash x 2)]
+          [(hash-table-get seen x #f)]
+          [(string? x)
+           (or (hash-table-get strings x #f)
+               (rlet1 w (encode-bytes T_STRING (string->u8vector x))
+                 (hash-table-put! strings x w)))]
+          [(symbol? x)
+           (rlet1 w (encode-bytes T_SYMBOL (string->u8vector (symbol->string x)))
+             (hash-table-put! seen x w))]
+          [(keyword? x)
+           (rlet1 w (encode-bytes T_KEYWORD
+                                  (string->u8vector (keyword->string x)))
+             (hash-table-put! seen x w))]
+          [(flonum? x)
+           (let1 off (alloc! 16)
+             (put-header! off 0 T_FLONUM)
+             (put-f64! buf (+ off 8) x endian)
+             (+ off 1))]
+          [(number? x)
+           (encode-bytes T_NUMBER (string->u8vector (number->string x)))]
+          [(pair? x) (encode-list x)]
+          [(vector? x) (encode-vector x)]
+          [(uvector? x) (encode-uvector x)]
+          [(hash-table? x) (encode-table x)]
+          [(trie? x) (encode-trie x)]
+          [else (error "can't store an object in a shared heap:" x)]))
+
+  (define (encode-bytes type bytes)
+    (let* ([n (u8vector-length bytes)]
+           [off (alloc! (+ n 8))])
+      (put-header! off n type)
+      (u8vector-copy! buf (+ off 8) bytes)
+      (+ off 1)))
+
+  (define (new-object! x size len type)
+    (rlet1 off (alloc! size)
+      (hash-table-put! seen x (+ off 1))
+      (put-header! off len type)))
+
+  ;; Cdr chain is followed by a loop, so that long lists don't consume
+  ;; the stack.
+  (define (encode-list x)
+    (let1 off (new-object! x 24 0 T_PAIR)
+      (let loop ([p x] [poff off])
+        (let1 w (encode (car p)) (put-word! (+ poff 8) w))
+        (let1 d (cdr p)
+          (if (and (pair? d) (not (hash-table-exists? seen d)))
+            (let1 doff (new-object! d 24 0 T_PAIR)
+              (put-word! (+ poff 16) (+ doff 1))
+              (loop d doff))
+            (let1 w (encode d) (put-word! (+ poff 16) w)))))
+      (+ off 1)))
+
+  (define (encode-vector x)
+    (let* ([n (vector-length x)]
+           [off (new-object! x (* (+ n 1) 8) n T_VECTOR)])
+      (dotimes [i n]
+        (let1 w (encode (vector-ref x i))
+          (put-word! (+ off 8 (* i 8)) w)))
+      (+ off 1)))
+
+  (define (encode-uvector x)
+    (let ([subtype (find-index (cut eq? <> (class-of x)) *uvector-classes*)]
+          [size (uvector-size x)])
+      (unless subtype
+        (error "can't store an object in a shared heap:" x))
+      ;; Make the elements 16-byte aligned for make-view-uvector.
+      (unless (= (modulo pos 16) 8) (alloc! 8))
+      (let1 off (alloc! (+ size 8))
+        (hash-table-put! seen x (+ off 1))
+        (put-word! off (logior (ash (uvector-length x) 16)
+                               (ash subtype 8)
+                               T_UVECTOR))
+        (uvector-copy! buf (+ off 8) x)
+        (+ off 1))))
+
+  (define (encode-table x)
+    (let* ([count (hash-table-num-entries x)]
+           [nb (let loop ([n 2]) (if (>= n (* count 2)) n (loop (* n 2))))]
+           [off (new-object! x (* (+ 2 (* nb 3)) 8) nb T_TABLE)])
+      (put-word! (+ off 8) count)
+      (hash-table-for-each
+       x
+       (^[k v]
+         (unless (%table-key? k)
+           (error "can't store a table with a key of this type:" k))
+         (let* ([h (%hash k)]
+                [slot (let loop ([i (logand h (- nb 1))])
+                        (let1 s (+ off 16 (* i 24))
+                          (if (zero? (get-word s))
+                            s
+                            (loop (logand (+ i 1) (- nb 1))))))])
+           (put-word! slot h)
+           (let1 w (encode k) (put-word! (+ slot 8) w))
+           (let1 w (encode v) (put-word! (+ slot 16) w)))))
+      (+ off 1)))
+
+  (define (encode-trie x)
+    (dolist [e (trie->list x)]
+      (unless (string? (car e))
+        (error "can't store a trie with a non-string key:" (car e))))
+    (let* ([entries (sort (trie->list x) string<? car)]
+           [n (length entries)]
+           [off (new-object! x (* (+ 1 (* n 2)) 8) n T_TRIE)])
+      (for-each (^[e i]
+                  (let1 w (encode (car e))
+                    (put-word! (+ off 8 (* i 16)) w))
+                  (let1 w (encode (cdr e))
+                    (put-word! (+ off 16 (* i 16)) w)))
+                entries (iota n))
+      (+ off 1)))
+
+  (let1 root (encode obj)
+    (string->u8vector! buf 0 *magic*)
+    (u8vector-set! buf 4 *version*)
+    (u8vector-set! buf 5 (%endian-code))
+    (put-word! 8 root)
+    (put-word! 16 pos))
+  (receive (port tmp) (sys-mkstemp path)
+    (guard (e [else (close-port port) (sys-unlink tmp) (raise e)])
+      (write-uvector buf port 0 pos)
+      (close-port port)
+      (sys-chmod tmp #o644)
+      (sys-rename tmp path)))
+  (undefined))
+
+;;;
+;;; Reader
+;;;
+
+(define-record-type <shared-heap> %make-shared-heap shared-heap?
+  (path    shared-heap-path)
+  (region  shared-heap-region)
+  (words   shared-heap-words)           ; s64vector view
+  (bytes   shared-heap-bytes)           ; u8vector view
+  (flonums shared-heap-flonums))        ; f64vector view
+
+;; Maps the image in PATH read-only.  The mapping is released when the
+;; heap and all the objects taken from it are garbage collected.
+(define (shared-heap-open path)
+  (define (bad msg) (error #"~msg in shared heap:" path))
+  (let* ([region (call-with-input-file path
+                   (^p (let1 size (slot-ref (sys-fstat p) 'size)
+                         (when (< size *header-size*) (bad "truncated header"))
+                         (sys-mmap p PROT_READ MAP_SHARED size))))]
+         [bytes (make-view-uvector region <u8vector> #f 0 #t)]
+         [words (make-view-uvector region <s64vector> #f 0 #t)])
+    (unless (equal? (u8vector->string bytes 0 4) *magic*)
+      (bad "bad magic"))
+    (unless (= (u8vector-ref bytes 4) *version*)
+      (bad "unsupported version"))
+    (unless (= (u8vector-ref bytes 5) (%endian-code))
+      (bad "different endianness"))
+    (unless (= (s64vector-ref words 2) (u8vector-length bytes))
+      (bad "size mismatch"))
+    (%make-shared-heap path region words bytes
+                       (make-view-uvector region <f64vector> #f 0 #t))))
+
+(define (shared-heap-root heap)
+  (%decode heap (s64vector-ref (shared-heap-words heap) 1)))
+
+(define-inline (%word heap off)
+  (s64vector-ref (shared-heap-words heap) (ash off -3)))
+
+(define (%decode heap w)
+  (case (logand w 3)
+    [(0) (ash w -2)]
+    [(1) (%decode-object heap (- w 1))]
+    [(2) (integer->char (ash w -2))]
+    [else (vector-ref *specials* (ash w -2))]))
+
+(define (%decode-string heap off)
+  (u8vector->string (shared-heap-bytes heap)
+                    (+ off 8) (+ off 8 (ash (%word heap off) -8))))
+
+(define (%decode-object heap off)
+  (let1 hdr (%word heap off)
+    (case (logand hdr #xff)
+      [(1) (make <shared-pair> :heap heap :offset off)]
+      [(2) (make <shared-vector> :heap heap :offset off)]
+      [(3) (%decode-string heap off)]
+      [(4) (string->symbol (%decode-string heap off))]
+      [(5) (make-keyword (%decode-string heap off))]
+      [(6) (f64vector-ref (shared-heap-flonums heap) (+ (ash off -3) 1))]
+      [(7) (string->number (%decode-string heap off))]
+      [(8) (make-view-uvector (shared-heap-region heap)
+                              (vector-ref *uvector-classes*
+                                          (logand (ash hdr -8) #xff))
+                              (ash hdr -16)
+                              (+ off 8)
+                              #t)]
+      [(9) (make <shared-table> :heap heap :offset off)]
+      [(10) (make <shared-trie> :heap heap :offset off)]
+      [else (errorf "broken shared heap ~s: unknown object type ~s at ~s"
+                    (shared-heap-path heap) (logand hdr #xff) off)])))
+
+;; Decodes the Kth word in the body of OBJ.
+(define-inline (%ref obj k)
+  (let1 heap (slot-ref obj 'heap)
+    (%decode heap (%word heap (+ (slot-ref obj 'offset) 8 (* k 8))))))
+
+(define-inline (%length obj)
+  (ash (%word (slot-ref obj 'heap) (slot-ref obj 'offset)) -8))
+
+;;;
+;;; Handles
+;;;
+
+(define-class <shared-object> ()
+  ((heap   :init-keyword :heap)
+   (offset :init-keyword :offset)))
+
+;; Two handles are equal if they refer to the same object.
+(define-method object-equal? ((a <shared-object>) (b <shared-object>))
+  (and (eq? (slot-ref a 'heap) (slot-ref b 'heap))
+       (= (slot-ref a 'offset) (slot-ref b 'offset))))
+
+(define-class <shared-pair> (<shared-object> <sequence>) ())
+(define-class <shared-vector> (<shared-object> <sequence>) ())
+(define-class <shared-table> (<shared-object> <dictionary>) ())
+(define-class <shared-trie> (<shared-object> <dictionary>) ())
+
+(define (shared-pair? obj) (is-a? obj <shared-pair>))
+(define (shared-vector? obj) (is-a? obj <shared-vector>))
+(define (shared-table? obj) (is-a? obj <shared-table>))
+(define (shared-trie? obj) (is-a? obj <shared-trie>))
+
+(define (shared-car p)
+  (assume-type p <shared-pair>)
+  (%ref p 0))
+(define (shared-cdr p)
+  (assume-type p <shared-pair>)
+  (%ref p 1))
+
+(define (shared-vector-length v)
+  (assume-type v <shared-vector>)
+  (%length v))
+
+(define (shared-vector-ref v k :optional fallback)
+  (assume-type v <shared-vector>)
+  (if (and (exact-integer? k) (<= 0 k) (< k (%length v)))
+    (%ref v k)
+    (if (undefined? fallback)
+      (error "index out of range:" k)
+      fallback)))
+
+;; Table
+
+(define (%table-slot tab key)
+  (let* ([heap (slot-ref tab 'heap)]
+         [off (slot-ref tab 'offset)]
+         [mask (- (%length tab) 1)]
+         [h (%hash key)])
+    (let loop ([i (logand h mask)])
+      (let* ([slot (+ off 16 (* i 24))]
+             [sh (%word heap slot)])
+        (cond [(zero? sh) #f]
+              [(and (= sh h)
+                    (equal? key (%decode heap (%word heap (+ slot 8)))))
+               slot]
+              [else (loop (logand (+ i 1) mask))])))))
+
+(define (shared-table-num-entries tab)
+  (assume-type tab <shared-table>)
+  (%word (slot-ref tab 'heap) (+ (slot-ref tab 'offset) 8)))
+
+(define (shared-table-ref tab key :optional fallback)
+  (assume-type tab <shared-table>)
+  (if-let1 slot (%table-slot tab key)
+    (let1 heap (slot-ref tab 'heap)
+      (%decode heap (%word heap (+ slot 16))))
+    (if (undefined? fallback)
+      (error "shared table does not have an entry for a key:" key)
+      fallback)))
+
+(define (shared-table-exists? tab key)
+  (assume-type tab <shared-table>)
+  (boolean (%table-slot tab key)))
+
+(define (shared-table-fold tab proc seed)
+  (assume-type tab <shared-table>)
+  (let ([heap (slot-ref tab 'heap)]
+        [off (slot-ref tab 'offset)])
+    (let loop ([i 0] [seed seed])
+      (if (= i (%length tab))
+        seed
+        (let1 slot (+ off 16 (* i 24))
+          (loop (+ i 1)
+                (if (zero? (%word heap slot))
+                  seed
+                  (proc (%decode heap (%word heap (+ slot 8)))
+                        (%decode heap (%word heap (+ slot 16)))
+                        seed))))))))
+
+;; Trie
+
+;; Compares the bytes of the Ith key of TRIE with the u8vector KEY.
+;; If PREFIX? is true, the stored key that begins with KEY is regarded
+;; as equal.
+(define (%trie-compare trie i key prefix?)
+  (let* ([heap (slot-ref trie 'heap)]
+         [bytes (shared-heap-bytes heap)]
+         [koff (- (%word heap (+ (slot-ref trie 'offset) 8 (* i 16))) 1)]
+         [klen (ash (%word heap koff) -8)]
+         [len (u8vector-length key)])
+    (let loop ([j 0])
+      (cond [(= j len) (if (or prefix? (= klen len)) 0 1)]
+            [(= j klen) -1]
+            [else
+             (let ([a (u8vector-ref bytes (+ koff 8 j))]
+                   [b (u8vector-ref key j)])
+               (cond [(< a b) -1]
+                     [(> a b) 1]
+                     [else (loop (+ j 1))]))]))))
+
+;; Returns the index of the first key that isn't less than KEY.
+(define (%trie-lower-bound trie key)
+  (let loop ([lo 0] [hi (%length trie)])
+    (if (= lo hi)
+      lo
+      (let1 mid (ash (+ lo hi) -1)
+        (if (< (%trie-compare trie mid key #f) 0)
+          (loop (+ mid 1) hi)
+          (loop lo mid))))))
+
+(define (%trie-index trie key)
+  (unless (string? key)
+    (error "shared trie key must be a string, but got:" key))
+  (let* ([bytes (string->u8vector key)]
+         [i (%trie-lower-bound trie bytes)])
+    (and (< i (%length trie))
+         (zero? (%trie-compare trie i bytes #f))
+         i)))
+
+(define (shared-trie-num-entries trie)
+  (assume-type trie <shared-trie>)
+  (%length trie))
+
+(define (shared-trie-ref trie key :optional fallback)
+  (assume-type trie <shared-trie>)
+  (if-let1 i (%trie-index trie key)
+    (%ref trie (+ (* i 2) 1))
+    (if (undefined? fallback)
+      (error "shared trie does not have an entry for a key:" key)
+      fallback)))
+
+(define (shared-trie-exists? trie key)
+  (assume-type trie <shared-trie>)
+  (boolean (%trie-index trie key)))
+
+;; PROC is called in the ascending order of keys.
+(define (shared-trie-common-prefix-fold trie prefix proc seed)
+  (assume-type trie <shared-trie>)
+  (let ([bytes (string->u8vector prefix)]
+        [n (%length trie)])
+    (let loop ([i (%trie-lower-bound trie bytes)] [seed seed])
+      (if (and (< i n) (zero? (%trie-compare trie i bytes #t)))
+        (loop (+ i 1)
+              (proc (%ref trie (* i 2)) (%ref trie (+ (* i 2) 1)) seed))
+        seed))))
+
+(define (shared-trie-fold trie proc seed)
+  (shared-trie-common-prefix-fold trie "" proc seed))
+
+;;;
+;;; Copying back
+;;;
+
+;; Returns a fresh copy of OBJ that doesn't refer to the heap.  Tables
+;; become equal? hash tables, and tries become data.trie.
+(define (shared->native obj)
+  (define memo (make-hash-table 'eqv?))   ; offset -> copy
+  (define (conv x)
+    (cond [(not (is-a? x <shared-object>)) x]
+          [(hash-table-get memo (slot-ref x 'offset) #f)]
+          [(shared-pair? x) (conv-list x)]
+          [(shared-vector? x)
+           (rlet1 v (make-vector (%length x))
+             (hash-table-put! memo (slot-ref x 'offset) v)
+             (dotimes [i (%length x)]
+               (vector-set! v i (conv (%ref x i)))))]
+          [(shared-table? x)
+           (rlet1 t (make-hash-table 'equal?)
+             (hash-table-put! memo (slot-ref x 'offset) t)
+             (shared-table-fold x (^[k v _] (hash-table-put! t k (conv v)))
+                                #f))]
+          [else
+           (rlet1 t (make-trie)
+             (hash-table-put! memo (slot-ref x 'offset) t)
+             (shared-trie-fold x (^[k v _] (trie-put! t k (conv v))) #f))]))
+  (define (conv-list x)
+    (rlet1 head (cons #f #f)
+      (hash-table-put! memo (slot-ref x 'offset) head)
+      (let loop ([p x] [cell head])
+        (set-car! cell (conv (shared-car p)))
+        (let1 d (shared-cdr p)
+          (if (and (shared-pair? d)
+                   (not (hash-table-exists? memo (slot-ref d 'offset))))
+            (let1 c (cons #f #f)
+              (hash-table-put! memo (slot-ref d 'offset) c)
+              (set-cdr! cell c)
+              (loop d c))
+            (set-cdr! cell (conv d)))))))
+  (conv obj))
+
+;;;
+;;; Collection and dictionary framework
+;;;
+
+(define-method call-with-iterator ((p <shared-pair>) proc . opts)
+  (let1 x p
+    (proc (^[] (not (shared-pair? x)))
+          (^[] (begin0 (shared-car x) (set! x (shared-cdr x)))))))
+
+(define-method call-with-iterator ((v <shared-vector>) proc . opts)
+  (let ([i (get-keyword :start opts 0)]
+        [n (%length v)])
+    (proc (^[] (>= i n))
+          (^[] (begin0 (%ref v i) (inc! i))))))
+
+(define-method size-of ((v <shared-vector>)) (%length v))
+(define-method size-of ((t <shared-table>)) (shared-table-num-entries t))
+(define-method size-of ((t <shared-trie>)) (%length t))
+
+(define-method referencer ((v <shared-vector>))
+  (^[v i . opts] (apply shared-vector-ref v i opts)))
+
+(define-dict-interface <shared-table>
+  :get     shared-table-ref
+  :put!    (^[t k v] (error "shared table is immutable:" t))
+  :immutable? (^t #t)
+  :exists? shared-table-exists?
+  :fold    shared-table-fold)
+
+(define-dict-interface <shared-trie>
+  :get     shared-trie-ref
+  :put!    (^[t k v] (error "shared trie is immutable:" t))
+  :immutable? (^t #t)
+  :exists? shared-trie-exists?
+  :fold    shared-trie-fold)
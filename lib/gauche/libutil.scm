@@ -126,7 +126,7 @@
            (or (and (string? mod/path) (provided? mod/path))
                (and (symbol? mod/path) (find-module mod/path))))
       ;; scan the filesystem
-      (let/cc found
+      (let/ec found
         (library-fold mod/path
                       (^[mod path seed] (found #t))
                       #f
@@ -38,8 +38,13 @@
   (use srfi.13)
   (use gauche.fcntl)
   (use gauche.threads)
+  (use gauche.uvector)
+  (use gauche.vport)
   (export <log-drain>
+          <log-buffered-drain>
           log-open
+          log-flush
+          log-close
           log-format
           log-display
           log-write
@@ -208,10 +213,141 @@
      (unlock-file (determine-lock-policy drain port) port data)]
     [else #t]))
 
+;; Buffered drain
+;;   Keeps the log file open, and accumulates messages in the buffer of
+;;   a buffered port.  The buffer is written out in one batch, under the
+;;   file lock, when it gets full, periodically by a background thread,
+;;   and at exit (Gauche flushes all buffered output ports on exit).
+;;   Since a writer that finds the buffer full writes it out by itself,
+;;   the memory is bounded by buffer-size.
+;;   The log file may be shared by other processes, so the decision and
+;;   the act of rotation are done under the file lock, based on the
+;;   actual file.  A process that finds the file rotated by others
+;;   reopens it.
+
+(define-class <log-buffered-drain> (<log-drain>)
+  ((buffer-size     :init-keyword :buffer-size :initform 65536)
+   (flush-interval  :init-keyword :flush-interval :initform 1) ; seconds
+   (rotate-size     :init-keyword :rotate-size :initform #f)   ; bytes
+   (rotate-interval :init-keyword :rotate-interval :initform #f) ; seconds
+   (rotate-count    :init-keyword :rotate-count :initform 5)
+   ;; private
+   (%port    :init-value #f)            ; <buffered-output-port>, or #f
+                                        ;  once closed
+   (%file    :init-value #f)            ; log file port, kept open
+   (%opened  :init-value 0)             ; sys-time the file is opened
+   (%flusher :init-value #f)            ; background thread
+   (%lock    :init-form (make-mutex))   ; serializes flusher and log-close
+   ))
+
+(define-method initialize ((self <log-buffered-drain>) initargs)
+  (next-method)
+  (unless (string? (slot-ref self 'path))
+    (error "<log-buffered-drain> requires a file path, but got:"
+           (slot-ref self 'path)))
+  (buffered-drain-open-file! self)
+  (set! (slot-ref self '%port)
+        (make <buffered-output-port>
+          :buffer-size (slot-ref self 'buffer-size)
+          :flush (^[buf _] (buffered-drain-write! self buf))))
+  (let1 interval (slot-ref self 'flush-interval)
+    (when interval
+      (set! (slot-ref self '%flusher)
+            (start-flusher (rlet1 wv (make-weak-vector 1)
+                             (weak-vector-set! wv 0 self))
+                           (slot-ref self 'path)
+                           interval)))))
+
+;; The flusher thread refers to the drain only through a weak vector WV,
+;; so that an abandoned drain can be collected.  The thread exits when
+;; the drain is closed or collected.
+(define (start-flusher wv path interval)
+  ($ thread-start! $ make-thread
+     (^[] (let loop ()
+            (thread-sleep! interval)
+            (when (guard (e [else
+                             (warn "Error in flushing log ~s: ~a\n" path e)
+                             #t])
+                    (and-let1 drain (weak-vector-ref wv 0 #f)
+                      (with-locking-mutex (slot-ref drain '%lock)
+                        (^[] (and-let1 p (slot-ref drain '%port)
+                               (flush p)
+                               #t)))))
+              (loop))))
+     "log-flusher"))
+
+(define (buffered-drain-open-file! drain)
+  (let1 p (open-output-file (slot-ref drain 'path) :if-exists :append)
+    (set! (slot-ref drain '%file) p)
+    (set! (slot-ref drain '%opened) (sys-time))))
+
+(define (buffered-drain-reopen-file! drain)
+  (close-output-port (slot-ref drain '%file))
+  (buffered-drain-open-file! drain))
+
+;; Called from the flush procedure of the buffered port, hence it is
+;; serialized by the port's lock.
+(define (buffered-drain-write! drain buf)
+  (let loop ()
+    (let* ([p (slot-ref drain '%file)]
+           [l (lock-data drain p)])
+      (lock-file drain p l)
+      (if (buffered-drain-stale? drain p)
+        ;; Another process has rotated the file.
+        (begin (unlock-file drain p l)
+               (buffered-drain-reopen-file! drain)
+               (loop))
+        (let1 rotated? (unwind-protect
+                           (begin
+                             (write-uvector buf p)
+                             (flush p)
+                             (and (buffered-drain-rotate? drain p)
+                                  (begin (buffered-drain-rotate! drain) #t)))
+                         (unlock-file drain p l))
+          (when rotated?
+            (buffered-drain-reopen-file! drain))))))
+  (u8vector-length buf))
+
+;; Returns #t if the file port P no longer refers to the file at path.
+(define (buffered-drain-stale? drain p)
+  (let1 st (sys-fstat p)
+    (guard (e [(<system-error> e) #t])
+      (let1 st2 (sys-stat (slot-ref drain 'path))
+        (not (and (eqv? (slot-ref st 'dev) (slot-ref st2 'dev))
+                  (eqv? (slot-ref st 'ino) (slot-ref st2 'ino))))))))
+
+(define (buffered-drain-rotate? drain p)
+  (let ([size (slot-ref drain 'rotate-size)]
+        [interval (slot-ref drain 'rotate-interval)])
+    (or (and size (>= (slot-ref (sys-fstat p) 'size) size))
+        (and interval
+             (>= (- (sys-time) (slot-ref drain '%opened)) interval)))))
+
+;; path.N-1 -> path.N, ..., path -> path.1
+;; Called with the file locked.  The caller reopens the file after
+;; releasing the lock.
+(define (buffered-drain-rotate! drain)
+  (let ([path (slot-ref drain 'path)]
+        [count (slot-ref drain 'rotate-count)])
+    (let loop ([n (- count 1)])
+      (when (> n 0)
+        (let1 src #"~|path|.~n"
+          (when (file-exists? src)
+            (sys-rename src #"~|path|.~(+ n 1)")))
+        (loop (- n 1))))
+    (if (> count 0)
+      (sys-rename path #"~|path|.1")
+      (sys-unlink path))))
+
 ;; Write log
 (define (with-log-output drain proc)
   (let1 path (slot-ref drain 'path)
-    (cond [(string? path)
+    (cond [(is-a? drain <log-buffered-drain>)
+           ;; NB: PROC writes the message with one call, which is atomic
+           ;; with the port lock.
+           (proc (or (slot-ref drain '%port)
+                     (error "log drain is already closed:" path)))]
+          [(string? path)
            (let* ([p (open-output-file path :if-exists :append)]
                   [l (lock-data drain p)])
              (dynamic-wind
@@ -257,10 +393,33 @@
 (define (log-write obj :optional (drain (log-default-drain)))
   (log-format drain "~s" obj))
 
-;; log-open path :key program-name prefix
+;; log-open path :key program-name prefix buffered ...
+;;  If buffered is true, <log-buffered-drain> is created, and other
+;;  keyword arguments for it are accepted.
 
 (define (log-open path . args)
-  (log-default-drain (apply make <log-drain> :path path args)))
+  (log-default-drain
+   (apply make (if (get-keyword :buffered args #f)
+                 <log-buffered-drain>
+                 <log-drain>)
+          :path path (delete-keyword :buffered args))))
+
+;; Write out the buffered messages.  Noop for unbuffered drains.
+(define (log-flush :optional (drain (log-default-drain)))
+  (when (is-a? drain <log-buffered-drain>)
+    (and-let1 p (slot-ref drain '%port)
+      (flush p))))
+
+;; Write out the buffered messages and close the file.  The background
+;; flusher exits when it wakes up next time.  Noop for unbuffered drains,
+;; and for a drain already closed.
+(define (log-close :optional (drain (log-default-drain)))
+  (when (is-a? drain <log-buffered-drain>)
+    (with-locking-mutex (slot-ref drain '%lock)
+      (^[] (and-let1 p (slot-ref drain '%port)
+             (set! (slot-ref drain '%port) #f)
+             (unwind-protect (close-output-port p)
+               (close-output-port (slot-ref drain '%file))))))))
 
 ;; log-from-input-port [drain] iport :key formatter
 ;;  returns thread
@@ -32,7 +32,9 @@
 ;;;
 
 (define-module gauche.modutil
-  (export export-if-defined use-version describe-symbol-bindings)
+  (use gauche.threads)
+  (export export-if-defined use-version describe-symbol-bindings
+          preload-modules)
   )
 (select-module gauche.modutil)
 
@@ -87,3 +89,110 @@
                      (length bindings) sym)
              (for-each (cut apply describe-binding <>) bindings))))
   (values))
+;;
+;; Parallel loading
+;;
+
+;; Returns a list of module names the source of module M uses, as far as
+;; we can tell by toplevel 'use' and 'extend' forms, including those in
+;; 'define-module'.  It's only a hint for scheduling; if we miss some,
+;; require still takes care of them.
+(define (module-dependencies m)
+  (define (scan form acc)
+    (if (pair? form)
+      (case (car form)
+        [(use) (if (and (pair? (cdr form)) (symbol? (cadr form)))
+                 (cons (cadr form) acc)
+                 acc)]
+        [(extend) (fold (^[m acc] (if (symbol? m) (cons m acc) acc))
+                        acc (cdr form))]
+        [(define-module) (if (pair? (cdr form)) (fold scan acc (cddr form)) acc)]
+        [else acc])
+      acc))
+  (or (and-let* ([r ((with-module gauche.internal find-load-file)
+                     (module-name->path m) (load-paths) (load-suffixes))])
+        (guard (e [else '()])
+          (call-with-input-file (car r)
+            (^[in] (let loop ([acc '()])
+                     (let1 form (read in)
+                       (if (eof-object? form)
+                         (reverse! acc)
+                         (loop (scan form acc)))))))))
+      '()))
+
+;; Load modules and the modules they use, with NUM-THREADS threads.
+;; A module is loaded after all the modules it uses are loaded, so
+;; independent ones run in parallel.
+(define (preload-modules modules :key (num-threads 4))
+  (define %require (with-module gauche.internal %require))
+  (define deps (make-hash-table 'eq?))       ; module -> modules it uses
+  (define dependents (make-hash-table 'eq?)) ; module -> modules using it
+  (define pending (make-hash-table 'eq?))    ; module -> # of unloaded deps
+  (define (scan! m)
+    (unless (or (hash-table-exists? deps m) (find-module m))
+      (hash-table-put! deps m '())
+      (let1 ds (module-dependencies m)
+        (hash-table-put! deps m ds)
+        (for-each scan! ds))))
+  (for-each scan! modules)
+
+  (let ([mutex (make-mutex)]
+        [cv (make-condition-variable)]
+        [ready '()]
+        [remaining (hash-table-num-entries deps)]
+        [busy 0]
+        [err #f])
+    ;; If the dependency hint has a cycle, we may get stuck with nothing
+    ;; to run.  We just release all the waiting modules then; require
+    ;; reports the error if the cycle is real.
+    (define (release-all!)
+      (hash-table-for-each pending
+                           (^[m n] (when (> n 0)
+                                     (hash-table-put! pending m 0)
+                                     (push! ready m))))
+      (pair? ready))
+    (define (next!)
+      (mutex-lock! mutex)
+      (let loop ()
+        (cond [(or err (zero? remaining)) (mutex-unlock! mutex) #f]
+              [(pair? ready)
+               (let1 m (pop! ready)
+                 (inc! busy)
+                 (mutex-unlock! mutex)
+                 m)]
+              [(zero? busy)
+               (if (release-all!) (loop) (begin (mutex-unlock! mutex) #f))]
+              [else (mutex-unlock! mutex cv) (mutex-lock! mutex) (loop)])))
+    (define (done! m e)
+      (with-locking-mutex mutex
+        (^[]
+          (dec! busy)
+          (dec! remaining)
+          (if e
+            (unless err (set! err e))
+            (dolist [d (hash-table-get dependents m '())]
+              (hash-table-update! pending d (cut - <> 1))
+              (when (zero? (hash-table-get pending d))
+                (push! ready d))))
+          (condition-variable-broadcast! cv))))
+    (define (worker)
+      (let loop ()
+        (and-let1 m (next!)
+          (done! m (guard (e [else e])
+                     (%require (module-name->path m))
+                     #f))
+          (loop))))
+    (hash-table-for-each
+     deps
+     (^[m ds]
+       (let1 ds (delete-duplicates
+                 (filter (^d (and (not (eq? d m)) (hash-table-exists? deps d)))
+                         ds))
+         (hash-table-put! pending m (length ds))
+         (dolist [d ds] (hash-table-push! dependents d m))
+         (when (null? ds) (push! ready m)))))
+    (let1 ts (map (^_ (thread-start! (make-thread worker)))
+                  (iota (max 1 num-threads)))
+      (for-each thread-join! ts))
+    (when err (raise err))
+    (undefined)))
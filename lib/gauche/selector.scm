@@ -32,6 +32,17 @@
 ;;;
 
 
+;; On systems with epoll (Linux), the readiness of fds is watched by epoll
+;; instead of select.  It doesn't have the FD_SETSIZE limit, and the cost
+;; of waiting only depends on the number of ready fds, which matters when
+;; we watch thousands of connections.  The handler lists are kept for
+;; both backends, so that selector-delete! works the same way.
+;; The backend is chosen when a selector is created.
+;;
+;; epoll refuses regular files (EPERM).  Select reports them always
+;; ready, so we do the same; such fds are kept in the 'always' table
+;; and not registered to epoll.
+
 (define-module gauche.selector
   (use scheme.list)
   (export <selector> selector-add! selector-delete! selector-select)
@@ -45,6 +56,13 @@
    (rhandlers :init-form '())  ; list of (port-or-fd . proc)
    (whandlers :init-form '())  ; ditto
    (xhandlers :init-form '())  ; ditto
+   ;; The following slots are only used with epoll backend.
+   (epfd :init-form #f)        ; port holding epoll fd, created lazily
+   (fdmap :init-form (make-hash-table 'eqv?))  ; fd -> list of
+                                               ;  (flag port-or-fd . proc)
+   (portfd :init-form (make-hash-table 'eqv?)) ; port-or-fd -> fd
+   (always :init-form (make-hash-table 'eqv?)) ; fds epoll can't watch
+   (epoll? :init-form *use-epoll*)
   ))
 
 (define (canon-flag flag)
@@ -62,26 +80,162 @@
   (case flag
     [(r) 'rhandlers] [(w) 'whandlers] [(x) 'xhandlers]))
 
+;;
+;; epoll backend
+;;
+
+(cond-expand
+ [gauche.sys.epoll
+  (define *use-epoll* #t)
+
+  (define (flag->events flag)
+    (case flag
+      [(r) EPOLLIN] [(w) EPOLLOUT] [(x) EPOLLPRI]))
+
+  (define (events->flags events)
+    (cond-list
+     [(logtest events (logior EPOLLIN EPOLLERR EPOLLHUP)) 'r]
+     [(logtest events (logior EPOLLOUT EPOLLERR)) 'w]
+     [(logtest events EPOLLPRI) 'x]))
+
+  ;; We keep the epoll fd as an owner port, so that it is closed when
+  ;; the selector is garbage-collected.
+  (define (%epfd selector)
+    (port-file-number
+     (or (slot-ref selector 'epfd)
+         (rlet1 p (open-input-fd-port (sys-epoll-create) :owner? #t
+                                      :name "(epoll)")
+           (slot-set! selector 'epfd p)))))
+
+  ;; Register FD with MASK to the epoll set.  The fdmap entry of an fd
+  ;; that was closed and whose number is reused is stale; MOD fails
+  ;; with ENOENT then, and we ADD instead.  Likewise, ADD fails with
+  ;; EEXIST if a dup of a closed fd keeps the old registration.
+  (define (%epoll-register! selector fd mask add?)
+    (unless (hash-table-exists? (slot-ref selector 'always) fd)
+      (let1 epfd (%epfd selector)
+        (guard (e [(<system-error> e)
+                   (let1 errno (condition-ref e 'errno)
+                     (cond [(eqv? errno EPERM)
+                            (hash-table-put! (slot-ref selector 'always) fd #t)]
+                           [(eqv? errno ENOENT)
+                            (sys-epoll-ctl epfd EPOLL_CTL_ADD fd mask)]
+                           [(eqv? errno EEXIST)
+                            (sys-epoll-ctl epfd EPOLL_CTL_MOD fd mask)]
+                           [else (raise e)]))])
+          (sys-epoll-ctl epfd (if add? EPOLL_CTL_ADD EPOLL_CTL_MOD) fd mask)))))
+
+  ;; Register events of FD according to its entries
+  (define (%epoll-update! selector fd old-entries)
+    (let* ([entries (hash-table-get (slot-ref selector 'fdmap) fd '())]
+           [mask (fold (^[e m] (logior m (flag->events (car e)))) 0 entries)])
+      (cond [(null? entries)
+             (hash-table-delete! (slot-ref selector 'fdmap) fd)
+             (if (hash-table-exists? (slot-ref selector 'always) fd)
+               (hash-table-delete! (slot-ref selector 'always) fd)
+               ;; The fd may already be closed, in which case the kernel
+               ;; has removed it from the epoll set.
+               (guard (e [(<system-error> e) #f])
+                 (sys-epoll-ctl (%epfd selector) EPOLL_CTL_DEL fd)))]
+            [else (%epoll-register! selector fd mask (null? old-entries))])))
+
+  (define (%epoll-add! selector port-or-fd proc flag)
+    (let* ([fd (if (integer? port-or-fd)
+                 port-or-fd
+                 (port-file-number port-or-fd))]
+           [old (hash-table-get (slot-ref selector 'fdmap) fd '())])
+      (unless fd
+        (error "port isn't associated with a file descriptor:" port-or-fd))
+      (hash-table-put! (slot-ref selector 'portfd) port-or-fd fd)
+      (hash-table-put! (slot-ref selector 'fdmap) fd
+                       (cons (cons* flag port-or-fd proc) old))
+      (%epoll-update! selector fd old)))
+
+  (define (%epoll-remove! selector port-or-fd proc flag)
+    (and-let* ([fd (hash-table-get (slot-ref selector 'portfd) port-or-fd #f)]
+               [old (hash-table-get (slot-ref selector 'fdmap) fd '())])
+      (let1 new (remove (^e (and (eq? (car e) flag)
+                                 (eqv? (cadr e) port-or-fd)
+                                 (eq? (cddr e) proc)))
+                        old)
+        (hash-table-put! (slot-ref selector 'fdmap) fd new)
+        (unless (any (^e (eqv? (cadr e) port-or-fd)) new)
+          (hash-table-delete! (slot-ref selector 'portfd) port-or-fd))
+        (%epoll-update! selector fd old))))
+
+  ;; Returns the number of ready fds counted in the same way as
+  ;; sys-select, i.e. an fd ready for both reading and writing counts 2.
+  (define (%epoll-select selector timeout)
+    (define fdmap (slot-ref selector 'fdmap))
+    (define (fd-entries fd) (hash-table-get fdmap fd '()))
+    (if (zero? (hash-table-num-entries fdmap))
+      (begin (sys-select #f #f #f timeout) 0) ; just wait
+      (let* ([always (hash-table-keys (slot-ref selector 'always))]
+             [nwatch (- (hash-table-num-entries fdmap) (length always))]
+             [ready (append
+                     (if (zero? nwatch)
+                       '()
+                       (sys-epoll-wait (%epfd selector) nwatch
+                                       (if (null? always) timeout 0)))
+                     (map (^[fd] (cons fd (logior EPOLLIN EPOLLOUT)))
+                          always))]
+             [calls (append-map
+                     (^[fd&events]
+                       (let1 flags (events->flags (cdr fd&events))
+                         (filter-map
+                          (^e (and (memq (car e) flags)
+                                   (list (cddr e) (cadr e) (car e))))
+                          (fd-entries (car fd&events)))))
+                     ready)]
+             [nfds (fold (^[fd&events n]
+                           (let1 flags (events->flags (cdr fd&events))
+                             (+ n (count (^f (any (^e (eq? (car e) f))
+                                                  (fd-entries (car fd&events))))
+                                         flags))))
+                         0 ready)])
+        ;; Call read handlers first, then write and exception handlers,
+        ;; as the select backend does.
+        (for-each (^h (apply (car h) (cdr h)))
+                  (append (filter (^h (eq? (caddr h) 'r)) calls)
+                          (filter (^h (eq? (caddr h) 'w)) calls)
+                          (filter (^h (eq? (caddr h) 'x)) calls)))
+        nfds)))]
+ [else
+  (define *use-epoll* #f)
+  (define (%epoll-add! selector port-or-fd proc flag) #f)
+  (define (%epoll-remove! selector port-or-fd proc flag) #f)
+  (define (%epoll-select selector timeout) 0)])
+
+;;
+;; API
+;;
+
 (define-method selector-add! ((selector <selector>) port-or-fd proc flags)
   (assume-type proc <procedure>)
   (assume-type flags <list>)
   (dolist [flag (map canon-flag flags)]
-    (let* ([slot (flag->fd-slot flag)]
-           [fds (or (slot-ref selector slot)
-                    (rlet1 f (make <sys-fdset>)
-                      (slot-set! selector slot f)))])
-      (set! (sys-fdset-ref fds port-or-fd) #t))
+    (if (slot-ref selector 'epoll?)
+      (%epoll-add! selector port-or-fd proc flag)
+      (let* ([slot (flag->fd-slot flag)]
+             [fds (or (slot-ref selector slot)
+                      (rlet1 f (make <sys-fdset>)
+                        (slot-set! selector slot f)))])
+        (set! (sys-fdset-ref fds port-or-fd) #t)))
     (slot-push! selector (flag->handler-slot flag) (cons port-or-fd proc))))
 
 (define-method selector-delete! ((selector <selector>) port-or-fd proc flags)
+  (define (unregister! flag entry)
+    (when (slot-ref selector 'epoll?)
+      (%epoll-remove! selector (car entry) (cdr entry) flag)))
   (let1 flags (if flags (map canon-flag flags) '(r w x))
-    (for-each (^[fds handlers]
+    (for-each (^[flag fds handlers]
                 (cond
                  [port-or-fd
                   (if-let1 p (assoc port-or-fd (slot-ref selector handlers))
                     (when (or (not proc) (eq? proc (cdr p)))
                       (slot-set! selector handlers
                                  (delete p (slot-ref selector handlers)))
+                      (unregister! flag p)
                       (if-let1 fds (slot-ref selector fds)
                         (sys-fdset-set! fds port-or-fd #f))))]
                  [proc
@@ -90,14 +244,18 @@
                     (cond [(null? h)
                            (slot-set! selector handlers (reverse newh))]
                           [(eq? proc (cdar h))
+                           (unregister! flag (car h))
                            (if-let1 fds (slot-ref selector fds)
                              (sys-fdset-set! fds (caar h) #f))
                            (loop (cdr h) newh)]
                           [else
                            (loop (cdr h) (cons (car h) newh))]))]
                  [else
+                  (for-each (cut unregister! flag <>)
+                            (slot-ref selector handlers))
                   (slot-set! selector fds #f)
                   (slot-set! selector handlers '())]))
+              flags
               (map flag->fd-slot flags)
               (map flag->handler-slot flags))))
 
@@ -112,15 +270,17 @@
           '()
           handlers))
 
-  (receive (nfds rfds wfds xfds)
-      (sys-select (slot-ref selector 'rfds)
-                  (slot-ref selector 'wfds)
-                  (slot-ref selector 'xfds)
-                  timeout)
-    (when (> nfds 0)
-      (for-each (^h (apply (car h) (cdr h)))
-                (append
-                 (pick-handlers rfds (slot-ref selector 'rhandlers) 'r)
-                 (pick-handlers wfds (slot-ref selector 'whandlers) 'w)
-                 (pick-handlers xfds (slot-ref selector 'xhandlers) 'x))))
-    nfds))
+  (if (slot-ref selector 'epoll?)
+    (%epoll-select selector timeout)
+    (receive (nfds rfds wfds xfds)
+        (sys-select (slot-ref selector 'rfds)
+                    (slot-ref selector 'wfds)
+                    (slot-ref selector 'xfds)
+                    timeout)
+      (when (> nfds 0)
+        (for-each (^h (apply (car h) (cdr h)))
+                  (append
+                   (pick-handlers rfds (slot-ref selector 'rhandlers) 'r)
+                   (pick-handlers wfds (slot-ref selector 'whandlers) 'w)
+                   (pick-handlers xfds (slot-ref selector 'xhandlers) 'x))))
+      nfds)))
@@ -88,7 +88,7 @@
 ;; This routine should be in sync of it.
 (define (profiler-show-load-stats stats)
   (let1 results '() ; [(<filename> . <time>)]
-    (let/cc return
+    (let/ec return
       (define (start stats)
         (match stats
           [()  (show-results)]
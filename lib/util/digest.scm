@@ -39,8 +39,9 @@
   (use gauche.uvector)
   (use rfc.base64)
   (export <message-digest-algorithm> <message-digest-algorithm-meta>
-          digest-update! digest-final! digest
+          digest-update! digest-final! digest digest-message
           digest-to digest-message-to
+          digest-file-to tree-digest-file-to
 
           ;; Obsoleted API
           digest-string digest-hexify)
@@ -48,6 +49,7 @@
 (select-module util.digest)
 
 (autoload gauche.vport open-input-uvector)
+(autoload control.pmap pmap)
 
 ;; API for digest algorithms
 ;;   Actual digest algorithms such as SHA should subclass
@@ -56,12 +58,19 @@
 (define-class <message-digest-algorithm-meta> (<class>)
   ;; Block size (in bytes) used in HMAC, determined by each algorithm.
   ;; Older algorithms uses 64, while SHA-384/512 uses 128.
-  ((hmac-block-size :init-keyword :hmac-block-size :init-value 64)))
+  ((hmac-block-size :init-keyword :hmac-block-size :init-value 64)
+   ;; True if the algorithm never keeps the data given to digest-update!
+   ;; or digest-message, so that digest-file-to can pass a view to the
+   ;; mapped file and unmap it right after.  Only the built-in algorithms
+   ;; set this; it isn't inherited by subclasses.
+   (transient-data :init-keyword :transient-data :init-value #f)))
 
 (define-class <message-digest-algorithm> ()
   ()
   :metaclass <message-digest-algorithm-meta>)
 
+;; NB: Built-in algorithms also accept other uvectors and an input port
+;; as DATA.
 (define-method digest-update! ((self <message-digest-algorithm>) data)
   #f)
 (define-method digest-final! ((self <message-digest-algorithm>))
@@ -69,13 +78,18 @@
 (define-method digest ((digester <message-digest-algorithm-meta>))
   #f)
 
-;; User API
-(define-method digest-to ((target <string-meta>)
-                          (digester <message-digest-algorithm-meta>))
-  (digest digester))
-(define-method digest-to ((target <u8vector-meta>)
-                          (digester <message-digest-algorithm-meta>))
-  (string->u8vector (digest digester)))
+;; Returns the digest of MESSAGE (a string or a u8vector) as an
+;; incomplete string.  The default method feeds MESSAGE through a
+;; port; the algorithms can specialize this to hash the message directly.
+(define-method digest-message ((digester <message-digest-algorithm-meta>)
+                               message)
+  (etypecase message
+    [<string> (with-input-from-string message (cut digest digester))]
+    [<u8vector> (with-input-from-port (open-input-uvector message)
+                  (cut digest digester))]))
+
+;; Converts the raw digest (incomplete string) into TARGET.
+;; Returns #f if TARGET isn't one of the built-in targets.
 ;; Special targets:
 ;;   base64
 ;;   base64url
@@ -84,29 +98,122 @@
 ;;   base32hex
 ;;   base16
 ;;   hex
+(define (%convert-digest target raw)
+  (cond [(eq? target <string>) raw]
+        [(eq? target <u8vector>) (string->u8vector raw)]
+        [(symbol? target)
+         (let1 encoder
+             (ecase target
+               [(base64) base64-encode-message]
+               [(base64url) (cut base64-encode-message <> :url-safe #t)]
+               [(base64url-nopad) (cut base64-encode-message <>
+                                       :url-safe #t :omit-padding #t)]
+               [(base32) base32-encode-message]
+               [(base32hex) base32hex-encode-message]
+               [(base16) base16-encode-message]
+               [(hex) (cut base16-encode-message <> :lowercase #t)])
+           (encoder raw))]
+        [else #f]))
+
+(define (%builtin-target? target)
+  (or (eq? target <string>) (eq? target <u8vector>) (symbol? target)))
+
+;; User API
+(define-method digest-to ((target <string-meta>)
+                          (digester <message-digest-algorithm-meta>))
+  (%convert-digest target (digest digester)))
+(define-method digest-to ((target <u8vector-meta>)
+                          (digester <message-digest-algorithm-meta>))
+  (%convert-digest target (digest digester)))
 (define-method digest-to ((target <symbol>)
                           (digester <message-digest-algorithm-meta>))
-  (define encoder
-    (ecase target
-      [(base64) base64-encode-message]
-      [(base64url) (cut base64-encode-message <> :url-safe #t)]
-      [(base64url-nopad) (cut base64-encode-message <>
-                              :url-safe #t :omit-padding #t)]
-      [(base32) base32-encode-message]
-      [(base32hex) base32hex-encode-message]
-      [(base16) base16-encode-message]
-      [(hex) (cut base16-encode-message <> :lowercase #t)]))
-  (encoder (digest digester)))
+  (%convert-digest target (digest digester)))
 
 ;; User API
 (define-method digest-message-to (target
                                   (digester <message-digest-algorithm-meta>)
                                   message)
-  (etypecase message
-    [<string> (with-input-from-string message (cut digest-to target digester))]
-    [<u8vector> (with-input-from-port (open-input-uvector message)
-                  (cut digest-to target digester))]))
+  (if (%builtin-target? target)
+    (%convert-digest target (digest-message digester message))
+    (etypecase message
+      [<string> (with-input-from-string message (cut digest-to target digester))]
+      [<u8vector> (with-input-from-port (open-input-uvector message)
+                    (cut digest-to target digester))])))
 
+;; Maps the regular file FILENAME and calls PROC with the memory region
+;; and its size.  If the file can't be mapped (e.g. it's a pipe), calls
+;; FALLBACK with the opened port instead.
+;; The region is unmapped as soon as PROC returns, so that hashing many
+;; files doesn't keep them mapped until GC.  PROC must not let a view to
+;; the region escape; see %region-view.
+(define (%call-with-mapped-file filename proc fallback)
+  (call-with-input-file filename
+    (^p (let1 st (sys-fstat p)
+          (cond [(not (eq? (~ st'type) 'regular)) (fallback p)]
+                [(zero? (~ st'size)) (proc #f 0)]
+                [else
+                 (let1 mem (sys-mmap p PROT_READ MAP_PRIVATE (~ st'size))
+                   (unwind-protect (proc mem (~ st'size))
+                     ((with-module gauche.internal %sys-munmap) mem)))])))))
+
+;; Returns the part of the mapped region as a u8vector.  A view is
+;; only given to the built-in algorithms, which don't keep it; other
+;; algorithms get a copy, since they may retain the data after the
+;; region is unmapped.
+(define (%region-view digester mem size
+                      :optional (offset 0) (len (- size offset)))
+  (cond [(not mem) (u8vector)]
+        [(~ digester'transient-data)
+         (make-view-uvector mem <u8vector> len offset #t)]
+        [else (u8vector-copy (make-view-uvector mem <u8vector> len offset #t))]))
+
+;; User API
+;;   Same as (digest-message-to target digester <file content>), but
+;;   the file is mapped and hashed in place.
+(define (digest-file-to target digester filename)
+  (%call-with-mapped-file filename
+    (^[mem size]
+      (%convert-digest target
+                       (digest-message digester
+                                       (%region-view digester mem size))))
+    (^[port] (%convert-digest target
+                              (with-input-from-port port
+                                (cut digest digester))))))
+
+;; User API
+;;   Tree hash of the file.  The file is split into LEAF-SIZE chunks,
+;;   each chunk is hashed as H(#x00 || chunk) in parallel, and the result
+;;   is H(#x01 || leaf-digest ...).  The value differs from the plain
+;;   digest of the file, so it is only comparable to another tree digest
+;;   with the same algorithm and LEAF-SIZE.
+(define (tree-digest-file-to target digester filename
+                             :key (leaf-size 1048576) (mapper #f))
+  (define (hash-leaf view)
+    (let1 d (make digester)
+      (digest-update! d '#u8(0))
+      (digest-update! d view)
+      (digest-final! d)))
+  (define (hash-root leaves)
+    (let1 d (make digester)
+      (digest-update! d '#u8(1))
+      (for-each (cut digest-update! d <>) leaves)
+      (digest-final! d)))
+  (unless (and (exact-integer? leaf-size) (positive? leaf-size))
+    (error "leaf-size must be a positive exact integer, but got:" leaf-size))
+  (%call-with-mapped-file filename
+    (^[mem size]
+      (let* ([offsets (if (zero? size)
+                        '(0)
+                        (iota (quotient (+ size leaf-size -1) leaf-size)
+                              0 leaf-size))]
+             [leaf (^[off] (hash-leaf (%region-view digester mem size off
+                                                    (min leaf-size
+                                                         (- size off)))))]
+             [leaves (if mapper
+                       (pmap leaf offsets :mapper mapper)
+                       (pmap leaf offsets))])
+        (%convert-digest target (hash-root leaves))))
+    (^[port] (error "tree-digest-file-to requires a regular file:" filename))))
 
 ;; OBSOLETED
 ;;  Use digest-message-to.
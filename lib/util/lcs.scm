@@ -51,24 +51,37 @@
 ;; The base algorithm.   This code implements
 ;; Eugene Myers, "An O(ND) Difference Algorithm and Its Variations",
 ;; Algorithmica Vol. 1 No. 2, 1986, pp. 251-266.
-;; It takes O((M+N)D) time and O((M+N)L) space, where
-;; N = (length a), M = (length b), D is the length of the smallest edit
-;; sequence (SES), and L is the length of the longest common subsequence (LCS).
+;; It takes O((M+N)D) time, where N = (length a), M = (length b), and
+;; D is the length of the smallest edit sequence (SES).
 ;; In most applications the difference is small, so it is much better than
 ;; DP algorithm that is generally O(MN) time and space complextiy.
-;; The worst case where a and b totally differ is O((M+N)^2).
-;; The Myers's paper gives refinement of the algorithm
-;; that improves worst case behavior, but I don't implement it yet. --[SK]
+;;
+;; The basic algorithm (lcs-basic) keeps the matched elements of each
+;; diagonal, which takes O((M+N)L) space where L is the length of the LCS;
+;; it becomes prohibitive for large inputs with many differences.  So we
+;; use the linear space refinement in the paper (Section 4b): find the
+;; "middle snake" of the optimal path by searching from both ends
+;; (middle-snake), and recurse on both sides of it.  Subproblems up to
+;; *lcs-basic-limit* elements, or with D <= 1, are handed to lcs-basic.
+;;
+;; If the equivalence predicate is one of eq?, eqv?, equal? or string=?,
+;; we map each element to an integer with a hash table first, and run
+;; the same algorithm in C (src/lcs.c) over s32vectors.  Both versions
+;; must choose the same subsequence.
 
-(define (lcs-with-positions a-ls b-ls :optional (eq equal?))
-  (let* ((A  (list->vector a-ls))
-         (B  (list->vector b-ls))
-         (N  (vector-length A))
-         (M  (vector-length B))
+(define-constant *lcs-basic-limit* 1024) ; must agree with src/gauche/priv/lcsP.h
+
+(define %lcs-positions (with-module gauche.internal %lcs-positions))
+
+;; Returns a list of (a-index . b-index) of the LCS of A[x0,x1) and
+;; B[y0,y1), followed by TAIL.
+(define (lcs-basic A B x0 x1 y0 y1 eq tail)
+  (let* ((N  (- x1 x0))
+         (M  (- y1 y0))
          (M+N (+ N M))
-         (V_d (make-vector (+ (* 2 M+N) 1) 0))
-         (V_r (make-vector (+ (* 2 M+N) 1) '()))
-         (V_l (make-vector (+ (* 2 M+N) 1) 0)))
+         (V_d (make-vector (+ (* 2 M+N) 2) 0))
+         (V_r (make-vector (+ (* 2 M+N) 2) '()))
+         (V_l (make-vector (+ (* 2 M+N) 2) 0)))
 
     (let-syntax ((vd
                   (syntax-rules ()
@@ -85,14 +98,14 @@
 
       (define (finish)
         (let loop ((i (- M+N)) (maxl 0) (r '()))
-          (cond ((> i M+N) (list maxl (reverse! r)))
+          (cond ((> i M+N) (append! (reverse! r) tail))
                 ((> (vl i) maxl)
                  (loop (+ i 1) (vl i) (vr i)))
                 (else
                  (loop (+ i 1) maxl r)))))
 
       (if (zero? M+N)
-        '(0 ()) ;; boundary case
+        tail ;; boundary case
         (let d-loop ((d 0))
           (if (> d M+N)
             (error "lcs-with-positions; something's wrong (implementation error?)")
@@ -109,10 +122,10 @@
                       (let xy-loop ((x x) (y (- x k)) (l l) (r r))
                         (cond ((>= x N) (values x y l r))
                               ((>= y M) (values x y l r))
-                              ((eq (vector-ref A x) (vector-ref B y))
+                              ((eq (vector-ref A (+ x0 x))
+                                   (vector-ref B (+ y0 y)))
                                (xy-loop (+ x 1) (+ y 1) (+ l 1)
-                                        (cons (list (vector-ref A x) x y)
-                                              r)))
+                                        (acons (+ x0 x) (+ y0 y) r)))
                               (else (values x y l r))))
                     (vd k x)
                     (vr k r)
@@ -124,6 +137,117 @@
             )))
       )))
 
+;; Finds the middle snake of A[x0,x1) and B[y0,y1).  Returns the length
+;; of the SES, and the start and end points of the snake.
+(define (middle-snake A B x0 x1 y0 y1 eq)
+  (let* ([N (- x1 x0)]
+         [M (- y1 y0)]
+         [delta (- N M)]
+         [odd (odd? delta)]
+         [maxd (quotient (+ N M 1) 2)]
+         [off (+ maxd 1)]
+         [V_f (make-vector (+ (* 2 off) 1) 0)]
+         [V_b (make-vector (+ (* 2 off) 1) 0)])
+    (let-syntax ([vf (syntax-rules ()
+                       [(_ k) (vector-ref V_f (+ k off))]
+                       [(_ k x) (vector-set! V_f (+ k off) x)])]
+                 [vb (syntax-rules ()
+                       [(_ k) (vector-ref V_b (+ k off))]
+                       [(_ k x) (vector-set! V_b (+ k off) x)])]
+                 ;; Where the D-path on diagonal K starts its snake, in
+                 ;; the forward (V = vf) or backward (V = vb) direction.
+                 [start-point
+                  (syntax-rules ()
+                    [(_ v k d)
+                     (if (or (= k (- d))
+                             (and (not (= k d)) (< (v (- k 1)) (v (+ k 1)))))
+                       (v (+ k 1))
+                       (+ (v (- k 1)) 1))])])
+      (let d-loop ([d 0])
+        (when (> d maxd)
+          (error "middle-snake; something's wrong (implementation error?)"))
+        (let f-loop ([k (- d)])
+          (if (> k d)
+            (let b-loop ([k (- d)])
+              (if (> k d)
+                (d-loop (+ d 1))
+                (let* ([su (start-point vb k d)]
+                       [sv (- su k)])
+                  (let snake ([u su] [v sv])
+                    (if (and (< u N) (< v M)
+                             (eq (vector-ref A (- x1 1 u))
+                                 (vector-ref B (- y1 1 v))))
+                      (snake (+ u 1) (+ v 1))
+                      (begin
+                        (vb k u)
+                        (if (and (not odd)
+                                 (<= (- d) (- delta k) d)
+                                 (>= (+ u (vf (- delta k))) N))
+                          (values (* 2 d) (- x1 u) (- y1 v) (- x1 su) (- y1 sv))
+                          (b-loop (+ k 2)))))))))
+            (let* ([sx (start-point vf k d)]
+                   [sy (- sx k)])
+              (let snake ([x sx] [y sy])
+                (if (and (< x N) (< y M)
+                         (eq (vector-ref A (+ x0 x)) (vector-ref B (+ y0 y))))
+                  (snake (+ x 1) (+ y 1))
+                  (begin
+                    (vf k x)
+                    (if (and odd
+                             (<= (- delta (- d 1)) k (+ delta (- d 1)))
+                             (>= (+ x (vb (- delta k))) N))
+                      (values (- (* 2 d) 1)
+                              (+ x0 sx) (+ y0 sy) (+ x0 x) (+ y0 y))
+                      (f-loop (+ k 2)))))))))))))
+
+(define (lcs-rec A B x0 x1 y0 y1 eq tail)
+  (if (or (<= (+ (- x1 x0) (- y1 y0)) *lcs-basic-limit*)
+          (= x0 x1) (= y0 y1))
+    (lcs-basic A B x0 x1 y0 y1 eq tail)
+    (receive (d sx sy ex ey) (middle-snake A B x0 x1 y0 y1 eq)
+      (if (<= d 1)
+        (lcs-basic A B x0 x1 y0 y1 eq tail)
+        (lcs-rec A B x0 sx y0 sy eq
+                 (let loop ([x (- ex 1)] [y (- ey 1)]
+                            [r (lcs-rec A B ex x1 ey y1 eq tail)])
+                   (if (< x sx)
+                     r
+                     (loop (- x 1) (- y 1) (acons x y r)))))))))
+
+;; Returns a hash table type that can be used to compare elements
+;; with EQ, or #f.
+(define (hashable-equivalence eq)
+  (cond [(eq? eq equal?) 'equal?]
+        [(eq? eq eqv?) 'eqv?]
+        [(eq? eq eq?) 'eq?]
+        [(eq? eq string=?) 'string=?]
+        [else #f]))
+
+;; Returns a list of (a-index . b-index) of the LCS of vectors A and B.
+(define (lcs-positions A B eq)
+  (if-let1 type (hashable-equivalence eq)
+    ;; Give each distinct element of A an id; elements only in B get -1.
+    (let* ([tab (make-hash-table type)]
+           [ia (make-s32vector (vector-length A))]
+           [ib (make-s32vector (vector-length B))])
+      (dotimes [i (vector-length A)]
+        (let1 x (vector-ref A i)
+          (s32vector-set! ia i
+                          (or (hash-table-get tab x #f)
+                              (rlet1 id (hash-table-num-entries tab)
+                                (hash-table-put! tab x id))))))
+      (dotimes [i (vector-length B)]
+        (s32vector-set! ib i (hash-table-get tab (vector-ref B i) -1)))
+      (%lcs-positions ia ib))
+    (lcs-rec A B 0 (vector-length A) 0 (vector-length B) eq '())))
+
+(define (lcs-with-positions a-ls b-ls :optional (eq equal?))
+  (let* ([A (list->vector a-ls)]
+         [B (list->vector b-ls)]
+         [ps (lcs-positions A B eq)])
+    (list (length ps)
+          (map (^p (list (vector-ref A (car p)) (car p) (cdr p))) ps))))
+
 ;; Just returns the LCS
 (define (lcs a b :optional (eq equal?))
   (map car (cadr (lcs-with-positions a b eq))))
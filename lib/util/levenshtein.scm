@@ -140,7 +140,7 @@
 
     (define f
       (if cutoff
-        (^[B] (let/cc break
+        (^[B] (let/ec break
                 (run B (^d (if (< cutoff d) (break #f))))))
         (cut run <> #f)))
 
@@ -212,7 +212,7 @@
 
     (define f
       (if cutoff
-        (^[B] (let/cc break
+        (^[B] (let/ec break
                 (run B (^d (if (< cutoff d) (break #f))))))
         (cut run <> #f)))
 
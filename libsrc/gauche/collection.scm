@@ -456,6 +456,83 @@
 ;; redefine for-each$ to use generic version of for-each
 (define ((for-each$ proc) . args) (apply for-each proc args))
 
+;; shortcuts for vectors and strings --------------------
+
+;; These loop with the type-specific accessors instead of the closures
+;; made by call-with-iterator.  They take a single collection and never
+;; call next-method, so the dispatcher (see the end of this file) picks
+;; them with one table lookup.  N-ary calls take the generic way.
+
+(define-syntax define-vector-shortcuts
+  (er-macro-transformer
+   (^[f r c]
+     (let* ([type (cadr f)]
+            [%class (r (symbol-append '< type '>))]
+            [%length (r (symbol-append type '-length))]
+            [%ref    (r (if (c (r type) (r'bitvector))
+                          'bitvector-ref/int
+                          (symbol-append type '-ref)))])
+       (quasirename r
+         `(begin
+            (define-method fold (proc knil (coll ,%class))
+              (let1 len (,%length coll)
+                (let loop ([i 0] [seed knil])
+                  (if (= i len)
+                    seed
+                    (loop (+ i 1) (proc (,%ref coll i) seed))))))
+            (define-method map (proc (coll ,%class))
+              (let1 len (,%length coll)
+                (let loop ([i 0] [acc '()])
+                  (if (= i len)
+                    (reverse! acc)
+                    (loop (+ i 1) (cons (proc (,%ref coll i)) acc))))))
+            (define-method for-each (proc (coll ,%class))
+              (let1 len (,%length coll)
+                (dotimes [i len] (proc (,%ref coll i)))))))))))
+
+(define-vector-shortcuts vector)
+(define-vector-shortcuts u8vector)
+(define-vector-shortcuts s8vector)
+(define-vector-shortcuts u16vector)
+(define-vector-shortcuts s16vector)
+(define-vector-shortcuts u32vector)
+(define-vector-shortcuts s32vector)
+(define-vector-shortcuts u64vector)
+(define-vector-shortcuts s64vector)
+(define-vector-shortcuts f16vector)
+(define-vector-shortcuts f32vector)
+(define-vector-shortcuts f64vector)
+(define-vector-shortcuts c32vector)
+(define-vector-shortcuts c64vector)
+(define-vector-shortcuts c128vector)
+(define-vector-shortcuts bitvector)
+(define-vector-shortcuts weak-vector)
+
+;; Strings are scanned with cursors, so that multibyte strings don't
+;; need indexing.
+(define-method fold (proc knil (coll <string>))
+  (let1 end (string-cursor-end coll)
+    (let loop ([cur (string-cursor-start coll)] [seed knil])
+      (if (string-cursor=? cur end)
+        seed
+        (loop (string-cursor-next coll cur)
+              (proc (string-ref coll cur) seed))))))
+
+(define-method map (proc (coll <string>))
+  (let1 end (string-cursor-end coll)
+    (let loop ([cur (string-cursor-start coll)] [acc '()])
+      (if (string-cursor=? cur end)
+        (reverse! acc)
+        (loop (string-cursor-next coll cur)
+              (cons (proc (string-ref coll cur)) acc))))))
+
+(define-method for-each (proc (coll <string>))
+  (let1 end (string-cursor-end coll)
+    (let loop ([cur (string-cursor-start coll)])
+      (unless (string-cursor=? cur end)
+        (proc (string-ref coll cur))
+        (loop (string-cursor-next coll cur))))))
+
 ;; size-of ----------------------------------------------
 
 ;; generic way
@@ -690,3 +767,20 @@
 (define-method group-by-size-to ((class <class>) (col <collection>) k . padding)
   (generator-map (cut coerce-to class <>)
                  (apply ggroup (x->generator col) k padding)))
+
+;;-------------------------------------------------
+;; Dispatch acceleration
+;;
+
+;; The methods of these generic functions are mostly leaf methods
+;; specialized by the collection argument, so the method dispatcher
+;; finds the one for a vector, a string or a list by a table lookup
+;; instead of sorting all applicable methods.  Calls it can't resolve,
+;; e.g. on user-defined collections, go through the normal dispatch.
+(let1 build! (with-module gauche.object generic-build-dispatcher!)
+  (build! call-with-iterator 0)
+  (build! size-of 0)
+  (build! lazy-size-of 0)
+  (build! fold 2)
+  (build! map 1)
+  (build! for-each 1))
@@ -41,7 +41,7 @@
           file->line-generator file->byte-generator
           port->sexp-generator port->char-generator
           port->line-generator port->byte-generator
-          x->generator generate
+          x->generator generate generate/fiber
 
           generator->list generator->reverse-list
           generator->vector generator->vector!
@@ -586,6 +586,17 @@
            (eof-object)))
   (^[] (cont)))
 
+;; generate/fiber :: ((a -> ()) -> ()) -> Generator a
+;; Same as generate, but PROC runs in a fiber, so switching between the
+;; generator and the consumer doesn't copy the continuation.  The
+;; generator is tied to the thread that first calls it, and PROC can't
+;; yield from within reset or a C callback.
+(define (generate/fiber proc)
+  (let1 f (make-fiber (^[] (proc (^[value] (fiber-yield value))) (eof-object)))
+    (^[] (if (eq? (fiber-state f) 'done)
+           (eof-object)
+           (fiber-resume f)))))
+
 ;; grxmatch :: (Regexp, Generator Char) -> Generator RegMatch
 ;;          |  (Regexp, String) -> Generator RegMatch
 (define (grxmatch rx gen)
@@ -97,7 +97,8 @@
 
 (autoload "gauche/sigutil" (:macro with-signal-handlers))
 
-(autoload gauche.modutil (:macro export-if-defined use-version))
+(autoload gauche.modutil (:macro export-if-defined use-version)
+          preload-modules)
 
 (autoload gauche.portutil copy-port)
 
@@ -36,6 +36,7 @@
 #include "gauche/code.h"
 #include "gauche/vminsn.h"
 #include "gauche/priv/configP.h"
+#include "gauche/priv/atomicP.h"
 #include "gauche/priv/builtin-syms.h"
 #include "gauche/priv/classP.h"
 #include "gauche/priv/identifierP.h"
@@ -1428,14 +1429,56 @@ ScmObj Scm_VMSlotInitializeUsingAccessor(ScmObj obj,
  *   (cond ((assq slot (ref class 'accessors)) => cdr)
  *         (else (error !!!))))
  */
+
+/* Slot accessor cache.
+ * Looking up accessors is an assq on klass->accessors, which is done
+ * on every slot-ref/slot-set!.  We keep a small direct-mapped global cache
+ * keyed by (class, slot name).  The accessors list is replaced as a whole
+ * when it's changed (class_accessors_set, class initialization), so
+ * we keep the list in the entry and treat it as a miss if it differs.
+ * Redefined classes are dealt with by the callers before getting here.
+ * An entry is immutable once created, and the table slot is updated
+ * with a single atomic store, so readers never see a torn entry.
+ */
+typedef struct slot_cache_entry_rec {
+    ScmClass *klass;
+    ScmObj slot;
+    ScmObj accessors;
+    ScmSlotAccessor *sa;
+} slot_cache_entry;
+
+#define SLOT_CACHE_SIZE 512     /* must be power of 2 */
+
+static ScmAtomicVar slot_cache[SLOT_CACHE_SIZE]; /* slot_cache_entry* */
+
+static inline u_long slot_cache_index(ScmClass *klass, ScmObj slot)
+{
+    return ((((u_long)klass) >> 4) ^ (((u_long)slot) >> 3))
+        & (SLOT_CACHE_SIZE-1);
+}
+
 ScmSlotAccessor *Scm_GetSlotAccessor(ScmClass *klass, ScmObj slot)
 {
-    ScmObj p = Scm_Assq(slot, klass->accessors);
+    u_long k = slot_cache_index(klass, slot);
+    slot_cache_entry *e = (slot_cache_entry*)Scm_AtomicLoad(&slot_cache[k]);
+    if (e != NULL && e->klass == klass && SCM_EQ(e->slot, slot)
+        && SCM_EQ(e->accessors, klass->accessors)) {
+        return e->sa;
+    }
+
+    ScmObj accessors = klass->accessors;
+    ScmObj p = Scm_Assq(slot, accessors);
     if (!SCM_PAIRP(p)) return NULL;
     if (!SCM_XTYPEP(SCM_CDR(p), SCM_CLASS_SLOT_ACCESSOR))
         Scm_Error("slot accessor information of class %S, slot %S is screwed up.",
                   SCM_OBJ(klass), slot);
-    return SCM_SLOT_ACCESSOR(SCM_CDR(p));
+    e = SCM_NEW(slot_cache_entry);
+    e->klass = klass;
+    e->slot = slot;
+    e->accessors = accessors;
+    e->sa = SCM_SLOT_ACCESSOR(SCM_CDR(p));
+    Scm_AtomicStore(&slot_cache[k], (ScmAtomicWord)e);
+    return e->sa;
 }
 
 /* (internal) slot-ref-using-accessor
@@ -3830,6 +3873,7 @@ void Scm__InitClass(void)
     CINIT(SCM_CLASS_PROMPT_TAG,       "<prompt-tag>");
     CINIT(SCM_CLASS_DYNAMIC_HANDLER,  "<dynamic-handler>");
     CINIT(SCM_CLASS_ESCAPE_POINT,     "<escape-point>");
+    CINIT(SCM_CLASS_FIBER,            "<fiber>");
 
     /* weak.c */
     CINIT(SCM_CLASS_WEAK_VECTOR,      "<weak-vector>");
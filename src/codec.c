@@ -0,0 +1,411 @@
+/*
+ * codec.c - base16, base32 and base64 codecs
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#define LIBGAUCHE_BODY
+#include "gauche.h"
+#include "gauche/priv/configP.h"
+#include "gauche/priv/codecP.h"
+
+#include <ctype.h>
+
+/* The encoder and the decoder work on quanta---3 bytes <-> 4 digits for
+ * base64, 5 bytes <-> 8 digits for base32 and 1 byte <-> 2 digits for
+ * base16.  While we're at a quantum boundary, we convert a whole run
+ * of quanta with straight-line code; the bit-by-bit path is only used
+ * to realign, to fold lines, and to deal with padding, whitespaces and
+ * invalid characters.
+ */
+
+#define CODEC_BUFSIZ  15360     /* multiple of 3 and 5 */
+
+void Scm__BinaryCodecInit(ScmBinaryCodec *c, const char *name,
+                          int bits, ScmString *digits,
+                          int flags, int lineWidth)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(digits);
+    const u_char *d = (const u_char*)SCM_STRING_BODY_START(b);
+    int ndigits = 1 << bits;
+
+    SCM_ASSERT(bits == 4 || bits == 5 || bits == 6);
+    if (SCM_STRING_BODY_SIZE(b) != ndigits
+        || SCM_STRING_BODY_LENGTH(b) != ndigits) {
+        Scm_Error("%s digits must be a string of %d ASCII characters, "
+                  "but got: %S", name, ndigits, SCM_OBJ(digits));
+    }
+
+    c->name = name;
+    c->bits = bits;
+    c->quantumDigits = (bits == 4)? 2 : (bits == 5)? 8 : 4;
+    c->flags = flags;
+    c->lineWidth = (lineWidth > 0)? lineWidth : 0;
+    c->column = 0;
+    c->count = 0;
+    c->done = FALSE;
+    c->nacc = 0;
+    c->acc = 0;
+    memset(c->dec, -1, sizeof(c->dec));
+    for (int i=0; i<ndigits; i++) {
+        c->enc[i] = (char)d[i];
+        c->dec[d[i]] = (signed char)i;
+        if ((flags & SCM_BINARY_CODEC_FOLD_CASE) && isupper(d[i])) {
+            c->dec[tolower(d[i])] = (signed char)i;
+        }
+    }
+}
+
+/*
+ * Encoder
+ */
+
+/* Upper bound of the output size of encoding LEN bytes, including
+   the final padding and newlines. */
+static ScmSize encode_bound(ScmBinaryCodec *c, ScmSize len)
+{
+    ScmSize ndigits = (len*8 + c->nacc + c->bits - 1)/c->bits
+        + c->quantumDigits;
+    if (c->lineWidth > 0) ndigits += ndigits/c->lineWidth + 1;
+    return ndigits;
+}
+
+static inline char *emit_char(ScmBinaryCodec *c, char *d, char ch)
+{
+    *d++ = ch;
+    if (++c->count == c->quantumDigits) c->count = 0;
+    if (c->lineWidth > 0 && ++c->column == c->lineWidth) {
+        *d++ = '\n';
+        c->column = 0;
+    }
+    return d;
+}
+
+static inline char *encode_byte(ScmBinaryCodec *c, char *d, u_char b)
+{
+    c->acc = (c->acc << 8) | b;
+    c->nacc += 8;
+    while (c->nacc >= c->bits) {
+        c->nacc -= c->bits;
+        d = emit_char(c, d, c->enc[(c->acc >> c->nacc)
+                                   & ((1UL << c->bits) - 1)]);
+    }
+    c->acc &= (1UL << c->nacc) - 1;
+    return d;
+}
+
+/* Encode NQ quanta from S to D.  No line folding. */
+static void encode_quanta(const ScmBinaryCodec *c, const u_char *s,
+                          char *d, ScmSize nq)
+{
+    const char *enc = c->enc;
+    switch (c->bits) {
+    case 6:
+        for (; nq > 0; nq--, s += 3, d += 4) {
+            uint32_t v = ((uint32_t)s[0]<<16) | ((uint32_t)s[1]<<8) | s[2];
+            d[0] = enc[v >> 18];
+            d[1] = enc[(v >> 12) & 0x3f];
+            d[2] = enc[(v >> 6) & 0x3f];
+            d[3] = enc[v & 0x3f];
+        }
+        break;
+    case 5:
+        for (; nq > 0; nq--, s += 5, d += 8) {
+            uint64_t v = ((uint64_t)s[0]<<32) | ((uint64_t)s[1]<<24)
+                | ((uint64_t)s[2]<<16) | ((uint64_t)s[3]<<8) | s[4];
+            d[0] = enc[v >> 35];
+            d[1] = enc[(v >> 30) & 0x1f];
+            d[2] = enc[(v >> 25) & 0x1f];
+            d[3] = enc[(v >> 20) & 0x1f];
+            d[4] = enc[(v >> 15) & 0x1f];
+            d[5] = enc[(v >> 10) & 0x1f];
+            d[6] = enc[(v >> 5) & 0x1f];
+            d[7] = enc[v & 0x1f];
+        }
+        break;
+    case 4:
+        for (; nq > 0; nq--, s++, d += 2) {
+            d[0] = enc[s[0] >> 4];
+            d[1] = enc[s[0] & 0x0f];
+        }
+        break;
+    }
+}
+
+/* Encode LEN bytes from SRC into DST, which must have encode_bound()
+   room.  Returns the number of characters written. */
+static ScmSize encode_chunk(ScmBinaryCodec *c, const u_char *src,
+                            ScmSize len, char *dst)
+{
+    const u_char *s = src, *end = src + len;
+    char *d = dst;
+    int qb = c->bits == 6 ? 3 : c->bits == 5 ? 5 : 1; /* bytes per quantum */
+    int qd = c->quantumDigits;
+
+    /* Realign to the quantum boundary */
+    while (c->nacc != 0 && s < end) d = encode_byte(c, d, *s++);
+
+    for (;;) {
+        ScmSize nq = (end - s)/qb;
+        if (nq == 0) break;
+        if (c->lineWidth > 0) {
+            ScmSize fit = (c->lineWidth - c->column)/qd;
+            if (fit == 0) {
+                /* This quantum straddles the line boundary */
+                for (int i=0; i<qb; i++) d = encode_byte(c, d, *s++);
+                continue;
+            }
+            if (nq > fit) nq = fit;
+        }
+        encode_quanta(c, s, d, nq);
+        s += nq*qb;
+        d += nq*qd;
+        if (c->lineWidth > 0) {
+            c->column += (int)(nq*qd);
+            if (c->column == c->lineWidth) {
+                *d++ = '\n';
+                c->column = 0;
+            }
+        }
+    }
+    while (s < end) d = encode_byte(c, d, *s++);
+    return d - dst;
+}
+
+/* Flush pending bits and emit padding. */
+static ScmSize encode_finish(ScmBinaryCodec *c, char *dst)
+{
+    char *d = dst;
+    if (c->nacc > 0) {
+        d = emit_char(c, d, c->enc[(c->acc << (c->bits - c->nacc))
+                                   & ((1UL << c->bits) - 1)]);
+        c->nacc = 0;
+        c->acc = 0;
+    }
+    if (!(c->flags & SCM_BINARY_CODEC_OMIT_PADDING)) {
+        while (c->count != 0) d = emit_char(c, d, '=');
+    }
+    return d - dst;
+}
+
+ScmObj Scm__BinaryEncode(ScmBinaryCodec *c, const u_char *src, ScmSize len)
+{
+    char *buf = SCM_NEW_ATOMIC2(char*, encode_bound(c, len) + 1);
+    ScmSize n = encode_chunk(c, src, len, buf);
+    n += encode_finish(c, buf + n);
+    buf[n] = '\0';
+    return Scm_MakeString(buf, n, n, 0);
+}
+
+void Scm__BinaryEncodePort(ScmBinaryCodec *c, ScmPort *in, ScmPort *out)
+{
+    char ibuf[CODEC_BUFSIZ];
+    char *obuf = SCM_NEW_ATOMIC2(char*, encode_bound(c, CODEC_BUFSIZ));
+
+    for (;;) {
+        ScmSize r = Scm_Getz(ibuf, CODEC_BUFSIZ, in);
+        if (r <= 0) break;
+        ScmSize n = encode_chunk(c, (const u_char*)ibuf, r, obuf);
+        Scm_Putz(obuf, n, out);
+    }
+    ScmSize n = encode_finish(c, obuf);
+    if (n > 0) Scm_Putz(obuf, n, out);
+}
+
+/*
+ * Decoder
+ */
+
+/* Called on a byte that isn't a digit.  We skip whitespaces, as well as
+   other garbage unless we're strict.  Returns the number of bytes to skip;
+   for non-ASCII characters, the whole multibyte sequence is skipped.  */
+static ScmSize decode_skip(ScmBinaryCodec *c, const u_char *s,
+                           const u_char *end)
+{
+    ScmSize n = 1;
+    if (*s < 0x80) {
+        if ((c->flags & SCM_BINARY_CODEC_STRICT) && !isspace(*s)) {
+            Scm_Error("Invalid %s input character %S",
+                      c->name, SCM_MAKE_CHAR(*s));
+        }
+    } else {
+        ScmChar ch = SCM_CHAR_INVALID;
+        n = SCM_CHAR_NFOLLOWS(*s) + 1;
+        if (n <= end - s) {
+            SCM_CHAR_GET((const char*)s, ch);
+        } else {
+            n = end - s;
+        }
+        if ((c->flags & SCM_BINARY_CODEC_STRICT)
+            && (ch == SCM_CHAR_INVALID || !SCM_CHAR_EXTRA_WHITESPACE(ch))) {
+            Scm_Error("Invalid %s input character %S", c->name,
+                      (ch == SCM_CHAR_INVALID
+                       ? SCM_MAKE_INT(*s) : SCM_MAKE_CHAR(ch)));
+        }
+    }
+    return n;
+}
+
+/* Decode NQ quanta from S into D, as far as all digits are valid.
+   Returns the number of quanta decoded. */
+static ScmSize decode_quanta(const ScmBinaryCodec *c, const u_char *s,
+                             u_char *d, ScmSize nq)
+{
+    const signed char *dec = c->dec;
+    ScmSize i = 0;
+    switch (c->bits) {
+    case 6:
+        for (; i < nq; i++, s += 4, d += 3) {
+            int a = dec[s[0]], b = dec[s[1]], e = dec[s[2]], f = dec[s[3]];
+            if ((a|b|e|f) < 0) break;
+            uint32_t v = ((uint32_t)a<<18) | ((uint32_t)b<<12) | (e<<6) | f;
+            d[0] = (u_char)(v >> 16);
+            d[1] = (u_char)(v >> 8);
+            d[2] = (u_char)v;
+        }
+        break;
+    case 5:
+        for (; i < nq; i++, s += 8, d += 5) {
+            int x[8], m = 0;
+            for (int k=0; k<8; k++) m |= (x[k] = dec[s[k]]);
+            if (m < 0) break;
+            uint64_t v = 0;
+            for (int k=0; k<8; k++) v = (v << 5) | (uint64_t)x[k];
+            d[0] = (u_char)(v >> 32);
+            d[1] = (u_char)(v >> 24);
+            d[2] = (u_char)(v >> 16);
+            d[3] = (u_char)(v >> 8);
+            d[4] = (u_char)v;
+        }
+        break;
+    case 4:
+        for (; i < nq; i++, s += 2, d++) {
+            int a = dec[s[0]], b = dec[s[1]];
+            if ((a|b) < 0) break;
+            d[0] = (u_char)((a << 4) | b);
+        }
+        break;
+    }
+    return i;
+}
+
+/* Decode LEN bytes from SRC into DST, which must have room for
+   LEN*bits/8+1 bytes.  Returns the number of bytes written. */
+static ScmSize decode_chunk(ScmBinaryCodec *c, const u_char *src,
+                            ScmSize len, u_char *dst)
+{
+    const u_char *s = src, *end = src + len;
+    u_char *d = dst;
+    int qd = c->quantumDigits;
+    int qb = c->bits == 6 ? 3 : c->bits == 5 ? 5 : 1;
+
+    while (s < end && !c->done) {
+        if (c->count == 0) {
+            ScmSize nq = decode_quanta(c, s, d, (end - s)/qd);
+            s += nq*qd;
+            d += nq*qb;
+            if (s == end) break;
+        }
+        int v = c->dec[*s];
+        if (v >= 0) {
+            c->acc = (c->acc << c->bits) | (u_long)v;
+            c->nacc += c->bits;
+            if (c->nacc >= 8) {
+                c->nacc -= 8;
+                *d++ = (u_char)(c->acc >> c->nacc);
+                c->acc &= (1UL << c->nacc) - 1;
+            }
+            if (++c->count == qd) {
+                c->count = 0;
+                c->nacc = 0;
+                c->acc = 0;
+            }
+            s++;
+        } else if (*s == '=' && c->bits != 4) {
+            c->done = TRUE;
+        } else {
+            s += decode_skip(c, s, end);
+        }
+    }
+    return d - dst;
+}
+
+static void decode_finish(ScmBinaryCodec *c)
+{
+    if (!c->done && c->count != 0 && (c->flags & SCM_BINARY_CODEC_STRICT)) {
+        Scm_Error("Premature end of %s input", c->name);
+    }
+}
+
+ScmObj Scm__BinaryDecode(ScmBinaryCodec *c, const u_char *src, ScmSize len,
+                         int toString)
+{
+    ScmSize bound = (len*c->bits)/8 + 1;
+    u_char *buf = SCM_NEW_ATOMIC2(u_char*, bound + 1);
+    ScmSize n = decode_chunk(c, src, len, buf);
+    decode_finish(c);
+    if (toString) {
+        buf[n] = '\0';
+        return Scm_MakeString((const char*)buf, n, -1, 0);
+    } else {
+        return Scm_MakeU8VectorFromArrayShared(n, buf);
+    }
+}
+
+/* NB: Since we read the input in chunks, the input after the padding
+   may be consumed. */
+void Scm__BinaryDecodePort(ScmBinaryCodec *c, ScmPort *in, ScmPort *out)
+{
+    u_char ibuf[CODEC_BUFSIZ + SCM_CHAR_MAX_BYTES];
+    u_char obuf[CODEC_BUFSIZ];  /* decoded data never exceeds input */
+
+    while (!c->done) {
+        ScmSize r = Scm_Getz((char*)ibuf, CODEC_BUFSIZ, in);
+        if (r <= 0) break;
+        /* Don't split a multibyte character, so that we can report it
+           properly. */
+        if (c->flags & SCM_BINARY_CODEC_STRICT) {
+            ScmSize k = r - 1;
+            while (k > 0 && r - k < SCM_CHAR_MAX_BYTES
+                   && (ibuf[k] & 0xc0) == 0x80) k--;
+            if (ibuf[k] >= 0x80) {
+                ScmSize need = k + SCM_CHAR_NFOLLOWS(ibuf[k]) + 1 - r;
+                if (need > 0) {
+                    ScmSize rr = Scm_Getz((char*)ibuf + r, need, in);
+                    if (rr > 0) r += rr;
+                }
+            }
+        }
+        ScmSize n = decode_chunk(c, ibuf, r, obuf);
+        if (n > 0) Scm_Putz((const char*)obuf, n, out);
+    }
+    decode_finish(c);
+}
@@ -32,6 +32,7 @@
  */
 
 #include <stdlib.h>
+#include <math.h>
 #define LIBGAUCHE_BODY
 #include "gauche.h"
 #include "gauche/priv/configP.h"
@@ -343,31 +344,481 @@ static int cmp_int(ScmObj x, ScmObj y, ScmObj dummy SCM_UNUSED)
     return Scm_Compare(x, y);
 }
 
-void Scm_SortArray(ScmObj *elts, int nelts, ScmObj cmpfn SCM_UNUSED)
+/*
+ * Radix sort for numeric keys
+ *
+ *   If the default comparison is used and the elements are all fixnums,
+ *   or all flonums without NaN, we don't need to call Scm_Compare at all.
+ *   We map each number to an unsigned 64bit key whose unsigned order
+ *   matches the numeric order, and run LSD radix sort with 8-bit digits.
+ *   Digits in which all keys share the same value are skipped, so
+ *   sorting small integers only takes a couple of passes.
+ *
+ *   Radix sort is stable, so it can be used for both sort and stable-sort.
+ *   For flonums, we map -0.0 and 0.0 to the same key, so that they're
+ *   kept in the original order as Scm_Compare regards them equal.
+ *
+ *   The same routine is used to sort integer and flonum uniform vectors.
+ */
+
+#define RADIX_SORT_MIN  64      /* below this, comparison sort is faster */
+#define KEY_SIGN        ((uint64_t)1 << 63)
+
+typedef union {
+    double d;
+    uint64_t u;
+} flonum_bits;
+
+static inline uint64_t double_to_key(double d)
+{
+    flonum_bits b;
+    b.d = d;
+    return (b.u & KEY_SIGN)? ~b.u : (b.u | KEY_SIGN);
+}
+
+static inline double key_to_double(uint64_t k)
+{
+    flonum_bits b;
+    b.u = (k & KEY_SIGN)? (k & ~KEY_SIGN) : ~k;
+    return b.d;
+}
+
+/* Sort KEYS in place.  If OBJS isn't NULL, it is permuted along with
+   KEYS. */
+static void radix_sort_keys(uint64_t *keys, ScmObj *objs, ScmSize n)
+{
+    ScmSize count[8][256];
+    memset(count, 0, sizeof(count));
+    for (ScmSize i=0; i<n; i++) {
+        uint64_t k = keys[i];
+        for (int d=0; d<8; d++) count[d][(k >> (d*8)) & 0xff]++;
+    }
+
+    uint64_t *src = keys, *dst = SCM_NEW_ATOMIC_ARRAY(uint64_t, n);
+    ScmObj *osrc = objs, *odst = objs ? SCM_NEW_ARRAY(ScmObj, n) : NULL;
+
+    for (int d=0; d<8; d++) {
+        int shift = d*8;
+        if (count[d][(src[0] >> shift) & 0xff] == n) continue;
+        ScmSize off[256], sum = 0;
+        for (int b=0; b<256; b++) {
+            off[b] = sum;
+            sum += count[d][b];
+        }
+        for (ScmSize i=0; i<n; i++) {
+            ScmSize j = off[(src[i] >> shift) & 0xff]++;
+            dst[j] = src[i];
+            if (osrc) odst[j] = osrc[i];
+        }
+        uint64_t *kt = src; src = dst; dst = kt;
+        ScmObj *ot = osrc; osrc = odst; odst = ot;
+    }
+    if (src != keys) {
+        memcpy(keys, src, n*sizeof(uint64_t));
+        if (objs) memcpy(objs, osrc, n*sizeof(ScmObj));
+    }
+}
+
+/* Try radix-sorting ELTS.  Returns FALSE if ELTS contains anything
+   other than fixnums, or other than non-NaN flonums. */
+static int radix_sort_objs(ScmObj *elts, ScmSize nelts)
+{
+    if (SCM_INTP(elts[0])) {
+        for (ScmSize i=1; i<nelts; i++) {
+            if (!SCM_INTP(elts[i])) return FALSE;
+        }
+        uint64_t *keys = SCM_NEW_ATOMIC_ARRAY(uint64_t, nelts);
+        for (ScmSize i=0; i<nelts; i++) {
+            keys[i] = (uint64_t)(int64_t)SCM_INT_VALUE(elts[i]) ^ KEY_SIGN;
+        }
+        radix_sort_keys(keys, NULL, nelts);
+        for (ScmSize i=0; i<nelts; i++) {
+            elts[i] = SCM_MAKE_INT((ScmSmallInt)(int64_t)(keys[i] ^ KEY_SIGN));
+        }
+        return TRUE;
+    }
+    if (SCM_FLONUMP(elts[0])) {
+        uint64_t *keys = SCM_NEW_ATOMIC_ARRAY(uint64_t, nelts);
+        for (ScmSize i=0; i<nelts; i++) {
+            if (!SCM_FLONUMP(elts[i])) return FALSE;
+            double d = SCM_FLONUM_VALUE(elts[i]);
+            if (SCM_IS_NAN(d)) return FALSE;
+            keys[i] = double_to_key(d == 0.0 ? 0.0 : d);
+        }
+        radix_sort_keys(keys, elts, nelts);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Stable merge sort
+ *
+ *   A simplified version of Timsort.  We scan the input for natural runs
+ *   (non-descending, or strictly descending ones which we reverse),
+ *   extend short runs to MIN_RUN elements by binary insertion sort,
+ *   and merge runs keeping Timsort's stack invariants.  Before merging
+ *   two runs, we skip the prefix of the left run and the suffix of the
+ *   right run that are already in place, so presorted or mostly sorted
+ *   input is handled in nearly linear time.
+ *
+ *   We only use "less than" relation, i.e. cmp(x, y, data) < 0, which
+ *   is consistent with the comparison procedures that return a boolean.
+ */
+
+#define MERGE_STACK_SIZE 85     /* enough for 2^64 elements */
+
+typedef int (*sort_cmp)(ScmObj, ScmObj, ScmObj);
+
+typedef struct merge_state_rec {
+    ScmObj *elts;
+    ScmSize nelts;
+    sort_cmp cmp;
+    ScmObj data;
+    ScmObj *tmp;                /* allocated on demand; nelts/2 elements */
+    int nruns;
+    ScmSize runBase[MERGE_STACK_SIZE];
+    ScmSize runLen[MERGE_STACK_SIZE];
+} merge_state;
+
+static ScmSize merge_min_run(ScmSize n)
+{
+    ScmSize r = 0;
+    while (n >= 64) {
+        r |= n & 1;
+        n >>= 1;
+    }
+    return n + r;
+}
+
+/* Returns the length of the run starting at elts[0].  If it is descending,
+   reverse it in place. */
+static ScmSize count_run(ScmObj *elts, ScmSize n, sort_cmp cmp, ScmObj data)
+{
+    if (n <= 1) return n;
+    ScmSize k = 2;
+    if (cmp(elts[1], elts[0], data) < 0) {
+        while (k < n && cmp(elts[k], elts[k-1], data) < 0) k++;
+        for (ScmSize i=0, j=k-1; i<j; i++, j--) {
+            ScmObj t = elts[i]; elts[i] = elts[j]; elts[j] = t;
+        }
+    } else {
+        while (k < n && !(cmp(elts[k], elts[k-1], data) < 0)) k++;
+    }
+    return k;
+}
+
+/* elts[0..sorted) is sorted.  Insert the rest up to n. */
+static void binary_insertion_sort(ScmObj *elts, ScmSize sorted, ScmSize n,
+                                  sort_cmp cmp, ScmObj data)
+{
+    for (ScmSize i=sorted; i<n; i++) {
+        ScmObj x = elts[i];
+        ScmSize lo = 0, hi = i;
+        while (lo < hi) {
+            ScmSize mid = lo + (hi - lo)/2;
+            if (cmp(x, elts[mid], data) < 0) hi = mid;
+            else lo = mid + 1;
+        }
+        memmove(elts+lo+1, elts+lo, (i-lo)*sizeof(ScmObj));
+        elts[lo] = x;
+    }
+}
+
+/* Number of elements in v[0..n) that are not greater than x. */
+static ScmSize upper_bound(ScmObj x, ScmObj *v, ScmSize n,
+                           sort_cmp cmp, ScmObj data)
+{
+    ScmSize lo = 0, hi = n;
+    while (lo < hi) {
+        ScmSize mid = lo + (hi - lo)/2;
+        if (cmp(x, v[mid], data) < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+/* Number of elements in v[0..n) that are less than x. */
+static ScmSize lower_bound(ScmObj x, ScmObj *v, ScmSize n,
+                           sort_cmp cmp, ScmObj data)
+{
+    ScmSize lo = 0, hi = n;
+    while (lo < hi) {
+        ScmSize mid = lo + (hi - lo)/2;
+        if (cmp(v[mid], x, data) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* Merge i-th and (i+1)-th runs on the stack. */
+static void merge_at(merge_state *ms, int i)
+{
+    ScmObj *a = ms->elts + ms->runBase[i];
+    ScmSize na = ms->runLen[i];
+    ScmObj *b = ms->elts + ms->runBase[i+1];
+    ScmSize nb = ms->runLen[i+1];
+
+    ms->runLen[i] = na + nb;
+    if (i == ms->nruns - 3) {
+        ms->runBase[i+1] = ms->runBase[i+2];
+        ms->runLen[i+1] = ms->runLen[i+2];
+    }
+    ms->nruns--;
+
+    /* Elements of A that are not greater than b[0] are already in place. */
+    ScmSize k = upper_bound(b[0], a, na, ms->cmp, ms->data);
+    a += k;
+    na -= k;
+    if (na == 0) return;
+    /* Elements of B that are not less than the last of A are, too. */
+    nb = lower_bound(a[na-1], b, nb, ms->cmp, ms->data);
+    if (nb == 0) return;
+
+    /* We copy the shorter run to the temporary area. */
+    if (ms->tmp == NULL) ms->tmp = SCM_NEW_ARRAY(ScmObj, ms->nelts/2 + 1);
+    ScmObj *t = ms->tmp;
+    if (na <= nb) {
+        /* Merge from the lower end */
+        memcpy(t, a, na*sizeof(ScmObj));
+        ScmObj *dst = a;
+        ScmSize i1 = 0, i2 = 0;
+        while (i1 < na && i2 < nb) {
+            if (ms->cmp(b[i2], t[i1], ms->data) < 0) *dst++ = b[i2++];
+            else                                    *dst++ = t[i1++];
+        }
+        /* The rest of B, if any, is already in place. */
+        if (i1 < na) memcpy(dst, t+i1, (na-i1)*sizeof(ScmObj));
+    } else {
+        /* Merge from the upper end */
+        memcpy(t, b, nb*sizeof(ScmObj));
+        ScmObj *dst = b + nb;
+        ScmSize i1 = na, i2 = nb;
+        while (i1 > 0 && i2 > 0) {
+            if (ms->cmp(t[i2-1], a[i1-1], ms->data) < 0) *--dst = a[--i1];
+            else                                        *--dst = t[--i2];
+        }
+        /* The rest of A, if any, is already in place. */
+        if (i2 > 0) memcpy(a, t, i2*sizeof(ScmObj));
+    }
+}
+
+static void merge_collapse(merge_state *ms)
+{
+    while (ms->nruns > 1) {
+        int n = ms->nruns - 2;
+        ScmSize *len = ms->runLen;
+        if ((n > 0 && len[n-1] <= len[n] + len[n+1])
+            || (n > 1 && len[n-2] <= len[n-1] + len[n])) {
+            if (len[n-1] < len[n+1]) n--;
+        } else if (len[n] > len[n+1]) {
+            break;
+        }
+        merge_at(ms, n);
+    }
+}
+
+static void merge_force_collapse(merge_state *ms)
+{
+    while (ms->nruns > 1) {
+        int n = ms->nruns - 2;
+        if (n > 0 && ms->runLen[n-1] < ms->runLen[n+1]) n--;
+        merge_at(ms, n);
+    }
+}
+
+static void sort_m(ScmObj *elts, ScmSize nelts, sort_cmp cmp, ScmObj data)
+{
+    merge_state ms;
+    ms.elts = elts;
+    ms.nelts = nelts;
+    ms.cmp = cmp;
+    ms.data = data;
+    ms.tmp = NULL;
+    ms.nruns = 0;
+
+    ScmSize minrun = merge_min_run(nelts);
+    ScmSize lo = 0;
+    while (lo < nelts) {
+        ScmSize rest = nelts - lo;
+        ScmSize len = count_run(elts+lo, rest, cmp, data);
+        if (len < minrun) {
+            ScmSize force = (rest < minrun) ? rest : minrun;
+            binary_insertion_sort(elts+lo, len, force, cmp, data);
+            len = force;
+        }
+        ms.runBase[ms.nruns] = lo;
+        ms.runLen[ms.nruns] = len;
+        ms.nruns++;
+        merge_collapse(&ms);
+        lo += len;
+    }
+    merge_force_collapse(&ms);
+}
+
+void Scm_SortArray(ScmObj *elts, int nelts, ScmObj cmpfn)
 {
     int limit, i;
     if (nelts <= 1) return;
-    /* approximate 2*log2(nelts) */
-    for (i=nelts,limit=1; i > 0; limit++) {i>>=1;}
     if (SCM_PROCEDUREP(cmpfn)) {
+        /* approximate 2*log2(nelts) */
+        for (i=nelts,limit=1; i > 0; limit++) {i>>=1;}
         sort_q(elts, 0, nelts-1, 0, limit, cmp_scm, cmpfn);
     } else {
+        if (nelts >= RADIX_SORT_MIN && radix_sort_objs(elts, nelts)) return;
+        for (i=nelts,limit=1; i > 0; limit++) {i>>=1;}
         sort_q(elts, 0, nelts-1, 0, limit, cmp_int, NULL);
     }
 }
 
+/* Stable version of Scm_SortArray. */
+void Scm_StableSortArray(ScmObj *elts, ScmSize nelts, ScmObj cmpfn)
+{
+    if (nelts <= 1) return;
+    if (SCM_PROCEDUREP(cmpfn)) {
+        sort_m(elts, nelts, cmp_scm, cmpfn);
+    } else {
+        if (nelts >= RADIX_SORT_MIN && radix_sort_objs(elts, nelts)) return;
+        sort_m(elts, nelts, cmp_int, NULL);
+    }
+}
+
+/*
+ * Sorting uniform vectors by the natural order of elements.
+ *
+ *   Integer vectors are radix sorted.  Flonum vectors are radix sorted
+ *   as well if they don't contain NaN.  In stable sort we can't tell
+ *   the order between -0.0 and 0.0 from the keys, so we give up if
+ *   the vector contains -0.0.  Returns FALSE if we can't handle V,
+ *   in which case V is not modified.
+ */
+
+#define UVECTOR_TO_KEYS(type, elts, expr)               \
+    do {                                                \
+        type *v_ = (type*)(elts);                       \
+        for (ScmSize i_=0; i_<n; i_++) {                \
+            type e = v_[i_];                            \
+            keys[i_] = (expr);                          \
+        }                                               \
+    } while (0)
+
+#define KEYS_TO_UVECTOR(type, elts, expr)               \
+    do {                                                \
+        type *v_ = (type*)(elts);                       \
+        for (ScmSize i_=0; i_<n; i_++) {                \
+            uint64_t k = keys[i_];                      \
+            v_[i_] = (type)(expr);                      \
+        }                                               \
+    } while (0)
+
+#define SORTABLE_FLONUMS(type, elts, stable)                    \
+    do {                                                        \
+        type *v_ = (type*)(elts);                               \
+        for (ScmSize i_=0; i_<n; i_++) {                        \
+            if (SCM_IS_NAN(v_[i_])) return FALSE;               \
+            if ((stable) && v_[i_] == 0.0 && signbit(v_[i_]))   \
+                return FALSE;                                   \
+        }                                                       \
+    } while (0)
+
+int Scm__SortUVector(ScmUVector *v, int stable)
+{
+    ScmSize n = SCM_UVECTOR_SIZE(v);
+    ScmUVectorType type = Scm_UVectorType(SCM_CLASS_OF(v));
+    void *elts = SCM_UVECTOR_ELEMENTS(v);
+    uint64_t *keys = NULL;
+
+    switch (type) {
+    case SCM_UVECTOR_S8:  case SCM_UVECTOR_U8:
+    case SCM_UVECTOR_S16: case SCM_UVECTOR_U16:
+    case SCM_UVECTOR_S32: case SCM_UVECTOR_U32:
+    case SCM_UVECTOR_S64: case SCM_UVECTOR_U64:
+        break;
+    case SCM_UVECTOR_F32:
+        SORTABLE_FLONUMS(float, elts, stable);
+        break;
+    case SCM_UVECTOR_F64:
+        SORTABLE_FLONUMS(double, elts, stable);
+        break;
+    default:
+        return FALSE;
+    }
+
+    SCM_UVECTOR_CHECK_MUTABLE(v);
+    if (n <= 1) return TRUE;
+    keys = SCM_NEW_ATOMIC_ARRAY(uint64_t, n);
+
+    switch (type) {
+    case SCM_UVECTOR_S8:
+        UVECTOR_TO_KEYS(int8_t, elts, (uint64_t)(int64_t)e ^ KEY_SIGN);
+        radix_sort_keys(keys, NULL, n);
+        KEYS_TO_UVECTOR(int8_t, elts, (int64_t)(k ^ KEY_SIGN));
+        break;
+    case SCM_UVECTOR_U8:
+        UVECTOR_TO_KEYS(uint8_t, elts, e);
+        radix_sort_keys(keys, NULL, n);
+        KEYS_TO_UVECTOR(uint8_t, elts, k);
+        break;
+    case SCM_UVECTOR_S16:
+        UVECTOR_TO_KEYS(int16_t, elts, (uint64_t)(int64_t)e ^ KEY_SIGN);
+        radix_sort_keys(keys, NULL, n);
+        KEYS_TO_UVECTOR(int16_t, elts, (int64_t)(k ^ KEY_SIGN));
+        break;
+    case SCM_UVECTOR_U16:
+        UVECTOR_TO_KEYS(uint16_t, elts, e);
+        radix_sort_keys(keys, NULL, n);
+        KEYS_TO_UVECTOR(uint16_t, elts, k);
+        break;
+    case SCM_UVECTOR_S32:
+        UVECTOR_TO_KEYS(int32_t, elts, (uint64_t)(int64_t)e ^ KEY_SIGN);
+        radix_sort_keys(keys, NULL, n);
+        KEYS_TO_UVECTOR(int32_t, elts, (int64_t)(k ^ KEY_SIGN));
+        break;
+    case SCM_UVECTOR_U32:
+        UVECTOR_TO_KEYS(uint32_t, elts, e);
+        radix_sort_keys(keys, NULL, n);
+        KEYS_TO_UVECTOR(uint32_t, elts, k);
+        break;
+    case SCM_UVECTOR_S64:
+        UVECTOR_TO_KEYS(int64_t, elts, (uint64_t)e ^ KEY_SIGN);
+        radix_sort_keys(keys, NULL, n);
+        KEYS_TO_UVECTOR(int64_t, elts, k ^ KEY_SIGN);
+        break;
+    case SCM_UVECTOR_U64:
+        UVECTOR_TO_KEYS(uint64_t, elts, e);
+        radix_sort_keys(keys, NULL, n);
+        KEYS_TO_UVECTOR(uint64_t, elts, k);
+        break;
+    case SCM_UVECTOR_F32:
+        UVECTOR_TO_KEYS(float, elts, double_to_key((double)e));
+        radix_sort_keys(keys, NULL, n);
+        KEYS_TO_UVECTOR(float, elts, key_to_double(k));
+        break;
+    case SCM_UVECTOR_F64:
+        UVECTOR_TO_KEYS(double, elts, double_to_key(e));
+        radix_sort_keys(keys, NULL, n);
+        KEYS_TO_UVECTOR(double, elts, key_to_double(k));
+        break;
+    default:
+        SCM_ASSERT(FALSE);
+    }
+    return TRUE;
+}
+
 /*
  * higher-level fns
  */
 
 #define STATIC_SIZE 32
 
-static ScmObj sort_list_int(ScmObj objs, ScmObj fn, int destructive)
+static ScmObj sort_list_int(ScmObj objs, ScmObj fn, int destructive,
+                            int stable)
 {
     ScmObj starray[STATIC_SIZE];
     ScmSize len = STATIC_SIZE;
     ScmObj *array = Scm_ListToArray(objs, &len, starray, TRUE);
-    Scm_SortArray(array, len, fn);
+    if (stable) Scm_StableSortArray(array, len, fn);
+    else        Scm_SortArray(array, len, fn);
     if (destructive) {
         ScmObj cp = objs;
         for (ScmSize i=0; i<len; i++, cp = SCM_CDR(cp)) {
@@ -381,12 +832,22 @@ static ScmObj sort_list_int(ScmObj objs, ScmObj fn, int destructive)
 
 ScmObj Scm_SortList(ScmObj objs, ScmObj fn)
 {
-    return sort_list_int(objs, fn, FALSE);
+    return sort_list_int(objs, fn, FALSE, FALSE);
 }
 
 ScmObj Scm_SortListX(ScmObj objs, ScmObj fn)
 {
-    return sort_list_int(objs, fn, TRUE);
+    return sort_list_int(objs, fn, TRUE, FALSE);
+}
+
+ScmObj Scm_StableSortList(ScmObj objs, ScmObj fn)
+{
+    return sort_list_int(objs, fn, FALSE, TRUE);
+}
+
+ScmObj Scm_StableSortListX(ScmObj objs, ScmObj fn)
+{
+    return sort_list_int(objs, fn, TRUE, TRUE);
 }
 
 /*
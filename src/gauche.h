@@ -136,6 +136,12 @@ SCM_DECL_BEGIN
    gauche/number.h for the details. */
 #define GAUCHE_FFX 1
 
+/* Define this to 0 to turn off per-VM allocation cache of small objects
+   (pairs, flonums, closures).  See Scm__VMAllocCached() in vm.c. */
+#if !defined(GAUCHE_VM_ALLOC_CACHE)
+#define GAUCHE_VM_ALLOC_CACHE 1
+#endif
+
 /* Temporary - to test alignment of pairs */
 #define GAUCHE_CHECK_PAIR_ALIGNMENT 0
 
@@ -532,6 +538,17 @@ typedef struct ScmInstanceRec {
 #define SCM_NEW_ATOMIC_ARRAY(type, nelts)  ((type*)(SCM_MALLOC_ATOMIC(sizeof(type)*(nelts))))
 #define SCM_NEW_ATOMIC2(type, size) ((type)(SCM_MALLOC_ATOMIC(size)))
 
+/* For small, fixed-size objects that are allocated very frequently.
+   They are taken from the per-VM free list, which is refilled in batch.
+   Only use it for the objects that can be allocated by SCM_NEW. */
+SCM_EXTERN void *Scm__VMAllocCached(size_t size);
+
+#if GAUCHE_VM_ALLOC_CACHE
+#define SCM_NEW_CACHED(type)  ((type*)Scm__VMAllocCached(sizeof(type)))
+#else
+#define SCM_NEW_CACHED(type)  SCM_NEW(type)
+#endif
+
 typedef void (*ScmFinalizerProc)(ScmObj z, void *data);
 SCM_EXTERN void Scm_RegisterFinalizer(ScmObj z, ScmFinalizerProc finalizer,
                                       void *data);
@@ -654,6 +671,7 @@ SCM_EXTERN ScmObj Scm_VMEval(ScmObj expr, ScmObj env);
 SCM_EXTERN ScmObj Scm_VMCall(ScmObj *args, int argcnt, void *data);
 
 SCM_EXTERN ScmObj Scm_VMCallCC(ScmObj proc);
+SCM_EXTERN ScmObj Scm_VMCallEC(ScmObj proc);
 SCM_EXTERN ScmObj Scm_VMCallPC(ScmObj proc);
 SCM_EXTERN ScmObj Scm_VMReset(ScmObj proc);
 SCM_EXTERN void   Scm_VMPushDynamicHandlers(ScmObj, ScmObj, ScmObj);
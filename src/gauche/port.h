@@ -129,6 +129,9 @@ typedef struct ScmPortInputStringRec {
     const char *start;
     const char *current;
     const char *end;
+    ScmObj owner;               /* If the content isn't in GC heap, the
+                                   object that owns it (e.g. memory-region).
+                                   #f otherwise. */
 } ScmPortInputString;
 
 /* Note on Port Positioning Interface
@@ -483,6 +486,9 @@ SCM_EXTERN ScmObj Scm_MakeInputStringPortFull(ScmString *str,
                                               u_long flags);
 SCM_EXTERN ScmObj Scm_MakeOutputStringPortFull(ScmObj name,
                                                u_long flags);
+SCM_EXTERN ScmObj Scm_MakeInputMemoryPort(const char *start, ScmSize size,
+                                          ScmObj owner, ScmObj name,
+                                          u_long flags);
 
 /* these two are deprecated */
 SCM_EXTERN ScmObj Scm_MakeInputStringPort(ScmString *str, int privatep);
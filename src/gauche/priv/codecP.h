@@ -0,0 +1,77 @@
+/*
+ * codecP.h - binary-to-text codecs (private)
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef GAUCHE_PRIV_CODECP_H
+#define GAUCHE_PRIV_CODECP_H
+
+/* Codecs for the binary-to-text encodings whose radix is a power of two,
+   that is, base16, base32 and base64 (RFC4648).   The codec carries
+   its state across calls, so that large input can be fed in chunks.
+   Used by rfc.base64. */
+
+typedef struct ScmBinaryCodecRec {
+    const char *name;           /* "base64" etc.  For error messages. */
+    int bits;                   /* bits per digit: 4, 5 or 6 */
+    int quantumDigits;          /* # of digits per quantum: 2, 8 or 4 */
+    int flags;
+    int lineWidth;              /* encoder: fold output.  0 for no folding */
+    int column;                 /* encoder: current column */
+    int count;                  /* # of digits processed, modulo quantum */
+    int done;                   /* decoder: padding is seen */
+    int nacc;                   /* # of pending bits in acc */
+    u_long acc;                 /* pending bits */
+    char enc[64];               /* value -> digit */
+    signed char dec[256];       /* byte -> value, or -1 */
+} ScmBinaryCodec;
+
+enum {
+    SCM_BINARY_CODEC_OMIT_PADDING = (1L<<0), /* encoder: omit trailing '=' */
+    SCM_BINARY_CODEC_STRICT = (1L<<1),       /* decoder: reject bad input */
+    SCM_BINARY_CODEC_FOLD_CASE = (1L<<2)     /* decoder: accept lowercase */
+};
+
+SCM_EXTERN void   Scm__BinaryCodecInit(ScmBinaryCodec *c, const char *name,
+                                       int bits, ScmString *digits,
+                                       int flags, int lineWidth);
+SCM_EXTERN ScmObj Scm__BinaryEncode(ScmBinaryCodec *c,
+                                    const u_char *src, ScmSize len);
+SCM_EXTERN ScmObj Scm__BinaryDecode(ScmBinaryCodec *c,
+                                    const u_char *src, ScmSize len,
+                                    int toString);
+SCM_EXTERN void   Scm__BinaryEncodePort(ScmBinaryCodec *c,
+                                        ScmPort *in, ScmPort *out);
+SCM_EXTERN void   Scm__BinaryDecodePort(ScmBinaryCodec *c,
+                                        ScmPort *in, ScmPort *out);
+
+#endif /*GAUCHE_PRIV_CODECP_H*/
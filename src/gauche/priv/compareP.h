@@ -46,4 +46,8 @@ struct ScmComparatorRec {
     u_long flags;
 };
 
+/* Sort uniform vector in place by the natural order.  Returns FALSE
+   if the vector can't be handled (see compare.c). */
+SCM_EXTERN int Scm__SortUVector(ScmUVector *v, int stable);
+
 #endif /*GAUCHE_PRIV_COMPAREP_H*/
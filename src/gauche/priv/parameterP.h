@@ -68,6 +68,9 @@ struct ScmParameterizationRec {
     ScmObj parameterization;
 };
 
+/* Invalidate the parameter lookup cache of VM. */
+SCM_EXTERN void Scm__VMParameterCacheClear(ScmVM *vm);
+
 /* Obtain uninterned symbol saved in the info slot of parameter subr. */
 SCM_EXTERN ScmObj Scm__GetParameterSymbol();
 
@@ -159,6 +159,10 @@ typedef struct ScmEscapePointRec {
                                    with-error-handler uses the latter model,
                                    but SRFI-34's guard needs the former model.
                                 */
+    int escapeOnly;             /* TRUE if this is created by call/ec.
+                                   CONT may point to a stale stack frame;
+                                   the current one is found through the
+                                   marker frame.  See Scm_VMCallEC. */
 
     /* The following fields are used for new implementation of partial cont. */
     ScmObj promptTag;
@@ -171,6 +175,55 @@ SCM_CLASS_DECL(Scm_EscapePointClass);
 #define SCM_ESCAPE_POINT(obj)   ((ScmEscapePoint*)obj)
 #define SCM_ESCAPE_POINT_P(obj) SCM_ISA(obj, SCM_CLASS_ESCAPE_POINT)
 
+/*
+ * Fiber
+ *
+ *  A fiber has its own VM stack segment.  Switching to and from a fiber
+ *  swaps the VM registers that depend on the stack segment, so no frames
+ *  are copied.  While the fiber is suspended, REGS holds the fiber's
+ *  registers; while it is running, REGS holds the resumer's.
+ *
+ *  GUARD is a dynamic handler entry placed at the bottom of the fiber's
+ *  handler chain.  Its 'after' handler is invoked when the control
+ *  escapes from the running fiber by a continuation or an error.
+ */
+typedef struct ScmFiberRegsRec {
+    ScmObj *stack;
+    ScmObj *stackBase;
+    ScmObj *stackEnd;
+    ScmObj *sp;
+    ScmContFrame *cont;
+    ScmObj denv;
+    ScmObj dynamicHandlers;
+    ScmObj resetChain;
+    ScmObj floatingEscapePoints;
+#if GAUCHE_FFX
+    ScmFlonum *fpsp;
+    ScmFlonum *fpstack;
+    ScmFlonum *fpstackEnd;
+#endif /*GAUCHE_FFX*/
+} ScmFiberRegs;
+
+struct ScmFiberRec {
+    SCM_HEADER;
+    ScmObj thunk;
+    int state;                  /* SCM_FIBER_* below */
+    ScmVM *vm;                  /* the VM that runs this fiber */
+    ScmObj parent;              /* the fiber that resumed us, or #f */
+    ScmCStack *cstack;          /* vm->cstack when resumed */
+    ScmObj guard;               /* bottom dynamic handler entry */
+    ScmObj *segment;            /* our stack segment */
+    ScmFiberRegs regs;
+};
+
+enum {
+    SCM_FIBER_NEW,              /* not started yet */
+    SCM_FIBER_SUSPENDED,        /* called fiber-yield */
+    SCM_FIBER_RUNNING,
+    SCM_FIBER_ESCAPED,          /* control escaped from the fiber */
+    SCM_FIBER_DONE              /* the thunk returned */
+};
+
 /* Escape types */
 #define SCM_VM_ESCAPE_NONE   0
 #define SCM_VM_ESCAPE_ERROR  1
@@ -273,6 +273,9 @@ SCM_EXTERN ScmObj Scm_SysSelect(ScmObj rfds, ScmObj wfds, ScmObj efds,
                                 ScmObj timeout);
 SCM_EXTERN ScmObj Scm_SysSelectX(ScmObj rfds, ScmObj wfds, ScmObj efds,
                                  ScmObj timeout);
+#if defined(HAVE_SYS_EPOLL_H)
+SCM_EXTERN ScmObj Scm_SysEpollWait(int epfd, int maxevents, ScmObj timeout);
+#endif /*HAVE_SYS_EPOLL_H*/
 #else  /*!HAVE_SELECT*/
 /* dummy definitions */
 typedef struct ScmHeaderRec ScmSysFdset;
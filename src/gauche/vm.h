@@ -37,6 +37,15 @@
 /* Size of stack per VM (in words). */
 #define SCM_VM_STACK_SIZE      10000
 
+/* Initial size of stack segment per fiber (in words).  When it
+   overflows, the frames are moved to the heap and the segment is
+   replaced by one twice as large, up to SCM_VM_STACK_SIZE. */
+#define SCM_VM_FIBER_STACK_SIZE 256
+
+/* Size of flonum stack per fiber (in flonums).  It is allocated
+   when the fiber first returns a flonum. */
+#define SCM_VM_FIBER_FPSTACK_SIZE 64
+
 /* Maximum # of values allowed for multiple value return */
 #define SCM_VM_MAX_VALUES      20
 
@@ -330,6 +339,26 @@ typedef struct ScmCStackRec {
 /* ScmEscapePoint definition is in vmP.h */
 typedef struct ScmEscapePointRec ScmEscapePoint;
 
+/*
+ * Fiber
+ *
+ *  A fiber runs a thunk on its own VM stack segment, and can suspend
+ *  itself by fiber-yield to return to the resumer.  See vm.c for
+ *  the details.  ScmFiber definition is in vmP.h.
+ */
+typedef struct ScmFiberRec ScmFiber;
+
+SCM_CLASS_DECL(Scm_FiberClass);
+#define SCM_CLASS_FIBER         (&Scm_FiberClass)
+#define SCM_FIBER(obj)          ((ScmFiber*)(obj))
+#define SCM_FIBERP(obj)         SCM_XTYPEP(obj, SCM_CLASS_FIBER)
+
+SCM_EXTERN ScmObj Scm_MakeFiber(ScmObj thunk);
+SCM_EXTERN ScmObj Scm_FiberState(ScmObj fiber);
+SCM_EXTERN ScmObj Scm_VMFiberResume(ScmObj fiber, ScmObj val);
+SCM_EXTERN ScmObj Scm_VMFiberYield(ScmObj val);
+SCM_EXTERN ScmObj Scm_VMCurrentFiber(void);
+
 /*
  * Signal queue
  *
@@ -408,6 +437,32 @@ typedef struct ScmVMStatRec {
     ScmObj     loadStat;
 } ScmVMStat;
 
+/*
+ * Allocation cache
+ *
+ *  Each VM keeps free lists of small objects, refilled in batch from GC.
+ *  Size classes are in units of GC granule (two words), and we cache
+ *  objects up to SCM_VM_ALLOC_CACHE_SIZE granules, which covers pairs,
+ *  extended pairs, flonums and closures.  See Scm__VMAllocCached() in vm.c.
+ */
+#define SCM_VM_ALLOC_CACHE_SIZE  5
+
+/*
+ * Parameter lookup cache
+ *
+ *  Each VM caches the parameterization found in the current denv, and
+ *  the bindings of recently referenced parameters in it.  The denv and
+ *  parameterization lists are never mutated, so the entries are keyed
+ *  by their identity.  See Scm_PrimitiveParameterRef() in parameter.c.
+ */
+#define SCM_VM_PARAMETER_CACHE_SIZE  16  /* must be power of 2 */
+
+typedef struct ScmVMParameterCacheRec {
+    ScmObj parameterization;    /* the alist this entry is valid for */
+    ScmObj param;               /* primitive parameter */
+    ScmObj binding;             /* (param . value) in parameterization, or #f */
+} ScmVMParameterCache;
+
 /* The profiler structure is defined in prof.h */
 typedef struct ScmVMProfilerRec ScmVMProfiler;
 
@@ -585,6 +640,21 @@ struct ScmVMRec {
                                    appears in 'reset' and the end marker of
                                    partial continuation is set. */
 
+    /* for fibers */
+    ScmObj currentFiber;        /* running fiber, or #f */
+    ScmObj *fiberStackCache;    /* a stack segment of a finished fiber,
+                                   kept for reuse. */
+
+    /* Parameter lookup cache */
+    ScmObj paramDenv;           /* denv paramTable is taken from */
+    ScmObj paramTable;          /* parameterization in paramDenv */
+    ScmVMParameterCache paramCache[SCM_VM_PARAMETER_CACHE_SIZE];
+
+#if GAUCHE_VM_ALLOC_CACHE
+    void *allocCache[SCM_VM_ALLOC_CACHE_SIZE];
+                                /* free lists of small objects, linked
+                                   through their first word. */
+#endif /*GAUCHE_VM_ALLOC_CACHE*/
 };
 
 SCM_EXTERN ScmVM *Scm_NewVM(ScmVM *proto, ScmObj name);
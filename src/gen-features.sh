@@ -119,6 +119,7 @@ check gauche.sys.crypt NULL HAVE_CRYPT
 check gauche.sys.symlink NULL HAVE_SYMLINK
 check gauche.sys.readlink NULL HAVE_READLINK
 check gauche.sys.select NULL HAVE_SELECT
+check gauche.sys.epoll NULL HAVE_SYS_EPOLL_H
 
 check gauche.net.ipv6 gauche.net HAVE_IPV6
 check gauche.sys.openpty gauche.termios HAVE_OPENPTY
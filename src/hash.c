@@ -36,6 +36,7 @@
 #include "gauche.h"
 #include "gauche/priv/configP.h"
 #include "gauche/priv/atomicP.h"
+#include "gauche/priv/hashP.h"
 
 /*============================================================
  * Internal structures
@@ -551,6 +552,9 @@ static Entry *insert_entry(ScmHashCore *table,
     e->value = 0;
     e->next = buckets[index];
     e->hashval = hashval;
+    /* The entry must be complete before it becomes reachable, for
+       Scm__HashCoreSearchConcurrent may be walking the chain. */
+    Scm_AtomicThreadFence();
     buckets[index] = e;
 
     if (table->numEntries == INT_MAX) {
@@ -579,9 +583,13 @@ static Entry *insert_entry(ScmHashCore *table,
         /* gc friendliness */
         for (int i=0; i<table->numBuckets; i++) table->buckets[i] = NULL;
 
-        table->numBuckets = newsize;
-        table->numBucketsLog2 = newbits;
+        /* Publish the new bucket array before the new size, so that
+           a concurrent reader that sees the new size never indexes
+           the old, smaller array.  See Scm__HashCoreSearchConcurrent. */
         table->buckets = (void**)newb;
+        table->numBucketsLog2 = newbits;
+        Scm_AtomicThreadFence();
+        table->numBuckets = newsize;
     }
     return e;
 }
@@ -886,6 +894,34 @@ ScmDictEntry *Scm_HashCoreSearch(ScmHashCore *table, intptr_t key,
     return (ScmDictEntry*)p(table, key, op);
 }
 
+/* Lookup without the lock the writers of TABLE hold.  Only for
+   SCM_HASH_EQ tables, and only for readers that can detect concurrent
+   modification by other means and retry (e.g. the binding version
+   in module.c).  While a writer is in progress, the result may miss an
+   existing entry, but we never read outside of the bucket array and
+   never follow a chain that doesn't terminate: entries are linked only
+   after they're complete, deleted entries get NULL next pointers, and
+   rehashing moves entries into fresh chains.  An entry just created
+   by SCM_DICT_CREATE may have no value yet; we treat it as absent. */
+ScmDictEntry *Scm__HashCoreSearchConcurrent(ScmHashCore *table, intptr_t key)
+{
+    SCM_ASSERT(table->accessfn == (void*)address_access);
+    int size = table->numBuckets;
+    int bits = table->numBucketsLog2;
+    Scm_AtomicThreadFence();
+    Entry **buckets = (Entry**)table->buckets;
+    if (size == 0) return NULL;
+
+    u_long hashval, index;
+    ADDRESS_HASH(hashval, key);
+    index = HASH2INDEX(size, bits, hashval);
+
+    for (Entry *e = buckets[index]; e; e = e->next) {
+        if (e->key == key) return e->value? (ScmDictEntry*)e : NULL;
+    }
+    return NULL;
+}
+
 int Scm_HashCoreNumEntries(ScmHashCore *table)
 {
     return table->numEntries;
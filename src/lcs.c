@@ -0,0 +1,250 @@
+/*
+ * lcs.c - longest common subsequence kernel
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#define LIBGAUCHE_BODY
+#include "gauche.h"
+#include "gauche/priv/configP.h"
+#include "gauche/priv/lcsP.h"
+
+/* LCS of two sequences of integers, used by util.lcs.  The caller maps
+ * the original elements (e.g. lines of text) to integers so that equal
+ * elements get the same number; we only compare integers here.
+ *
+ * The algorithm is Myers's O((M+N)D) one, with the linear-space
+ * refinement described in the same paper (Section 4b): we find the
+ * "middle snake" of the optimal edit path by running the search from
+ * both ends, and recurse on the two halves.  Small subproblems, and the
+ * ones whose edit distance is at most 1, are solved with the basic greedy
+ * algorithm that keeps the matched points of each diagonal.
+ *
+ * Scheme version of the same algorithm is in lib/util/lcs.scm; both must
+ * choose the same subsequence.
+ */
+
+typedef struct lcs_ctx_rec {
+    const int32_t *a;
+    const int32_t *b;
+    /* Work vectors, 2(N+M)+2 elements each.  The middle snake search
+       uses v0 and v1 as forward and backward V; the basic algorithm
+       uses v0 for x, v1 for the lcs length and v2 for the match chain. */
+    ScmSmallInt *v0, *v1, *v2;
+    /* Match chain nodes for the basic algorithm */
+    ScmSmallInt *nx, *ny, *nprev;
+    ScmSmallInt nnodes, nodecap;
+    /* Result pairs, in order */
+    ScmSmallInt *out;
+    ScmSmallInt nout, outcap;
+} lcs_ctx;
+
+static ScmSmallInt *grow(ScmSmallInt *v, ScmSmallInt n, ScmSmallInt newcap)
+{
+    ScmSmallInt *nv = SCM_NEW_ATOMIC_ARRAY(ScmSmallInt, newcap);
+    if (n > 0) memcpy(nv, v, n * sizeof(ScmSmallInt));
+    return nv;
+}
+
+static void emit(lcs_ctx *c, ScmSmallInt x, ScmSmallInt y)
+{
+    if (c->nout + 2 > c->outcap) {
+        ScmSmallInt cap = c->outcap * 2 + 64;
+        c->out = grow(c->out, c->nout, cap);
+        c->outcap = cap;
+    }
+    c->out[c->nout++] = x;
+    c->out[c->nout++] = y;
+}
+
+static ScmSmallInt new_node(lcs_ctx *c, ScmSmallInt x, ScmSmallInt y,
+                            ScmSmallInt prev)
+{
+    if (c->nnodes == c->nodecap) {
+        ScmSmallInt cap = c->nodecap * 2 + 64;
+        c->nx = grow(c->nx, c->nnodes, cap);
+        c->ny = grow(c->ny, c->nnodes, cap);
+        c->nprev = grow(c->nprev, c->nnodes, cap);
+        c->nodecap = cap;
+    }
+    c->nx[c->nnodes] = x;
+    c->ny[c->nnodes] = y;
+    c->nprev[c->nnodes] = prev;
+    return c->nnodes++;
+}
+
+/* The basic algorithm on a[x0,x1) and b[y0,y1).  Its space is
+   proportional to the total length of the snakes it visits, so we only
+   use it on small subproblems. */
+static void lcs_basic(lcs_ctx *c, ScmSmallInt x0, ScmSmallInt x1,
+                      ScmSmallInt y0, ScmSmallInt y1)
+{
+    ScmSmallInt N = x1 - x0, M = y1 - y0, T = N + M;
+    ScmSmallInt *vd = c->v0 + T, *vl = c->v1 + T, *vr = c->v2 + T;
+    const int32_t *a = c->a, *b = c->b;
+
+    if (N == 0 || M == 0) return;   /* no common subsequence */
+    for (ScmSmallInt i = -T; i <= T + 1; i++) vl[i] = 0;
+    vd[1] = 0;
+    vr[1] = -1;
+    c->nnodes = 0;
+
+    for (ScmSmallInt d = 0; d <= T; d++) {
+        for (ScmSmallInt k = -d; k <= d; k += 2) {
+            ScmSmallInt x, l, r;
+            if (k == -d || (k != d && vd[k-1] < vd[k+1])) {
+                x = vd[k+1]; l = vl[k+1]; r = vr[k+1];
+            } else {
+                x = vd[k-1] + 1; l = vl[k-1]; r = vr[k-1];
+            }
+            ScmSmallInt y = x - k;
+            while (x < N && y < M && a[x0+x] == b[y0+y]) {
+                r = new_node(c, x0+x, y0+y, r);
+                x++; y++; l++;
+            }
+            vd[k] = x; vl[k] = l; vr[k] = r;
+            if (x >= N && y >= M) {
+                /* Pick the first diagonal that has the longest chain. */
+                ScmSmallInt maxl = 0, best = -1;
+                for (ScmSmallInt i = -T; i <= T; i++) {
+                    if (vl[i] > maxl) { maxl = vl[i]; best = vr[i]; }
+                }
+                ScmSmallInt start = c->nout;
+                for (; best >= 0; best = c->nprev[best]) {
+                    emit(c, c->nx[best], c->ny[best]);
+                }
+                /* The chain is in reverse order. */
+                for (ScmSmallInt i = start, j = c->nout - 2; i < j;
+                     i += 2, j -= 2) {
+                    ScmSmallInt tx = c->out[i], ty = c->out[i+1];
+                    c->out[i] = c->out[j]; c->out[i+1] = c->out[j+1];
+                    c->out[j] = tx; c->out[j+1] = ty;
+                }
+                return;
+            }
+        }
+    }
+    Scm_Panic("lcs_basic: something's wrong (implementation error?)");
+}
+
+/* Finds the middle snake of a[x0,x1) and b[y0,y1).  Returns the length
+   of the shortest edit script, and sets the snake to (*sx,*sy)-(*ex,*ey). */
+static ScmSmallInt middle_snake(lcs_ctx *c, ScmSmallInt x0, ScmSmallInt x1,
+                                ScmSmallInt y0, ScmSmallInt y1,
+                                ScmSmallInt *sx, ScmSmallInt *sy,
+                                ScmSmallInt *ex, ScmSmallInt *ey)
+{
+    ScmSmallInt N = x1 - x0, M = y1 - y0, delta = N - M;
+    ScmSmallInt maxd = (N + M + 1) / 2;
+    ScmSmallInt *vf = c->v0 + maxd + 1, *vb = c->v1 + maxd + 1;
+    int odd = (int)(delta & 1);
+    const int32_t *a = c->a, *b = c->b;
+
+    vf[1] = 0;
+    vb[1] = 0;
+    for (ScmSmallInt d = 0; d <= maxd; d++) {
+        for (ScmSmallInt k = -d; k <= d; k += 2) {
+            ScmSmallInt x = (k == -d || (k != d && vf[k-1] < vf[k+1]))
+                ? vf[k+1] : vf[k-1] + 1;
+            ScmSmallInt y = x - k, x_ = x, y_ = y;
+            while (x < N && y < M && a[x0+x] == b[y0+y]) { x++; y++; }
+            vf[k] = x;
+            if (odd && k >= delta - (d - 1) && k <= delta + (d - 1)
+                && x + vb[delta - k] >= N) {
+                *sx = x0 + x_; *sy = y0 + y_;
+                *ex = x0 + x;  *ey = y0 + y;
+                return 2 * d - 1;
+            }
+        }
+        for (ScmSmallInt k = -d; k <= d; k += 2) {
+            ScmSmallInt u = (k == -d || (k != d && vb[k-1] < vb[k+1]))
+                ? vb[k+1] : vb[k-1] + 1;
+            ScmSmallInt v = u - k, u_ = u, v_ = v;
+            while (u < N && v < M && a[x1-1-u] == b[y1-1-v]) { u++; v++; }
+            vb[k] = u;
+            if (!odd && delta - k >= -d && delta - k <= d
+                && u + vf[delta - k] >= N) {
+                *sx = x1 - u;  *sy = y1 - v;
+                *ex = x1 - u_; *ey = y1 - v_;
+                return 2 * d;
+            }
+        }
+    }
+    Scm_Panic("middle_snake: something's wrong (implementation error?)");
+    return 0;                   /* dummy */
+}
+
+static void lcs_rec(lcs_ctx *c, ScmSmallInt x0, ScmSmallInt x1,
+                    ScmSmallInt y0, ScmSmallInt y1)
+{
+    if (x0 == x1 || y0 == y1) return;   /* no common subsequence */
+    if ((x1 - x0) + (y1 - y0) <= SCM_LCS_BASIC_LIMIT) {
+        lcs_basic(c, x0, x1, y0, y1);
+        return;
+    }
+    ScmSmallInt sx, sy, ex, ey;
+    ScmSmallInt d = middle_snake(c, x0, x1, y0, y1, &sx, &sy, &ex, &ey);
+    if (d <= 1) {
+        lcs_basic(c, x0, x1, y0, y1);
+        return;
+    }
+    lcs_rec(c, x0, sx, y0, sy);
+    for (ScmSmallInt i = 0; i < ex - sx; i++) emit(c, sx + i, sy + i);
+    lcs_rec(c, ex, x1, ey, y1);
+}
+
+/* Returns a list of (i . j) such that a[i] == b[j], for the LCS. */
+ScmObj Scm__LCSPositions(const int32_t *a, ScmSmallInt n,
+                         const int32_t *b, ScmSmallInt m)
+{
+    lcs_ctx c;
+    ScmSmallInt vsize = 2 * (n + m) + 2;
+
+    c.a = a;
+    c.b = b;
+    c.v0 = SCM_NEW_ATOMIC_ARRAY(ScmSmallInt, vsize);
+    c.v1 = SCM_NEW_ATOMIC_ARRAY(ScmSmallInt, vsize);
+    c.v2 = SCM_NEW_ATOMIC_ARRAY(ScmSmallInt, vsize);
+    c.nx = c.ny = c.nprev = NULL;
+    c.nnodes = c.nodecap = 0;
+    c.out = NULL;
+    c.nout = c.outcap = 0;
+
+    lcs_rec(&c, 0, n, 0, m);
+
+    ScmObj r = SCM_NIL;
+    for (ScmSmallInt i = c.nout - 2; i >= 0; i -= 2) {
+        r = Scm_Cons(Scm_Cons(SCM_MAKE_INT(c.out[i]),
+                              SCM_MAKE_INT(c.out[i+1])),
+                     r);
+    }
+    return r;
+}
@@ -512,23 +512,63 @@
 
 (select-module gauche.internal)
 
-(define-cproc %sort (seq)
+(define-cproc %sort (seq :optional (stable::<boolean> #f))
   (cond [(SCM_VECTORP seq)
          (let* ([r (Scm_VectorCopy (SCM_VECTOR seq) 0 -1 SCM_UNDEFINED)])
-           (Scm_SortArray (SCM_VECTOR_ELEMENTS r) (SCM_VECTOR_SIZE r) '#f)
+           (if stable
+             (Scm_StableSortArray (SCM_VECTOR_ELEMENTS r) (SCM_VECTOR_SIZE r)
+                                  '#f)
+             (Scm_SortArray (SCM_VECTOR_ELEMENTS r) (SCM_VECTOR_SIZE r) '#f))
            (return r))]
-        [(>= (Scm_Length seq) 0) (return (Scm_SortList seq '#f))]
+        [(>= (Scm_Length seq) 0)
+         (return (?: stable
+                     (Scm_StableSortList seq '#f)
+                     (Scm_SortList seq '#f)))]
         [else (SCM_TYPE_ERROR seq "proper list or vector")
               (return SCM_UNDEFINED)]))
 
-(define-cproc %sort! (seq)
+(define-cproc %sort! (seq :optional (stable::<boolean> #f))
   (cond [(SCM_VECTORP seq)
-         (Scm_SortArray (SCM_VECTOR_ELEMENTS seq) (SCM_VECTOR_SIZE seq) '#f)
+         (if stable
+           (Scm_StableSortArray (SCM_VECTOR_ELEMENTS seq) (SCM_VECTOR_SIZE seq)
+                                '#f)
+           (Scm_SortArray (SCM_VECTOR_ELEMENTS seq) (SCM_VECTOR_SIZE seq) '#f))
          (return seq)]
-        [(>= (Scm_Length seq) 0) (return (Scm_SortListX seq '#f))]
+        [(>= (Scm_Length seq) 0)
+         (return (?: stable
+                     (Scm_StableSortListX seq '#f)
+                     (Scm_SortListX seq '#f)))]
         [else (SCM_TYPE_ERROR seq "proper list or vector")
               (return SCM_UNDEFINED)]))
 
+;; Sort uniform vector V in place by the natural order of its elements.
+;; Returns #f if V can't be handled by the built-in sorter.
+(define-cproc %uvector-sort! (v::<uvector> :optional (stable::<boolean> #f))
+  ::<boolean>
+  (return (Scm__SortUVector v stable)))
+
+;; Non-destructive version.  Returns a sorted copy of V, or #f.
+(define-cproc %uvector-sorted-copy (v::<uvector> stable::<boolean>)
+  (let* ([klass::ScmClass* (Scm_ClassOf (SCM_OBJ v))]
+         [r (Scm_MakeUVector klass (SCM_UVECTOR_SIZE v) NULL)])
+    (memcpy (SCM_UVECTOR_ELEMENTS r) (SCM_UVECTOR_ELEMENTS v)
+            (Scm_UVectorSizeInBytes v))
+    (return (?: (Scm__SortUVector (SCM_UVECTOR r) stable) r SCM_FALSE))))
+
+;; Stable-sort the range [start, end) of vector V.  CMP is #f (to use
+;; the default order) or a procedure that returns true iff the first
+;; argument is less than the second one.  Sorted subranges in the input
+;; are detected, so this can also be used to merge sorted slices.
+(define-cproc %vector-stable-sort! (v::<vector> start::<fixnum> end::<fixnum>
+                                                 cmp)
+  ::<void>
+  (SCM_VECTOR_CHECK_MUTABLE v)
+  (unless (and (<= 0 start) (<= start end) (<= end (SCM_VECTOR_SIZE v)))
+    (Scm_Error "start/end out of range: (%ld %ld)" start end))
+  (unless (or (SCM_FALSEP cmp) (SCM_PROCEDUREP cmp))
+    (SCM_TYPE_ERROR cmp "procedure or #f"))
+  (Scm_StableSortArray (+ (SCM_VECTOR_ELEMENTS v) start) (- end start) cmp))
+
 ;; internal macro
 (define-syntax define-less?
   (syntax-rules ()
@@ -646,12 +686,24 @@
 ;;; Warren, and first used in the DEC-10 Prolog system.  R. A. O'Keefe
 ;;; adapted it to work destructively in Scheme.
 
+;; If the default order is requested, we can use the builtin sorter.
+(define-inline (%default-order? cmp key)
+  (and (not cmp) (or (eq? key identity) (eq? key values))))
+
 (define-in-module gauche (sort! seq . args)
-  (if (and (or (pair? seq) (vector? seq)) (null? args))
-    (%sort! seq)                  ; use internal version
-    (apply stable-sort! seq args)))
+  (cond [(and (or (pair? seq) (vector? seq)) (null? args))
+         (%sort! seq)]                  ; use internal version
+        [(and (uvector? seq) (null? args) (%uvector-sort! seq)) seq]
+        [else (apply stable-sort! seq args)]))
 
 (define-in-module gauche (stable-sort! seq :optional (cmp #f) (key identity))
+  (cond [(and (or (pair? seq) (vector? seq)) (%default-order? cmp key))
+         (%sort! seq #t)]
+        [(and (uvector? seq) (%default-order? cmp key) (%uvector-sort! seq #t))
+         seq]
+        [else (%stable-sort-by-procedure! seq cmp key)]))
+
+(define (%stable-sort-by-procedure! seq cmp key)
   (let1 sorted (%stable-sort! seq cmp key)
     (if (and (pair? sorted) (not (eq? sorted seq)))
       ;; %stable-sort! on a list may return a cell that's not the same
@@ -747,12 +799,20 @@
 ;;; copy of the sequence.
 
 (define-in-module gauche (sort seq . args)
-  (if (and (or (pair? seq) (vector? seq)) (null? args))
-    (%sort seq)  ;; use internal version
-    (apply stable-sort seq args)))
+  (cond [(and (or (pair? seq) (vector? seq)) (null? args))
+         (%sort seq)]                   ; use internal version
+        [(and (uvector? seq) (null? args) (%uvector-sorted-copy seq #f))]
+        [else (apply stable-sort seq args)]))
 
 (define-in-module gauche (stable-sort seq :optional (cmp #f) (key identity))
   (define-less? less? cmp 'sort)
+  (cond [(and (or (pair? seq) (vector? seq)) (%default-order? cmp key))
+         (%sort seq #t)]
+        [(and (uvector? seq) (%default-order? cmp key)
+              (%uvector-sorted-copy seq #t))]
+        [else (%stable-sort-by-procedure seq less? key)]))
+
+(define (%stable-sort-by-procedure seq less? key)
   (if (memq key `(,identity ,values))
     (cond [(null? seq) seq]
           [(pair? seq) (%stable-sort! (list-copy seq) less?)]
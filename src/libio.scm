@@ -1325,6 +1325,24 @@
          (unwind-protect (with-output-to-port port thunk)
            (close-output-port port)))))
 
+;; Maps the entire file and reads from memory.  Avoids read(2) and
+;; buffer copying; useful to scan large files.  The port drops the
+;; mapping when closed; it is unmapped when it becomes garbage.
+(define-in-module gauche (open-input-mmap-file filename
+                                                :key (if-does-not-exist :error))
+  (and-let* ([p (%open-input-file filename
+                                  :if-does-not-exist if-does-not-exist)])
+    (unwind-protect
+        (let* ([st (sys-fstat p)]
+               [size (slot-ref st 'size)])
+          (unless (eq? (slot-ref st 'type) 'regular)
+            (error "can't map a non-regular file:" filename))
+          (if (zero? size)
+            (open-input-string "" :name filename)
+            (open-input-memory-region (sys-mmap p PROT_READ MAP_PRIVATE size)
+                                      :name filename :owner? #t)))
+      (close-input-port p))))
+
 ;; String ports
 (define-in-module gauche (with-output-to-string thunk)
   (let1 out (open-output-string)
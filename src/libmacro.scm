@@ -39,7 +39,7 @@
                              ^o ^p ^q ^r ^s ^t ^u ^v ^w ^x ^y ^z $ cut cute rec
                              guard
                              push! push-unique! pop! inc! dec! update! rotate!
-                             let1 if-let1 and-let1 let/cc begin0 rlet1
+                             let1 if-let1 and-let1 let/cc let/ec begin0 rlet1
                              let-values let*-values define-values set!-values
                              values-ref values->list
                              assume assume-type assert ineq ineq/comparator
@@ -571,6 +571,14 @@
                          `(call/cc (lambda (,var) ,@body)))]
        [_ (error "malformed let/cc:" f)]))))
 
+(define-syntax let/ec                   ;as in PLT
+  (er-macro-transformer
+   (^[f r c]
+     (match f
+       [(_ var . body) (quasirename r
+                         `(call/ec (lambda (,var) ,@body)))]
+       [_ (error "malformed let/ec:" f)]))))
+
 (define-syntax begin0                   ;prog1 in Lisp
   (er-macro-transformer
    (^[f r c]
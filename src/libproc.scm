@@ -81,6 +81,11 @@
 (define-cproc %call/pc (proc) (return (Scm_VMCallPC proc)))
 (define-cproc %reset (proc) (return (Scm_VMReset proc)))
 
+;; Escape-only continuation.  See Scm_VMCallEC in vm.c
+(select-module gauche)
+(define-cproc call-with-escape-continuation (proc) Scm_VMCallEC)
+(define call/ec call-with-escape-continuation)
+
 ;; Continuaton prompts
 (select-module gauche)
 (define-cproc make-continuation-prompt-tag (:optional (name #f))
@@ -156,6 +161,33 @@
   (gensym (x->string name)))
 (define (continuation-mark-key? obj) #t)
 
+;; Fibers
+;; See the comment of 'Fibers' section in vm.c
+(select-module gauche)
+(define-cproc make-fiber (thunk::<procedure>)
+  (return (Scm_MakeFiber (SCM_OBJ thunk))))
+(define-cproc fiber? (obj) ::<boolean> SCM_FIBERP)
+(define-cproc fiber-state (fiber) Scm_FiberState)
+(define-cproc current-fiber () Scm_VMCurrentFiber)
+
+(define-cproc fiber-resume (fiber :optional val)
+  (when (SCM_UNBOUNDP val) (set! val SCM_UNDEFINED))
+  (return (Scm_VMFiberResume fiber val)))
+(define-cproc fiber-yield (:optional val)
+  (when (SCM_UNBOUNDP val) (set! val SCM_UNDEFINED))
+  (return (Scm_VMFiberYield val)))
+
+;; Returns #t iff FIBER is the current fiber and fiber-yield can
+;; switch from here, i.e. we're not in a C callback (or reset) called
+;; within the fiber.  Used by control.green-thread to check before
+;; changing its state.
+(select-module gauche.internal)
+(define-cproc %fiber-yieldable? (fiber) ::<boolean>
+  (let* ([vm::ScmVM* (Scm_VM)])
+    (return (and (SCM_FIBERP fiber)
+                 (SCM_EQ fiber (-> vm currentFiber))
+                 (== (-> vm cstack) (-> (SCM_FIBER fiber) cstack))))))
+
 ;;;
 ;;; Useful gadgets
 ;;;
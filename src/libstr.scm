@@ -697,3 +697,78 @@
 (define-cproc string-cursor-diff (s::<string> start end)
   (return (Scm_Sub (Scm_StringCursorIndex s end)
                    (Scm_StringCursorIndex s start))))
+
+;;
+;; Binary-to-text codecs.  Used by rfc.base64.
+;;
+
+(select-module gauche.internal)
+(inline-stub
+ (.include "gauche/priv/codecP.h")
+
+ (define-cise-stmt with-codec-input
+   [(_ data (ptr len) . body)
+    `(cond
+      [(SCM_U8VECTORP ,data)
+       (let* ([,ptr :: (const u_char*)
+                    (cast (const u_char*) (SCM_U8VECTOR_ELEMENTS ,data))]
+              [,len :: ScmSize (SCM_U8VECTOR_SIZE ,data)])
+         ,@body)]
+      [(SCM_STRINGP ,data)
+       (let* ([b :: (const ScmStringBody*) (SCM_STRING_BODY ,data)]
+              [,ptr :: (const u_char*)
+                    (cast (const u_char*) (SCM_STRING_BODY_START b))]
+              [,len :: ScmSize (SCM_STRING_BODY_SIZE b)])
+         ,@body)]
+      [else (SCM_TYPE_ERROR ,data "u8vector or string")])])
+
+ (define-cfn codec-flags (omit-padding::int strict::int fold-case::int)
+   ::int :static
+   (return (logior (?: omit-padding SCM_BINARY_CODEC_OMIT_PADDING 0)
+                   (?: strict SCM_BINARY_CODEC_STRICT 0)
+                   (?: fold-case SCM_BINARY_CODEC_FOLD_CASE 0))))
+ )
+
+;; NAME is used in error messages.  BITS is 4, 5 or 6, and DIGITS is a
+;; string of 2^BITS characters.
+(define-cproc %binary-encode (name::<const-cstring> bits::<fixnum>
+                              digits::<string> data
+                              line-width::<fixnum> omit-padding::<boolean>)
+  (let* ([c::ScmBinaryCodec])
+    (Scm__BinaryCodecInit (& c) name bits digits
+                          (codec-flags omit-padding FALSE FALSE) line-width)
+    (with-codec-input data (p len)
+      (return (Scm__BinaryEncode (& c) p len)))
+    (return SCM_UNDEFINED)))
+
+(define-cproc %binary-decode (name::<const-cstring> bits::<fixnum>
+                              digits::<string> data
+                              strict::<boolean> fold-case::<boolean>
+                              to-string::<boolean>)
+  (let* ([c::ScmBinaryCodec])
+    (Scm__BinaryCodecInit (& c) name bits digits
+                          (codec-flags FALSE strict fold-case) 0)
+    (with-codec-input data (p len)
+      (return (Scm__BinaryDecode (& c) p len to-string)))
+    (return SCM_UNDEFINED)))
+
+(define-cproc %binary-encode-port (name::<const-cstring> bits::<fixnum>
+                                   digits::<string>
+                                   iport::<input-port> oport::<output-port>
+                                   line-width::<fixnum>
+                                   omit-padding::<boolean>)
+  ::<void>
+  (let* ([c::ScmBinaryCodec])
+    (Scm__BinaryCodecInit (& c) name bits digits
+                          (codec-flags omit-padding FALSE FALSE) line-width)
+    (Scm__BinaryEncodePort (& c) iport oport)))
+
+(define-cproc %binary-decode-port (name::<const-cstring> bits::<fixnum>
+                                   digits::<string>
+                                   iport::<input-port> oport::<output-port>
+                                   strict::<boolean> fold-case::<boolean>)
+  ::<void>
+  (let* ([c::ScmBinaryCodec])
+    (Scm__BinaryCodecInit (& c) name bits digits
+                          (codec-flags FALSE strict fold-case) 0)
+    (Scm__BinaryDecodePort (& c) iport oport)))
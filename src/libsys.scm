@@ -50,6 +50,7 @@
   (.when "HAVE_SYS_MMAN_H"     (.include <sys/mman.h>))
 
   (.when (defined "GAUCHE_WINDOWS")
+    (.include <io.h>)   ;; _commit
     (.undef _SC_CLK_TCK)) ;; avoid undefined reference to sysconf
   )
 
@@ -615,6 +616,33 @@
           [else (SCM_TYPE_ERROR maybe-port "port or #f")])
     (return (Scm_SysMmap NULL fd size off prot flags))))
 
+;; Unmaps the region immediately.  Not public, since views to the region
+;; would point to unmapped memory; the caller must make sure none of them
+;; is used afterwards.  Used by util.digest.
+(select-module gauche.internal)
+(define-cproc %sys-munmap (mem) ::<void>
+  (unless (SCM_MEMORY_REGION_P mem)
+    (SCM_TYPE_ERROR mem "<memory-region>"))
+  (Scm_SysMunmap (SCM_MEMORY_REGION mem)))
+
+(select-module gauche)
+
+;; Input port reading from the memory region.  If OWNER? is true,
+;; the port drops its reference to the region when closed.  The region
+;; isn't unmapped then, since views to it may be alive; its finalizer
+;; does the job.
+(define-cproc open-input-memory-region (mem :key (name #f)
+                                                 (owner?::<boolean> #f))
+  (unless (SCM_MEMORY_REGION_P mem)
+    (SCM_TYPE_ERROR mem "<memory-region>"))
+  (when (SCM_FALSEP name) (set! name (SCM_MAKE_STR "(memory region)")))
+  (let* ([m::ScmMemoryRegion* (SCM_MEMORY_REGION mem)])
+    (when (== (-> m ptr) NULL)
+      (Scm_Error "memory region is already unmapped: %S" mem))
+    (return (Scm_MakeInputMemoryPort (cast (const char *) (-> m ptr))
+                                     (-> m size) mem name
+                                     (?: owner? SCM_PORT_OWNER 0)))))
+
 (inline-stub
  (define-enum PROT_EXEC)
  (define-enum PROT_READ)
@@ -1325,6 +1353,15 @@
     (SCM_SYSCALL r (ftruncate fd (Scm_IntegerToOffset length)))
     (when (< r 0) (Scm_SysError "ftruncate failed on %S" port_or_fd))))
 
+;; If PORT-OR-FD is an output port, its buffer is flushed first.
+(define-cproc sys-fsync (port_or_fd) ::<void>
+  (let* ([r::int] [fd::int (Scm_GetPortFd port_or_fd TRUE)])
+    (when (SCM_OPORTP port_or_fd) (Scm_Flush (SCM_PORT port_or_fd)))
+    (.if (defined "GAUCHE_WINDOWS")
+      (SCM_SYSCALL r (_commit fd))
+      (SCM_SYSCALL r (fsync fd)))
+    (when (< r 0) (Scm_SysError "fsync failed on %S" port_or_fd))))
+
 (inline-stub
  ;; NB. Linux needs _XOPEN_SOURCE defined before unistd.h to get crypt()
  ;; prototype.  However, it screws up something else.  Just for now I
@@ -1446,6 +1483,42 @@
    ) ;; when defined(HAVE_SELECT)
  )
 
+;; epoll - Linux specific.  Scalable alternative of select; the cost of
+;; sys-epoll-wait only depends on the number of ready fds.
+(inline-stub
+ (.when (defined "HAVE_SYS_EPOLL_H")
+   (.include <sys/epoll.h>)
+
+   (define-cproc sys-epoll-create () ::<int>
+     (SCM_SYSCALL SCM_RESULT (epoll_create1 EPOLL_CLOEXEC))
+     (when (< SCM_RESULT 0) (Scm_SysError "epoll_create1 failed")))
+
+   (define-cproc sys-epoll-ctl (epfd::<int> op::<int> port-or-fd
+                                            :optional (events::<ulong> 0))
+     ::<void>
+     (let* ([fd::int (Scm_GetPortFd port-or-fd TRUE)]
+            [ev::(struct epoll_event)]
+            [r::int])
+       (set! (ref ev events) events
+             (ref ev data fd) fd)
+       (SCM_SYSCALL r (epoll_ctl epfd op fd (& ev)))
+       (when (< r 0) (Scm_SysError "epoll_ctl failed on %S" port-or-fd))))
+
+   (define-cproc sys-epoll-wait (epfd::<int> :optional (maxevents::<int> 64)
+                                                       (timeout #f))
+     (return (Scm_SysEpollWait epfd maxevents timeout)))
+
+   (define-enum EPOLL_CTL_ADD)
+   (define-enum EPOLL_CTL_MOD)
+   (define-enum EPOLL_CTL_DEL)
+   (define-enum EPOLLIN)
+   (define-enum EPOLLOUT)
+   (define-enum EPOLLPRI)
+   (define-enum EPOLLERR)
+   (define-enum EPOLLHUP)
+   ) ;; when defined(HAVE_SYS_EPOLL_H)
+ )
+
 ;;---------------------------------------------------------------------
 ;; miscellaneous
 
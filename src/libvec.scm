@@ -917,3 +917,17 @@
                                    ceil::size_t*)
    ::size_t (%binary-search (ScmDoubleComplex) common-eqv dc-lt))
  )
+
+;;
+;; LCS kernel.  Used by util.lcs.
+;;
+
+(select-module gauche.internal)
+(inline-stub
+ (.include "gauche/priv/lcsP.h"))
+
+;; A and B are sequences of element ids; returns the LCS as a list
+;; of (a-index . b-index).
+(define-cproc %lcs-positions (a::<s32vector> b::<s32vector>)
+  (return (Scm__LCSPositions (SCM_S32VECTOR_ELEMENTS a) (SCM_S32VECTOR_SIZE a)
+                             (SCM_S32VECTOR_ELEMENTS b) (SCM_S32VECTOR_SIZE b))))
@@ -57,7 +57,7 @@ SCM_DEFINE_BUILTIN_CLASS(Scm_NullClass, NULL, NULL, NULL, NULL, list_cpl);
 
 ScmObj Scm_Cons(ScmObj car, ScmObj cdr)
 {
-    ScmPair *z = SCM_NEW(ScmPair);
+    ScmPair *z = SCM_NEW_CACHED(ScmPair);
     /* NB: these ENSURE_MEMs are moved here from vm loop to reduce
        the register pressure there.  In most cases these increases
        just a couple of mask-and-test instructions on the data on
@@ -71,8 +71,8 @@ ScmObj Scm_Cons(ScmObj car, ScmObj cdr)
 
 ScmObj Scm_Acons(ScmObj caar, ScmObj cdar, ScmObj cdr)
 {
-    ScmPair *y = SCM_NEW(ScmPair);
-    ScmPair *z = SCM_NEW(ScmPair);
+    ScmPair *y = SCM_NEW_CACHED(ScmPair);
+    ScmPair *z = SCM_NEW_CACHED(ScmPair);
     SCM_SET_CAR_UNCHECKED(y, caar);
     SCM_SET_CDR_UNCHECKED(y, cdar);
     SCM_SET_CAR_UNCHECKED(z, SCM_OBJ(y));
@@ -114,13 +114,13 @@ ScmObj Scm_VaList(va_list pvar)
          obj = va_arg(pvar, ScmObj))
     {
         if (SCM_NULLP(start)) {
-            start = SCM_OBJ(SCM_NEW(ScmPair));
+            start = SCM_OBJ(SCM_NEW_CACHED(ScmPair));
             SCM_SET_CAR_UNCHECKED(start, obj);
             SCM_SET_CDR_UNCHECKED(start, SCM_NIL);
             cp = start;
         } else {
             ScmObj item;
-            item = SCM_OBJ(SCM_NEW(ScmPair));
+            item = SCM_OBJ(SCM_NEW_CACHED(ScmPair));
             SCM_SET_CDR_UNCHECKED(cp, item);
             SCM_SET_CAR_UNCHECKED(item, obj);
             SCM_SET_CDR_UNCHECKED(item, SCM_NIL);
@@ -439,14 +439,14 @@ ScmObj Scm_Reverse2(ScmObj list, ScmObj tail)
 {
     if (!SCM_PAIRP(list)) return tail;
 
-    ScmPair *p = SCM_NEW(ScmPair);
+    ScmPair *p = SCM_NEW_CACHED(ScmPair);
     SCM_SET_CAR_UNCHECKED(p, SCM_NIL);
     SCM_SET_CDR_UNCHECKED(p, tail);
     ScmObj result = SCM_OBJ(p);
     ScmObj cp;
     SCM_FOR_EACH(cp, list) {
         SCM_SET_CAR_UNCHECKED(result, SCM_CAR(cp));
-        p = SCM_NEW(ScmPair);
+        p = SCM_NEW_CACHED(ScmPair);
         SCM_SET_CAR_UNCHECKED(p, SCM_NIL);
         SCM_SET_CDR_UNCHECKED(p, result);
         result = SCM_OBJ(p);
@@ -798,7 +798,7 @@ ScmObj Scm_MonotonicMerge(ScmObj sequences)
 static ScmObj make_extended_pair(ScmExtendedPairDescriptor *desc,
                                  ScmObj car, ScmObj cdr, ScmObj attrs)
 {
-    ScmRealExtendedPair *xp = SCM_NEW(ScmRealExtendedPair);
+    ScmRealExtendedPair *xp = SCM_NEW_CACHED(ScmRealExtendedPair);
     /* ScmRealExtendedPair is not an ScmObj, and
        ScmExtendedPairDescriptor is not an ScmClass.   To avoid confusion,
        we manually tweak tag bits.
@@ -34,8 +34,10 @@
 #define LIBGAUCHE_BODY
 #include "gauche.h"
 #include "gauche/priv/configP.h"
+#include "gauche/priv/atomicP.h"
 #include "gauche/priv/builtin-syms.h"
 #include "gauche/priv/glocP.h"
+#include "gauche/priv/hashP.h"
 #include "gauche/priv/moduleP.h"
 
 /*
@@ -77,6 +79,20 @@
  *    affect normal runtime performance.
  *
  * Benchmark showed the change made program loading 30% faster.
+ *
+ * Later, when programs started to load libraries from multiple threads,
+ * the lock on the lookup side became the bottleneck, since every
+ * global variable reference the compiler resolves goes through
+ * Scm_FindBinding.  So now lookups don't take the lock.  Modifications
+ * of binding tables and import lists still hold modules.mutex, and
+ * bracket the change with BINDINGS_CHANGE_BEGIN/END, which make
+ * modules.version odd during the change and advance it afterwards.
+ * A reader records the version, searches, and accepts the result
+ * only if the version was even and hasn't changed; otherwise it
+ * searches again under the lock.  The search can safely run in
+ * parallel with a writer (see Scm__HashCoreSearchConcurrent), and
+ * since definitions come in bursts while loading, the fallback is rare
+ * after startup.
  */
 
 /* Special treatment of keyword modules.
@@ -130,10 +146,35 @@
 /* Global module table */
 static struct {
     ScmHashTable *table;    /* Maps name -> module. */
-    ScmInternalMutex mutex; /* Lock for table.  Only register_module and
-                               lookup_module may hold the lock. */
+    ScmInternalMutex mutex; /* Lock for table and modification of
+                               bindings. */
+    ScmAtomicVar version;   /* Odd while bindings are being modified.
+                               See the note on mutex above. */
 } modules;
 
+/* Must be called with modules.mutex held */
+#define BINDINGS_CHANGE_BEGIN()                                         \
+    do {                                                                \
+        Scm_AtomicStore(&modules.version,                               \
+                        Scm_AtomicLoad(&modules.version)+1);            \
+        Scm_AtomicThreadFence();                                        \
+    } while (0)
+
+#define BINDINGS_CHANGE_END()                                           \
+    do {                                                                \
+        Scm_AtomicThreadFence();                                        \
+        Scm_AtomicStore(&modules.version,                               \
+                        Scm_AtomicLoad(&modules.version)+1);            \
+    } while (0)
+
+/* Lookup in a binding table, safe without modules.mutex */
+static inline ScmObj binding_ref(ScmHashTable *tab, ScmObj sym)
+{
+    ScmDictEntry *e = Scm__HashCoreSearchConcurrent(SCM_HASH_TABLE_CORE(tab),
+                                                    (intptr_t)sym);
+    return e? SCM_DICT_VALUE(e) : SCM_FALSE;
+}
+
 /* Predefined modules - slots will be initialized by Scm__InitModule */
 #define DEFINE_STATIC_MODULE(cname) \
     static ScmModule cname;
@@ -310,7 +351,8 @@ static inline void module_add_visited(module_cache *c, ScmModule *m)
    we need recursive searching in case of phantom binding (see gloc.h
    about phantom bindings).  The flags stay_in_module and external_only
    corresponds to the flags passed to Scm_FindBinding.  The exclude_self
-   flag is only used in recursive search. */
+   flag is only used in recursive search.
+   This may run without modules.mutex; see the note on mutex above. */
 static ScmGloc *search_binding(ScmModule *module, ScmSymbol *symbol,
                                int stay_in_module, int external_only,
                                int exclude_self)
@@ -321,9 +363,9 @@ static ScmGloc *search_binding(ScmModule *module, ScmSymbol *symbol,
     /* First, search from the specified module.  In this phase, we just ignore
        phantom bindings, for we'll search imported bindings later anyway. */
     if (!exclude_self) {
-        ScmObj v = Scm_HashTableRef(
+        ScmObj v = binding_ref(
             external_only? module->external : module->internal,
-            SCM_OBJ(symbol), SCM_FALSE);
+            SCM_OBJ(symbol));
         if (SCM_GLOCP(v)) {
             ScmGloc *g = SCM_GLOC(v);
             if (SCM_GLOC_PHANTOM_BINDING_P(g)) {
@@ -364,7 +406,7 @@ static ScmGloc *search_binding(ScmModule *module, ScmSymbol *symbol,
                 prefixed = TRUE;
             }
 
-            ScmObj v = Scm_HashTableRef(m->external, SCM_OBJ(sym), SCM_FALSE);
+            ScmObj v = binding_ref(m->external, SCM_OBJ(sym));
             if (SCM_GLOCP(v)) {
                 g = SCM_GLOC(v);
                 if (g->hidden) break;
@@ -390,8 +432,8 @@ static ScmGloc *search_binding(ScmModule *module, ScmSymbol *symbol,
             if (!SCM_SYMBOLP(sym)) return NULL;
             symbol = SCM_SYMBOL(sym);
         }
-        ScmObj v = Scm_HashTableRef(external_only?m->external:m->internal,
-                                    SCM_OBJ(symbol), SCM_FALSE);
+        ScmObj v = binding_ref(external_only?m->external:m->internal,
+                               SCM_OBJ(symbol));
 
         if (SCM_GLOCP(v)) {
             if (SCM_GLOC_PHANTOM_BINDING_P(SCM_GLOC(v))) {
@@ -414,9 +456,20 @@ ScmGloc *Scm_FindBinding(ScmModule *module, ScmSymbol *symbol, int flags)
     int external_only = flags&SCM_BINDING_EXTERNAL;
     ScmGloc *gloc = NULL;
 
-    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(modules.mutex);
-    gloc = search_binding(module, symbol, stay_in_module, external_only, FALSE);
-    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    ScmAtomicWord ver = Scm_AtomicLoad(&modules.version);
+    if (!(ver & 1)) {
+        Scm_AtomicThreadFence();
+        gloc = search_binding(module, symbol, stay_in_module, external_only,
+                              FALSE);
+        Scm_AtomicThreadFence();
+        if (Scm_AtomicLoad(&modules.version) != ver) ver = 1;
+    }
+    if (ver & 1) {
+        SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(modules.mutex);
+        gloc = search_binding(module, symbol, stay_in_module, external_only,
+                              FALSE);
+        SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    }
 
     if (flags&SCM_BINDING_SYNTAX) {
         if (Scm_GlocSyntaxP(gloc)) return gloc;
@@ -461,11 +514,13 @@ ScmGloc *Scm_MakeBinding(ScmModule *module, ScmSymbol *symbol,
         existing = TRUE;
     } else {
         g = SCM_GLOC(Scm_MakeGloc(symbol, module));
+        BINDINGS_CHANGE_BEGIN();
         Scm_HashTableSet(module->internal, SCM_OBJ(symbol), SCM_OBJ(g), 0);
         /* If module is marked 'export-all', export this binding by default */
         if (module->exportAll && SCM_SYMBOL_INTERNED(symbol)) {
             Scm_HashTableSet(module->external, SCM_OBJ(symbol), SCM_OBJ(g), 0);
         }
+        BINDINGS_CHANGE_END();
     }
     SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
 
@@ -544,7 +599,9 @@ void Scm_HideBinding(ScmModule *module, ScmSymbol *symbol)
     } else {
         ScmGloc *g = SCM_GLOC(Scm_MakeGloc(symbol, module));
         g->hidden = TRUE;
+        BINDINGS_CHANGE_BEGIN();
         Scm_HashTableSet(module->external, SCM_OBJ(symbol), SCM_OBJ(g), 0);
+        BINDINGS_CHANGE_END();
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
 
@@ -586,8 +643,10 @@ int Scm_AliasBinding(ScmModule *target, ScmSymbol *targetName,
     ScmGloc *g = Scm_FindBinding(origin, originName, SCM_BINDING_EXTERNAL);
     if (g == NULL) return FALSE;
     SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(modules.mutex);
+    BINDINGS_CHANGE_BEGIN();
     Scm_HashTableSet(target->external, SCM_OBJ(targetName), SCM_OBJ(g), 0);
     Scm_HashTableSet(target->internal, SCM_OBJ(targetName), SCM_OBJ(g), 0);
+    BINDINGS_CHANGE_END();
     SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
     return TRUE;
 }
@@ -622,6 +681,7 @@ ScmObj Scm_ImportModule(ScmModule *module,
 
     /* Prepend imported module to module->imported list. */
     (void)SCM_INTERNAL_MUTEX_LOCK(modules.mutex);
+    BINDINGS_CHANGE_BEGIN();
     {
         ScmObj ms, prev = p;
         SCM_SET_CDR_UNCHECKED(p, module->imported);
@@ -642,6 +702,7 @@ ScmObj Scm_ImportModule(ScmModule *module,
         }
         module->imported = p;
     }
+    BINDINGS_CHANGE_END();
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
 
     return module->imported;
@@ -681,6 +742,7 @@ ScmObj Scm_ExportSymbols(ScmModule *module, ScmObj specs)
     }
 
     (void)SCM_INTERNAL_MUTEX_LOCK(modules.mutex);
+    BINDINGS_CHANGE_BEGIN();
     SCM_FOR_EACH(lp, specs) {
         ScmObj spec = SCM_CAR(lp);
         ScmSymbol *name, *exported_name;
@@ -719,12 +781,14 @@ ScmObj Scm_ExportSymbols(ScmModule *module, ScmObj specs)
                                    (intptr_t)name, SCM_DICT_CREATE);
             if (!e->value) {
                 ScmGloc *g = SCM_GLOC(Scm_MakeGloc(name, module));
+                Scm_AtomicThreadFence(); /* publish initialized gloc */
                 (void)SCM_DICT_SET_VALUE(e, SCM_OBJ(g));
             }
             Scm_HashTableSet(module->external, SCM_OBJ(exported_name),
                              SCM_DICT_VALUE(e), 0);
         }
     }
+    BINDINGS_CHANGE_END();
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
 
     /* Now, if this export changes the meaning of exported symbols, we
@@ -751,6 +815,7 @@ ScmObj Scm_ExportAll(ScmModule *module)
         /* Mark the module 'export-all' so that the new bindings would get
            exported mark by default. */
         module->exportAll = TRUE;
+        BINDINGS_CHANGE_BEGIN();
 
         /* Scan the module and mark all existing bindings as exported. */
         ScmHashIter iter;
@@ -764,6 +829,7 @@ ScmObj Scm_ExportAll(ScmModule *module)
                 (void)SCM_DICT_SET_VALUE(ee, SCM_DICT_VALUE(e));
             }
         }
+        BINDINGS_CHANGE_END();
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
     return SCM_OBJ(module);
@@ -884,8 +950,12 @@ void Scm__DestroyModule(ScmModule *m)
     m->parents = SCM_NIL;
     m->mpl = SCM_NIL;
     m->depended = SCM_NIL;
+    (void)SCM_INTERNAL_MUTEX_LOCK(modules.mutex);
+    BINDINGS_CHANGE_BEGIN();
     Scm_HashCoreClear(&m->internal->core);
     Scm_HashCoreClear(&m->external->core);
+    BINDINGS_CHANGE_END();
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
     m->origin = SCM_FALSE;
     m->prefix = SCM_FALSE;
 }
@@ -1031,6 +1101,7 @@ extern void Scm__InitCurrentRecursiveHash();
 void Scm__InitModule(void)
 {
     (void)SCM_INTERNAL_MUTEX_INIT(modules.mutex);
+    Scm_AtomicStore(&modules.version, 0);
     modules.table = SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 64));
 
     /* standard module chain */
@@ -340,7 +340,7 @@ static void report_flonum_count(void *data SCM_UNUSED)
 
 ScmObj Scm_MakeFlonum(double d)
 {
-    ScmFlonum *f = SCM_NEW(ScmFlonum);
+    ScmFlonum *f = SCM_NEW_CACHED(ScmFlonum);
     SCM_FLONUM_VALUE(f) = d;
 #ifdef COUNT_FLONUM_ALLOC
     ScmAtomicWord c;
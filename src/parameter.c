@@ -297,14 +297,58 @@ void Scm_InstallParameterization(ScmParameterization *pz)
     Scm_VMPushDynamicEnv(k, pz->parameterization);
 }
 
+/*
+ * Binding lookup
+ *
+ *  Finding the binding naively takes a scan of denv and then a scan of
+ *  the parameterization, each proportional to the nesting depth.
+ *  Since both lists are never mutated (the value of a binding is updated
+ *  in the binding pair, which we don't copy), we cache the results in the
+ *  VM keyed by the identity of the lists.  In the common case, a parameter
+ *  reference is two pointer comparisons.  The cache is per-VM, so no
+ *  locking is needed; VM must be the current thread's VM.
+ */
+void Scm__VMParameterCacheClear(ScmVM *vm)
+{
+    vm->paramDenv = SCM_UNBOUND;  /* never eq to a denv */
+    vm->paramTable = SCM_NIL;
+    for (int i=0; i<SCM_VM_PARAMETER_CACHE_SIZE; i++) {
+        vm->paramCache[i].parameterization = SCM_UNBOUND;
+        vm->paramCache[i].param = SCM_FALSE;
+        vm->paramCache[i].binding = SCM_FALSE;
+    }
+}
+
+/* Returns (param . value) if P is dynamically bound, #f otherwise. */
+static ScmObj find_binding(ScmVM *vm, const ScmPrimitiveParameter *p)
+{
+    if (!SCM_EQ(vm->paramDenv, vm->denv)) {
+        ScmObj k = Scm__GetDenvKey(SCM_DENV_KEY_PARAMETERIZATION);
+        ScmObj e = Scm_Assq(k, vm->denv);
+        vm->paramTable = SCM_PAIRP(e) ? SCM_CDR(e) : SCM_NIL;
+        vm->paramDenv = vm->denv;
+    }
+    ScmObj table = vm->paramTable;
+    if (SCM_NULLP(table)) return SCM_FALSE;
+
+    ScmVMParameterCache *c =
+        &vm->paramCache[(((u_long)p) >> 4) & (SCM_VM_PARAMETER_CACHE_SIZE-1)];
+    if (SCM_EQ(c->param, SCM_OBJ(p)) && SCM_EQ(c->parameterization, table)) {
+        return c->binding;
+    }
+    ScmObj r = Scm_Assq(SCM_OBJ(p), table);
+    c->parameterization = table;
+    c->param = SCM_OBJ(p);
+    c->binding = r;
+    return r;
+}
+
 /*
  * Accessor & modifier
  */
 ScmObj Scm_PrimitiveParameterRef(ScmVM *vm, const ScmPrimitiveParameter *p)
 {
-    ScmObj k = Scm__GetDenvKey(SCM_DENV_KEY_PARAMETERIZATION);
-    ScmObj parameterization = Scm_VMFindDynamicEnv(k, SCM_NIL);
-    ScmObj r = Scm_Assq(SCM_OBJ(p), parameterization);
+    ScmObj r = find_binding(vm, p);
 
     if (SCM_PAIRP(r)) {
         /* dynamically bound */
@@ -331,9 +375,7 @@ ScmObj Scm_PrimitiveParameterRef(ScmVM *vm, const ScmPrimitiveParameter *p)
 ScmObj Scm_PrimitiveParameterSet(ScmVM *vm, const ScmPrimitiveParameter *p,
                                  ScmObj val)
 {
-    ScmObj k = Scm__GetDenvKey(SCM_DENV_KEY_PARAMETERIZATION);
-    ScmObj parameterization = Scm_VMFindDynamicEnv(k, SCM_NIL);
-    ScmObj r = Scm_Assq(SCM_OBJ(p), parameterization);
+    ScmObj r = find_binding(vm, p);
     ScmObj old;
 
     if (SCM_PAIRP(r)) {
@@ -35,12 +35,16 @@
 #include "gauche.h"
 #include "gauche/priv/configP.h"
 #include "gauche/priv/portP.h"
+#include "gauche/priv/mmapP.h"
 #include "gauche/priv/builtin-syms.h"
 
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <ctype.h>
+#if !defined(GAUCHE_WINDOWS)
+#include <sys/uio.h>
+#endif /*!GAUCHE_WINDOWS*/
 
 #undef MAX
 #undef MIN
@@ -81,6 +85,9 @@ static void bufport_flush(ScmPort*, ScmSize, int);
 static void file_closer(ScmPort *p);
 static int  file_buffered_port_p(ScmPort *p);       /* for Scm_PortFdDup */
 static void file_buffered_port_set_fd(ScmPort *p, int fd); /* ditto */
+static int  file_direct_io_p(ScmPort *p, int dir); /* for bufport_read/write */
+static ScmSize file_read_direct(ScmPort *p, char *dst, ScmSize siz);
+static void file_write_direct(ScmPort *p, const char *src, ScmSize siz);
 
 /* Returns an appropripate basic port class according to the direciton */
 static ScmClass *port_class_from_direction(int direction)
@@ -234,6 +241,18 @@ static void port_cleanup(ScmPort *port, _Bool final)
         ScmPortBuffer *buf = Scm_PortBufferStruct(port);
         if (!final && port->ownerp && buf->closer) buf->closer(port);
         break;
+    case SCM_PORT_ISTR:
+        /* A memory port owning a mapped region drops its reference.
+           We don't unmap the region here, for view uvectors taken from
+           it may still be alive; the region's finalizer unmaps it once
+           nothing refers to it. */
+        if (!final && port->ownerp
+            && SCM_MEMORY_REGION_P(PORT_ISTR(port)->owner)) {
+            PORT_ISTR(port)->owner = SCM_FALSE;
+            PORT_ISTR(port)->start = PORT_ISTR(port)->current =
+                PORT_ISTR(port)->end = "";
+        }
+        break;
     case SCM_PORT_PROC:
         if (!final && PORT_VT(port)->Close) PORT_VT(port)->Close(port);
         break;
@@ -1156,6 +1175,14 @@ static void bufport_flush(ScmPort *p, ScmSize cnt, int forcep)
    the port's buffer.  Won't return until entire siz bytes are written. */
 static void bufport_write(ScmPort *p, const char *src, ScmSize siz)
 {
+    /* If the data doesn't fit in the buffer anyway, and the port is
+       directly connected to fd, we skip copying; the buffered data and
+       the given data are written out together. */
+    if (siz > PORT_BUFFER_ROOM(p) && siz >= PORT_BUF(p)->size
+        && file_direct_io_p(p, SCM_PORT_OUTPUT)) {
+        file_write_direct(p, src, siz);
+        return;
+    }
     do {
         ScmSize room = PORT_BUF(p)->end - PORT_BUF(p)->current;
         if (room >= siz) {
@@ -1182,7 +1209,9 @@ static ScmSize bufport_fill(ScmPort *p, ScmSize min, int allow_less)
     ScmSize cursiz = PORT_BUF(p)->end - PORT_BUF(p)->current;
     ScmSize nread = 0, toread;
     if (cursiz > 0) {
-        memmove(PORT_BUF(p)->buffer, PORT_BUF(p)->current, cursiz);
+        if (PORT_BUF(p)->current != PORT_BUF(p)->buffer) {
+            memmove(PORT_BUF(p)->buffer, PORT_BUF(p)->current, cursiz);
+        }
         PORT_BUF(p)->current = PORT_BUF(p)->buffer;
         PORT_BUF(p)->end = PORT_BUF(p)->current + cursiz;
     } else {
@@ -1239,6 +1268,18 @@ static ScmSize bufport_read(ScmPort *p, char *dst, ScmSize siz)
             }
         }
 
+        /* The buffer is empty at this point.  If the request is larger
+           than the buffer, we read directly into DST, bypassing the
+           buffer. */
+        if (siz >= PORT_BUF(p)->size && file_direct_io_p(p, SCM_PORT_INPUT)) {
+            ScmSize r = file_read_direct(p, dst, siz);
+            if (r <= 0) break; /* EOF */
+            nread += r;
+            siz -= r;
+            dst += r;
+            continue;
+        }
+
         ScmSize req = MIN(siz, PORT_BUF(p)->size);
         ScmSize r = bufport_fill(p, req, TRUE);
         if (r <= 0) break; /* EOF or an error*/
@@ -1525,6 +1566,88 @@ static ScmSize file_flusher(ScmPort *p, ScmSize cnt, int forcep)
     return nwrote;
 }
 
+/* Direct I/O between fd and the caller's memory, used by bufport_read
+   and bufport_write for large transfers.  Only valid when the port
+   uses the file filler/flusher. */
+static int file_direct_io_p(ScmPort *p, int dir)
+{
+    if (!file_buffered_port_p(p)) return FALSE;
+    if (dir == SCM_PORT_INPUT) return (PORT_BUF(p)->filler == file_filler);
+    else                       return (PORT_BUF(p)->flusher == file_flusher);
+}
+
+/* Like file_filler, but reads into DST.  The caller must make sure
+   the buffer is empty. */
+static ScmSize file_read_direct(ScmPort *p, char *dst, ScmSize siz)
+{
+    int fd = FILE_PORT_FD(p);
+    ScmSize r;
+    SCM_ASSERT(fd >= 0);
+    do {
+        errno = 0;
+        SCM_SYSCALL(r, read(fd, dst, siz));
+        if (r < 0) {
+            p->error = TRUE;
+            Scm_SysError("read failed on %S", p);
+        }
+    } while (r < 0);
+    return r;
+}
+
+/* Writes out the buffered data followed by SIZ bytes from SRC.
+   Won't return until everything is written.  The buffer becomes empty. */
+static void file_write_direct(ScmPort *p, const char *src, ScmSize siz)
+{
+    int fd = FILE_PORT_FD(p);
+    const char *bufptr = PORT_BUF(p)->buffer;
+    ScmSize bufsiz = PORT_BUFFER_AVAIL(p);
+
+    SCM_ASSERT(fd >= 0);
+    while (bufsiz > 0 || siz > 0) {
+        ScmSize r;
+        errno = 0;
+#if !defined(GAUCHE_WINDOWS)
+        struct iovec iov[2];
+        int iovcnt = 0;
+        if (bufsiz > 0) {
+            iov[iovcnt].iov_base = (void*)bufptr;
+            iov[iovcnt].iov_len = bufsiz;
+            iovcnt++;
+        }
+        if (siz > 0) {
+            iov[iovcnt].iov_base = (void*)src;
+            iov[iovcnt].iov_len = siz;
+            iovcnt++;
+        }
+        SCM_SYSCALL(r, writev(fd, iov, iovcnt));
+#else  /*GAUCHE_WINDOWS*/
+        if (bufsiz > 0) {
+            SCM_SYSCALL(r, write(fd, bufptr, bufsiz));
+        } else {
+            SCM_SYSCALL(r, write(fd, src, siz));
+        }
+#endif /*GAUCHE_WINDOWS*/
+        if (r < 0) {
+            if (errno == EPIPE && PORT_BUFFER_SIGPIPE_SENSITIVE_P(p)) {
+                Scm_Exit(1);    /* see file_flusher */
+            }
+            PORT_BUF(p)->current = PORT_BUF(p)->buffer; /* for safety */
+            p->error = TRUE;
+            Scm_SysError("write failed on %S", p);
+        }
+        if (r < bufsiz) {
+            bufptr += r;
+            bufsiz -= r;
+        } else {
+            r -= bufsiz;
+            bufsiz = 0;
+            src += r;
+            siz -= r;
+        }
+    }
+    PORT_BUF(p)->current = PORT_BUF(p)->buffer;
+}
+
 static void file_closer(ScmPort *p)
 {
     int fd = FILE_PORT_FD(p);
@@ -1661,10 +1784,30 @@ ScmObj Scm_MakeInputStringPortFull(ScmString *str, ScmObj name,
     PORT_ISTR(p)->start = SCM_STRING_BODY_START(sb);
     PORT_ISTR(p)->current = SCM_STRING_BODY_START(sb);
     PORT_ISTR(p)->end = SCM_STRING_BODY_END(sb);
+    PORT_ISTR(p)->owner = SCM_FALSE;
     if (flags&SCM_PORT_STRING_PRIVATE) PORT_PRELOCK(p, Scm_VM());
     return SCM_OBJ(p);
 }
 
+/* Input port reading directly from SIZE bytes of memory from START,
+   which may be outside of GC heap (e.g. mmapped file).  OWNER is
+   an object that keeps the memory valid, and the port retains it.
+   If FLAGS has SCM_PORT_OWNER and OWNER is a memory region, it is
+   unmapped when the port is closed.  Strings taken from the port never
+   share the memory. */
+ScmObj Scm_MakeInputMemoryPort(const char *start, ScmSize size,
+                               ScmObj owner, ScmObj name, u_long flags)
+{
+    ScmPort *p = make_port(SCM_CLASS_INPUT_PORT, name, SCM_PORT_INPUT,
+                           SCM_PORT_ISTR);
+    PORT_ISTR(p)->start = start;
+    PORT_ISTR(p)->current = start;
+    PORT_ISTR(p)->end = start + size;
+    PORT_ISTR(p)->owner = owner;
+    p->ownerp = (flags & SCM_PORT_OWNER) != 0;
+    return SCM_OBJ(p);
+}
+
 /* deprecated */
 ScmObj Scm_MakeInputStringPort(ScmString *str, int privatep)
 {
@@ -1717,6 +1860,7 @@ ScmObj Scm_GetRemainingInputString(ScmPort *port, int flags)
         Scm_Error("input string port required, but got %S", port);
     /* NB: we don't need to lock the port, since the string body
        the port is pointing won't be changed. */
+    if (!SCM_FALSEP(PORT_ISTR(port)->owner)) flags |= SCM_STRING_COPYING;
     const char *ep = PORT_ISTR(port)->end;
     const char *cp = PORT_ISTR(port)->current;
     /* Things gets complicated if there's an ungotten char or bytes.
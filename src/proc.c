@@ -116,7 +116,7 @@ void Scm__ProcedureInit(ScmProcedure *proc,
 
 ScmObj Scm_MakeClosureWithTags(ScmObj code, ScmEnvFrame *env, ScmObj tags)
 {
-    ScmClosure *c = SCM_NEW(ScmClosure);
+    ScmClosure *c = SCM_NEW_CACHED(ScmClosure);
 
     SCM_ASSERT(SCM_COMPILED_CODE(code));
     /* CODE->signatureInfo can be #f or (<signature> . <other-info>) */
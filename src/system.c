@@ -85,6 +85,9 @@ static int win_wait_for_handles(HANDLE *handles, int nhandles, int options,
 #ifdef HAVE_SCHED_H
 #include <sched.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 
 /*
  * Auxiliary system interface functions.   See libsys.scm for
@@ -2338,6 +2341,39 @@ ScmObj Scm_SysSelectX(ScmObj rfds, ScmObj wfds, ScmObj efds, ScmObj timeout)
     return select_int(r, w, e, timeout);
 }
 
+#if defined(HAVE_SYS_EPOLL_H)
+/* Waits on epoll fd, and returns a list of (fd . events) of ready fds.
+   Unlike select, the cost doesn't depend on the number of watched fds.
+   TIMEOUT is the same as select.  Returns () on timeout. */
+ScmObj Scm_SysEpollWait(int epfd, int maxevents, ScmObj timeout)
+{
+    struct epoll_event evbuf[64], *evs = evbuf;
+    struct timeval tm;
+    int msec = -1, n;
+
+    if (maxevents <= 0) {
+        Scm_Error("maxevents must be positive: %d", maxevents);
+    }
+    if (maxevents > 64) {
+        evs = SCM_NEW_ATOMIC_ARRAY(struct epoll_event, maxevents);
+    }
+    if (select_timeval(timeout, &tm) != NULL) {
+        /* round up, so that we won't busy-loop for sub-msec timeout */
+        long long ms = (long long)tm.tv_sec*1000 + (tm.tv_usec+999)/1000;
+        msec = (ms > INT_MAX)? INT_MAX : (int)ms;
+    }
+    SCM_SYSCALL(n, epoll_wait(epfd, evs, maxevents, msec));
+    if (n < 0) Scm_SysError("epoll_wait failed");
+
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    for (int i=0; i<n; i++) {
+        SCM_APPEND1(h, t, Scm_Cons(SCM_MAKE_INT(evs[i].data.fd),
+                                   Scm_MakeIntegerU(evs[i].events)));
+    }
+    return h;
+}
+#endif /*HAVE_SYS_EPOLL_H*/
+
 #endif /* HAVE_SELECT */
 
 /*===============================================================
@@ -136,7 +136,8 @@ static ScmEnvFrame ccEnvMark = {
     ((ptr) >= vm->stack && (ptr) < vm->stackEnd)
 #else  /*!GAUCHE_SPLIT_STACK*/
 #define IN_STACK_P(ptr)                                         \
-    ((unsigned long)((ptr) - vm->stack) < SCM_VM_STACK_SIZE)
+    ((unsigned long)((ptr) - vm->stack)                         \
+     < (unsigned long)(vm->stackEnd - vm->stack))
 #define IN_FULL_STACK_P(ptr) IN_STACK_P(ptr)
 #endif /*!GAUCHE_SPLIT_STACK*/
 
@@ -201,7 +202,16 @@ static DWORD vm_key;
 static ScmVM *theVM;
 #endif /* !GAUCHE_USE_PTHREADS */
 
-static void save_stack(ScmVM *vm);
+static void save_stack(ScmVM *vm, long size);
+static int fiber_grow_segment(ScmVM *vm, long size);
+static ScmObj fiber_finish_cc(ScmVM *vm, ScmObj val, ScmObj *data);
+
+#if GAUCHE_VM_ALLOC_CACHE
+/* Set to TRUE once theVM becomes valid.  Until then, Scm__VMAllocCached
+   falls back to the ordinary allocation. */
+static int vm_alloc_cache_ready = FALSE;
+static void vm_alloc_cache_clear(ScmVM *vm);
+#endif /*GAUCHE_VM_ALLOC_CACHE*/
 
 static ScmObj find_dynamic_env(ScmVM *vm, ScmObj key, ScmObj fallback);
 static void push_dynamic_env(ScmVM *vm, ScmObj key, ScmObj val);
@@ -356,6 +366,13 @@ ScmVM *Scm_NewVM(ScmVM *proto, ScmObj name)
 
     v->currentPrompt = NULL;
     v->resetChain = SCM_NIL;
+    v->currentFiber = SCM_FALSE;
+    v->fiberStackCache = NULL;
+
+    Scm__VMParameterCacheClear(v);
+#if GAUCHE_VM_ALLOC_CACHE
+    vm_alloc_cache_clear(v);
+#endif /*GAUCHE_VM_ALLOC_CACHE*/
 
     Scm_RegisterFinalizer(SCM_OBJ(v), vm_finalize, NULL);
     return v;
@@ -411,13 +428,17 @@ ScmVM *Scm_VMTakeSnapshot(ScmVM *vm)
     v->sp = v->stack;
     v->stackBase = v->stack;
     v->stackEnd = v->stack + SCM_VM_STACK_SIZE;
-    memcpy(v->stack, vm->stack, SCM_VM_STACK_SIZE*sizeof(ScmObj));
+    /* NB: vm->stack may be a fiber's stack segment, which is smaller. */
+    memcpy(v->stack, vm->stack, (vm->stackEnd - vm->stack)*sizeof(ScmObj));
 
 #if GAUCHE_FFX
     v->fpstack = SCM_NEW_ATOMIC_ARRAY(ScmFlonum, SCM_VM_STACK_SIZE);
     v->fpstackEnd = v->fpstack + SCM_VM_STACK_SIZE;
     v->fpsp = v->fpstack;
-    memcpy(v->fpstack, vm->fpstack, SCM_VM_STACK_SIZE*sizeof(ScmFlonum));
+    if (vm->fpstack) {
+        memcpy(v->fpstack, vm->fpstack,
+               (vm->fpstackEnd - vm->fpstack)*sizeof(ScmFlonum));
+    }
 #endif /* GAUCHE_FFX */
 
     /* Relocate env/cont chains: frames copied from the original stack still
@@ -475,6 +496,13 @@ ScmVM *Scm_VMTakeSnapshot(ScmVM *vm)
 
     v->currentPrompt = vm->currentPrompt;
     v->resetChain = vm->resetChain;
+    v->currentFiber = vm->currentFiber;
+    v->fiberStackCache = NULL;
+    Scm__VMParameterCacheClear(v);
+#if GAUCHE_VM_ALLOC_CACHE
+    /* The free lists must not be shared. */
+    vm_alloc_cache_clear(v);
+#endif /*GAUCHE_VM_ALLOC_CACHE*/
     /* NB: We don't register the finalizer vm_finalize to the snapshot,
        for we do not want the associated system resources to be cleaned
        up when the snapshot is GCed. */
@@ -560,6 +588,10 @@ void Scm_DetachVM(ScmVM *vm)
     if (vm != NULL) {
         (void)SCM_INTERNAL_THREAD_SETSPECIFIC(Scm_VMKey(), NULL);
         vm_unregister(vm);
+#if GAUCHE_VM_ALLOC_CACHE
+        /* Let GC reclaim the cached objects. */
+        vm_alloc_cache_clear(vm);
+#endif /*GAUCHE_VM_ALLOC_CACHE*/
     }
 }
 
@@ -598,6 +630,57 @@ ScmVM *Scm_VM(void)
    below, we can safely replace Scm_VM() to theVM. */
 #define Scm_VM() theVM
 
+/*
+ * Allocation cache
+ *
+ *   Pairs, flonums and closures are allocated so often that the cost of
+ *   going through GC_malloc for each of them (thread-local free list
+ *   lookup, size class calculation, and occasional allocation lock)
+ *   becomes noticeable.  Each VM keeps its own free lists of those small
+ *   objects, and refills them by GC_malloc_many(), which returns a chain
+ *   of objects of the same size linked through their first word.
+ *
+ *   The free lists are only touched by the thread the VM is attached to,
+ *   so no locking is required.  Since the heads of the lists are in
+ *   the VM structure, GC won't reclaim the cached objects.
+ *
+ *   GC_malloc_many returns cleared objects except the link word, so
+ *   the objects we return are indistinguishable from SCM_NEW'ed ones.
+ */
+
+#define ALLOC_CACHE_GRANULE   (2*sizeof(ScmWord))
+
+void *Scm__VMAllocCached(size_t size)
+{
+#if GAUCHE_VM_ALLOC_CACHE && !defined(GC_DEBUG)
+    size_t ci = (size + ALLOC_CACHE_GRANULE - 1)/ALLOC_CACHE_GRANULE - 1;
+    ScmVM *vm;
+
+    if (vm_alloc_cache_ready
+        && ci < SCM_VM_ALLOC_CACHE_SIZE
+        && (vm = theVM) != NULL) {
+        void *p = vm->allocCache[ci];
+        if (p == NULL) {
+            p = GC_malloc_many((ci+1)*ALLOC_CACHE_GRANULE);
+            /* If we fail, let SCM_MALLOC deal with the out-of-memory
+               situation. */
+            if (p == NULL) return SCM_MALLOC(size);
+        }
+        vm->allocCache[ci] = GC_NEXT(p);
+        GC_NEXT(p) = NULL;
+        return p;
+    }
+#endif /*GAUCHE_VM_ALLOC_CACHE && !GC_DEBUG*/
+    return SCM_MALLOC(size);
+}
+
+#if GAUCHE_VM_ALLOC_CACHE
+static void vm_alloc_cache_clear(ScmVM *vm)
+{
+    for (int i=0; i<SCM_VM_ALLOC_CACHE_SIZE; i++) vm->allocCache[i] = NULL;
+}
+#endif /*GAUCHE_VM_ALLOC_CACHE*/
+
 /*
  * Get VM key
  */
@@ -731,7 +814,7 @@ static void vm_unregister(ScmVM *vm)
 #define CHECK_STACK(size)                                       \
     do {                                                        \
         if (MOSTLY_FALSE(SP >= vm->stackEnd - (size))) {        \
-            save_stack(vm);                                     \
+            save_stack(vm, (size));                             \
         }                                                       \
     } while (0)
 
@@ -1316,7 +1399,7 @@ static void save_cont(ScmVM *vm)
     }
 }
 
-static void save_stack(ScmVM *vm)
+static void save_stack(ScmVM *vm, long size)
 {
 #if HAVE_GETTIMEOFDAY
     int stats = SCM_VM_RUNTIME_FLAG_IS_SET(vm, SCM_COLLECT_VM_STATS);
@@ -1328,12 +1411,14 @@ static void save_stack(ScmVM *vm)
 #endif
 
     save_cont(vm);
-    memmove(vm->stackBase, vm->argp,
-            (vm->sp - (ScmObj*)vm->argp) * sizeof(ScmObj*));
-    vm->sp -= (ScmObj*)vm->argp - vm->stackBase;
-    vm->argp = vm->stackBase;
-    /* Clear the stack.  This removes bogus pointers and accelerates GC */
-    for (ScmObj *p = vm->sp; p < vm->stackEnd; p++) *p = NULL;
+    if (!fiber_grow_segment(vm, size)) {
+        memmove(vm->stackBase, vm->argp,
+                (vm->sp - (ScmObj*)vm->argp) * sizeof(ScmObj*));
+        vm->sp -= (ScmObj*)vm->argp - vm->stackBase;
+        vm->argp = vm->stackBase;
+        /* Clear the stack.  This removes bogus pointers and accelerates GC */
+        for (ScmObj *p = vm->sp; p < vm->stackEnd; p++) *p = NULL;
+    }
 
 #if HAVE_GETTIMEOFDAY
     if (stats) {
@@ -1547,6 +1632,12 @@ void Scm_VMFlushFPStack(ScmVM *vm)
     }
 #endif
 
+    if (vm->fpstack == NULL) {
+        /* A fiber's flonum stack is allocated on demand. */
+        vm->fpstack = SCM_NEW_ATOMIC_ARRAY(ScmFlonum,
+                                           SCM_VM_FIBER_FPSTACK_SIZE);
+        vm->fpstackEnd = vm->fpstack + SCM_VM_FIBER_FPSTACK_SIZE;
+    }
     vm->fpsp = vm->fpstack;
 
 #ifdef COUNT_FLUSH_FPSTACK
@@ -1973,12 +2064,60 @@ static ScmEscapePoint *new_ep(ScmVM *vm,
     ep->errorReporting =
         SCM_VM_RUNTIME_FLAG_IS_SET(vm, SCM_ERROR_BEING_REPORTED);
     ep->rewindBefore = rewindBefore;
+    ep->escapeOnly = FALSE;
     ep->promptTag = promptTag;
     ep->abortHandler = abortHandler;
     ep->bottom = NULL;
     return ep;
 }
 
+/*
+ * Escape-only continuations
+ *
+ *   Scm_VMCallEC doesn't save the continuation frames.  Instead it pushes
+ *   a C continuation frame as a marker, whose data is the escape point.
+ *   The escape point is valid while the marker is in the current
+ *   continuation chain, and the frame it returns to is always the one
+ *   below the marker---which may have been moved to the heap after
+ *   the escape point was created, so we look it up every time.
+ *   Since the marker holds the escape point itself, a stale stack area
+ *   that happens to be reused can't be mistaken for it.
+ *
+ *   The continuation chain of a fiber ends with the fiber's finishing
+ *   frame.  While the fiber is running (or escaping), the resumer's
+ *   continuation is kept in the fiber's registers, so we follow it to
+ *   find a marker pushed outside of the fiber.
+ */
+static ScmObj escape_marker_cc(ScmVM *vm SCM_UNUSED, ScmObj val0,
+                               ScmObj *data SCM_UNUSED)
+{
+    return val0;
+}
+
+static ScmContFrame *escape_target(ScmVM *vm, ScmEscapePoint *ep)
+{
+    ScmContFrame *c = vm->cont;
+    while (c) {
+        if (C_CONTINUATION_P(c)) {
+            if (c->pc == (ScmWord*)escape_marker_cc
+                && ((ScmObj*)c - c->size)[0] == SCM_OBJ(ep)) {
+                return c->prev;
+            }
+            if (c->pc == (ScmWord*)fiber_finish_cc) {
+                ScmFiber *f = SCM_FIBER(((ScmObj*)c - c->size)[0]);
+                if (f->state == SCM_FIBER_RUNNING
+                    || f->state == SCM_FIBER_ESCAPED) {
+                    c = f->regs.cont;
+                    continue;
+                }
+            }
+        }
+        c = c->prev;
+    }
+    Scm_Error("escape continuation invoked outside of its extent");
+    return NULL;                /* dummy */
+}
+
 /*-------------------------------------------------------------
  * User level eval and apply.
  *   When the C routine wants the Scheme code to return to it,
@@ -3287,6 +3426,11 @@ ScmObj Scm_ContinuationMarks(ScmObj contProc, ScmObj promptTag)
         SCM_TYPE_ERROR(contProc, "continuation");
     }
     ScmEscapePoint *ep = (ScmEscapePoint*)SCM_SUBR(contProc)->data;
+    if (ep->escapeOnly) {
+        /* The mark set may outlive the frames on the stack. */
+        save_cont(theVM);
+        ep->cont = escape_target(theVM, ep);
+    }
     ScmContFrame *cont = ep->cont;
     return make_continuation_mark_set(theVM, cont, ep->denv, promptTag);
 }
@@ -3497,6 +3641,10 @@ static ScmObj throw_cont_body(ScmObj hdlist,      /*((flag . handler-chain)...)*
     /*
      * now, install the target continuation
      */
+    if (ep->escapeOnly) {
+        /* The dynamic handlers may have moved the frames to the heap. */
+        ep->cont = escape_target(vm, ep);
+    }
     vm->pc = PC_TO_RETURN;
     vm->cont = ep->cont;
     vm->denv = ep->denv;
@@ -3613,6 +3761,32 @@ ScmObj Scm_VMCallCC(ScmObj proc)
     return Scm_VMApply1(proc, contproc);
 }
 
+/* Body of the escape-only continuation SUBR.  We check the extent before
+   running any dynamic handlers. */
+static ScmObj throw_escape(ScmObj *argframe, int nargs, void *data)
+{
+    (void)escape_target(theVM, (ScmEscapePoint*)data);
+    return throw_continuation(argframe, nargs, data);
+}
+
+/* call with escape-only continuation.  This is for the common use of
+   call/cc just to exit from PROC early, e.g. returning from a loop.
+   The continuation can only be invoked within the dynamic extent of PROC,
+   and in return it costs a single frame instead of saving the whole
+   continuation chain. */
+ScmObj Scm_VMCallEC(ScmObj proc)
+{
+    ScmVM *vm = theVM;
+
+    ScmEscapePoint *ep = new_ep(vm, SCM_FALSE, FALSE, SCM_FALSE, SCM_FALSE);
+    ep->escapeOnly = TRUE;
+    ScmObj *data = new_ccont(vm, escape_marker_cc, NULL, 1);
+    data[0] = SCM_OBJ(ep);
+    ScmObj contproc = Scm_MakeSubr(throw_escape, ep, 0, 1,
+                                   continuation_symbol);
+    return Scm_VMApply1(proc, contproc);
+}
+
 int Scm_ContinuationP(ScmObj proc)
 {
     return (SCM_SUBRP(proc) && SCM_PROCEDURE_INFO(proc) == continuation_symbol);
@@ -3707,6 +3881,368 @@ ScmObj Scm_VMReset(ScmObj proc)
     return ret;
 }
 
+/*==============================================================
+ * Fibers
+ *
+ *   A fiber runs a thunk on its own VM stack segment.  Resuming and
+ *   yielding just swap the stack-related registers of the VM with the
+ *   ones saved in the fiber, so the cost of a switch doesn't depend on
+ *   the depth of the fiber's continuation (unlike shift/reset, which
+ *   copies the frames to the heap on every capture).
+ *
+ *   The switch happens within a subr call (fiber-resume or fiber-yield),
+ *   which always returns to the continuation in vm->cont.  So the
+ *   subr only needs to swap the registers and return the value; run_loop
+ *   picks up the new continuation.
+ *
+ *   The fiber's dynamic handler chain is built on top of the resumer's
+ *   chain, with a 'guard' entry at the boundary.  When the fiber yields,
+ *   the 'after' handlers of the fiber's own entries are called; when
+ *   resumed, their 'before' handlers are called.  The guard entry catches
+ *   escapes from the fiber by an error or a continuation; the fiber is
+ *   regarded finished then.
+ *
+ *   Restriction: A fiber can only yield at the same C stack level as
+ *   it is resumed, since we don't switch C stacks.
+ */
+
+static void fiber_print(ScmObj obj, ScmPort *out,
+                        ScmWriteContext *ctx SCM_UNUSED)
+{
+    Scm_Printf(out, "#<fiber %S %p>", Scm_FiberState(obj), obj);
+}
+
+SCM_DEFINE_BUILTIN_CLASS(Scm_FiberClass,
+                         fiber_print, NULL, NULL, NULL,
+                         SCM_CLASS_DEFAULT_CPL);
+
+/* Exchange the VM's stack registers with the ones in the fiber. */
+static void fiber_swap_regs(ScmVM *vm, ScmFiber *f)
+{
+    ScmFiberRegs r = f->regs;
+    f->regs.stack = vm->stack;
+    f->regs.stackBase = vm->stackBase;
+    f->regs.stackEnd = vm->stackEnd;
+    f->regs.sp = vm->sp;
+    f->regs.cont = vm->cont;
+    f->regs.denv = vm->denv;
+    f->regs.dynamicHandlers = vm->dynamicHandlers;
+    f->regs.resetChain = vm->resetChain;
+    f->regs.floatingEscapePoints = vm->floatingEscapePoints;
+#if GAUCHE_FFX
+    f->regs.fpsp = vm->fpsp;
+    f->regs.fpstack = vm->fpstack;
+    f->regs.fpstackEnd = vm->fpstackEnd;
+#endif /*GAUCHE_FFX*/
+
+    vm->stack = r.stack;
+    vm->stackBase = r.stackBase;
+    vm->stackEnd = r.stackEnd;
+    vm->sp = vm->argp = r.sp;
+    vm->cont = r.cont;
+    vm->denv = r.denv;
+    vm->dynamicHandlers = r.dynamicHandlers;
+    vm->resetChain = r.resetChain;
+    vm->floatingEscapePoints = r.floatingEscapePoints;
+#if GAUCHE_FFX
+    vm->fpsp = r.fpsp;
+    vm->fpstack = r.fpstack;
+    vm->fpstackEnd = r.fpstackEnd;
+#endif /*GAUCHE_FFX*/
+    /* The env frame is always saved in a continuation frame at the
+       point of switch, since we're in a subr call. */
+    vm->env = NULL;
+    vm->pc = PC_TO_RETURN;
+#if GAUCHE_SPLIT_STACK
+    vm->lastErrorCont = NULL;
+#endif /*GAUCHE_SPLIT_STACK*/
+}
+
+/* Move the resumer's continuation frames to the heap.  Called when
+   the control escapes from the fiber, for the escape lands in the
+   resumer's continuation while the VM still uses the fiber's segment.
+   The VM registers are left untouched. */
+static void fiber_save_resumer(ScmVM *vm, ScmFiber *f)
+{
+    ScmEnvFrame *env = vm->env;
+    ScmWord *pc = vm->pc;
+    ScmObj *argp = vm->argp;
+    fiber_swap_regs(vm, f);
+    save_cont(vm);
+    fiber_swap_regs(vm, f);
+    vm->env = env;
+    vm->pc = pc;
+    vm->argp = argp;
+}
+
+/* The guard entry of the fiber's handler chain. */
+static ScmObj fiber_guard_after(ScmObj *argv, int argc SCM_UNUSED,
+                                void *data SCM_UNUSED)
+{
+    ScmFiber *f = SCM_FIBER(argv[0]);
+    if (f->state == SCM_FIBER_RUNNING) {
+        ScmVM *vm = theVM;
+        f->state = SCM_FIBER_ESCAPED;
+        fiber_save_resumer(vm, f);
+        vm->currentFiber = f->parent;
+    }
+    return SCM_UNDEFINED;
+}
+
+static ScmObj fiber_guard_before(ScmObj *argv, int argc SCM_UNUSED,
+                                 void *data SCM_UNUSED)
+{
+    ScmFiber *f = SCM_FIBER(argv[0]);
+    if (f->state != SCM_FIBER_ESCAPED) {
+        Scm_Error("attempt to re-enter a fiber by a continuation: %S",
+                  SCM_OBJ(f));
+    }
+    /* The control comes back to the fiber, e.g. an exception handler
+       outside of the fiber returns to the continuation of 'raise'. */
+    f->state = SCM_FIBER_RUNNING;
+    theVM->currentFiber = SCM_OBJ(f);
+    return SCM_UNDEFINED;
+}
+
+static SCM_DEFINE_STRING_CONST(fiber_guard_after_name,
+                               "fiber-guard-after",
+                               17, 17); /* strlen("fiber-guard-after") */
+static SCM_DEFINE_SUBR(fiber_guard_after_rec, 1, 0,
+                       SCM_OBJ(&fiber_guard_after_name),
+                       fiber_guard_after, NULL, NULL);
+static SCM_DEFINE_STRING_CONST(fiber_guard_before_name,
+                               "fiber-guard-before",
+                               18, 18); /* strlen("fiber-guard-before") */
+static SCM_DEFINE_SUBR(fiber_guard_before_rec, 1, 0,
+                       SCM_OBJ(&fiber_guard_before_name),
+                       fiber_guard_before, NULL, NULL);
+
+ScmObj Scm_MakeFiber(ScmObj thunk)
+{
+    ScmFiber *f = SCM_NEW(ScmFiber);
+    SCM_SET_CLASS(f, SCM_CLASS_FIBER);
+    f->thunk = thunk;
+    f->state = SCM_FIBER_NEW;
+    f->vm = NULL;
+    f->parent = SCM_FALSE;
+    f->cstack = NULL;
+    f->guard = make_dynamic_handler(theVM,
+                                    SCM_OBJ(&fiber_guard_before_rec),
+                                    SCM_OBJ(&fiber_guard_after_rec),
+                                    SCM_LIST1(SCM_OBJ(f)));
+    f->segment = NULL;
+    memset(&f->regs, 0, sizeof(ScmFiberRegs));
+    return SCM_OBJ(f);
+}
+
+ScmObj Scm_FiberState(ScmObj fiber)
+{
+    if (!SCM_FIBERP(fiber)) SCM_TYPE_ERROR(fiber, "fiber");
+    switch (SCM_FIBER(fiber)->state) {
+    case SCM_FIBER_NEW:       return SCM_INTERN("new");
+    case SCM_FIBER_SUSPENDED: return SCM_INTERN("suspended");
+    case SCM_FIBER_RUNNING:   return SCM_INTERN("running");
+    default:                  return SCM_INTERN("done");
+    }
+}
+
+ScmObj Scm_VMCurrentFiber(void)
+{
+    return theVM->currentFiber;
+}
+
+/* Allocate an initial stack segment.  It is small, for most generators
+   yield from shallow recursion; see fiber_grow_segment. */
+static ScmObj *fiber_alloc_segment(ScmVM *vm)
+{
+    ScmObj *seg = vm->fiberStackCache;
+    if (seg) {
+        vm->fiberStackCache = NULL;
+    } else {
+        seg = SCM_NEW_ARRAY(ScmObj, SCM_VM_FIBER_STACK_SIZE);
+    }
+    return seg;
+}
+
+/* Called from save_stack when the stack overflows.  All the frames
+   are already moved to the heap, and only the argument frame is left.
+   If the VM is running on the current fiber's segment, replace it with
+   a larger one, preferably with room for SIZE words, so that deep
+   recursion doesn't overflow again soon.  Returns TRUE if the segment
+   is replaced. */
+static int fiber_grow_segment(ScmVM *vm, long size)
+{
+    if (!SCM_FIBERP(vm->currentFiber)) return FALSE;
+    ScmFiber *f = SCM_FIBER(vm->currentFiber);
+    if (vm->stack != f->segment) return FALSE;
+
+    long nargs = vm->sp - vm->argp;
+    long cursize = vm->stackEnd - vm->stack;
+    if (cursize >= SCM_VM_STACK_SIZE) return FALSE;
+    long newsize = cursize * 2;
+    while (newsize < nargs + size + (long)CONT_FRAME_SIZE) newsize *= 2;
+    /* Never exceed the VM stack size; Scm_VMTakeSnapshot copies the
+       segment into a block of that size. */
+    if (newsize > SCM_VM_STACK_SIZE) newsize = SCM_VM_STACK_SIZE;
+
+    ScmObj *seg = SCM_NEW_ARRAY(ScmObj, newsize);
+    memcpy(seg, vm->argp, nargs * sizeof(ScmObj));
+    f->segment = seg;
+    vm->stack = vm->stackBase = vm->argp = seg;
+    vm->sp = seg + nargs;
+    vm->stackEnd = seg + newsize;
+    return TRUE;
+}
+
+static ScmObj fiber_finish_cc(ScmVM *vm, ScmObj val, ScmObj *data)
+{
+    ScmFiber *f = SCM_FIBER(data[0]);
+    SCM_ASSERT(f->state == SCM_FIBER_RUNNING);
+
+    /* Values can't refer to our flonum stack after we leave. */
+    for (int i=0; i<vm->numVals-1; i++) {
+        SCM_FLONUM_ENSURE_MEM(vm->vals[i]);
+    }
+
+    f->state = SCM_FIBER_DONE;
+    vm->currentFiber = f->parent;
+    f->parent = SCM_FALSE;
+    /* Only a segment of the initial size is kept for reuse. */
+    int reusable = (vm->stack == f->segment
+                    && vm->stackEnd - vm->stack == SCM_VM_FIBER_STACK_SIZE);
+    fiber_swap_regs(vm, f);
+    if (reusable) {
+        for (ScmObj *p = f->segment; p < f->segment+SCM_VM_FIBER_STACK_SIZE;
+             p++) {
+            *p = NULL;
+        }
+        vm->fiberStackCache = f->segment;
+    }
+    memset(&f->regs, 0, sizeof(ScmFiberRegs));
+    f->segment = NULL;
+    f->thunk = SCM_FALSE;
+    f->cstack = NULL;
+    return val;
+}
+
+ScmObj Scm_VMFiberResume(ScmObj fiber, ScmObj val)
+{
+    ScmVM *vm = theVM;
+
+    if (!SCM_FIBERP(fiber)) SCM_TYPE_ERROR(fiber, "fiber");
+    ScmFiber *f = SCM_FIBER(fiber);
+    switch (f->state) {
+    case SCM_FIBER_NEW: case SCM_FIBER_SUSPENDED:
+        break;
+    case SCM_FIBER_RUNNING:
+        Scm_Error("fiber is already running: %S", fiber);
+    default:
+        Scm_Error("fiber is already finished: %S", fiber);
+    }
+    if (f->vm == NULL) {
+        f->vm = vm;
+    } else if (f->vm != vm) {
+        Scm_Error("fiber can't be resumed by other thread: %S", fiber);
+    }
+
+    int fresh = (f->state == SCM_FIBER_NEW);
+    if (fresh) {
+        ScmObj *seg = fiber_alloc_segment(vm);
+        f->segment = seg;
+        f->regs.stack = f->regs.stackBase = f->regs.sp = seg;
+        f->regs.stackEnd = seg + SCM_VM_FIBER_STACK_SIZE;
+        f->regs.cont = NULL;
+        f->regs.denv = vm->denv;
+        f->regs.dynamicHandlers = Scm_Cons(f->guard, vm->dynamicHandlers);
+        f->regs.resetChain = SCM_NIL;
+        f->regs.floatingEscapePoints = SCM_NIL;
+#if GAUCHE_FFX
+        /* Allocated by Scm_VMFlushFPStack on the first use. */
+        f->regs.fpstack = f->regs.fpsp = f->regs.fpstackEnd = NULL;
+#endif /*GAUCHE_FFX*/
+    } else {
+        /* The fiber's handler chain is (<entry> ... <guard> . <resumer's>).
+           If we're resumed from a different dynamic extent, graft
+           the fiber's own entries onto the current chain, and call their
+           'before' handlers. */
+        ScmObj h = f->regs.dynamicHandlers;
+        if (!(SCM_PAIRP(h) && SCM_EQ(SCM_CAR(h), f->guard)
+              && SCM_EQ(SCM_CDR(h), vm->dynamicHandlers))) {
+            ScmObj bottom = Scm_Cons(f->guard, vm->dynamicHandlers);
+            ScmObj head = SCM_NIL, tail = SCM_NIL, p;
+            SCM_FOR_EACH(p, h) {
+                if (SCM_EQ(SCM_CAR(p), f->guard)) break;
+                SCM_APPEND1(head, tail, SCM_CAR(p));
+            }
+            if (SCM_NULLP(head)) {
+                f->regs.dynamicHandlers = bottom;
+            } else {
+                SCM_SET_CDR_UNCHECKED(tail, bottom);
+                ScmObj denv = vm->denv;
+                ScmObj handlers = vm->dynamicHandlers;
+                vm->dynamicHandlers = bottom;
+                call_dynamic_handlers(vm, head, bottom);
+                vm->denv = denv;
+                vm->dynamicHandlers = handlers;
+                f->regs.dynamicHandlers = head;
+            }
+        }
+    }
+
+    f->parent = vm->currentFiber;
+    f->cstack = vm->cstack;
+    fiber_swap_regs(vm, f);
+    vm->currentFiber = fiber;
+    f->state = SCM_FIBER_RUNNING;
+
+    if (fresh) {
+        ScmObj *data = new_ccont(vm, fiber_finish_cc, NULL, 1);
+        data[0] = fiber;
+        return Scm_VMApply0(f->thunk);
+    } else {
+        vm->numVals = 1;
+        return val;
+    }
+}
+
+ScmObj Scm_VMFiberYield(ScmObj val)
+{
+    ScmVM *vm = theVM;
+
+    if (!SCM_FIBERP(vm->currentFiber)) {
+        Scm_Error("fiber-yield called outside of a fiber");
+    }
+    ScmFiber *f = SCM_FIBER(vm->currentFiber);
+    if (vm->cstack != f->cstack) {
+        Scm_Error("fiber can't yield across C stack boundary: %S",
+                  SCM_OBJ(f));
+    }
+
+    /* Call 'after' handlers of the fiber's own entries.  We keep
+       the chain intact, so that we can call 'before' handlers on resume. */
+    ScmObj handlers = vm->dynamicHandlers;
+    if (SCM_PAIRP(handlers) && !SCM_EQ(SCM_CAR(handlers), f->guard)) {
+        ScmObj denv = vm->denv;
+        ScmObj bottom = handlers;
+        while (SCM_PAIRP(bottom) && !SCM_EQ(SCM_CAR(bottom), f->guard)) {
+            bottom = SCM_CDR(bottom);
+        }
+        /* The handlers may drop escape points from the floating list
+           (see discard_ehandler), so make their continuations safe. */
+        if (SCM_PAIRP(vm->floatingEscapePoints)) save_cont(vm);
+        call_dynamic_handlers(vm, bottom, handlers);
+        vm->denv = denv;
+        vm->dynamicHandlers = handlers;
+    }
+
+    f->state = SCM_FIBER_SUSPENDED;
+    vm->currentFiber = f->parent;
+    f->parent = SCM_FALSE;
+    fiber_swap_regs(vm, f);
+    vm->numVals = 1;
+    return val;
+}
+
 /*==============================================================
  * Unwind protect API
  */
@@ -4312,6 +4848,14 @@ struct GC_ms_entry *vm_stack_mark(GC_word *addr,
     int limit = vm->sp - vm->stackBase + 5;
     void *spb = (void *)vm->stackBase;
     void *sbe = (void *)(vm->stackBase + SCM_VM_STACK_SIZE);
+
+    /* While a fiber is running, vm->stackBase points to the fiber's
+       segment, and this block holds the suspended frames of the main
+       context.  We scan the whole block then. */
+    if (vm->stackBase != vmsb) {
+        limit = SCM_VM_STACK_SIZE;
+        spb = sbe = (void *)vmsb;
+    }
     void *hb = GC_least_plausible_heap_addr;
     void *he = GC_greatest_plausible_heap_addr;
 
@@ -4396,6 +4940,10 @@ void Scm__InitVM(void)
     theVM = rootVM;
 #endif  /* no threads */
 
+#if GAUCHE_VM_ALLOC_CACHE
+    vm_alloc_cache_ready = TRUE;
+#endif /*GAUCHE_VM_ALLOC_CACHE*/
+
 #ifdef COUNT_INSN_FREQUENCY
     Scm_AddCleanupHandler(dump_insn_frequency, NULL);
 #endif /*COUNT_INSN_FREQUENCY*/
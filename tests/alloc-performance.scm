@@ -0,0 +1,60 @@
+;;
+;; Measure allocation throughput of small objects (pairs, flonums and
+;; closures) with increasing number of threads.
+;;
+;; Compare the result of the build with GAUCHE_VM_ALLOC_CACHE 1 (default)
+;; and 0 to see the effect of the per-VM allocation cache.
+;;
+
+(use gauche.threads)
+(use gauche.time)
+
+(define *count* 5000000)
+
+;; Each loop keeps a small live set so that the cost is dominated by
+;; allocation, not by marking.
+(define (cons-loop n)
+  (let loop ([i 0] [r '()])
+    (cond [(= i n) (length r)]
+          [(= (modulo i 1000) 0) (loop (+ i 1) '())]
+          [else (loop (+ i 1) (cons i r))])))
+
+(define (flonum-loop n)
+  (let loop ([i 0] [x 0.0] [r '()])
+    (cond [(= i n) (length r)]
+          [(= (modulo i 1000) 0) (loop (+ i 1) x '())]
+          [else (let1 y (+ x 0.5)
+                  (loop (+ i 1) y (cons y r)))])))
+
+(define (closure-loop n)
+  (let1 v (make-vector 1000 #f)
+    (dotimes [i n]
+      (vector-set! v (modulo i 1000) (^[] i)))
+    (vector-length v)))
+
+;; Run PROC in K threads, each allocating *count*/K objects, and returns
+;; the elapsed real time.
+(define (run-threads k proc)
+  (let1 per-thread (quotient *count* k)
+    (time-result-real
+     (time-this 1 (^[]
+                    (for-each thread-join!
+                              (map (^_ (thread-start!
+                                        (make-thread (^[] (proc per-thread)))))
+                                   (iota k))))))))
+
+(define (bench name proc)
+  (print name)
+  (dolist [k (let loop ([k 1] [r '()])
+               (if (> k (max 1 (sys-available-processors)))
+                 (reverse r)
+                 (loop (* k 2) (cons k r))))]
+    (let1 t (run-threads k proc)
+      (format #t "  ~2d threads: ~8,3f sec  ~10,0f objs/sec\n"
+              k t (/ *count* t)))))
+
+(define (main args)
+  (bench "pairs" cons-loop)
+  (bench "flonums" flonum-loop)
+  (bench "closures" closure-loop)
+  0)
@@ -0,0 +1,44 @@
+;;
+;; Measure matrix operations of gauche.array.  Matrices backed by the
+;; same uvector class (<f64array> etc.) are handled by native kernels;
+;; general <array>s, or a mixture of classes, take the generic path.
+;;
+
+(use gauche.time)
+(use gauche.uvector)
+(use gauche.array)
+(use util.match)
+
+(define (make-matrix make n conv)
+  (rlet1 a (make (shape 0 n 0 n) 0)
+    (array-retabulate! a (^[i j] (conv (if (= i j)
+                                         (+ n (modulo (* i 7) 13))
+                                         (- (modulo (+ (* i 31) (* j 17)) 19)
+                                            9)))))))
+
+;; Each entry is (label make-a make-b conv inverse?).
+;; For <array> we use flonums, so that inverse is comparable to <f64array>.
+(define (bench n entries)
+  (define (cases e)
+    (match-let1 (label make-a make-b conv inverse?) e
+      (let ([a (make-matrix make-a n conv)]
+            [b (make-matrix make-b n conv)])
+        `((,#"mul-~label" . ,(^[] (array-mul a b)))
+          ,@(if inverse?
+              `((,#"inverse-~label" . ,(^[] (array-inverse a)))
+                (,#"determinant-~label" . ,(^[] (determinant a))))
+              '())))))
+  (print #"~|n|x~n")
+  (time-these/report 1 (append-map cases entries)))
+
+(define (main args)
+  ;; The generic path is slow; keep the size small to compare.
+  (bench 100 `(("f64" ,make-f64array ,make-f64array ,identity #t)
+               ("f32" ,make-f32array ,make-f32array ,identity #t)
+               ("s32" ,make-s32array ,make-s32array ,identity #f)
+               ("f64xf32" ,make-f64array ,make-f32array ,identity #f)
+               ("generic" ,make-array ,make-array ,inexact #t)))
+  (bench 500 `(("f64" ,make-f64array ,make-f64array ,identity #t)
+               ("f32" ,make-f32array ,make-f32array ,identity #t)
+               ("s32" ,make-s32array ,make-s32array ,identity #f)))
+  0)
@@ -0,0 +1,41 @@
+;;
+;; Measure throughput of character encoding conversion, for mostly-ASCII
+;; text (like logs) and for Japanese text.
+;;
+;; Runs of ASCII characters are converted in bulk, so the former should
+;; be much faster than the latter.
+;;
+
+(use gauche.time)
+(use gauche.uvector)
+(use gauche.charconv)
+
+(define *size* (* 16 1024 1024))
+
+;; A log-like line with a few Japanese words in it.
+(define *ascii-line*
+  (string-append "2024-05-01 12:34:56 INFO [worker-3] request "
+                 (string (ucs->char #x53d7) (ucs->char #x4ed8))
+                 " GET /api/v1/items?id=12345 status=200 time=0.0123\n"))
+
+(define *japanese-line*
+  (list->string (map (^i (ucs->char (+ #x3042 (modulo i 80)))) (iota 60))))
+
+(define (make-text line)
+  (with-output-to-string
+    (^[] (dotimes [i (quotient *size* (string-size line))] (display line)))))
+
+(define (bench name text)
+  (print #"~name (~(quotient (string-size text) 1048576) MB)")
+  (dolist [code '("EUCJP" "SJIS" "ISO2022JP" "UTF-16LE" "UTF-32LE")]
+    (let1 encoded (ces-convert-to <u8vector> text 'utf-8 code)
+      (time-these/report
+       1
+       `((,#"UTF-8->~code" . ,(^[] (ces-convert-to <u8vector> text
+                                                   'utf-8 code)))
+         (,#"~|code|->UTF-8" . ,(^[] (ces-convert encoded code 'utf-8))))))))
+
+(define (main args)
+  (bench "mostly ASCII" (make-text *ascii-line*))
+  (bench "Japanese" (make-text *japanese-line*))
+  0)
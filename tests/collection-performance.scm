@@ -0,0 +1,52 @@
+;;
+;; Measure map and fold of gauche.collection over vectors, strings and
+;; uvectors, against the type-specific procedures.  The generic
+;; functions find the shortcut method for each type through the method
+;; dispatcher; a <sequence> subclass shows the generic way, which goes
+;; through call-with-iterator.
+;;
+
+(use gauche.time)
+(use gauche.uvector)
+(use gauche.sequence)
+(use scheme.vector)
+(use srfi.13)
+
+(define *size* 100000)
+
+;; A sequence without shortcut methods.
+(define-class <wrapped> (<sequence>)
+  ((vec :init-keyword :vec)))
+(define-method call-with-iterator ((w <wrapped>) proc . opts)
+  (apply call-with-iterator (~ w'vec) proc opts))
+
+(define (bench name alist)
+  (print #"~name, ~*size* elements")
+  (time-these/report '(cpu 3) alist))
+
+(define (main args)
+  (let ([vec (vector-tabulate *size* identity)]
+        [str (make-string *size* #\a)]
+        [u8 (make-u8vector *size* 1)]
+        [f64 (make-f64vector *size* 1.0)])
+    (bench "vector"
+           `((vector-map     . ,(^[] (vector-map (^x (+ x 1)) vec)))
+             (map            . ,(^[] (map (^x (+ x 1)) vec)))
+             (vector-fold    . ,(^[] (vector-fold (^[r x] (+ r x)) 0 vec)))
+             (fold           . ,(^[] (fold + 0 vec)))
+             (fold-generic   . ,(^[] (fold + 0 (make <wrapped> :vec vec))))))
+    (bench "string"
+           `((string-map     . ,(^[] (string-map char-upcase str)))
+             (map            . ,(^[] (map char-upcase str)))
+             (string-fold    . ,(^[] (string-fold (^[c r] (+ r 1)) 0 str)))
+             (fold           . ,(^[] (fold (^[c r] (+ r 1)) 0 str)))))
+    (bench "u8vector"
+           `((u8vector->list . ,(^[] (u8vector->list u8)))
+             (map            . ,(^[] (map identity u8)))
+             (fold           . ,(^[] (fold + 0 u8)))
+             (fold-generic   . ,(^[] (fold + 0 (make <wrapped> :vec u8))))))
+    (bench "f64vector"
+           `((f64vector->list . ,(^[] (f64vector->list f64)))
+             (map             . ,(^[] (map identity f64)))
+             (fold            . ,(^[] (fold + 0 f64))))))
+  0)
@@ -0,0 +1,37 @@
+;;
+;; Measure the cost of escaping with call/cc, call/ec and guard.
+;; call/cc saves the continuation frames to the heap every time it is
+;; called, so its cost grows with the depth of the stack; call/ec only
+;; pushes a marker frame.  guard is shown for exception-heavy code.
+;;
+
+(use gauche.time)
+
+(define *count* 100000)
+
+;; Calls THUNK at the recursion depth DEPTH.
+(define (nest depth thunk)
+  (if (zero? depth)
+    (thunk)
+    (+ 1 (nest (- depth 1) thunk))))
+
+;; Find the first negative number in a short list, escaping by K.
+(define (search escape)
+  (dotimes [*count*]
+    (escape (^k (for-each (^x (when (negative? x) (k x))) '(1 2 -3 4))
+                #f))))
+
+(define (raise-and-catch)
+  (dotimes [*count*]
+    (guard (e [(string? e) e])
+      (raise "oops"))))
+
+(define (main args)
+  (dolist [depth '(0 100 1000)]
+    (print #"depth ~depth, ~*count* escapes")
+    (time-these/report
+     1
+     `((call/cc . ,(^[] (nest depth (^[] (search call/cc) 0))))
+       (call/ec . ,(^[] (nest depth (^[] (search call/ec) 0))))
+       (guard   . ,(^[] (nest depth (^[] (raise-and-catch) 0)))))))
+  0)
@@ -422,6 +422,64 @@
 (test "Al's call/cc test" 1
       (^[] (call/cc (^c (0 (c 1))))))
 
+;;-----------------------------------------------------------------------
+;; Escape-only continuations
+;;
+
+(test-section "escape continuations")
+
+(test* "call/ec normal return" '(1 2)
+       (values->list (call/ec (^k (values 1 2)))))
+(test* "call/ec escape" 'found
+       (call/ec (^k (for-each (^x (when (eq? x 'c) (k 'found))) '(a b c d))
+                    'not-found)))
+(test* "call/ec escape with values" '(a b)
+       (values->list (call/ec (^k (+ 1 (k 'a 'b))))))
+(test* "call/ec is a continuation" #t
+       (call/ec continuation?))
+(test* "let/ec" 3
+       (let/ec break
+         (let loop ([i 0])
+           (when (= i 3) (break i))
+           (loop (+ i 1)))))
+(test* "let/ec nested" '(inner outer)
+       (let/ec outer
+         (list (let/ec inner (inner 'inner)) (outer '(inner outer)))))
+
+(test* "call/ec and dynamic-wind" '(result before after)
+       (let1 trace '()
+         (let1 r (call/ec
+                  (^k (dynamic-wind
+                          (^[] (push! trace 'before))
+                          (^[] (k 'result) 'oops)
+                          (^[] (push! trace 'after)))))
+           (cons r (reverse trace)))))
+
+(test* "call/ec after frames are saved" 'escaped
+       (call/ec (^k (call/cc (^c #f)) (k 'escaped))))
+
+(test* "call/ec after frames are saved by a dynamic handler" 'escaped
+       (call/ec (^k (dynamic-wind
+                        (^[] #f)
+                        (^[] (k 'escaped))
+                        (^[] (call/cc (^c #f)))))))
+
+(test* "call/ec across C stack" 'caught
+       (call/ec (^k (with-error-handler (^e (k 'caught))
+                      (^[] (error "oops"))))))
+
+(test* "call/ec deep recursion" 100000
+       (let/ec return
+         (let loop ([n 0])
+           (if (= n 100000) (return n) (+ 1 (loop (+ n 1)))))))
+
+(test* "call/ec outside of its extent" (test-error)
+       (let1 k (call/ec identity)
+         (k 'again)))
+(test* "call/ec outside of its extent (nested)" (test-error)
+       (let1 k (let/ec outer (call/ec (^k (outer k))))
+         (k 'again)))
+
 ;;-----------------------------------------------------------------------
 ;; Continuation prompts
 ;;
@@ -809,4 +867,169 @@
          (parameterize ([(make-parameter 0) 1])
            (call-with-immediate-continuation-mark 'in-tail-context identity))))
 
+;;-----------------------------------------------------------------------
+(test-section "fibers")
+
+(test* "fiber basic" '(1 2 3 done)
+       (let1 f (make-fiber (^[] (fiber-yield 1) (fiber-yield 2) 3))
+         (let* ([a (fiber-resume f)]
+                [b (fiber-resume f)]
+                [c (fiber-resume f)])
+           (list a b c (fiber-state f)))))
+
+(test* "fiber passing values" '(a b (10 20))
+       (let1 f (make-fiber (^[] (let* ([x (fiber-yield 'a)]
+                                       [y (fiber-yield 'b)])
+                                  (list x y))))
+         (let* ([a (fiber-resume f)]
+                [b (fiber-resume f 10)]
+                [c (fiber-resume f 20)])
+           (list a b c))))
+
+(test* "fiber multiple values" '(1 2 3)
+       (receive r (fiber-resume (make-fiber (^[] (values 1 2 3)))) r))
+
+(test* "fiber states" '(#t #f new running suspended done)
+       (let* ([states '()]
+              [f (make-fiber (^[]
+                               (push! states (fiber-state (current-fiber)))
+                               (fiber-yield)
+                               'end))])
+         (push! states (fiber-state f))
+         (fiber-resume f)
+         (push! states (fiber-state f))
+         (fiber-resume f)
+         (push! states (fiber-state f))
+         (list* (fiber? f) (current-fiber) (reverse states))))
+
+(test* "nested fibers" '(i1 o1 i2 done done)
+       (let* ([inner (make-fiber (^[] (fiber-yield 'i1) 'i2))]
+              [outer (make-fiber (^[]
+                                   (fiber-yield (fiber-resume inner))
+                                   (fiber-yield 'o1)
+                                   (fiber-resume inner)))])
+         (let* ([a (fiber-resume outer)]
+                [b (fiber-resume outer)]
+                [c (fiber-resume outer)])
+           (list a b c (fiber-state inner) (fiber-state outer)))))
+
+(test* "fiber and dynamic-wind" '(in out y in out r)
+       (let* ([log '()]
+              [f (make-fiber (^[]
+                               (dynamic-wind
+                                 (^[] (push! log 'in))
+                                 (^[] (fiber-yield 'y) 'r)
+                                 (^[] (push! log 'out)))))])
+         (push! log (fiber-resume f))
+         (push! log (fiber-resume f))
+         (reverse log)))
+
+(test* "fiber and parameterize" '(inner outer inner)
+       (let* ([p (make-parameter 'outer)]
+              [f (make-fiber (^[] (parameterize ([p 'inner])
+                                    (fiber-yield (p))
+                                    (p))))])
+         (let* ([a (fiber-resume f)]
+                [b (p)]
+                [c (fiber-resume f)])
+           (list a b c))))
+
+(test* "fiber and error" '("boom" done)
+       (let1 f (make-fiber (^[] (fiber-yield 1) (error "boom")))
+         (fiber-resume f)
+         (let1 r (guard (e [(error? e) (condition-message e)])
+                   (fiber-resume f))
+           (list r (fiber-state f)))))
+
+(test* "fiber and reraise" '(outer "inner" done)
+       (let1 f (make-fiber (^[] (guard (e [(string? e) 'no])
+                                  (error "inner"))))
+         (let1 r (guard (e [(error? e) (list 'outer (condition-message e))])
+                   (fiber-resume f))
+           (append r (list (fiber-state f))))))
+
+(test* "fiber and raise-continuable through guard" 6
+       (with-exception-handler
+        (^e 5)
+        (^[] (guard (e [#f 'no])
+               (fiber-resume
+                (make-fiber (^[] (+ 1 (raise-continuable 'c)))))))))
+
+(test* "fiber and escape" '(escaped done)
+       (let* ([f #f]
+              [r (call/cc (^k (set! f (make-fiber (^[] (k 'escaped) 'no)))
+                              (fiber-resume f)))])
+         (list r (fiber-state f))))
+
+(test* "fiber and escape-only continuation" '(escaped done)
+       (let* ([f #f]
+              [r (let/ec k (set! f (make-fiber (^[] (k 'escaped) 'no)))
+                           (fiber-resume f))])
+         (list r (fiber-state f))))
+
+(test* "escape-only continuation from nested fibers" 'escaped
+       (let/ec k
+         (fiber-resume
+          (make-fiber (^[] (fiber-resume (make-fiber (^[] (k 'escaped)))))))))
+
+(use gauche.generator)
+
+(test* "escape-only continuation from generate/fiber" 1
+       (let/ec k (let1 g (generate/fiber (^[y] (k 1))) (g))))
+
+(test* "escape-only continuation from generate/fiber after yield"
+       '(0 escaped)
+       (let* ([r '()]
+              [v (let/ec k
+                   (let1 g (generate/fiber (^[y] (y 0) (k 'escaped)))
+                     (push! r (g))
+                     (g)))])
+         (reverse (cons v r))))
+
+(test* "fiber deep recursion" '(bottom 100000)
+       (letrec ([deep (^n (if (= n 0)
+                            (fiber-yield 'bottom)
+                            (+ 1 (deep (- n 1)))))])
+         (let1 f (make-fiber (^[] (deep 100000)))
+           (let* ([a (fiber-resume f)]
+                  [b (fiber-resume f 0)])
+             (list a b)))))
+
+(test* "fiber with a large argument frame" '(1000 999)
+       (let1 f (make-fiber (^[] (fiber-yield (length (apply list (iota 1000))))
+                             (apply max (iota 1000))))
+         (let* ([a (fiber-resume f)]
+                [b (fiber-resume f)])
+           (list a b))))
+
+(test* "fiber and flonums" '(0.0 25.0 50.0 75.0 100.0)
+       (let1 f (make-fiber (^[] (let loop ([i 0] [x 0.0])
+                                  (when (zero? (modulo i 50)) (fiber-yield x))
+                                  (if (= i 200) 'end (loop (+ i 1) (+ x 0.5))))))
+         (let loop ([r '()])
+           (let1 v (fiber-resume f)
+             (if (eq? v 'end) (reverse r) (loop (cons v r)))))))
+
+(test* "fiber-yield outside of fiber" (test-error)
+       (fiber-yield 1))
+
+(test* "resuming running fiber" (test-error)
+       (fiber-resume (make-fiber (^[] (fiber-resume (current-fiber))))))
+
+(test* "resuming finished fiber" (test-error)
+       (let1 f (make-fiber (^[] 1))
+         (fiber-resume f)
+         (fiber-resume f)))
+
+(test* "re-entering suspended fiber" (test-error)
+       (let* ([k #f]
+              [f (make-fiber (^[] (call/cc (^c (set! k c)))
+                               (fiber-yield 1)
+                               2))])
+         (fiber-resume f)
+         (k #f)))
+
+(test* "fiber-yield across C stack" (test-error)
+       (fiber-resume (make-fiber (^[] (reset (fiber-yield 1))))))
+
 (test-end)
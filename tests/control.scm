@@ -349,6 +349,24 @@
              (iota 20)
              :mapper (make-fully-concurrent-mapper)))
 
+(let* ([n 50000]
+       [data (map (^i (modulo (* i 7919) n)) (iota n))]
+       [expected (sort data)])
+  (test* "psort (default)" expected (psort data))
+  (test* "psort (vector)" (list->vector expected)
+         (psort (list->vector data)))
+  (test* "psort (procedure, static)" (reverse expected)
+         (psort data > :mapper (make-static-mapper)))
+  (test* "psort (comparator, pool)" expected
+         (psort data default-comparator :mapper (make-pool-mapper)))
+  (test* "psort (stable)"
+         (stable-sort (map (^i (cons (modulo i 10) i)) (iota n))
+                      (^[a b] (< (car a) (car b))))
+         (psort (map (^i (cons (modulo i 10) i)) (iota n))
+                (^[a b] (< (car a) (car b)))))
+  (test* "psort! (small)" '#(1 2 3 4 5)
+         (rlet1 v (vector 3 1 5 2 4) (psort! v))))
+
 ;;--------------------------------------------------------------------
 ;; control.scheduler
 ;;
@@ -715,6 +733,141 @@
          (port-closed? outlet0))
   )
 
+;;--------------------------------------------------------------------
+;; control.green-thread
+;;
+
+(test-section "control.green-thread")
+(use control.green-thread)
+(test-module 'control.green-thread)
+
+(test* "run-green-threads" '(a b)
+       (run-green-threads (^[] (values->list (values 'a 'b)))))
+
+(test* "green threads interleave" '(a0 b0 a1 b1 a2 b2)
+       (let1 log '()
+         (run-green-threads
+          (^[]
+            (let1 ts (map (^[name]
+                            (make-green-thread
+                             (^[] (dotimes [i 3]
+                                    (push! log (symbol-append name i))
+                                    (green-thread-yield!)))))
+                          '(a b))
+              (for-each green-thread-start! ts)
+              (for-each green-thread-join! ts))))
+         (reverse log)))
+
+(test* "green-thread-sleep!" '(0 1 2)
+       (let1 log '()
+         (run-green-threads
+          (^[]
+            (let1 ts (map (^i (make-green-thread
+                               (^[] (green-thread-sleep! (* (- 2 i) 0.02))
+                                    (push! log (- 2 i)))))
+                          (iota 3))
+              (for-each green-thread-start! ts)
+              (for-each green-thread-join! ts))))
+         (reverse log)))
+
+(test* "green-thread-join! result" '(10 20)
+       (run-green-threads
+        (^[]
+          (let ([a (green-thread-start! (make-green-thread (^[] 10)))]
+                [b (green-thread-start! (make-green-thread (^[] 20)))])
+            (list (green-thread-join! a) (green-thread-join! b))))))
+
+(test* "green-thread-join! exception" "oops"
+       (run-green-threads
+        (^[]
+          (let1 t (green-thread-start!
+                   (make-green-thread (^[] (error "oops"))))
+            (guard (e [(error? e) (condition-message e)])
+              (green-thread-join! t))))))
+
+(test* "green-thread-state" '(new terminated #f)
+       (let1 t (make-green-thread (^[] #t))
+         (let1 s (green-thread-state t)
+           (run-green-threads (^[] (green-thread-join!
+                                    (green-thread-start! t))))
+           (list s (green-thread-state t) (current-green-thread)))))
+
+(test* "green-thread-yield! outside" (test-error)
+       (green-thread-yield!))
+
+(test* "green-thread-join! self" (test-error)
+       (run-green-threads (^[] (green-thread-join! (current-green-thread)))))
+
+(test* "deadlock" (test-error)
+       (run-green-threads
+        (^[]
+          (let1 me (current-green-thread)
+            (green-thread-join!
+             (green-thread-start!
+              (make-green-thread (^[] (green-thread-join! me)))))))))
+
+(use gauche.generator)
+(let ()
+  ;; Switching from a nested fiber or from reset is an error, and leaves
+  ;; the green thread running.
+  (define (try gen)
+    (run-green-threads
+     (^[]
+       (list (guard (e [(error? e) 'error]) (gen))
+             (green-thread-state (current-green-thread))
+             (begin (green-thread-sleep! 0.001) 'ok)))))
+  (test* "green-thread-sleep! in a generate/fiber body" '(error running ok)
+         (try (generate/fiber (^[yield] (green-thread-sleep! 0.01) (yield 1)))))
+  (test* "green-thread-yield! in a generate/fiber body" '(error running ok)
+         (try (generate/fiber (^[yield] (green-thread-yield!) (yield 1)))))
+  (test* "green-thread-yield! in a generate body" '(error running ok)
+         (try (generate (^[yield] (green-thread-yield!) (yield 1))))))
+
+(test* "green-thread-wait-readable" '(#f "hello")
+       (receive (in out) (sys-pipe)
+         (run-green-threads
+          (^[]
+            (let* ([r (green-thread-start!
+                       (make-green-thread
+                        (^[] (list (green-thread-wait-readable in 0.01)
+                                   (begin (green-thread-wait-readable in)
+                                          (read-line in))))))]
+                   [w (green-thread-start!
+                       (make-green-thread
+                        (^[] (green-thread-sleep! 0.05)
+                             (green-thread-wait-writable out)
+                             (write-string "hello\n" out)
+                             (flush out))))])
+              (green-thread-join! w)
+              (green-thread-join! r))))))
+
+(test* "green-thread pool" (iota 100)
+       (let* ([pool (make-green-thread-pool 3)]
+              [ts (map (^i (green-thread-pool-spawn!
+                            pool (^[] (green-thread-sleep! 0.001)
+                                      (green-thread-yield!)
+                                      i)))
+                       (iota 100))]
+              [rs (map green-thread-join! ts)])
+         (green-thread-pool-shutdown! pool)
+         rs))
+
+(test* "green-thread pool, joining across workers" '(1 0)
+       ;; Spawned in round-robin: t0 and t2 go to one worker, t1 and t3
+       ;; to the other.  t2 and t3 join a thread of the other worker.
+       (let* ([pool (make-green-thread-pool 2)]
+              [t0 (green-thread-pool-spawn!
+                   pool (^[] (green-thread-sleep! 0.05) 0))]
+              [t1 (green-thread-pool-spawn!
+                   pool (^[] (green-thread-sleep! 0.05) 1))]
+              [t2 (green-thread-pool-spawn!
+                   pool (^[] (green-thread-join! t1)))]
+              [t3 (green-thread-pool-spawn!
+                   pool (^[] (green-thread-join! t0)))]
+              [rs (list (green-thread-join! t2) (green-thread-join! t3))])
+         (green-thread-pool-shutdown! pool)
+         rs))
+
 ;;--------------------------------------------------------------------
 ;; control.timeout
 ;;
@@ -0,0 +1,35 @@
+;;
+;; Measure throughput of reading CSV with text.csv, with the native
+;; tokenizer, with the Scheme fallback (forced by giving a predicate
+;; as the trim charset), and reading into typed columns.
+;;
+
+(use gauche.time)
+(use gauche.uvector)
+(use text.csv)
+
+(define *rows* 200000)
+
+(define *text*
+  (with-output-to-string
+    (^[] (dotimes [i *rows*]
+           (format #t "~a,\"name ~a, quoted\",~a,~a\n"
+                   i i (* i 0.25) (modulo (* i 7) 1000))))))
+
+(define (read-all reader)
+  (with-input-from-string *text*
+    (^[] (let loop ([n 0])
+           (if (eof-object? (reader)) n (loop (+ n 1)))))))
+
+(define (main args)
+  (print #"text.csv, ~*rows* rows")
+  (time-these/report
+   1
+   `((native  . ,(^[] (read-all (make-csv-reader #\,))))
+     (scheme  . ,(^[] (read-all (make-csv-reader #\, #\"
+                                                 (cut char-whitespace? <>)))))
+     (columns . ,(^[] (with-input-from-string *text*
+                        (make-csv-column-reader
+                         #\, `(,<s32vector> ,<string> ,<f64vector>
+                               ,<s32vector>)))))))
+  0)
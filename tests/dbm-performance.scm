@@ -0,0 +1,67 @@
+;;
+;; Measure put, get and traversal of dbm.btree against dbm.fsdbm.
+;; Btree commits each put by itself unless it's in a transaction, so
+;; we show both; bulk load builds the tree bottom up.  Range scan only
+;; reads the pages that cover the range.
+;;
+
+(use gauche.time)
+(use dbm)
+(use dbm.btree)
+(use dbm.fsdbm)
+(use file.util)
+
+(define *count* 20000)
+(define *path* "dbm-perf.dbm")
+
+(define (key i) (format "key~8,'0d" i))
+(define (scrambled i) (modulo (* i 7919) *count*))
+
+(define (clean-up)
+  (remove-files (list *path*)))
+
+(define (with-db class mode proc)
+  (let1 db (dbm-open class :path *path* :rw-mode mode)
+    (begin0 (proc db) (dbm-close db))))
+
+;; The cases run in order, so 'get' and 'fold' read what 'put' wrote.
+(define (common-cases class)
+  `((put  . ,(^[] (with-db class :create
+                    (^[db] (dotimes [i *count*]
+                             (dbm-put! db (key (scrambled i))
+                                       (x->string i)))))))
+    (get  . ,(^[] (with-db class :read
+                    (^[db] (dotimes [i *count*]
+                             (dbm-get db (key (scrambled i))))))))
+    (fold . ,(^[] (with-db class :read
+                    (^[db] (dbm-fold db (^[k v r] (+ r 1)) 0)))))))
+
+(define (main args)
+  (unwind-protect
+      (begin
+        (print #"fsdbm, ~*count* keys")
+        (time-these/report 1 (common-cases <fsdbm>))
+        (clean-up)
+        (print #"btree, ~*count* keys")
+        (time-these/report
+         1
+         `(,@(common-cases <btree>)
+           (put-transaction
+            . ,(^[] (with-db <btree> :create
+                      (^[db] (btree-transaction db
+                               (^[] (dotimes [i *count*]
+                                      (dbm-put! db (key (scrambled i))
+                                                (x->string i)))))))))
+           (bulk-load
+            . ,(^[] (with-db <btree> :create
+                      (^[db] (btree-bulk-load!
+                              db (map (^i (cons (key i) (x->string i)))
+                                      (iota *count*)))))))
+           (range-100
+            . ,(^[] (with-db <btree> :read
+                      (^[db] (dotimes [i (quotient *count* 100)]
+                               (btree-range-fold db (key (* i 100))
+                                                 (key (+ (* i 100) 100))
+                                                 (^[k v r] (+ r 1)) 0)))))))))
+    (clean-up))
+  0)
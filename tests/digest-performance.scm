@@ -0,0 +1,45 @@
+;;
+;; Measure throughput of message digest algorithms, for an in-memory
+;; message, for reading from a port, and for a mapped file with
+;; plain and tree (parallel) hashing.  Real time is compared, since tree
+;; hashing uses multiple threads.
+;;
+;; SHA-1 and SHA-256 use the CPU's SHA extensions when available; build
+;; with -DGAUCHE_DIGEST_NO_SHANI to compare with the portable code.
+;;
+
+(use gauche.time)
+(use gauche.uvector)
+(use file.util)
+(use util.digest)
+(use rfc.md5)
+(use rfc.sha)
+
+(define *size* (* 64 1024 1024))
+(define *file* "digest-performance.o")
+
+(define *algorithms*
+  `(("md5" ,<md5>) ("sha1" ,<sha1>) ("sha256" ,<sha256>)
+    ("sha512" ,<sha512>) ("sha3-256" ,<sha3-256>)))
+
+(define *data*
+  (rlet1 v (make-u8vector *size*)
+    (dotimes [i *size*] (u8vector-set! v i (logand (* i 31) #xff)))))
+
+(define (bench name class)
+  (print #"~name (~(quotient *size* 1048576) MB)")
+  (time-these/report
+   1
+   `((message . ,(^[] (digest-message-to <u8vector> class *data*)))
+     (port    . ,(^[] (with-input-from-file *file*
+                        (^[] (digest-to <u8vector> class)))))
+     (mapped  . ,(^[] (digest-file-to <u8vector> class *file*)))
+     (tree    . ,(^[] (tree-digest-file-to <u8vector> class *file*))))
+   :metric 'real))
+
+(define (main args)
+  (with-output-to-file *file* (^[] (write-uvector *data*)))
+  (unwind-protect
+      (dolist [a *algorithms*] (apply bench a))
+    (remove-files *file*))
+  0)
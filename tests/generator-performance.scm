@@ -0,0 +1,66 @@
+;;
+;; Measure the cost of switching between a coroutine generator and its
+;; consumer.  'generate/fiber' runs the coroutine in a fiber, so the cost
+;; stays the same when yield is called deep inside recursion; 'generate'
+;; copies the continuation on every yield.  A plain closure generator is
+;; shown as the baseline.
+;;
+;; The 'shallow' section creates many short generators, each yielding
+;; a few values without recursion, which is the common use.  It shows
+;; the cost of setting up a fiber, and of keeping many of them
+;; suspended at the same time.
+;;
+
+(use gauche.time)
+(use gauche.generator)
+
+(define *count* 200000)
+
+;; Yields 0 ... *count*-1, at the recursion depth DEPTH.
+(define (counter depth)
+  (^[yield]
+    (let nest ([d depth])
+      (if (zero? d)
+        (dotimes [i *count*] (yield i))
+        (begin (nest (- d 1)) #f)))))
+
+(define (drain gen)
+  (let loop () (unless (eof-object? (gen)) (loop))))
+
+;; Yields 0 ... n-1 without recursion.
+(define (short n)
+  (^[yield] (dotimes [i n] (yield i))))
+
+;; Makes *count*/N generators of N elements each, and drains them one
+;; after another.
+(define (short-sequential make n)
+  (^[] (dotimes [k (quotient *count* n)] (drain (make (short n))))))
+
+;; Makes *count*/N generators of N elements each, and reads them
+;; round-robin, so all of them are suspended at once.
+(define (short-interleaved make n)
+  (^[]
+    (let1 gens (list-tabulate (quotient *count* n) (^_ (make (short n))))
+      (dotimes [i n] (dolist [g gens] (g)))
+      (dolist [g gens] (g)))))
+
+(define (main args)
+  (dolist [depth '(0 10 100)]
+    (print #"depth ~depth, ~*count* yields")
+    (time-these/report
+     1
+     `((fiber       . ,(^[] (drain (generate/fiber (counter depth)))))
+       (reset/shift . ,(^[] (drain (generate (counter depth))))))))
+  (dolist [n '(1 10)]
+    (print #"shallow, ~n element(s) per generator")
+    (time-these/report
+     1
+     `((fiber       . ,(short-sequential generate/fiber n))
+       (reset/shift . ,(short-sequential generate n)))))
+  (print "shallow, 2000 generators suspended at once")
+  (time-these/report
+   1
+   `((fiber       . ,(short-interleaved generate/fiber 100))
+     (reset/shift . ,(short-interleaved generate 100))
+     (giota       . ,(^[] (drain (giota *count*))))))
+  0)
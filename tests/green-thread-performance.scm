@@ -0,0 +1,36 @@
+;;
+;; Measure the cost of green threads in control.green-thread: spawning
+;; many of them (think of one per connection), and switching between
+;; them.  OS threads are shown for comparison, with a smaller count.
+;;
+
+(use gauche.time)
+(use gauche.threads)
+(use control.green-thread)
+
+;; Spawn N threads, each of which yields K times.
+(define (green n k)
+  (run-green-threads
+   (^[]
+     (let1 ts (map (^_ (green-thread-start!
+                        (make-green-thread
+                         (^[] (dotimes [k] (green-thread-yield!))))))
+                   (iota n))
+       (for-each green-thread-join! ts)))))
+
+(define (os n)
+  (let1 ts (map (^_ (thread-start! (make-thread (^[] #t)))) (iota n))
+    (for-each thread-join! ts)))
+
+(define (main args)
+  (print "spawn and join")
+  (time-these/report
+   1
+   `((green-x100000 . ,(^[] (green 100000 0)))
+     (os-x1000      . ,(^[] (os 1000))))
+   :metric 'real)
+  (print "switch")
+  (time-these/report
+   1
+   `((green-1000x100 . ,(^[] (green 1000 100)))))
+  0)
@@ -226,6 +226,65 @@
        (call-with-input-file "tmp1.o"
          (^p (peek-char p) (read-block 10 p))))
 
+;; Large blocks bypass the port buffer
+(let1 data (with-output-to-string
+             (^[] (dotimes [i 30000]
+                    (write-char (integer->char (+ 65 (modulo i 26)))))))
+  (call-with-output-file "tmp1.o"
+    (^p (display "xyz" p) (write-string data p) (write-string data p)))
+  (test* "read-block (large)" (list "xyz" data data 60003 #t)
+         (call-with-input-file "tmp1.o"
+           (^p (let* ([a (read-block 3 p)]
+                      [b (read-block 30000 p)]
+                      [c (read-block 40000 p)])
+                 (list (string-incomplete->complete a)
+                       (string-incomplete->complete b)
+                       (string-incomplete->complete c)
+                       (port-tell p)
+                       (eof-object? (read-block 10 p))))))))
+
+;; mmap input port
+(with-output-to-file "tmp1.o" (cut display "abc\ndef\nghi"))
+(test* "open-input-mmap-file" '("abc" "def" "ghi" #t)
+       (call-with-port (open-input-mmap-file "tmp1.o")
+         (^p (let* ([a (read-line p)] [b (read-line p)] [c (read-line p)])
+               (list a b c (eof-object? (read-line p)))))))
+(test* "open-input-mmap-file (seek)" '(#\e 5 "ef\nghi")
+       (call-with-port (open-input-mmap-file "tmp1.o")
+         (^p (port-seek p 5)
+             (let1 c (read-char p)
+               (port-seek p -1 SEEK_CUR)
+               (list c (port-tell p) (get-remaining-input-string p))))))
+(test* "open-input-mmap-file (closed)" ""
+       (let1 p (open-input-mmap-file "tmp1.o")
+         (close-port p)
+         (get-remaining-input-string p)))
+(test* "open-input-mmap-file (nonexistent)" #f
+       (open-input-mmap-file "tmp-nonexistent.o" :if-does-not-exist #f))
+(test* "open-input-mmap-file (views survive close)" #u8(97 98 99)
+       (let* ([m (call-with-input-file "tmp1.o"
+                   (^p (sys-mmap p PROT_READ MAP_PRIVATE 3)))]
+              [v (make-view-uvector m <u8vector> 3)])
+         (close-port (open-input-memory-region m :owner? #t))
+         (gc)
+         v))
+(test* "%sys-munmap" (test-error)
+       (let ([m (call-with-input-file "tmp1.o"
+                  (^p (sys-mmap p PROT_READ MAP_PRIVATE 3)))]
+             [munmap (with-module gauche.internal %sys-munmap)])
+         (munmap m)
+         (munmap m)
+         (open-input-memory-region m)))
+(cond-expand
+ (gauche.os.windows #f)
+ (else
+  (test* "open-input-mmap-file (non-regular file)" (test-error)
+         (open-input-mmap-file "/dev/null"))))
+(with-output-to-file "tmp1.o" (cut display ""))
+(test* "open-input-mmap-file (empty)" #t
+       (eof-object? (call-with-port (open-input-mmap-file "tmp1.o")
+                      read-char)))
+
 (with-output-to-file "tmp1.o" (cut display "\n"))
 (test* "read-line (LF)" ""
        (call-with-input-file "tmp1.o" read-line))
@@ -1071,6 +1071,108 @@
             ("write" ,write)
             ("pprint" ,pprint)))
 
+;;===============================================================
+;; shared heap image
+;;
+
+(test-section "shared heap image")
+
+(use gauche.experimental.shared-heap)
+(use data.trie)
+
+(sys-unlink "test.o")
+
+(let ([tab (alist->hash-table '(("apple" . 1) (banana 2 3) (#\c . 3.5)
+                                (42 . "forty-two"))
+                              'equal?)]
+      [shared (list 1 2)])
+  (shared-heap-save
+   `#(-7 ,(expt 2 70) 1/3 2.5 #\x3042 "str" sym :key () #t #f
+      #u8(1 2 3) #f64(1.0 -2.0) #s16(-1 2)
+      (a b c) ,shared ,shared ,tab)
+   "test.o")
+  (let* ([heap (shared-heap-open "test.o")]
+         [root (shared-heap-root heap)])
+    (test* "root" #t (shared-vector? root))
+    (test* "length" 18 (shared-vector-length root))
+    (test* "atoms"
+           `(-7 ,(expt 2 70) 1/3 2.5 #\x3042 "str" sym :key () #t #f)
+           (map (cut shared-vector-ref root <>) (iota 11)))
+    (test* "out of range" 'none (shared-vector-ref root 18 'none))
+    (test* "uvector views" '(#u8(1 2 3) #t #f64(1.0 -2.0) #s16(-1 2))
+           (let1 u (shared-vector-ref root 11)
+             (list u (uvector-immutable? u)
+                   (shared-vector-ref root 12) (shared-vector-ref root 13))))
+    (test* "list" '(a b c)
+           (let1 p (shared-vector-ref root 14)
+             (list (shared-car p)
+                   (shared-car (shared-cdr p))
+                   (shared-car (shared-cdr (shared-cdr p))))))
+    (test* "list as sequence" '(a b c)
+           (coerce-to <list> (shared-vector-ref root 14)))
+    (test* "sharing" #t
+           (equal? (shared-vector-ref root 15) (shared-vector-ref root 16)))
+    (let1 t (shared-vector-ref root 17)
+      (test* "table" '(1 (2 3) 3.5 "forty-two" none)
+             (list (shared-table-ref t "apple")
+                   (coerce-to <list> (shared-table-ref t 'banana))
+                   (shared-table-ref t #\c)
+                   (shared-table-ref t 42)
+                   (shared-table-ref t "banana" 'none)))
+      (test* "table entries" 4 (shared-table-num-entries t))
+      (test* "table as dictionary" '(#t #f 1)
+             (list (dict-exists? t 'banana) (dict-exists? t "pear")
+                   (dict-get t "apple")))
+      (test* "table immutable" (test-error) (dict-put! t "pear" 5)))
+    (let1 t (shared->native (shared-vector-ref root 17))
+      (test* "table to native" '(1 (2 3) 3.5)
+             (list (hash-table-get t "apple")
+                   (hash-table-get t 'banana)
+                   (hash-table-get t #\c))))
+    (test* "shared->native" '(a b c)
+           (shared->native (shared-vector-ref root 14)))))
+
+(let ([tr (trie '() '("car" . 1) '("cart" . 2) '("cat" . 3) '("dog" . 4)
+                '("あ" . 5))])
+  (shared-heap-save tr "test.o")
+  (let ([t (shared-heap-root (shared-heap-open "test.o"))]
+        [acons* (^[k v s] (acons k v s))])
+    (test* "trie" '(1 2 3 4 5 none)
+           (list (shared-trie-ref t "car") (shared-trie-ref t "cart")
+                 (shared-trie-ref t "cat") (shared-trie-ref t "dog")
+                 (shared-trie-ref t "あ") (shared-trie-ref t "ca" 'none)))
+    (test* "trie prefix" '(("car" . 1) ("cart" . 2) ("cat" . 3))
+           (reverse (shared-trie-common-prefix-fold t "ca" acons* '())))
+    (test* "trie prefix (exact)" '(("car" . 1) ("cart" . 2))
+           (reverse (shared-trie-common-prefix-fold t "car" acons* '())))
+    (test* "trie prefix (none)" '()
+           (shared-trie-common-prefix-fold t "e" acons* '()))
+    (test* "trie fold" 15 (shared-trie-fold t (^[k v s] (+ v s)) 0))
+    (test* "trie to native" '(("car" . 1) ("cart" . 2) ("cat" . 3))
+           (sort (trie-common-prefix (shared->native t) "ca") string<? car))))
+
+(let1 c (list 1 2 3)
+  (set-cdr! (cddr c) c)
+  (shared-heap-save (vector c (make-list 10000 'x)) "test.o")
+  (let* ([root (shared-heap-root (shared-heap-open "test.o"))]
+         [p (shared-vector-ref root 0)])
+    (test* "cycle" #t
+           (equal? p (shared-cdr (shared-cdr (shared-cdr p)))))
+    (test* "cycle to native" '(1 2 3 1 2 3)
+           (let1 n (shared->native p)
+             (list (car n) (cadr n) (caddr n)
+                   (cadddr n) (car (cddddr n)) (cadr (cddddr n)))))
+    (test* "long list" 10000 (size-of (shared-vector-ref root 1)))))
+
+(test* "unstorable object" (test-error)
+       (shared-heap-save (list car) "test.o"))
+(test* "bad image" (test-error)
+       (begin (sys-unlink "test.o")
+              (with-output-to-file "test.o" (cut display (make-string 64 #\a)))
+              (shared-heap-open "test.o")))
+
+(sys-unlink "test.o")
+
 ;;===============================================================
 ;; utf-8 with BOM
 ;;
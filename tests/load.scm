@@ -78,6 +78,35 @@
           (eval '(require "test.o/d") (interaction-environment))
           (eval 'z m))))
 
+;; preload-modules ---------------------------------------
+;; Module test..o.pl-a is loaded from test.o/pl-a.scm.  The diamond
+;; a -> b, c -> d lets b and c be loaded in parallel.
+(rmrf "test.o")
+(sys-mkdir "test.o" #o777)
+(define (write-pl-module name uses body)
+  (with-output-to-file #"test.o/pl-~|name|.scm"
+    (^[]
+      (write `(define-module ,(symbol-append 'test..o.pl- name)
+                ,@(map (^u `(use ,(symbol-append 'test..o.pl- u))) uses)
+                (export ,name)))
+      (write `(select-module ,(symbol-append 'test..o.pl- name)))
+      (write `(define ,name ,body)))))
+(write-pl-module 'd '() 1)
+(write-pl-module 'b '(d) '(+ d 10))
+(write-pl-module 'c '(d) '(+ d 100))
+(write-pl-module 'a '(b c) '(+ b c))
+(with-output-to-file "test.o/pl-e.scm" (^[] (display "(define-module (")))
+
+(test* "preload-modules" '(112 #t #t #t)
+       (begin
+         (preload-modules '(test..o.pl-a) :num-threads 3)
+         (list (eval 'a (find-module 'test..o.pl-a))
+               (module? (find-module 'test..o.pl-b))
+               (module? (find-module 'test..o.pl-c))
+               (module? (find-module 'test..o.pl-d)))))
+(test* "preload-modules (error)" (test-error)
+       (preload-modules '(test..o.pl-e)))
+
 ;; :environment arg -------------------------------------
 (test-section "load environment")
 
@@ -0,0 +1,44 @@
+;;
+;; Measure throughput of gauche.logger writing to a file: the plain
+;; drain, which opens, locks and closes the file for every message, and
+;; the buffered drain, which appends to an in-memory buffer and writes
+;; it out in batches.
+;;
+
+(use gauche.time)
+(use gauche.threads)
+(use gauche.logger)
+
+(define *file* "logperf.o")
+(define *messages* 20000)
+
+;; Log N messages from each of NTHREADS threads.
+(define (run drain n nthreads)
+  (let1 ts (map (^k (thread-start!
+                     (make-thread
+                      (^[] (dotimes [i n]
+                             (log-format drain "thread ~a message ~a" k i))))))
+                (iota nthreads))
+    (for-each thread-join! ts)
+    (log-close drain)))
+
+(define (bench make-drain nthreads)
+  (^[]
+    (sys-unlink *file*)
+    (run (make-drain) *messages* nthreads)))
+
+(define (main args)
+  (dolist [nthreads '(1 4)]
+    (print #"~nthreads thread(s), ~*messages* messages per thread")
+    (time-these/report
+     1
+     `((plain      . ,(bench (^[] (make <log-drain> :path *file*))
+                             nthreads))
+       (buffered   . ,(bench (^[] (make <log-buffered-drain> :path *file*))
+                             nthreads))
+       (buffer-4KB . ,(bench (^[] (make <log-buffered-drain> :path *file*
+                                        :buffer-size 4096))
+                             nthreads)))
+     :metric 'real))
+  (sys-unlink *file*)
+  0)
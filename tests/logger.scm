@@ -14,6 +14,7 @@
   (load "../ext/syslog/syslog"))
 (test-start "logger")
 (use gauche.logger)
+(use gauche.threads)
 (test-module 'gauche.logger)
 
 ;;-------------------------------------------------------------------------
@@ -79,6 +80,94 @@
       (lambda ()
         (call-with-input-file "test.o" port->string-list)))
 
+;;-------------------------------------------------------------------------
+(test-section "buffered drain")
+
+(define (read-log file)
+  (if (file-exists? file)
+    (call-with-input-file file port->string-list)
+    '()))
+
+(sys-system "rm -f test.o test.o.1 test.o.2")
+
+(let1 drain (make <log-buffered-drain> :path "test.o" :prefix "b:"
+                  :buffer-size 1024
+                  :flush-interval #f)
+  (log-format drain "one")
+  (log-format drain "two")
+  (test* "buffered drain (before flush)" '() (read-log "test.o"))
+  (log-flush drain)
+  (test* "buffered drain (after flush)" '("b:one" "b:two") (read-log "test.o"))
+  (dotimes [i 2000] (log-format drain "~4d" i))
+  (test* "buffered drain (buffer full)" #t
+         (> (length (read-log "test.o")) 2))
+  (log-flush drain)
+  (test* "buffered drain (all)" 2002 (length (read-log "test.o"))))
+
+(sys-system "rm -f test.o test.o.1 test.o.2")
+
+(let1 drain (make <log-buffered-drain> :path "test.o" :prefix ""
+                  :flush-interval 0.01)
+  (log-format drain "background")
+  (test* "buffered drain (background flush)" '("background")
+         (let loop ([retry 0])
+           (when (> retry 100)
+             (error "log isn't flushed"))
+           (sys-nanosleep 10000000)
+           (let1 lines (read-log "test.o")
+             (if (null? lines) (loop (+ retry 1)) lines))))
+  (log-format drain "closing")
+  (log-close drain)
+  (test* "log-close" '("background" "closing") (read-log "test.o"))
+  (test* "log-close (flusher exits)" 'terminated
+         (let1 t (slot-ref drain '%flusher)
+           (let loop ([retry 0])
+             (cond [(eq? (thread-state t) 'terminated) 'terminated]
+                   [(> retry 100) (thread-state t)]
+                   [else (sys-nanosleep 10000000) (loop (+ retry 1))]))))
+  (test* "log-close (again)" #t (begin (log-close drain) #t))
+  (test* "log-format after log-close" (test-error)
+         (log-format drain "too late")))
+
+(sys-system "rm -f test.o test.o.1 test.o.2")
+
+(let1 drain (make <log-buffered-drain> :path "test.o" :prefix ""
+                  :flush-interval #f :rotate-size 10 :rotate-count 2)
+  (dolist [msg '("first-line" "second-line" "third-line")]
+    (log-format drain msg)
+    (log-flush drain))
+  (test* "buffered drain (rotate)" '(() ("third-line") ("second-line"))
+         (map read-log '("test.o" "test.o.1" "test.o.2")))
+  (log-close drain))
+
+(sys-system "rm -f test.o test.o.1 test.o.2")
+
+;; Two drains on the same file stand for two processes sharing it.
+(let ([a (make <log-buffered-drain> :path "test.o" :prefix ""
+                :flush-interval #f :rotate-size 10 :rotate-count 2)]
+      [b (make <log-buffered-drain> :path "test.o" :prefix ""
+                :flush-interval #f :rotate-size 10 :rotate-count 2)])
+  (log-format a "first-line")
+  (log-flush a)
+  (log-format b "second-line")
+  (log-flush b)
+  (test* "buffered drain (rotated by other)"
+         '(() ("second-line") ("first-line"))
+         (map read-log '("test.o" "test.o.1" "test.o.2")))
+  (log-close a)
+  (log-close b))
+
+(sys-system "rm -f test.o test.o.1 test.o.2")
+
+(test* "log-open :buffered" #t
+       (begin
+         (log-open "test.o" :buffered #t :flush-interval #f)
+         (log-format "buffered")
+         (log-flush)
+         (and (is-a? (log-default-drain) <log-buffered-drain>)
+              (equal? (length (read-log "test.o")) 1))))
+(log-close)
+
 ;;-------------------------------------------------------------------------
 (test-section "log-from-input-port")
 
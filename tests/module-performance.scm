@@ -0,0 +1,51 @@
+;;
+;; Measure global binding lookup from several threads, which no longer
+;; serializes on the module lock, and the startup time of a program
+;; that uses a number of libraries, loading them one by one with 'use'
+;; and in parallel with preload-modules.  Startup is measured by
+;; running fresh gosh processes; run this in the src directory.
+;; Real time is compared, since the work is done in other threads and
+;; processes.
+;;
+
+(use gauche.time)
+(use gauche.threads)
+(use gauche.process)
+
+(define *lookups* 200000)
+
+(define *libraries*
+  '(rfc.http rfc.json rfc.uri text.csv text.tree data.queue
+    util.match gauche.generator www.cgi srfi.13 file.util))
+
+(define (lookup-in-threads nthreads)
+  (let1 ts (map (^_ (thread-start!
+                     (make-thread
+                      (^[] (dotimes [*lookups*]
+                             (global-variable-ref 'user 'car))))))
+                (iota nthreads))
+    (for-each thread-join! ts)))
+
+(define (gosh . exprs)
+  (do-process `("./gosh" "-ftest" ,@(append-map (^e `("-e" ,(write-to-string e)))
+                                                exprs)
+                "-Eexit")))
+
+(define (main args)
+  (print #"binding lookup, ~*lookups* per thread")
+  (time-these/report
+   1
+   (map (^n (cons #"~|n|-thread(s)" (^[] (lookup-in-threads n))))
+        '(1 2 4 8))
+   :metric 'real)
+  (print "startup")
+  (time-these/report
+   1
+   `((gosh-only . ,(^[] (gosh)))
+     (use       . ,(^[] (apply gosh (map (^m `(use ,m)) *libraries*))))
+     ,@(map (^n (cons #"preload-x~n"
+                      (^[] (gosh `(preload-modules ',*libraries*
+                                                   :num-threads ,n)))))
+            '(2 4)))
+   :metric 'real)
+  0)
@@ -447,6 +447,36 @@
              (acc-dis-1 (make <acc-dis-1>) 2)))
 
 
+;;----------------------------------------------------------------
+(test-section "slot accessor cache")
+
+;; Classes sharing slot names at different positions.  Slot lookup
+;; results are cached per (class, slot), so make sure they don't mix up.
+(define-class <sac-a> () ((x :init-value 'a-x) (y :init-value 'a-y)))
+(define-class <sac-b> () ((y :init-value 'b-y) (x :init-value 'b-x)))
+(define-class <sac-c> (<sac-b>) ((z :init-value 'c-z)))
+
+(test* "slot-ref through cache" '(a-x a-y b-x b-y b-x b-y c-z)
+       (let ([a (make <sac-a>)] [b (make <sac-b>)] [c (make <sac-c>)])
+         (dotimes [i 3] (slot-ref a 'x) (slot-ref b 'x) (slot-ref c 'x))
+         (list (slot-ref a 'x) (slot-ref a 'y)
+               (slot-ref b 'x) (slot-ref b 'y)
+               (~ c 'x) (~ c 'y) (~ c 'z))))
+
+(test* "slot-set! through cache" '(1 2 a-x)
+       (let ([a (make <sac-a>)] [b (make <sac-b>)] [a2 (make <sac-a>)])
+         (slot-set! a 'x 1)
+         (set! (~ b 'x) 2)
+         (list (~ a 'x) (~ b 'x) (~ a2 'x))))
+
+(test* "slot cache and redefinition" '(a-x new-w)
+       (let1 a (make <sac-a>)
+         (slot-ref a 'x)
+         (eval '(define-class <sac-a> ()
+                  ((w :init-value 'new-w) (x :init-value 'a-x)))
+               (current-module))
+         (list (slot-ref a 'x) (slot-ref a 'w))))
+
 ;;----------------------------------------------------------------
 (test-section "module and accessor")
 
@@ -0,0 +1,68 @@
+;;
+;; Measure the cost of parameter references under increasing depth of
+;; parameterize nesting, both for a bare parameter and for libraries
+;; that consult parameters in their inner loops (rfc.json, text.csv).
+;;
+;; Each VM keeps a small cache of parameter bindings, so the cost should
+;; stay flat as the nesting depth grows.
+;;
+
+(use gauche.time)
+(use rfc.json)
+(use text.csv)
+
+(define *count* 1000000)
+(define *depths* '(0 8 32 128))
+
+(define p (make-parameter 0))
+(define q (make-parameter 0))
+
+;; Call THUNK with DEPTH levels of parameterize around it.  Unrelated
+;; parameter Q is rebound at each level so that P is at the bottom.
+(define (with-depth depth thunk)
+  (let loop ([d depth])
+    (if (zero? d)
+      (thunk)
+      (parameterize ([q d]) (loop (- d 1))))))
+
+(define (ref-loop n)
+  (let loop ([i 0] [s 0])
+    (if (= i n) s (loop (+ i 1) (+ s (p))))))
+
+(define (port-loop n)
+  (dotimes [i n] (current-output-port)))
+
+(define *json-text*
+  (construct-json-string
+   (list->vector
+    (map (^i `(("id" . ,i) ("name" . ,(x->string i)) ("tags" . #("a" "b"))))
+         (iota 2000)))))
+
+(define (json-loop n)
+  (dotimes [i (quotient n 100000)]
+    (construct-json-string (parse-json-string *json-text*))))
+
+(define *csv-text*
+  (with-output-to-string
+    (^[] (dotimes [i 5000] (format #t "~a,\"~a\",~a\n" i (* i i) "x y")))))
+
+(define (csv-loop n)
+  (dotimes [i (quotient n 100000)]
+    (let1 reader (make-csv-reader #\,)
+      (with-input-from-string *csv-text*
+        (^[] (let loop () (unless (eof-object? (reader (current-input-port)))
+                            (loop))))))))
+
+(define (bench name proc)
+  (print name)
+  (dolist [depth *depths*]
+    (let1 t (time-result-real
+             (time-this 1 (^[] (with-depth depth (^[] (proc *count*))))))
+      (format #t "  depth ~3d: ~8,3f sec\n" depth t))))
+
+(define (main args)
+  (bench "parameter ref" ref-loop)
+  (bench "current-output-port" port-loop)
+  (bench "rfc.json round trip" json-loop)
+  (bench "text.csv read" csv-loop)
+  0)
@@ -93,6 +93,42 @@
 (test* "base64 omit-padding" "YQ" (base64-encode-message "a" :omit-padding #t))
 (test* "base64 omit-padding" "YTA" (base64-encode-message "a0" :omit-padding #t))
 
+(test* "base64 decode (garbage)" "a0\n"
+       (base64-decode-string-to <string> "YあT*A　K"))
+(test* "base64 decode (strict)" "a0\n"
+       (base64-decode-string-to <string> "Y T　A\nK" :strict #t))
+(test* "base64 decode (strict, garbage)" (test-error)
+       (base64-decode-string-to <string> "YT*AK" :strict #t))
+(test* "base64 decode (strict, garbage)" (test-error)
+       (base64-decode-string-to <string> "YTあAK" :strict #t))
+(test* "base64 decode (strict, premature)" (test-error)
+       (base64-decode-string-to <string> "YTA" :strict #t))
+
+;; Large data goes through the codec in chunks.  Make sure the chunk
+;; boundaries don't affect the result.
+(let* ([data (let1 v (make-u8vector 100003)
+               (dotimes [i (u8vector-length v)]
+                 (u8vector-set! v i (modulo (* i 7919) 251)))
+               v)]
+       [str (u8vector->string data)])
+  (define (encode-port str . opts)
+    (with-string-io str (cut apply base64-encode opts)))
+  (define (decode-port str . opts)
+    (with-string-io str (cut apply base64-decode opts)))
+  (dolist [w '(76 0 1 7)]
+    (let1 enc (base64-encode-message data :line-width w)
+      (test* #"base64 encode large (port, line-width ~w)" enc
+             (encode-port str :line-width w))
+      (test* #"base64 decode large (line-width ~w)" data
+             (base64-decode-string-to <u8vector> enc))
+      (test* #"base64 decode large (port, line-width ~w)" data
+             (string->u8vector (decode-port enc)))))
+  (test* "base32 round trip large" data
+         (base32-decode-string-to <u8vector>
+                                  (base32-encode-message data :line-width 60)))
+  (test* "base16 round trip large" data
+         (base16-decode-string-to <u8vector> (base16-encode-message data))))
+
 ;; Test data from RFC4648
 (define (test-base32 orig encoded encoded-hex)
   (define (test-1 name encoded encoder decoder)
@@ -138,6 +174,13 @@
               ("foobar" "666F6F626172"))))
   (for-each (cut apply test-base16 <>) data))
 
+(test* "base16 decode (lowercase)" "foo"
+       (base16-decode-string-to <string> "666f6F"))
+(test* "base16 decode (lowercase, strict)" (test-error)
+       (base16-decode-string-to <string> "666f6F" :strict #t))
+(test* "base16 encode (lowercase)" "666f6f"
+       (base16-encode-message "foo" :lowercase #t))
+
 ;;--------------------------------------------------------------------
 (test-section "rfc.quoted-printable")
 (use rfc.quoted-printable)
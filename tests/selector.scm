@@ -97,4 +97,59 @@
          (selector-select *sel* 0)
          (list *x* *y*)))
 
+;; The select backend is tested above unless epoll is available; in that
+;; case, test the select backend here, and the cases specific to epoll.
+(define (backend-tests name)
+  (define x #f)
+  (define (set-x port flags) (set! x (read port)))
+  (receive (p0 p1) (sys-pipe)
+    (let1 sel (make <selector>)
+      (selector-add! sel p0 set-x '(r))
+      (test* #"~name: timeout" 0 (selector-select sel 0))
+      (write '(foo) p1) (flush p1)
+      (test* #"~name: select" '(1 (foo)) (list (selector-select sel 0) x))
+      ;; Two handlers on the same condition count as one ready fd.
+      (selector-add! sel p0 (^[port flags] #t) '(r))
+      (write '(bar) p1) (flush p1)
+      (test* #"~name: return value" '(1 (bar))
+             (list (selector-select sel 0) x))
+      (selector-delete! sel p0 #f #f)
+      (write '(baz) p1) (flush p1)
+      (test* #"~name: delete" '(0 (bar)) (list (selector-select sel 0) x))
+      (close-port p0) (close-port p1)))
+  ;; Regular files are always ready
+  (with-output-to-file "test.o" (cut write '(file)))
+  (call-with-input-file "test.o"
+    (^p (let1 sel (make <selector>)
+          (test* #"~name: regular file" '(1 (file))
+                 (begin
+                   (selector-add! sel p set-x '(r))
+                   (list (selector-select sel 0) x))))))
+  (sys-unlink "test.o"))
+
+(cond-expand
+ [gauche.sys.epoll
+  (test-section "select backend")
+  (with-module gauche.selector (set! *use-epoll* #f))
+  (backend-tests "select")
+  (with-module gauche.selector (set! *use-epoll* #t))
+
+  (test-section "epoll backend")
+  (backend-tests "epoll")
+  ;; The selector still has an entry for the closed fd, whose number
+  ;; is then reused.
+  (test* "epoll: reused fd" '(foo)
+         (let ([sel (make <selector>)]
+               [x #f])
+           (receive (p0 p1) (sys-pipe)
+             (selector-add! sel p0 (^[p f] #f) '(r))
+             (close-port p0) (close-port p1))
+           (receive (p0 p1) (sys-pipe)
+             (selector-add! sel p0 (^[p f] (set! x (read p))) '(r))
+             (write '(foo) p1) (flush p1)
+             (selector-select sel 0)
+             (close-port p0) (close-port p1)
+             x)))]
+ [else])
+
 (test-end)
@@ -0,0 +1,47 @@
+;;
+;; Compare a worker's startup and lookup cost between reading a table
+;; from an s-expression file and mapping a shared heap image of it.
+;; Reading has to rebuild the whole table in every process; opening the
+;; image only maps the file, and lookups are done in place.
+;;
+
+(use gauche.time)
+(use gauche.experimental.shared-heap)
+
+(define *size* 100000)
+(define *lookups* 100000)
+
+(define (key i) (format "key-~d" i))
+
+(define (main args)
+  (let1 tab (make-hash-table 'equal?)
+    (dotimes [i *size*]
+      (hash-table-put! tab (key i) (list i (number->string i))))
+    (with-output-to-file "shared-heap.sexp"
+      (^[] (write (hash-table->alist tab))))
+    (shared-heap-save tab "shared-heap.img"))
+  (let ([native #f] [shared #f])
+    (print #"load, ~*size* entries")
+    (time-these/report
+     1
+     `((read
+        . ,(^[] (set! native
+                      (alist->hash-table
+                       (with-input-from-file "shared-heap.sexp" read)
+                       'equal?))))
+       (shared-heap-open
+        . ,(^[] (set! shared
+                      (shared-heap-root
+                       (shared-heap-open "shared-heap.img")))))))
+    (print #"lookup, ~*lookups* times")
+    (time-these/report
+     1
+     `((hash-table-get
+        . ,(^[] (dotimes [i *lookups*]
+                  (hash-table-get native (key (modulo i *size*))))))
+       (shared-table-ref
+        . ,(^[] (dotimes [i *lookups*]
+                  (shared-table-ref shared (key (modulo i *size*)))))))))
+  (sys-unlink "shared-heap.sexp")
+  (sys-unlink "shared-heap.img")
+  0)
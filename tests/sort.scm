@@ -126,6 +126,48 @@
            '("bbb" "CCC" "AAA" "aaa" "BBB" "ccc")
            '("CCC" "ccc" "bbb" "BBB" "AAA" "aaa"))
 
+;; default order is stable, too
+(sort-test "stable-sort stability (nocmp)"
+           stable-sort stable-sort! '()
+           '(2 1.0 3 1 0.0 0 "a")
+           '(0.0 0 1.0 1 2 3 "a"))
+
+;; large inputs take specialized paths (radix sort for fixnums and flonums,
+;; run detection for presorted input).  Compare the results with
+;; the ones sorted with an explicit comparison procedure.
+(let ()
+  (define (pseudo-random-list n seed mod)
+    (let loop ([i 0] [x seed] [r '()])
+      (if (= i n)
+        r
+        (let1 x (modulo (+ (* x 1103515245) 12345) 2147483648)
+          (loop (+ i 1) x (cons (- (modulo x mod) (quotient mod 2)) r))))))
+  (define (check name in)
+    (let1 expected (stable-sort in (^[a b] (< a b)))
+      (test* #"~name (list)" expected (sort in))
+      (test* #"~name (stable list)" expected (stable-sort in))
+      (test* #"~name (vector)" (list->vector expected) (sort (list->vector in)))
+      (test* #"~name (stable vector!)" (list->vector expected)
+             (rlet1 v (list->vector in) (stable-sort! v)))))
+
+  (check "fixnums" (pseudo-random-list 3000 1 100000))
+  (check "fixnums (wide)"
+         (map (cut * <> 1000003) (pseudo-random-list 3000 2 1000000)))
+  (check "fixnums (few keys)" (pseudo-random-list 3000 3 5))
+  (check "flonums" (map (cut / <> 7.0) (pseudo-random-list 3000 4 100000)))
+  (check "mixed" (map (^x (if (odd? x) x (inexact x)))
+                      (pseudo-random-list 3000 5 100000)))
+  (check "presorted" (append (iota 1000) (iota 1000 500) (reverse (iota 1000))))
+  (check "strings" (map number->string (pseudo-random-list 2000 6 100000)))
+
+  (test* "flonum stability (-0.0 and 0.0)"
+         (append (make-list 100 -1.0) '(0.0 -0.0 0.0 -0.0) (make-list 100 1.0))
+         (vector->list
+          (stable-sort (list->vector
+                        (append (make-list 100 1.0) '(0.0 -0.0)
+                                (make-list 100 -1.0) '(0.0 -0.0))))))
+  )
+
 (test-section "sort-by")
 
 (define (sort-by-nocmp key . in&exps)
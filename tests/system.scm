@@ -347,6 +347,13 @@
            :if-exists :append)
          (call-with-input-file "test.dir/zzZzz" read-line)))
 
+(test* "fsync" "abcdeXY"
+       (begin
+         (call-with-output-file "test.dir/zzZzz"
+           (^p (display "XY" p) (sys-fsync p))
+           :if-exists :append)
+         (call-with-input-file "test.dir/zzZzz" read-line)))
+
 (test* "rmdir" #f
        (begin
          (sys-unlink "test.dir/zzZzz")
@@ -841,6 +848,33 @@
   ]
  [else]) ; cond-expand gauche.sys.select
 
+(cond-expand
+ [gauche.sys.epoll
+  (test* "epoll" '(() ((in . #t)) ())
+         (receive (in out) (sys-pipe)
+           (let1 epfd (sys-epoll-create)
+             (unwind-protect
+                 (begin
+                   (sys-epoll-ctl epfd EPOLL_CTL_ADD in EPOLLIN)
+                   (let1 a (sys-epoll-wait epfd 8 0)
+                     (display "x" out)
+                     (flush out)
+                     (let1 b (sys-epoll-wait epfd 8 #f)
+                       (read-char in)
+                       (sys-epoll-ctl epfd EPOLL_CTL_DEL in)
+                       (display "y" out)
+                       (flush out)
+                       (list a
+                             (map (^p (cons (if (eqv? (car p)
+                                                      (port-file-number in))
+                                              'in
+                                              (car p))
+                                            (logtest (cdr p) EPOLLIN)))
+                                  b)
+                             (sys-epoll-wait epfd 8 0)))))
+               (sys-close epfd)))))]
+ [else])
+
 ;;-------------------------------------------------------------------
 (test-section "signal handling")
 
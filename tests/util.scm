@@ -449,6 +449,32 @@
          (lcs z (apply append (make-list 10 (iota 10 9 -1)))))
   )
 
+;; Inputs larger than the basic algorithm's limit go through the linear
+;; space version.  The C kernel (for equal? etc.) and the Scheme version
+;; (for other predicates) must agree.
+(let* ([a (map (^i (modulo (* i 7) 13)) (iota 1500))]
+       [b (map (^i (if (zero? (modulo i 5)) 'x (modulo (* i 7) 13)))
+               (iota 1600))]
+       [av (list->vector a)]
+       [bv (list->vector b)]
+       [valid? (^[r] (let loop ([r (cadr r)] [pa -1] [pb -1])
+                       (or (null? r)
+                           (let ([e (car (car r))]
+                                 [ia (cadr (car r))]
+                                 [ib (caddr (car r))])
+                             (and (> ia pa) (> ib pb)
+                                  (equal? e (vector-ref av ia))
+                                  (equal? e (vector-ref bv ib))
+                                  (loop (cdr r) ia ib))))))]
+       [r1 (lcs-with-positions a b)]
+       [r2 (lcs-with-positions a b (^[x y] (equal? x y)))])
+  (test* "lcs (large, kernel)" #t (valid? r1))
+  (test* "lcs (large, scheme)" #t (valid? r2))
+  (test* "lcs (large, agree)" #t (equal? r1 r2))
+  (test* "lcs (large, strings)" (car r1)
+         (car (lcs-with-positions (map x->string a) (map x->string b)
+                                  string=?))))
+
 (test* "lcs edit-list"
        '(((- 0 a))
          ((+ 2 d))